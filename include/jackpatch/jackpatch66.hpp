@@ -30,13 +30,14 @@
  * \library       jackpatch66 application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-02-25
- * \updates       2025-03-07
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
  *   To do.
  */
 
+#include <cstdint>                      /* std::uint32_t                    */
 #include <string>                       /* std::string                      */
 #include <vector>                       /* std::vector                      */
 
@@ -57,7 +58,7 @@
  *  We're replacing most of the C code with C++ code.
  */
 
-using client_port = struct
+struct client_port
 {
     std::string client;
     std::string port;
@@ -77,50 +78,55 @@ using client_port = struct
  *  -   dequeu(p): if p is not null, simply frees it. It is called only
  *      in clear_all_patches(), so we put the code there and remove this
  *      function.
- *  -   process_patch(). Scans a patch-record specification,
- *      creates a new patch_record, and passes it to enqueue(). Two are created
- *      if a "|" character is encountered, meaning bidirectional.
+ *  -   add_patch(). Creates a new patch_record from a patch parsed by
+ *      jackpatch::patch_file, and passes it to enqueue(). The parser makes
+ *      two if a "|" character is encountered, meaning bidirectional.
  *  -   connect_path(). Creates JACK source and destination port names and
  *      then connects the two ports.
  *  -   inactivate_path(). Sets the patch-record active flag to false.
  *  -   snapshot(). See it's function banner.
  *
- *  Why not use an std::list or and std::forward_list? Or even just vector?
+ *  The port IDs are filled in by jackpatch::patch_graph::add().  This is a
+ *  named struct, not an alias of an unnamed one, so that it has linkage
+ *  and can be shared with the patchgraph module.
  */
 
-using patch_record = struct
+struct patch_record
 {
     client_port pr_src;                 /* source client port               */
     client_port pr_dst;                 /* destination client port          */
     bool pr_active;                     /* true if patch is activated       */
+    std::uint32_t pr_src_id;            /* interned "client:port" of source */
+    std::uint32_t pr_dst_id;            /* interned "client:port" of dest.  */
 };
 
 /**
- *  Operations on port_record.
- *
- *  -   enqueue_known_port(). Creates a new port-record and hooks it to the
- *      existing known-port list in the same manner as enqueue(patch_record).
- *  -   remove_known_port(). Removes a port and marks it inactive in the other
- *      ports.
- *  -   find_known_port(). Iterates through the known-ports and returns
- *      the name of a match. Used only in the connect_path() function.
+ *  This structure is written to the JACK ring-buffer by the port
+ *  registration and connection callbacks, and read in batches by
+ *  check_for_new_ports().  Every record has the same size, so the
+ *  callbacks never allocate, and the reader never has to peek at a
+ *  length.  A full JACK port name is at most jack_port_name_size() bytes,
+ *  320 on Linux.
  */
 
-using port_record = struct
+const int c_port_name_max = 512;
+
+enum class notification
 {
-    std::string port;
+    registered,                         /* pnr_port appeared                */
+    unregistered,                       /* pnr_port is gone                 */
+    connected,                          /* pnr_port (output) to pnr_other   */
+    disconnected                        /* pnr_port (output) from pnr_other */
 };
 
-/**
- *  This structure is read from the JACK ring-buffer in dequeue_new_port()
- *  in check_for_new_ports.
- */
-
 using port_notification_record = struct
 {
-    int pnr_length;                     /* len, the length of the ???       */
-    int pnr_registered;                 /* reg: non-zero if registered      */
-    char pnr_port [256];                /* char pnr_port[]?  TODO           */
+    long long pnr_stamp;                /* CLOCK_MONOTONIC time, in ns      */
+    notification pnr_kind;              /* what happened                    */
+    int pnr_length;                     /* the length of the port name      */
+    int pnr_other_length;               /* the length of the other name     */
+    char pnr_port [c_port_name_max];    /* the full "client:port" name      */
+    char pnr_other [c_port_name_max];   /* the input port of a connection   */
 };
 
 /**
@@ -130,19 +136,14 @@ using port_notification_record = struct
 using patchfunc = void (*) (patch_record &);
 
 /**
- *  Provides a list of patch_records. There's no real need for a linked list
- *  (std::list or std::forward_list) for a set of data we anticipate to
- *  be a dozen or two. Note that vector<> and list<> share many of the
- *  same operations. One exception is sort().
- *
- *  Same for lists of port_records.
+ *  Provides a list of patch_records, held by jackpatch::patch_graph along
+ *  with the known ports.  The C version used linked lists:
  *
  *      static patch_record * g_patch_list = nullptr;
  *      static port_record * g_known_ports = nullptr;
  */
 
 using patch_list = std::vector<patch_record>;
-using port_list = std::vector<port_record>;
 
 #endif          // defined NSM66_JACKPATCH66_HPP
 
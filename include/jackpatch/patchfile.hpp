@@ -0,0 +1,159 @@
+#if ! defined NSM66_JACKPATCH_PATCHFILE_HPP
+#define NSM66_JACKPATCH_PATCHFILE_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          patchfile.hpp
+ *
+ *    This module provides the parser of the .jackpatch files.
+ *
+ * \library       jackpatch66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The file used to be read into a vector of lines, and each line split
+ *  into four new strings by nsm::process_patch() (or by sscanf() with "%m"
+ *  allocations), at the first colon of each side.  Now the file is mapped
+ *  into memory and parsed in one pass; the client and port names handed to
+ *  the handler are views into the mapping, valid only during the call.
+ *  Nothing is allocated per line.
+ *
+ *  A JACK client name can contain a colon (e.g. the a2jmidid clients of
+ *  some setups), so the first colon is not always the boundary.  Given
+ *  the names of the live JACK clients, the longest one that matches the
+ *  start of a "client:port" name wins; without a match, the first colon is
+ *  used, as before.
+ *
+ *  Two formats are accepted:
+ *
+ *      -   The text format written by snapshot(), one patch per line:
+ *          "client:port |> client:port".  The direction can also be "|<",
+ *          and "||" makes two patches, one in each direction.
+ *      -   A compact indexed format, for very large graphs, in which each
+ *          port name is written only once.  The first line is the header
+ *          below.  Each "= client:port" line defines the next port index,
+ *          starting at 0, and each patch line uses those indexes, as in
+ *          "0 |> 1".
+ *
+ *  In both, blank lines and lines starting with '#' are skipped.
+ */
+
+#include <functional>                   /* std::function<>                  */
+#include <string>                       /* std::string                      */
+#include <string_view>                  /* std::string_view                 */
+#include <vector>                       /* std::vector<>                    */
+
+namespace jackpatch
+{
+
+/**
+ *  Provides the parsing of a .jackpatch file.
+ */
+
+class patch_file
+{
+
+public:
+
+    /**
+     *  One side of a patch, as views into the parsed text.
+     */
+
+    using endpoint = struct
+    {
+        std::string_view e_client;
+        std::string_view e_port;
+    };
+
+    using handler = std::function<void (const endpoint &, const endpoint &)>;
+
+    static const char * const c_indexed_header;
+
+private:
+
+    /**
+     *  The names of the live JACK clients, sorted, for resolving the
+     *  client and port boundary.
+     */
+
+    std::vector<std::string> m_clients;
+
+    /**
+     *  The ports defined by an indexed file, reused from file to file.
+     */
+
+    std::vector<endpoint> m_ports;
+
+    int m_lines;
+    int m_patches;
+    int m_bad_lines;
+    bool m_indexed;
+
+public:
+
+    patch_file ();
+
+    patch_file (const patch_file &) = delete;
+    patch_file & operator = (const patch_file &) = delete;
+
+    void clients (const std::vector<std::string> & names);
+    bool load (const std::string & file, handler h);
+    bool parse (std::string_view text, handler h);
+    endpoint split (std::string_view fullname) const;
+
+    int lines () const
+    {
+        return m_lines;
+    }
+
+    int patches () const
+    {
+        return m_patches;
+    }
+
+    int bad_lines () const
+    {
+        return m_bad_lines;
+    }
+
+    bool indexed () const
+    {
+        return m_indexed;
+    }
+
+private:
+
+    bool parse_line (std::string_view line, handler & h);
+    bool lookup_port (std::string_view index, endpoint & e) const;
+    bool known_client (std::string_view name) const;
+
+};              // class patch_file
+
+}               // namespace jackpatch
+
+#endif          // defined NSM66_JACKPATCH_PATCHFILE_HPP
+
+/*
+ * patchfile.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,185 @@
+#if ! defined NSM66_JACKPATCH_PATCHGRAPH_HPP
+#define NSM66_JACKPATCH_PATCHGRAPH_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          patchgraph.hpp
+ *
+ *    This module provides the patches of jackpatch66, indexed by interned
+ *    port names.
+ *
+ * \library       jackpatch66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The patches and the known ports used to be vectors of strings, scanned
+ *  and compared for every new port, every removed port, and every
+ *  connection attempt.  Restoring a studio graph of thousands of ports
+ *  and connections took O(ports x patches) string comparisons.
+ *
+ *  Now each full "client:port" name is interned once to a port_id.  Each
+ *  patch holds the IDs of its two ports, and each port has the list of
+ *  the patches it is in, so that a port appearing or disappearing only
+ *  touches its own patches.  The known (present in JACK) flag is kept per
+ *  port_id.  A patch that is already in the graph is not added again.
+ *
+ *  Interned names are never forgotten; clear() drops only the patches.
+ *  The names are held in a deque, which never moves them, so that the ID
+ *  map can be keyed by views of them, and a name is looked up without
+ *  building a string.  For that reason the graph is not copyable.
+ *
+ *  The graph is also the live model of the JACK connections: the active
+ *  flag of a patch follows the connect callback, and any change marks the
+ *  graph dirty, so that a save which finds it clean can skip the file.
+ *  prune() drops the patches the user disconnected, which are the
+ *  inactive ones whose two ports are both present.
+ */
+
+#include <cstdint>                      /* std::uint32_t, std::uint64_t     */
+#include <deque>                        /* std::deque<>                     */
+#include <string>                       /* std::string                      */
+#include <string_view>                  /* std::string_view                 */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+#include "jackpatch66.hpp"              /* patch_record, patch_list         */
+
+namespace jackpatch
+{
+
+/**
+ *  Provides the patch list and the known ports.
+ */
+
+class patch_graph
+{
+
+public:
+
+    using port_id = std::uint32_t;
+    using index_list = std::vector<std::size_t>;
+
+    static const port_id c_no_port = port_id(-1);
+    static const std::size_t c_no_patch = std::size_t(-1);
+
+private:
+
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string_view, port_id> m_ids;
+    std::vector<bool> m_known;
+    std::vector<index_list> m_adjacency;
+    patch_list m_patches;
+    std::unordered_map<std::uint64_t, std::size_t> m_pairs;
+    std::size_t m_known_count;
+    bool m_dirty;
+
+public:
+
+    patch_graph ();
+    patch_graph (const patch_graph &) = delete;
+    patch_graph & operator = (const patch_graph &) = delete;
+
+    port_id intern (std::string_view fullname);
+    port_id find (std::string_view fullname) const;
+    bool add (patch_record & pr);
+    std::size_t find_patch (port_id src, port_id dst) const;
+    void active (std::size_t i, bool flag);
+    std::size_t prune ();
+    void clear ();
+    void known (port_id id, bool flag);
+    const index_list & patches_of (port_id id) const;
+
+    bool dirty () const
+    {
+        return m_dirty;
+    }
+
+    void dirty (bool flag)
+    {
+        m_dirty = flag;
+    }
+
+    const std::string & name (port_id id) const
+    {
+        return m_names[id];
+    }
+
+    bool known (port_id id) const
+    {
+        return id < m_known.size() && m_known[id];
+    }
+
+    std::size_t known_count () const
+    {
+        return m_known_count;
+    }
+
+    std::size_t port_count () const
+    {
+        return m_names.size();
+    }
+
+    patch_record & patch (std::size_t i)
+    {
+        return m_patches[i];
+    }
+
+    patch_list & patches ()
+    {
+        return m_patches;
+    }
+
+    const patch_list & patches () const
+    {
+        return m_patches;
+    }
+
+    std::size_t size () const
+    {
+        return m_patches.size();
+    }
+
+    bool empty () const
+    {
+        return m_patches.empty();
+    }
+
+private:
+
+    void index (std::size_t i);
+
+    static std::uint64_t pair_key (port_id src, port_id dst)
+    {
+        return (std::uint64_t(src) << 32) | std::uint64_t(dst);
+    }
+
+};              // class patch_graph
+
+}               // namespace jackpatch
+
+#endif          // defined NSM66_JACKPATCH_PATCHGRAPH_HPP
+
+/*
+ * patchgraph.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,169 @@
+#if ! defined NSM66_NSMD_ADDRESSCACHE_HPP
+#define NSM66_NSMD_ADDRESSCACHE_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          addresscache.hpp
+ *
+ *    This module provides shared, reference-counted OSC addresses.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The address returned by lo_message_get_source() belongs to the liblo
+ *  server and is overwritten by the next message received.  A handler
+ *  that waits for clients (and so dispatches other messages) must copy
+ *  it first.  Doing that with lo_address_new_from_url() on every reply
+ *  costs a URL format, a parse, and an allocation, and the copies were
+ *  never freed.
+ *
+ *  Here each peer (host, port, protocol) gets one lo_address.  Users
+ *  acquire() and release() it; an address nobody holds stays in a small
+ *  LRU list, so a GUI or script talking to us repeatedly reuses the same
+ *  object, and the least recently used idle address is freed when the
+ *  list is full.
+ */
+
+#include <list>                         /* std::list<>                      */
+#include <string>                       /* std::string                      */
+#include <unordered_map>                /* std::unordered_map<>             */
+
+#include "lo/lo.h"                      /* lo_address, lo_message           */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the cache of peer addresses.
+ */
+
+class address_cache
+{
+
+private:
+
+    using lru_list = std::list<std::string>;
+
+    /**
+     *  A cached address. The LRU position is valid only while the
+     *  reference count is 0.
+     */
+
+    using slot = struct
+    {
+        lo_address s_addr;
+        int s_refs;
+        lru_list::iterator s_idle;
+    };
+
+    std::unordered_map<std::string, slot> m_slots;
+    std::unordered_map<lo_address, std::string> m_keys;
+    lru_list m_idle;
+    std::size_t m_idle_capacity;
+    long m_hits;
+    long m_misses;
+
+public:
+
+    address_cache (std::size_t idlecapacity = 16);
+    ~address_cache ();
+
+    address_cache (const address_cache &) = delete;
+    address_cache & operator = (const address_cache &) = delete;
+
+    static std::string address_key (lo_address addr);
+
+    lo_address acquire (lo_address source);
+    lo_address acquire (const std::string & url);
+    void release (lo_address addr);
+    const std::string & key (lo_address addr) const;
+
+    std::size_t size () const
+    {
+        return m_slots.size();
+    }
+
+    long hits () const
+    {
+        return m_hits;
+    }
+
+    long misses () const
+    {
+        return m_misses;
+    }
+
+private:
+
+    lo_address lookup (const std::string & key);
+    void insert (const std::string & key, lo_address addr);
+    void evict ();
+
+};              // class address_cache
+
+/**
+ *  Holds one reference to a cached address for the life of a scope,
+ *  typically an OSC handler that must reply after waiting on clients.
+ */
+
+class address_ref
+{
+
+private:
+
+    address_cache & m_cache;
+    lo_address m_addr;
+
+public:
+
+    address_ref (address_cache & cache, lo_address source) :
+        m_cache (cache),
+        m_addr  (cache.acquire(source))
+    {
+        // no code
+    }
+
+    ~address_ref ()
+    {
+        m_cache.release(m_addr);
+    }
+
+    address_ref (const address_ref &) = delete;
+    address_ref & operator = (const address_ref &) = delete;
+
+    lo_address get () const
+    {
+        return m_addr;
+    }
+
+};              // class address_ref
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_ADDRESSCACHE_HPP
+
+/*
+ * addresscache.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
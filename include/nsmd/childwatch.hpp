@@ -0,0 +1,134 @@
+#if ! defined NSM66_NSMD_CHILDWATCH_HPP
+#define NSM66_NSMD_CHILDWATCH_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          childwatch.hpp
+ *
+ *    This module provides the supervision of the client processes with
+ *    process file descriptors (pidfd).
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Each client process is held by a pidfd_open() descriptor in the event
+ *  loop.  The descriptor becomes readable when the process exits.  For a
+ *  child of nsmd, waitid(P_PIDFD) then reaps exactly that process; a
+ *  pidfd keeps referring to the same process, so PID reuse cannot fool
+ *  it.  A client that nsmd did not start (it announced on its own) can be
+ *  watched too, which replaces polling it with kill(pid, 0).
+ *
+ *  Linux 5.3 has pidfd_open() but not waitid(P_PIDFD); there a child is
+ *  reaped with waitpid() on its PID when its pidfd becomes readable.
+ *
+ *  On kernels without pidfd_open() (older than 5.3), reap_children()
+ *  falls back to reaping every exited child with waitpid(-1) on SIGCHLD,
+ *  as before; with pidfds, SIGCHLD only reaps the children that could
+ *  not be watched.  Either way, each exit is reported exactly once.
+ */
+
+#include <functional>                   /* std::function<>                  */
+#include <map>                          /* std::map<>                       */
+#include <set>                          /* std::set<>                       */
+
+#include "eventloop.hpp"                /* nsmd::eventloop class            */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the pidfd supervision of processes.
+ */
+
+class child_watch
+{
+
+public:
+
+    /**
+     *  Called once per ended process, with its PID and its exit status, or
+     *  -1 if it was killed by a signal or is not a child of nsmd.
+     */
+
+    using ended = std::function<void (int, int)>;
+
+private:
+
+    eventloop & m_loop;
+    ended m_ended;
+    bool m_supported;
+    bool m_waitid_pidfd;                /* waitid(P_PIDFD) works            */
+
+    /**
+     *  The pidfd of each watched process, and whether it is our child.
+     */
+
+    std::map<int, int> m_pidfds;
+    std::set<int> m_children;
+
+    /**
+     *  Children whose pidfd_open() failed, reaped on SIGCHLD.
+     */
+
+    std::set<int> m_unwatched;
+
+public:
+
+    child_watch (eventloop & loop);
+    ~child_watch ();
+
+    child_watch (const child_watch &) = delete;
+    child_watch & operator = (const child_watch &) = delete;
+
+    bool initialize (ended callback);
+    bool watch (int pid, bool child);
+    bool watching (int pid) const;
+    void reap_children ();
+
+    bool supported () const
+    {
+        return m_supported;
+    }
+
+    std::size_t size () const
+    {
+        return m_pidfds.size();
+    }
+
+private:
+
+    void handle (int pid);
+    void unwatch (int pid);
+    void report (int pid, int status);
+
+};              // class child_watch
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_CHILDWATCH_HPP
+
+/*
+ * childwatch.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
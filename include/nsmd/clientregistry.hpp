@@ -0,0 +1,182 @@
+#if ! defined NSM66_NSMD_CLIENTREGISTRY_HPP
+#define NSM66_NSMD_CLIENTREGISTRY_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          clientregistry.hpp
+ *
+ *    This module provides the indexed list of clients of the session.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The clients are kept in session order in a vector, which is what the
+ *  loops over all clients iterate.  Lookups by PID, client ID, OSC
+ *  address (host, port, and protocol) and executable go through hash
+ *  indices, and the number of clients with a reply pending and the number
+ *  of "responsive" clients (announced, or failed to launch) are kept as
+ *  running counts.
+ *
+ *  A Client that has been added holds a pointer back to the registry, and
+ *  its setters for the indexed fields call refresh(), so the indices and
+ *  counts never go stale.  The registry does not own the clients; callers
+ *  still delete them after removal.
+ */
+
+#include <string>                       /* std::string                      */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+#include "nsm66d.hpp"                   /* Client class                     */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the clients of the session with constant-time lookups.
+ */
+
+class client_registry
+{
+
+public:
+
+    using container = std::vector<Client *>;
+    using iterator = container::iterator;
+    using const_iterator = container::const_iterator;
+
+private:
+
+    /**
+     *  The values under which a client is currently indexed and counted.
+     *  A change in the client is found by comparing against these.
+     */
+
+    using entry = struct
+    {
+        int e_pid;
+        std::string e_client_id;
+        std::string e_exe_path;
+        lo_address e_addr;
+        std::string e_addr_key;
+        bool e_reply_pending;
+        bool e_responsive;
+    };
+
+    container m_clients;
+    std::unordered_map<const Client *, entry> m_entries;
+    std::unordered_map<int, Client *> m_by_pid;
+    std::unordered_map<std::string, Client *> m_by_id;
+    std::unordered_map<std::string, Client *> m_by_address;
+    std::unordered_multimap<std::string, Client *> m_by_exe;
+    int m_pending_replies;
+    int m_responsive;
+
+public:
+
+    client_registry ();
+    ~client_registry ();
+
+    client_registry (const client_registry &) = delete;
+    client_registry & operator = (const client_registry &) = delete;
+
+    void add (Client * c);
+    void remove (Client * c);
+    iterator erase (iterator it);
+    void clear ();
+    void refresh (Client * c);
+
+    Client * by_pid (int pid) const;
+    Client * by_id (const std::string & id) const;
+    Client * by_address (lo_address addr) const;
+    Client * expected (const std::string & exe, int pid) const;
+
+    const container & clients () const
+    {
+        return m_clients;
+    }
+
+    container::size_type size () const
+    {
+        return m_clients.size();
+    }
+
+    bool empty () const
+    {
+        return m_clients.empty();
+    }
+
+    iterator begin ()
+    {
+        return m_clients.begin();
+    }
+
+    iterator end ()
+    {
+        return m_clients.end();
+    }
+
+    const_iterator begin () const
+    {
+        return m_clients.begin();
+    }
+
+    const_iterator end () const
+    {
+        return m_clients.end();
+    }
+
+    /**
+     *  The number of active clients that have a command pending.
+     */
+
+    int pending_replies () const
+    {
+        return m_pending_replies;
+    }
+
+    /**
+     *  The number of clients that announced or failed to launch.
+     */
+
+    int responsive () const
+    {
+        return m_responsive;
+    }
+
+private:
+
+    void index (Client * c, entry & e);
+    void unindex (const Client * c, const entry & e);
+
+};              // class client_registry
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_CLIENTREGISTRY_HPP
+
+/*
+ * clientregistry.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
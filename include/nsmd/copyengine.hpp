@@ -0,0 +1,196 @@
+#if ! defined NSM66_NSMD_COPYENGINE_HPP
+#define NSM66_NSMD_COPYENGINE_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          copyengine.hpp
+ *
+ *    This module provides the copying of a session directory tree in the
+ *    background, for /nsm/server/duplicate.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Sessions can hold tens of gigabytes of audio, which a byte-for-byte
+ *  copy in the daemon's thread took minutes to duplicate.  Now:
+ *
+ *      -   The tree is walked in the daemon's thread, creating the
+ *          directories and symbolic links, and listing the files.
+ *      -   A small pool of worker threads copies the files, largest
+ *          first, so the big audio files are copied side by side.
+ *      -   Each file is first cloned with the FICLONE ioctl, which on a
+ *          file-system with reflinks (Btrfs, XFS) shares the data and is
+ *          nearly instant.  Failing that, copy_file_range() copies it in
+ *          the kernel (server-side on NFS), and failing that, read() and
+ *          write() are used.
+ *      -   The workers signal an eventfd after each file and each chunk,
+ *          which the event loop uses to report the progress, and to
+ *          notice the end of the copy.
+ */
+
+#include <atomic>                       /* std::atomic<>                    */
+#include <cstdint>                      /* std::uint64_t                    */
+#include <mutex>                        /* std::mutex                       */
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* mode_t                           */
+#include <thread>                       /* std::thread                      */
+#include <time.h>                       /* struct timespec                  */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the background copy of a directory tree.
+ */
+
+class copy_engine
+{
+
+private:
+
+    /**
+     *  A regular file to copy.
+     */
+
+    using job = struct
+    {
+        std::string j_source;
+        std::string j_destination;
+        std::uint64_t j_size;
+        mode_t j_mode;
+        struct timespec j_atime;
+        struct timespec j_mtime;
+    };
+
+    std::size_t m_worker_count;
+    int m_event_fd;
+    std::vector<job> m_jobs;
+    std::vector<std::thread> m_threads;
+    std::string m_destination;
+    std::uint64_t m_bytes_total;
+    bool m_running;
+    bool m_made_destination;
+
+    /*
+     *  Shared with the workers.
+     */
+
+    std::atomic<std::size_t> m_next_job;
+    std::atomic<std::size_t> m_active_workers;
+    std::atomic<std::size_t> m_files_done;
+    std::atomic<std::uint64_t> m_bytes_done;
+    std::atomic<bool> m_cancelled;
+    std::atomic<long> m_reflinked;
+    std::atomic<long> m_ranged;
+    std::atomic<long> m_streamed;
+    std::mutex m_error_mutex;
+    std::string m_error;
+
+public:
+
+    copy_engine (std::size_t workers = 4);
+    ~copy_engine ();
+
+    copy_engine (const copy_engine &) = delete;
+    copy_engine & operator = (const copy_engine &) = delete;
+
+    bool initialize ();
+    bool start (const std::string & source, const std::string & destination);
+    bool wait ();
+    void cancel ();
+    void acknowledge ();
+    bool remove_destination ();
+    std::string error ();
+
+    int descriptor () const
+    {
+        return m_event_fd;
+    }
+
+    bool running () const
+    {
+        return m_running;
+    }
+
+    bool finished () const
+    {
+        return m_active_workers.load() == 0;
+    }
+
+    std::size_t files_total () const
+    {
+        return m_jobs.size();
+    }
+
+    std::size_t files_done () const
+    {
+        return m_files_done.load();
+    }
+
+    std::uint64_t bytes_total () const
+    {
+        return m_bytes_total;
+    }
+
+    std::uint64_t bytes_done () const
+    {
+        return m_bytes_done.load();
+    }
+
+    long reflinked () const
+    {
+        return m_reflinked.load();
+    }
+
+    long ranged () const
+    {
+        return m_ranged.load();
+    }
+
+    long streamed () const
+    {
+        return m_streamed.load();
+    }
+
+private:
+
+    bool scan (const std::string & source, const std::string & destination);
+    void work ();
+    bool copy_file (const job & j);
+    int copy_range (int in, int out);
+    bool copy_stream (int in, int out);
+    void notify ();
+    void record_error (const std::string & what, const std::string & path);
+
+};              // class copy_engine
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_COPYENGINE_HPP
+
+/*
+ * copyengine.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,132 @@
+#if ! defined NSM66_NSMD_EVENTLOOP_HPP
+#define NSM66_NSMD_EVENTLOOP_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          eventloop.hpp
+ *
+ *    This module provides the single reactor that drives nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The daemon used to poll in fixed ticks (100 ms, 50 ms, or 1 s) in each
+ *  of its wait functions.  Now every source of work is a file descriptor
+ *  in one epoll set:
+ *
+ *      -   The SIGCHLD signalfd.
+ *      -   The liblo server socket.
+ *      -   One timerfd, always armed for the earliest pending deadline.
+ *
+ *  A wait is expressed as a predicate plus a timeout.  The predicate is
+ *  re-evaluated only after something actually happened, so a reply,
+ *  announce, or child exit ends a wait immediately.
+ *
+ *  Idle handlers run at the end of every iteration, after all the ready
+ *  descriptors were dispatched; the GUI queue is flushed that way.
+ */
+
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <functional>                   /* std::function<>                  */
+#include <map>                          /* std::map<>                       */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides epoll-based dispatching of descriptors and timers.
+ */
+
+class eventloop
+{
+
+public:
+
+    using handler = std::function<void ()>;
+    using predicate = std::function<bool ()>;
+    using clock = std::chrono::steady_clock;
+    using timer_id = unsigned;
+
+private:
+
+    /**
+     *  A pending timer. A non-zero interval makes the timer periodic.
+     */
+
+    using timer = struct
+    {
+        timer_id t_id;
+        long t_interval_ms;
+        handler t_callback;
+    };
+
+    using timer_key = std::pair<clock::time_point, timer_id>;
+
+    int m_epoll_fd;
+    int m_timer_fd;
+    timer_id m_next_timer_id;
+    std::map<int, handler> m_descriptors;
+    std::map<timer_key, timer> m_timers;
+    std::map<timer_id, clock::time_point> m_timer_deadlines;
+    std::vector<handler> m_idle_handlers;
+
+public:
+
+    eventloop ();
+    ~eventloop ();
+
+    eventloop (const eventloop &) = delete;
+    eventloop & operator = (const eventloop &) = delete;
+
+    bool initialize ();
+
+    bool active () const
+    {
+        return m_epoll_fd >= 0;
+    }
+
+    bool add_descriptor (int fd, handler h);
+    bool remove_descriptor (int fd);
+    timer_id add_timer (long ms, handler h, bool periodic = false);
+    bool cancel_timer (timer_id id);
+    void add_idle (handler h);
+    bool run_once (long timeout_ms);
+    bool wait_until (predicate done, long timeout_ms);
+
+private:
+
+    void arm_timer ();
+    void fire_expired_timers ();
+
+};              // class eventloop
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_EVENTLOOP_HPP
+
+/*
+ * eventloop.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
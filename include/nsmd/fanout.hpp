@@ -0,0 +1,131 @@
+#if ! defined NSM66_NSMD_FANOUT_HPP
+#define NSM66_NSMD_FANOUT_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          fanout.hpp
+ *
+ *    This module provides the sending of one OSC message to many peers,
+ *    for /nsm/server/broadcast.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Controllers broadcast transport and tempo messages to every client
+ *  several times a second.  The broadcast used to copy the arguments into
+ *  an osc_value_list and have liblo build the message again for each
+ *  client.  Here the message is built and serialised once, into a buffer
+ *  that is reused from one broadcast to the next, and the bytes are sent
+ *  with sendto() on the server's UDP socket.
+ *
+ *  The socket address of each peer is resolved once, from its numeric
+ *  host and port, and kept by peer key (see address_cache::address_key()),
+ *  so a freed and reused lo_address cannot point to a stale one.  A peer
+ *  that is not UDP, or whose host is not numeric, gets the same message
+ *  through lo_send_message_from().
+ *
+ *  Every argument type of the incoming message is passed through,
+ *  including blobs ('b') and doubles ('d'), not only 's', 'i', and 'f'.
+ */
+
+#include <string>                       /* std::string                      */
+#include <sys/socket.h>                 /* struct sockaddr_storage          */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+#include "lo/lo.h"                      /* lo_message, lo_address, lo_arg   */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the serialise-once OSC fan-out.
+ */
+
+class fanout
+{
+
+private:
+
+    /**
+     *  A resolved peer; an empty one (length 0) could not be resolved.
+     */
+
+    using peer = struct
+    {
+        struct sockaddr_storage p_addr;
+        socklen_t p_length;
+    };
+
+    std::string m_path;
+    lo_message m_message;
+    std::vector<char> m_buffer;
+    std::size_t m_size;
+    std::unordered_map<std::string, peer> m_peers;
+    long m_sent;
+    long m_fallbacks;
+
+public:
+
+    fanout ();
+    ~fanout ();
+
+    fanout (const fanout &) = delete;
+    fanout & operator = (const fanout &) = delete;
+
+    bool build
+    (
+        const std::string & path,
+        const char * types,
+        lo_arg ** argv,
+        int first,
+        int argc
+    );
+    bool send (lo_server server, lo_address to, const std::string & key);
+
+    long sent () const
+    {
+        return m_sent;
+    }
+
+    long fallbacks () const
+    {
+        return m_fallbacks;
+    }
+
+private:
+
+    const peer & resolve (lo_address to, const std::string & key);
+    void clear ();
+
+};              // class fanout
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_FANOUT_HPP
+
+/*
+ * fanout.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
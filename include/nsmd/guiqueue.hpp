@@ -0,0 +1,173 @@
+#if ! defined NSM66_NSMD_GUIQUEUE_HPP
+#define NSM66_NSMD_GUIQUEUE_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          guiqueue.hpp
+ *
+ *    This module provides the outbound queue of messages to the GUI.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Messages for the GUI are queued and sent together as OSC bundles once
+ *  per event-loop iteration, instead of one datagram each.  A message
+ *  posted with a key (the status, label, progress, dirty, or visibility
+ *  of one client) supersedes a still-queued message with the same key:
+ *  the older one is dropped and the new one goes to the end of the queue,
+ *  so the GUI sees only the latest state, in the order the latest states
+ *  arose.  Messages without a key are events, and are never merged.
+ */
+
+#include <list>                         /* std::list<>                      */
+#include <string>                       /* std::string                      */
+#include <unordered_map>                /* std::unordered_map<>             */
+
+#include "lo/lo.h"                      /* lo_message, lo_bundle            */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the coalescing queue of GUI messages.
+ */
+
+class gui_queue
+{
+
+private:
+
+    /**
+     *  A queued message. The queue owns the lo_message.
+     */
+
+    using item = struct
+    {
+        std::string g_path;
+        std::string g_key;
+        lo_message g_message;
+    };
+
+    using item_list = std::list<item>;
+
+    item_list m_items;
+    std::unordered_map<std::string, item_list::iterator> m_keyed;
+    std::size_t m_max_bundle;
+    long m_sent;
+    long m_merged;
+
+public:
+
+    gui_queue (std::size_t maxbundle = 4096);
+    ~gui_queue ();
+
+    gui_queue (const gui_queue &) = delete;
+    gui_queue & operator = (const gui_queue &) = delete;
+
+    void post
+    (
+        const std::string & path, lo_message m,
+        const std::string & key = ""
+    );
+    void flush (lo_address addr, lo_server srv);
+    void clear ();
+
+    bool empty () const
+    {
+        return m_items.empty();
+    }
+
+    long sent () const
+    {
+        return m_sent;
+    }
+
+    long merged () const
+    {
+        return m_merged;
+    }
+
+};              // class gui_queue
+
+/*
+ *  Helpers to build an lo_message from the argument types the daemon
+ *  sends to the GUI.
+ */
+
+inline void
+message_add (lo_message m, const char * s)
+{
+    lo_message_add_string(m, s);
+}
+
+inline void
+message_add (lo_message m, const std::string & s)
+{
+    lo_message_add_string(m, s.c_str());
+}
+
+inline void
+message_add (lo_message m, int i)
+{
+    lo_message_add_int32(m, i);
+}
+
+/*
+ *  The NSM GUI protocol sends flags (dirty, GUI visible) as integers.
+ */
+
+inline void
+message_add (lo_message m, bool b)
+{
+    lo_message_add_int32(m, b ? 1 : 0);
+}
+
+inline void
+message_add (lo_message m, float f)
+{
+    lo_message_add_float(m, f);
+}
+
+inline void
+message_build (lo_message)
+{
+    // no code, ends the recursion
+}
+
+template <typename T, typename... Args>
+void
+message_build (lo_message m, T first, Args... rest)
+{
+    message_add(m, first);
+    message_build(m, rest...);
+}
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_GUIQUEUE_HPP
+
+/*
+ * guiqueue.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
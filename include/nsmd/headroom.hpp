@@ -0,0 +1,102 @@
+#if ! defined NSM66_NSMD_HEADROOM_HPP
+#define NSM66_NSMD_HEADROOM_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          headroom.hpp
+ *
+ *    This module provides the memory and CPU limits for starting clients
+ *    ahead of time, while a session runs.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Preparing the next session starts its heavy clients while the current
+ *  one is playing.  That must not starve the running clients, so each
+ *  prepared client is started only while:
+ *
+ *      -   MemAvailable in /proc/meminfo is at least the minimum free
+ *          memory, in MiB; and
+ *      -   the one-minute load average of /proc/loadavg, divided by the
+ *          number of on-line CPUs, is at most the maximum load.
+ *
+ *  A limit of 0 is not checked.
+ */
+
+#include <string>                       /* std::string                      */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the headroom check.
+ */
+
+class headroom
+{
+
+private:
+
+    long m_min_free_mib;
+    double m_max_load;
+
+public:
+
+    headroom (long minfreemib = 1024, double maxload = 0.8);
+
+    static long available_mib ();
+    static double load_per_cpu ();
+
+    bool allows (std::string & reason) const;
+
+    void min_free_mib (long mib)
+    {
+        m_min_free_mib = mib;
+    }
+
+    void max_load (double load)
+    {
+        m_max_load = load;
+    }
+
+    long min_free_mib () const
+    {
+        return m_min_free_mib;
+    }
+
+    double max_load () const
+    {
+        return m_max_load;
+    }
+
+};              // class headroom
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_HEADROOM_HPP
+
+/*
+ * headroom.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -30,7 +30,7 @@
  * \library       nsm66d application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-02-05
- * \updates       2025-04-19
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
@@ -60,6 +60,11 @@
 #include "osc/endpoint.hpp"             /* osc::endpoint class              */
 #include "util/strfunctions.hpp"        /* util::info_message() etc.        */
 
+namespace nsmd
+{
+    class client_registry;              /* forward reference                */
+}
+
 class Client
 {
 
@@ -77,10 +82,25 @@ private:
 
     struct timeval m_command_sent_time;
 
+    /**
+     *  The time at which launch() started this client. Used to log the
+     *  launch-to-announce delay of each client.
+     */
+
+    struct timeval m_launch_time;
+
     bool m_gui_visible;
 
     std::string m_label;
 
+    /**
+     *  The registry that indexes this client, if any. The setters of the
+     *  indexed fields (PID, ID, address, executable, and the state that
+     *  feeds the counters) tell it about each change.
+     */
+
+    nsmd::client_registry * m_registry;
+
 public:
 
     /*
@@ -161,6 +181,14 @@ public:
 
     std::string m_name_with_id;
 
+    /*
+     * v1.6, the optional fourth field of the client's session.nsm line,
+     * e.g. "tier=1,after=nABCD".  See nsmd::session_plan.  Kept as text,
+     * so that saving writes back what was read.
+     */
+
+    std::string m_attributes;
+
 public:
 
     Client ();
@@ -171,7 +199,7 @@ public:
         const std::string & id
     );
 
-    ~Client () = default;
+    ~Client ();
 
     bool has_error () const
     {
@@ -205,7 +233,14 @@ public:
     }
 
     void pending_command (int command);
+    void registry (nsmd::client_registry * r)
+    {
+        m_registry = r;
+    }
+
     double ms_since_last_command () const;
+    void launch_stamp ();
+    double ms_since_launch () const;
 
     bool gui_visible () const
     {
@@ -240,6 +275,7 @@ public:
     void addr (lo_address a)
     {
         m_addr = a;
+        reindex();
     }
 
     const std::string & name () const
@@ -260,6 +296,7 @@ public:
     void exe_path (const std::string & exe)
     {
         m_exe_path = exe;
+        reindex();
     }
 
     int pid () const
@@ -270,6 +307,7 @@ public:
     void pid (int p)
     {
         m_pid = p;
+        reindex();
     }
 
     float progress () const
@@ -290,6 +328,7 @@ public:
     void active (bool a)
     {
         m_active = a;
+        reindex();
     }
 
     const std::string & client_id () const
@@ -300,6 +339,7 @@ public:
     void client_id (const std::string & id)
     {
         m_client_id = id;
+        reindex();
     }
 
     const std::string & capabilities () const
@@ -364,6 +404,7 @@ public:
     void launch_error (int p)
     {
         m_launch_error = p;
+        reindex();
     }
 
     const std::string & name_with_id () const
@@ -376,6 +417,20 @@ public:
         m_name_with_id = n;
     }
 
+    const std::string & attributes () const
+    {
+        return m_attributes;
+    }
+
+    void attributes (const std::string & a)
+    {
+        m_attributes = a;
+    }
+
+private:
+
+    void reindex ();
+
 };              // class Client
 
 using client_list = std::list<Client *>;
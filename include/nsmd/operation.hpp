@@ -0,0 +1,181 @@
+#if ! defined NSM66_NSMD_OPERATION_HPP
+#define NSM66_NSMD_OPERATION_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          operation.hpp
+ *
+ *    This module provides the session operation (save, open, etc.) that
+ *    is in progress, as a sequence of phases run by the event loop.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The OSC handlers for /nsm/server/save, open, duplicate, new, close, and
+ *  abort used to do all their work inside the handler, waiting there for
+ *  the clients (up to a minute for replies).  Now a handler only builds the
+ *  phases of its operation and starts it.  Each phase has:
+ *
+ *      -   A start action, run once when the phase is entered. It can
+ *          fail() the operation.
+ *      -   An optional "done" predicate, checked after every event-loop
+ *          iteration. Without one, the phase ends as soon as it starts.
+ *      -   An optional timeout, after which the phase ends even though the
+ *          predicate is still false.
+ *      -   An optional finish action, run when the phase ends for any
+ *          reason, including cancellation.
+ *
+ *  Phases marked "final" are run even when the operation fails or is
+ *  cancelled, but without waiting on their predicates; they restore a
+ *  consistent session state.  When the last phase is done, the completion
+ *  callback gets the result, normally to reply to the requester.
+ *
+ *  Only one operation runs at a time.  With a tracer, the operation and
+ *  each phase are recorded as async events, numbered per operation.
+ */
+
+#include <functional>                   /* std::function<>                  */
+#include <string>                       /* std::string                      */
+#include <vector>                       /* std::vector<>                    */
+
+#include "eventloop.hpp"                /* nsmd::eventloop class            */
+#include "tracer.hpp"                   /* nsmd::tracer class               */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the running session operation.
+ */
+
+class operation
+{
+
+public:
+
+    using action = std::function<void ()>;
+    using predicate = std::function<bool ()>;
+    using completion = std::function<void (int, const std::string &)>;
+
+private:
+
+    using phase = struct
+    {
+        std::string p_name;
+        action p_start;
+        predicate p_done;
+        long p_timeout_ms;
+        action p_finish;
+        bool p_final;
+    };
+
+    eventloop & m_loop;
+
+    /**
+     *  The nsm::command value of the running operation; 0 (none) if no
+     *  operation is running.
+     */
+
+    int m_command;
+    std::string m_name;
+    std::vector<phase> m_phases;
+    std::size_t m_current;
+    bool m_started;
+    bool m_expired;
+    bool m_stepping;
+    eventloop::timer_id m_timer;
+    int m_error;
+    std::string m_message;
+    completion m_completion;
+    eventloop::clock::time_point m_begin_time;
+    tracer * m_tracer;
+    unsigned m_serial;
+
+public:
+
+    operation (eventloop & loop);
+
+    operation (const operation &) = delete;
+    operation & operator = (const operation &) = delete;
+
+    void prepare (int command, const std::string & name, completion done);
+    void add_phase
+    (
+        const std::string & name,
+        action start,
+        predicate done = nullptr,
+        long timeout_ms = 0,
+        action finish = nullptr,
+        bool isfinal = false
+    );
+    void add_final_phase (const std::string & name, action start);
+    void start ();
+    void step ();
+    void fail (int code, const std::string & message);
+    bool cancel (int code, const std::string & message);
+    void abandon ();
+
+    bool busy () const
+    {
+        return m_command != 0;
+    }
+
+    int command () const
+    {
+        return m_command;
+    }
+
+    const std::string & name () const
+    {
+        return m_name;
+    }
+
+    bool failed () const
+    {
+        return m_error != 0;
+    }
+
+    std::string phase_name () const;
+
+    void trace (tracer & t)
+    {
+        m_tracer = &t;
+    }
+
+private:
+
+    void end_phase ();
+    void complete ();
+    void reset ();
+
+};              // class operation
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_OPERATION_HPP
+
+/*
+ * operation.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
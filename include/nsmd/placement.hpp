@@ -0,0 +1,145 @@
+#if ! defined NSM66_NSMD_PLACEMENT_HPP
+#define NSM66_NSMD_PLACEMENT_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          placement.hpp
+ *
+ *    This module provides the CPU, scheduling, and cgroup placement of a
+ *    client, from its session.nsm attributes.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The placement attributes go in the same attribute field as the start
+ *  attributes (see session_plan), and are saved back in the same way:
+ *
+ *      Carla:carla:nABCD:cpus=2-5,nice=5
+ *      Zyn:zynaddsubfx:nEFGH:cpus=4,cpus=6-7,sched=batch
+ *      Browser:firefox:nIJKL:cgroup=heavy,cpu.weight=20,memory.high=4G
+ *
+ *      -   "cpus=N" or "cpus=N-M": the CPUs the client may run on.  It
+ *          can be repeated.
+ *      -   "nice=N": the nice value, -20 to 19.  A negative value needs
+ *          CAP_SYS_NICE or an RLIMIT_NICE allowing it.
+ *      -   "sched=other|batch|idle": the scheduling class.
+ *      -   "cgroup=name": the cgroup v2 group the client is moved to.  A
+ *          relative name is a sibling of nsm66d's own cgroup, e.g. in the
+ *          app.slice of a systemd user session; an absolute one is below
+ *          /sys/fs/cgroup.  It is created if missing.
+ *      -   "cpu.weight=N" (1 to 10000) and "memory.high=N[KMGT]|max" are
+ *          written to that cgroup.
+ *
+ *  The spawner places the child before its exec, so that every thread and
+ *  helper process of the client inherits the placement: the child is
+ *  created in its cgroup by clone3(CLONE_INTO_CGROUP), and sets its own
+ *  CPUs, scheduling class, and nice value (see nsmd::spawner).  Only if
+ *  clone3() is missing or fails is the client placed once it is running,
+ *  by apply(); then a client that started threads early has them outside
+ *  the placement.  A placement that cannot be applied is reported, and
+ *  the client runs anyway.
+ */
+
+#include <sched.h>                      /* cpu_set_t                        */
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* pid_t                            */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the placement of one client process.
+ */
+
+class placement
+{
+
+private:
+
+    std::vector<int> m_cpus;
+    int m_policy;                       /* SCHED_OTHER etc., or -1          */
+    int m_nice;
+    bool m_has_nice;
+    std::string m_cgroup;
+    long m_cpu_weight;                  /* 0 leaves it alone                */
+    std::string m_memory_high;          /* bytes, or "max"; empty: alone    */
+
+public:
+
+    placement ();
+
+    bool parse (const std::string & attributes);
+    bool cpu_set (cpu_set_t & set) const;
+    bool apply (pid_t pid) const;
+    std::string cgroup_directory () const;
+    std::string prepare_cgroup () const;
+    bool move_to_cgroup (pid_t pid, const std::string & dir) const;
+
+    bool empty () const
+    {
+        return ! has_cpus() && ! has_policy() && ! m_has_nice &&
+            m_cgroup.empty();
+    }
+
+    bool has_cpus () const
+    {
+        return ! m_cpus.empty();
+    }
+
+    bool has_policy () const
+    {
+        return m_policy >= 0;
+    }
+
+    int policy () const
+    {
+        return m_policy;
+    }
+
+    bool has_nice () const
+    {
+        return m_has_nice;
+    }
+
+    int nice_value () const
+    {
+        return m_nice;
+    }
+
+    bool has_cgroup () const
+    {
+        return ! m_cgroup.empty();
+    }
+
+};              // class placement
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_PLACEMENT_HPP
+
+/*
+ * placement.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,159 @@
+#if ! defined NSM66_NSMD_PROCSAMPLER_HPP
+#define NSM66_NSMD_PROCSAMPLER_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          procsampler.hpp
+ *
+ *    This module provides the sampling of the CPU, memory, and I/O use of
+ *    the supervised processes.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Each call of sample() reads /proc/<pid>/stat, statm, and io, three
+ *  small reads into a buffer on the stack, and records for the process:
+ *
+ *      -   "cpu": the CPU time used since the previous sample, as a
+ *          percentage of one CPU.
+ *      -   "rss": the resident memory, in KiB.
+ *      -   "read" and "write": the storage I/O since the previous sample,
+ *          in KiB/s.  The io file of a process of another user cannot be
+ *          read; then these are -1.
+ *      -   "majflt": the major page faults since the previous sample.
+ *
+ *  The first sample of a process only primes the counters.  The last
+ *  c_window samples are kept in a fixed ring per process, for the means
+ *  and peaks of summary().  A process that is not sampled again before
+ *  sweep() is forgotten.
+ *
+ *  It is used by nsm66d, from a timer of its event loop, and by a
+ *  multi-child nsm-proxy66.
+ */
+
+#include <array>                        /* std::array<>                     */
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* pid_t                            */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides rolling windows of /proc samples, per process.
+ */
+
+class proc_sampler
+{
+
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    /**
+     *  The number of samples kept per process.
+     */
+
+    static const int c_window = 16;
+
+    using reading = struct
+    {
+        double r_cpu_percent;
+        long r_rss_kib;
+        double r_read_kibps;
+        double r_write_kibps;
+        long r_major_faults;
+    };
+
+private:
+
+    using process = struct
+    {
+        std::string p_name;
+        clock::time_point p_stamp;
+        unsigned long long p_ticks;     /* utime + stime                    */
+        unsigned long long p_read_bytes;
+        unsigned long long p_write_bytes;
+        unsigned long p_major_faults;
+        bool p_io;                      /* /proc/<pid>/io is readable       */
+        bool p_seen;                    /* sampled since the last sweep()   */
+        int p_count;                    /* samples in the window            */
+        int p_next;                     /* the next slot of the window      */
+        std::array<reading, c_window> p_window;
+    };
+
+    std::unordered_map<pid_t, process> m_processes;
+    double m_ticks_per_second;
+    long m_page_kib;
+    long m_samples;
+
+public:
+
+    proc_sampler ();
+
+    bool sample (pid_t pid, const std::string & name);
+    void sweep ();
+    bool latest (pid_t pid, reading & s) const;
+    std::string summary (pid_t pid) const;
+    std::vector<std::string> report () const;
+
+    std::size_t size () const
+    {
+        return m_processes.size();
+    }
+
+    long samples () const
+    {
+        return m_samples;
+    }
+
+private:
+
+    bool read_counters
+    (
+        pid_t pid,
+        unsigned long long & ticks,
+        unsigned long & majflt,
+        long & rsspages
+    ) const;
+    bool read_io
+    (
+        pid_t pid,
+        unsigned long long & readbytes,
+        unsigned long long & writebytes
+    ) const;
+    std::string summary (const process & p) const;
+
+};              // class proc_sampler
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_PROCSAMPLER_HPP
+
+/*
+ * procsampler.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
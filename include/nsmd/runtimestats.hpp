@@ -0,0 +1,150 @@
+#if ! defined NSM66_NSMD_RUNTIMESTATS_HPP
+#define NSM66_NSMD_RUNTIMESTATS_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          runtimestats.hpp
+ *
+ *    This module provides the latency histograms and handler timings
+ *    reported by /nsm/server/stats.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The daemon records, per client and per kind:
+ *
+ *      -   "announce": launch to announce.
+ *      -   "save": /nsm/client/save to the reply.
+ *      -   "open" and "switch": /nsm/client/open to the reply, for a new
+ *          client and for one told to switch.
+ *      -   "quit": SIGTERM to the reaping of the process.
+ *
+ *  It also records the time spent in each OSC method handler, by path.
+ *  Each histogram has power-of-two buckets of microseconds, so it is a
+ *  fixed, small array no matter how many samples it holds; a percentile
+ *  is reported as the upper bound of its bucket.
+ */
+
+#include <array>                        /* std::array<>                     */
+#include <map>                          /* std::map<>                       */
+#include <string>                       /* std::string                      */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides a log2 histogram of durations.
+ */
+
+class histogram
+{
+
+public:
+
+    /**
+     *  Bucket 0 holds durations below 1 us; bucket b holds durations
+     *  from 2^(b-1) up to 2^b us.  The last bucket (about 18 minutes and
+     *  more) takes the rest.
+     */
+
+    static const int c_buckets = 32;
+
+private:
+
+    std::array<long, c_buckets> m_buckets;
+    long m_count;
+    double m_sum_ms;
+    double m_min_ms;
+    double m_max_ms;
+
+public:
+
+    histogram ();
+
+    void add (double ms);
+    double percentile_ms (double p) const;
+    std::string summary () const;
+
+    long count () const
+    {
+        return m_count;
+    }
+
+    double mean_ms () const
+    {
+        return m_count > 0 ? m_sum_ms / m_count : 0.0 ;
+    }
+
+    double min_ms () const
+    {
+        return m_min_ms;
+    }
+
+    double max_ms () const
+    {
+        return m_max_ms;
+    }
+
+};              // class histogram
+
+/**
+ *  Provides the statistics of the running daemon.
+ */
+
+class runtime_stats
+{
+
+private:
+
+    using histogram_map = std::map<std::string, histogram>;
+
+    histogram_map m_commands;
+    std::map<std::string, histogram_map> m_clients;
+    histogram_map m_handlers;
+
+public:
+
+    runtime_stats ();
+
+    void latency
+    (
+        const std::string & client,
+        const std::string & kind,
+        double ms
+    );
+    void handled (const std::string & path, double ms);
+    std::vector<std::string> report () const;
+    void clear ();
+
+};              // class runtime_stats
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_RUNTIMESTATS_HPP
+
+/*
+ * runtimestats.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
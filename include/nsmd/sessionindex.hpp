@@ -0,0 +1,128 @@
+#if ! defined NSM66_NSMD_SESSIONINDEX_HPP
+#define NSM66_NSMD_SESSIONINDEX_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionindex.hpp
+ *
+ *    This module provides the in-memory list of sessions below the
+ *    session root.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  A session is a directory holding a "session.nsm" file, named by its
+ *  path relative to the session root (e.g. "album/song").  No session is
+ *  looked for below a session directory, so the (often large) audio
+ *  trees of the sessions are never walked.
+ *
+ *  The index is built once with fts, then kept current by inotify: every
+ *  directory visited by the walk is watched, including the session
+ *  directories themselves (for the removal of their session file), but
+ *  nothing below them.  nsmd also adds the sessions it writes itself, so
+ *  a reply never has to wait for the inotify event.
+ */
+
+#include <set>                          /* std::set<>                       */
+#include <string>                       /* std::string                      */
+#include <unordered_map>                /* std::unordered_map<>             */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the sorted set of session paths.
+ */
+
+class session_index
+{
+
+public:
+
+    using container = std::set<std::string>;
+
+private:
+
+    std::string m_root;
+    std::string m_session_file;
+    container m_sessions;
+    int m_inotify_fd;
+
+    /**
+     *  The watched directories, relative to the root ("" is the root),
+     *  by watch descriptor and the reverse.
+     */
+
+    std::unordered_map<int, std::string> m_watches;
+    std::unordered_map<std::string, int> m_watch_ids;
+
+public:
+
+    session_index ();
+    ~session_index ();
+
+    session_index (const session_index &) = delete;
+    session_index & operator = (const session_index &) = delete;
+
+    bool build (const std::string & root, const std::string & sessionfile);
+    bool rebuild ();
+    void handle_events ();
+    void add (const std::string & relpath);
+    void remove (const std::string & relpath);
+    std::string relative (const std::string & fullpath) const;
+
+    int descriptor () const
+    {
+        return m_inotify_fd;
+    }
+
+    const container & sessions () const
+    {
+        return m_sessions;
+    }
+
+    bool contains (const std::string & relpath) const
+    {
+        return m_sessions.find(relpath) != m_sessions.end();
+    }
+
+private:
+
+    bool scan (const std::string & reldir);
+    void watch (const std::string & reldir);
+    void forget (const std::string & reldir);
+    void unwatch (const std::string & reldir, bool self);
+    void clear ();
+    std::string full_path (const std::string & reldir) const;
+
+};              // class session_index
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_SESSIONINDEX_HPP
+
+/*
+ * sessionindex.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,132 @@
+#if ! defined NSM66_NSMD_SESSIONPLAN_HPP
+#define NSM66_NSMD_SESSIONPLAN_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionplan.hpp
+ *
+ *    This module provides the parsing of session.nsm, including the
+ *    optional start attributes of each client, and the start tiers.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  A line of session.nsm is "name:executable:id", optionally followed by
+ *  a fourth field of comma-separated attributes:
+ *
+ *      Carla:carla:nABCD
+ *      a2j:a2jmidid:nEFGH:tier=0
+ *      ZynAddSubFX:zynaddsubfx:nIJKL:after=nEFGH
+ *      JACKPatch:jackpatch66:nMNOP:after=nABCD,after=nIJKL
+ *
+ *      -   "tier=N" starts the client in tier N or later (default 0).
+ *      -   "after=ID" starts the client in a later tier than client ID.
+ *          It can be repeated.
+ *
+ *  The placement attributes ("cpus", "nice", "sched", "cgroup", ...) of
+ *  nsmd::placement share the field, and do not affect the tiers.
+ *
+ *  The attribute field is recognized by its "=", so an executable path
+ *  holding a colon still parses.  Unknown attributes are kept, and
+ *  written back on save, so newer session files survive older daemons.
+ *
+ *  Tier 0 starts first. Each later tier starts once every client of the
+ *  previous tier announced (or the grace period ran out).  If any client
+ *  of a session has tier attributes, a jackpatch client with no tier
+ *  attributes goes into a tier of its own after all the others, so that
+ *  it finds every JACK port present and restores the connections in one
+ *  pass; unless another client starts "after" it.  An "after" that would
+ *  close a cycle is reported and dropped.  Without attributes, all
+ *  clients are in tier 0, as before.
+ */
+
+#include <string>                       /* std::string                      */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the parsed session file and its start tiers.
+ */
+
+class session_plan
+{
+
+public:
+
+    /**
+     *  One client line of a session file.
+     */
+
+    using entry = struct
+    {
+        std::string se_name;
+        std::string se_exe;
+        std::string se_id;
+        std::string se_attributes;
+    };
+
+    using entry_list = std::vector<entry>;
+
+    /**
+     *  Each tier is a list of indices into the entries.
+     */
+
+    using tier_list = std::vector<std::vector<std::size_t>>;
+
+private:
+
+    entry_list m_entries;
+
+public:
+
+    session_plan ();
+
+    bool read (const std::string & sessionfile);
+
+    const entry_list & entries () const
+    {
+        return m_entries;
+    }
+
+    static bool parse_line (const std::string & line, entry & e);
+    static std::vector<std::string> attribute_values
+    (
+        const std::string & attributes,
+        const std::string & key
+    );
+    static bool is_tiered (const entry_list & entries);
+    static tier_list tiers (const entry_list & entries);
+
+};              // class session_plan
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_SESSIONPLAN_HPP
+
+/*
+ * sessionplan.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
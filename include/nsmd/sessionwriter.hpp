@@ -0,0 +1,134 @@
+#if ! defined NSM66_NSMD_SESSIONWRITER_HPP
+#define NSM66_NSMD_SESSIONWRITER_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionwriter.hpp
+ *
+ *    This module provides the writing of the session.nsm file.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The session file used to be rewritten in place on every save.  Now:
+ *
+ *      -   The new contents are hashed (64-bit FNV-1a). If the hash
+ *          matches the file as last written or read, and the file was not
+ *          touched since (same size and modification time), nothing is
+ *          written.
+ *      -   Otherwise the contents go to "session.nsm.tmp", which is then
+ *          renamed over session.nsm, so a crash leaves either the old or
+ *          the new file, never a truncated one.
+ *      -   With fsync enabled (the --fsync option), the temporary file is
+ *          flushed before the rename, and the directory after it.
+ *
+ *  A session file that is not writable is still treated as protected: it
+ *  is not replaced, even though the rename would allow it.
+ */
+
+#include <cstdint>                      /* std::uint64_t                    */
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* off_t                            */
+#include <time.h>                       /* struct timespec                  */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the change-detecting, atomic writer of session files.
+ */
+
+class session_writer
+{
+
+private:
+
+    bool m_fsync;
+    std::string m_file;
+    bool m_have_hash;
+    std::uint64_t m_hash;
+    off_t m_size;
+    struct timespec m_mtime;
+    long m_writes;
+    long m_skips;
+    long m_failures;
+    std::uint64_t m_bytes_written;
+
+public:
+
+    session_writer ();
+
+    session_writer (const session_writer &) = delete;
+    session_writer & operator = (const session_writer &) = delete;
+
+    static std::uint64_t hash (const std::string & text);
+
+    bool write (const std::string & filename, const std::string & text);
+
+    void use_fsync (bool flag)
+    {
+        m_fsync = flag;
+    }
+
+    bool fsync_enabled () const
+    {
+        return m_fsync;
+    }
+
+    long writes () const
+    {
+        return m_writes;
+    }
+
+    long skips () const
+    {
+        return m_skips;
+    }
+
+    long failures () const
+    {
+        return m_failures;
+    }
+
+    std::uint64_t bytes_written () const
+    {
+        return m_bytes_written;
+    }
+
+private:
+
+    bool unchanged (const std::string & filename, std::uint64_t h);
+    bool replace (const std::string & filename, const std::string & text);
+    void remember (const std::string & filename, std::uint64_t h);
+
+};              // class session_writer
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_SESSIONWRITER_HPP
+
+/*
+ * sessionwriter.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,145 @@
+#if ! defined NSM66_NSMD_SPAWNER_HPP
+#define NSM66_NSMD_SPAWNER_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          spawner.hpp
+ *
+ *    This module provides the starting of the client processes, with
+ *    posix_spawnp() instead of fork() and execvp().
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  launch() used to fork() the daemon and set up the child's environment
+ *  after the fork.  Copying the page tables of the daemon made each launch
+ *  slower as the daemon grew, and only async-signal-safe calls are safe in
+ *  the child of a process with threads (the copy engine has some).  An
+ *  exec failure could only be guessed from an exit code of 255.
+ *
+ *  Now the environment and the signal mask of the child are prepared in
+ *  the daemon, and posix_spawnp() starts it.  glibc 2.24 and later
+ *  implement it with clone(CLONE_VM | CLONE_VFORK), so nothing is copied,
+ *  and it returns the errno of a failed exec (ENOENT, EACCES, ...) to the
+ *  caller.  With an older C library the child exits with 127 instead.
+ *
+ *  A client with a placement (see nsmd::placement) is started with
+ *  clone3() instead, so that it is created in its cgroup and sets its
+ *  CPUs, scheduling class, and nice value itself before the exec.  If
+ *  clone3() is missing or fails, posix_spawnp() is used: the CPU set is
+ *  set on the calling thread for the spawn, so that the child inherits
+ *  it, and then restored, and the rest is set once the child runs.
+ */
+
+#include <signal.h>                     /* sigset_t                         */
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* pid_t                            */
+#include <utility>                      /* std::pair<>                      */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+class placement;                        /* forward reference                */
+
+/**
+ *  Provides the starting of client processes.
+ */
+
+class spawner
+{
+
+public:
+
+    /**
+     *  Variables to set in the environment of the child.  An empty value
+     *  removes the variable.
+     */
+
+    using environment = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     *  The exit code of a child whose exec failed, when posix_spawnp()
+     *  cannot report it.
+     */
+
+    static const int c_exec_failed = 127;
+
+private:
+
+    int m_error;
+    long m_spawned;
+    long m_failures;
+
+public:
+
+    spawner ();
+
+    spawner (const spawner &) = delete;
+    spawner & operator = (const spawner &) = delete;
+
+    pid_t spawn
+    (
+        const std::string & executable,
+        const environment & env,
+        const placement * where = nullptr
+    );
+    std::string error_message () const;
+
+    int error () const
+    {
+        return m_error;
+    }
+
+    long spawned () const
+    {
+        return m_spawned;
+    }
+
+    long failures () const
+    {
+        return m_failures;
+    }
+
+private:
+
+    pid_t clone_placed
+    (
+        char * const argv [],
+        char * const envp [],
+        const sigset_t & mask,
+        const placement & where,
+        bool & placed
+    );
+
+};              // class spawner
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_SPAWNER_HPP
+
+/*
+ * spawner.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
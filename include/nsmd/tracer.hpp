@@ -0,0 +1,199 @@
+#if ! defined NSM66_NSMD_TRACER_HPP
+#define NSM66_NSMD_TRACER_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          tracer.hpp
+ *
+ *    This module provides the event trace recorder enabled by --trace.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Events go into a ring buffer allocated when tracing is enabled; when
+ *  it is full, the oldest events are overwritten.  Recording an event is
+ *  a time stamp and two bounded string copies, with no allocation.  When
+ *  tracing is disabled, each call is one test of a flag.
+ *
+ *  At exit the events are written in the Chrome trace-event JSON format,
+ *  which chrome://tracing and https://ui.perfetto.dev load:
+ *
+ *      -   "B" and "E" (begin and end) for the nested, synchronous work of
+ *          the daemon, such as an OSC handler or a fork().
+ *      -   "b" and "e" (async begin and end) for the session operations
+ *          and their phases, which span many event-loop iterations.
+ *      -   "i" (instant) for single points, such as an announce.
+ *
+ *  Each event can carry a client ID, shown as its "client" argument.
+ */
+
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <string>                       /* std::string                      */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmd
+{
+
+/**
+ *  Provides the trace recorder.
+ */
+
+class tracer
+{
+
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    static const std::size_t c_name_size = 48;
+    static const std::size_t c_id_size = 16;
+
+private:
+
+    using event = struct
+    {
+        clock::time_point t_time;
+        unsigned t_async_id;
+        char t_phase;
+        char t_name[c_name_size];
+        char t_id[c_id_size];
+    };
+
+    bool m_enabled;
+    std::string m_file;
+    std::vector<event> m_events;
+    std::size_t m_next;
+    std::size_t m_count;
+    clock::time_point m_origin;
+
+public:
+
+    tracer ();
+
+    tracer (const tracer &) = delete;
+    tracer & operator = (const tracer &) = delete;
+
+    bool enable (const std::string & file, std::size_t capacity = 65536);
+    bool dump ();
+
+    bool enabled () const
+    {
+        return m_enabled;
+    }
+
+    const std::string & file () const
+    {
+        return m_file;
+    }
+
+    void begin (const char * name, const char * id = nullptr)
+    {
+        if (m_enabled)
+            record('B', name, id, 0);
+    }
+
+    void end (const char * name, const char * id = nullptr)
+    {
+        if (m_enabled)
+            record('E', name, id, 0);
+    }
+
+    void async_begin (const char * name, unsigned serial)
+    {
+        if (m_enabled)
+            record('b', name, nullptr, serial);
+    }
+
+    void async_end (const char * name, unsigned serial)
+    {
+        if (m_enabled)
+            record('e', name, nullptr, serial);
+    }
+
+    void instant (const char * name, const char * id = nullptr)
+    {
+        if (m_enabled)
+            record('i', name, id, 0);
+    }
+
+private:
+
+    void record (char phase, const char * name, const char * id, unsigned s);
+
+};              // class tracer
+
+/**
+ *  Records "B" now and "E" when the scope is left.  The client ID is
+ *  copied, so it can change (as on a switch) inside the scope.
+ */
+
+class trace_scope
+{
+
+private:
+
+    tracer & m_tracer;
+    const char * m_name;
+    char m_id[tracer::c_id_size];
+
+public:
+
+    trace_scope (tracer & t, const char * name, const char * id = nullptr) :
+        m_tracer    (t),
+        m_name      (name)
+    {
+        m_id[0] = 0;
+        if (m_tracer.enabled())
+            start(id);
+    }
+
+    trace_scope (tracer & t, const char * name, const std::string & id) :
+        trace_scope (t, name, id.c_str())
+    {
+        // no code
+    }
+
+    ~trace_scope ()
+    {
+        if (m_tracer.enabled())
+            m_tracer.end(m_name, m_id[0] != 0 ? m_id : nullptr);
+    }
+
+    trace_scope (const trace_scope &) = delete;
+    trace_scope & operator = (const trace_scope &) = delete;
+
+private:
+
+    void start (const char * id);
+
+};              // class trace_scope
+
+}               // namespace nsmd
+
+#endif          // defined NSM66_NSMD_TRACER_HPP
+
+/*
+ * tracer.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,175 @@
+#if ! defined NSM66_NSMPROXY_CHILDSET_HPP
+#define NSM66_NSMPROXY_CHILDSET_HPP
+
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          childset.hpp
+ *
+ *    This module provides the wrapped executables of a multi-child
+ *    nsm-proxy66.
+ *
+ * \library       nsm-proxy66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Each program without NSM support used to need its own nsm-proxy66, with
+ *  its own OSC server, signalfd, and announce.  With the --multi option,
+ *  one nsm-proxy66 is a single composite NSM client for several programs.
+ *  Their settings are kept in the one NSM_PROXY_CONFIG_FILE_NAME of the
+ *  client, in the nsm-proxy format, with an "executable" entry starting
+ *  each child, and a tab before each value:
+ *
+ *      executable
+ *          qjackctl
+ *      arguments
+ *          --start
+ *      save signal
+ *          0
+ *      stop signal
+ *          15
+ *      label
+ *          QJackCtl
+ *
+ *  Each child is run as "/bin/sh -c 'exec executable arguments'", with its
+ *  output in "error-N.log", and is found again by its PID when it ends.
+ */
+
+#include <string>                       /* std::string                      */
+#include <sys/types.h>                  /* pid_t                            */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+namespace nsmproxy
+{
+
+/**
+ *  Provides the children of a composite proxy.
+ */
+
+class child_set
+{
+
+public:
+
+    /**
+     *  How a child ended; see reap().
+     */
+
+    enum class ending
+    {
+        unknown,                        /* not one of our children          */
+        normal,                         /* exit(0), or a stop signal        */
+        abnormal                        /* an error exit, or a crash        */
+    };
+
+    using child = struct
+    {
+        std::string c_executable;
+        std::string c_arguments;
+        std::string c_config_file;
+        std::string c_label;
+        int c_save_signal;
+        int c_stop_signal;
+        pid_t c_pid;                    /* 0 if not running                 */
+        int c_status;                   /* the last exit status             */
+    };
+
+    /**
+     *  The settings that nsm-proxy-gui sends before "/nsm/proxy/start".
+     *  The proxy holds them until add() makes the child they belong to.
+     */
+
+    using settings = struct
+    {
+        std::string s_label;
+        int s_save_signal;
+        int s_stop_signal;
+    };
+
+private:
+
+    std::vector<child> m_children;
+    std::unordered_map<pid_t, std::size_t> m_by_pid;
+    std::string m_client_id;
+    std::string m_display_name;
+
+public:
+
+    child_set ();
+
+    child_set (const child_set &) = delete;
+    child_set & operator = (const child_set &) = delete;
+
+    void session (const std::string & clientid, const std::string & name);
+    bool restore (const std::string & file);
+    bool dump (const std::string & file) const;
+    bool add
+    (
+        const std::string & executable,
+        const std::string & arguments,
+        const std::string & configfile,
+        const settings & guisettings
+    );
+    void start_all ();
+    void save ();
+    void kill ();
+    ending reap (pid_t pid, int status, std::string & label);
+
+    std::size_t size () const
+    {
+        return m_children.size();
+    }
+
+    std::size_t running () const
+    {
+        return m_by_pid.size();
+    }
+
+    const std::vector<child> & children () const
+    {
+        return m_children;
+    }
+
+    /**
+     *  The child that the GUI shows, the one added last.
+     */
+
+    child * last ()
+    {
+        return m_children.empty() ? nullptr : &m_children.back() ;
+    }
+
+private:
+
+    bool start (std::size_t index);
+
+};              // class child_set
+
+}               // namespace nsmproxy
+
+#endif          // defined NSM66_NSMPROXY_CHILDSET_HPP
+
+/*
+ * childset.hpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
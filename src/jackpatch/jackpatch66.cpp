@@ -24,7 +24,7 @@
  * \library       jackpatch66 application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-02-14
- * \updates       2025-04-20
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
@@ -39,13 +39,20 @@
  */
 
 #include <algorithm>                    /* std::sort()                      */
+#include <atomic>                       /* std::atomic<> drop counter       */
 #include <cerrno>                       /* #include <errno.h>               */
 #include <csignal>                      /* std::signal() and <signal.h>     */
 #include <cstring>                      /* std::strerror()                  */
 #include <cstdlib>                      /* std::getenv(), std::rand()       */
+#include <ctime>                        /* clock_gettime()                  */
 #include <getopt.h>
+#include <poll.h>                       /* poll(2)                          */
+#include <sys/eventfd.h>                /* eventfd(2)                       */
+#include <unistd.h>                     /* read(), write()                  */
 
 #include "jackpatch66.hpp"              /* application data types           */
+#include "patchfile.hpp"                /* jackpatch::patch_file class      */
+#include "patchgraph.hpp"               /* jackpatch::patch_graph class     */
 #include "cfg/appinfo.hpp"              /* cfg66: cfg::set_client_name()    */
 #include "nsm/helpers.hpp"              /* nsm66: nsm::extract_xxx() funcs  */
 #include "osc/lowrapper.hpp"            /* nsm66: LO_TT_IMMEDIATE_2         */
@@ -80,7 +87,8 @@
 
 #include <jack/ringbuffer.h>
 
-#define JACK_RINGBUFFER_SIZE    (1024 * 8)
+#define JACK_RINGBUFFER_SIZE    (1024 * sizeof(port_notification_record))
+#define PORT_NOTIFICATION_BATCH 64
 #define OSC_NAME(name)          osc_ ## name
 
 static lo_server g_lo_server;
@@ -89,8 +97,21 @@ static std::string g_project_file;
 static int g_jack_portname_sz = 0;  // defined after jack client activated
 static bool g_nsm_is_active = false;
 static bool g_die_now = false;
-static patch_list g_patch_list;
-static port_list g_known_ports;
+static std::atomic<long> g_dropped_notifications{0};
+static long g_resynced_drops = 0;
+static int g_wake_fd = (-1);            /* signalled by the JACK callbacks  */
+static long g_connections_made = 0;
+static std::string g_saved_file;        /* the last file written, and...    */
+static lib66::tokenization g_saved_table;   /* ...the lines written to it   */
+static jackpatch::patch_graph g_graph;     /* patches and known ports  */
+static jackpatch::patch_file g_patch_file; /* the .jackpatch parser     */
+
+using port_id = jackpatch::patch_graph::port_id;
+using patch_endpoint = jackpatch::patch_file::endpoint;
+
+static std::vector<port_id> g_pending_ports;    /* new, not yet patched     */
+static long long g_pending_since = 0;   /* stamp of the first pending port  */
+static int g_settle_ms = 25;            /* see connect_pending_patches()    */
 
 /*
  * Pre-declarations of some functions defined in this module.
@@ -98,18 +119,15 @@ static port_list g_known_ports;
 
 jack_client_t * jackpatch_client ();
 jack_ringbuffer_t * jackpatch_ringbuffer ();
-void inactivate_patch (const std::string & portname);
+void inactivate_patch (std::string_view portname);
+void check_for_new_ports ();
+void connect_pending_patches (bool force);
+static long long monotonic_ns ();
 
 /*
  *  Helper functions.
  */
 
-static std::string
-make_client_port_name (const client_port & cp)
-{
-    return util::string_asprintf("%s:%s", V(cp.client), V(cp.port));
-}
-
 static void
 preserving_msg (const std::string & dir, const std::string & clientport)
 {
@@ -145,70 +163,44 @@ print_patch (const patch_record & pr, bool iserror)
     }
 }
 
-void
-enqueue (patch_record & p)
-{
-    g_patch_list.push_back(p);
-}
-
-/*
- *  Don't need a separate function. Make it similar to enqueue().
- *
- *      enqueue_port(&g_known_ports, port);
+/**
+ *  Adds a patch, unless the graph has it already.
  */
 
 void
-enqueue_known_port (const std::string & portname)
+enqueue (patch_record & p)
 {
-    port_record p { portname };
-    g_known_ports.push_back(p);
+    (void) g_graph.add(p);
 }
 
-/**
- *  Find a jack port in our own data structure and not in the jack graph.
+/*
+ *  Marks the port as present in JACK, returning its ID.
  */
 
-std::string
-find_known_port (const std::string & portname)
+port_id
+enqueue_known_port (std::string_view portname)
 {
-    std::string result;
-    for (const auto & pr : g_known_ports)
-    {
-        if (pr.port == portname)
-        {
-            result = pr.port;
-            break;
-        }
-    }
+    port_id result = g_graph.intern(portname);
+    g_graph.known(result, true);
     return result;
 }
 
 /*
- *  Remove it from the list of known ports. This is done by getting
- *  the port_record's "next" pointer, assigning it, then deleting
- *  the port record.
- *
- *  Then mark all patches including this port as inactive.
+ *  Marks the port as gone, and all patches including this port as
+ *  inactive.
  */
 
 void
-remove_known_port (const std::string & portname)
+remove_known_port (std::string_view portname)
 {
-    port_list & known = g_known_ports;
-    for (port_list::iterator i = known.begin(); i != known.end(); ++i)
-    {
-        if (i->port == portname)
-        {
-            known.erase(i);
-            break;
-        }
-    }
+    g_graph.known(g_graph.find(portname), false);
     inactivate_patch(portname);
 }
 
 /**
- * Convert a symbolic string of a JACK connection into an actual data struct
- * patch_record.
+ *  Converts a patch parsed from a .jackpatch file into a patch_record, and
+ *  adds it.  The parsing is done by jackpatch::patch_file, which hands out
+ *  views into the file; they are copied here.
  *
  *  The name of the patch file is like this: "JACKPatch.nLWNW.jackpatch".
  *
@@ -224,215 +216,57 @@ remove_known_port (const std::string & portname)
  *
  *      seq66.nPSLM:fluidsynth-midi:midi_00 |> fluidsynth-midi:midi_00
  *
- *      " %m[^:]:%m[^|] |%1[<>|] %m[^:]:%m[^\n]",
- *       ^ ^ ^  ^   ^   ^ ^ ^^    ^
- *       | | |  |   |   | | dir   |
- *       | | |  |   |   | |        -----> The rest are simple.
- *       | | |  |   |   |  ----> Get only one of the <, >, or | characters.
- *       | | |  |   |    ------> Absorb the pipe
- *       | | |  |    ----------> Fetch all characters up to the pipe
- *       | | |   --------------> Absorb the colon
- *       | |  -----------------> See "[^:]" notes below
- *       |  -------------------> A character pointer allocated by sscanf()
- *        ---------------------> Throw-away white space
- *
- *  "[^:]"
- *
- *      This token suppresses white-space scanning. The characters in the
- *      square brackets are the characters to be accepted as data; but here,
- *      the "^:" means "accept all characters that are not a colon".
- *
- *  Issue:
- *
- *      One issue is that, with a2jmidid running (on older JACK setups),
- *      the client-name itself will have a colon, screwing up the parsing
- *      above.
- *
- *  At some point we would like to use something a bit easier to read, such
- *  as the INI or JSON formats. XML, as used in ajsnapshot, is overkill.
- *
- *  The 5 elements processed are the source client and port, the destination
- *  client and port, and the directional indicator ("<", ">", and "|>".
- *
- * \return
- *      Returns 0 if the 5 elements were not found. Returns -1 if an EOF was
- *      encountered.
- *
- * Warning:
- *
- *      ISO C++11 doesn't support the 'm' scanf() flag. Therefore we replace it
- *      with a new process_patch(), which calls nsm::process_patch().
+ *  With a2jmidid running (on older JACK setups), the client-name itself
+ *  can have a colon, which broke the old sscanf() parsing at the first
+ *  colon.  The parser now splits at the end of the longest live JACK
+ *  client name; see live_jack_clients().
  */
 
-#if defined USE_PROCESS_PATCH_SSCANF
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat"
-
-bool
-process_patch_sscanf (const std::string & patch)
+void
+add_patch (const patch_endpoint & src, const patch_endpoint & dst)
 {
-    /*
-     * Pointers filled in by %m by sscanf().
-     */
-
-    char * leftc;               /* left capture client  */
-    char * leftp;               /* left playback port   */
-    char * rightc;              /* right capture client */
-    char * rightp;              /* right playback port  */
-    char dir[4];                /* < or > direction     */
-    int count = sscanf
-    (
-        CSTR(patch), " %m[^:]:%m[^|] |%1[<>|] %m[^:]:%m[^\n]",
-        &leftc, &leftp, dir, &rightc, &rightp
-    );
-    if (count == EOF || count != 5)
-        return false;
-
-    /*
-     * Trim space
-     */
-
-    for (int j = strlen(leftp) - 1; j > 0; --j)
-    {
-        if (leftp[j] == ' ' || leftp[j] == '\t')
-            leftp[j] = 0;
-        else
-            break;
-    }
-    dir[2] = 0;
-
-    patch_record pr;
-    switch (dir[0])
-    {
-        case '<':                   /* this character is not used, afaict   */
-
-            pr.pr_src.client = rightc;
-            pr.pr_src.port   = rightp;
-            pr.pr_dst.client = leftc;
-            pr.pr_dst.port   = leftp;
-            enqueue(pr);
-            break;
-
-        case '>':
-
-            pr.pr_src.client = leftc;
-            pr.pr_src.port   = leftp;
-            pr.pr_dst.client = rightc;
-            pr.pr_dst.port   = rightp;
-            enqueue(pr);
-            break;
-
-        case '|':
-
-            {
-                pr.pr_src.client = rightc;
-                pr.pr_src.port   = rightp;
-                pr.pr_dst.client = leftc;
-                pr.pr_dst.port   = leftp;
-                enqueue(pr);
-
-                patch_record pr2;
-                pr2.pr_src.client = leftc;
-                pr2.pr_src.port   = leftp;
-                pr2.pr_dst.client = rightc;
-                pr2.pr_dst.port   = rightp;
-                enqueue(pr2);
-            }
-            break;
-
-        default:
-
-            return false;
-    }
-    pr.pr_active = false;
+    patch_record pr {};
+    pr.pr_src.client.assign(src.e_client.data(), src.e_client.size());
+    pr.pr_src.port.assign(src.e_port.data(), src.e_port.size());
+    pr.pr_dst.client.assign(dst.e_client.data(), dst.e_client.size());
+    pr.pr_dst.port.assign(dst.e_port.data(), dst.e_port.size());
+    enqueue(pr);
     print_patch(pr, false);         /* no error detectable currently */
-    return true;
 }
 
-#pragma GCC diagnostic pop
-
-#endif  // defined USE_PROCESS_PATCH_SSCANF
+/**
+ *  Gets the names of the JACK clients that have ports now.  A port's
+ *  client name is its full name less the short name and the colon, which
+ *  is right even when the client name has a colon in it.
+ */
 
-bool
-process_patch (const std::string & patch)
+std::vector<std::string>
+live_jack_clients ()
 {
-    std::string leftc;               /* left capture client  */
-    std::string leftp;               /* left playback port   */
-    std::string rightc;              /* right capture client */
-    std::string rightp;              /* right playback port  */
-    nsm::patch_direction dir = nsm::process_patch
-    (
-        patch, leftc, leftp, rightc, rightp
-    );
-    if (dir == nsm::patch_direction::error)
-    {
-        util::error_message("Failed to parse", patch);
-        return false;
-    }
-
-    /*
-     * Trim space? Why? If needed, do it in nsm::process_patch().
-     */
+    std::vector<std::string> result;
+    jack_client_t * client = jackpatch_client();
+    if (is_nullptr(client))
+        return result;
 
-#if 0
-    for (int j = strlen(leftp) - 1; j > 0; --j)
+    const char ** jports = ::jack_get_ports(client, NULL, NULL, 0);
+    if (not_nullptr(jports))
     {
-        if (leftp[j] == ' ' || leftp[j] == '\t')
-            leftp[j] = 0;
-        else
-            break;
-    }
-    dir[2] = 0;
-#endif
-
-    patch_record pr;
-    switch (dir)
-    {
-        case nsm::patch_direction::left:    /* '<' char not used, AFAICT    */
-
-            pr.pr_src.client = rightc;
-            pr.pr_src.port   = rightp;
-            pr.pr_dst.client = leftc;
-            pr.pr_dst.port   = leftp;
-            enqueue(pr);
-            break;
-
-        case nsm::patch_direction::right:   /* '>' character                */
-
-            pr.pr_src.client = leftc;
-            pr.pr_src.port   = leftp;
-            pr.pr_dst.client = rightc;
-            pr.pr_dst.port   = rightp;
-            enqueue(pr);
-            break;
-
-        case nsm::patch_direction::duplex:  /* '|' char not used, AFAICT    */
-
-            {
-                pr.pr_src.client = rightc;
-                pr.pr_src.port   = rightp;
-                pr.pr_dst.client = leftc;
-                pr.pr_dst.port   = leftp;
-                enqueue(pr);
-
-                patch_record pr2;
-                pr2.pr_src.client = leftc;
-                pr2.pr_src.port   = leftp;
-                pr2.pr_dst.client = rightc;
-                pr2.pr_dst.port   = rightp;
-                enqueue(pr2);
-            }
-            break;
+        for (const char ** jport = jports; not_nullptr(*jport); ++jport)
+        {
+            jack_port_t * jp = ::jack_port_by_name(client, *jport);
+            const char * shortname = not_nullptr(jp) ?
+                ::jack_port_short_name(jp) : nullptr ;
 
-        default:
+            std::size_t full = std::strlen(*jport);
+            std::size_t len = not_nullptr(shortname) ?
+                std::strlen(shortname) : 0 ;
 
-            util::error_message("Bad patch");
-            return false;
+            if (len > 0 && len + 1 < full)
+                result.emplace_back(*jport, full - len - 1);
+        }
+        ::jack_free(jports);
     }
-    pr.pr_active = false;
-    print_patch(pr, false);         /* no error detectable currently */
-    return true;
+    return result;
 }
 
 /**
@@ -442,40 +276,48 @@ process_patch (const std::string & patch)
 void
 clear_all_patches ()
 {
-    g_patch_list.clear();
+    g_graph.clear();
 }
 
 /**
- *  Crudely parse configuration file named by /file/ using fscanf().
- *  The process is:
- *
- *      1. Open the file.
- *      2. Clear all existing patches.
- *      3. Read a line c
- *      kharacter-by-character.
- *      4. Process the line, which contains a connection.
- *      5. Close the file.
- *
- *  We now use lib66/cfg66 library items and functions. More work
- *  behind the scenes, but easier on the caller.
+ *  Parses the configuration file named by /file/, replacing all existing
+ *  patches.  The file is memory-mapped and parsed in one pass by
+ *  jackpatch::patch_file, without allocating per line.  Bad lines are
+ *  reported and skipped.
  */
 
 bool
 read_config (const std::string & file)
 {
     util::status_message("Reading connections", file);
-    lib66::tokenization lines;
-    bool result = util::file_read_lines(file, lines);
+    g_patch_file.clients(live_jack_clients());
+
+    bool cleared = false;
+    bool result = g_patch_file.load
+    (
+        file,
+        [&cleared] (const patch_endpoint & src, const patch_endpoint & dst)
+        {
+            if (! cleared)
+            {
+                clear_all_patches();
+                cleared = true;
+            }
+            add_patch(src, dst);
+        }
+    );
     if (result)
     {
-        int count = 0;
-        clear_all_patches();
-        for (const auto & buf : lines)
+        if (! cleared)
+            clear_all_patches();                /* a file with no patches   */
+
+        if (util::investigate())
         {
-            ++count;
-            result = process_patch(buf);        /* calls sscanf()           */
-            if (! result)
-                util::warn_printf("Bad line %i", count);
+            util::info_printf
+            (
+                "Read %d patches from %d lines", g_patch_file.patches(),
+                g_patch_file.lines()
+            );
         }
     }
     return result;
@@ -485,99 +327,55 @@ read_config (const std::string & file)
  *  A connection attempt will only be made when a JACK port registers itself
  *  and we receive the JACK callback, and once on startup.  There is no
  *  periodic check if a previously saved connection is still alive. This
- *  is by design.
- *
- *  Returns 0 if connection failed, true if succeeded.
- *  Already connected is not considered a failure.
- *
- * Notes:
- *
- *      1.  These should really be g_jack_portname_sz, but in the real world
- *          not every system and compiler does C99.
- *
- *      2.  Since we only connect KNOWN TO US ports a connection will not be
- *          made on startup / file load, even if both jack ports are actually
- *          present in JACK. This is because we have not parsed both ports
- *          yet. The true connection attempt will be made only when the
- *          second port of the pair was parsed.
- *
- *          The log message below is misleading for users, because nothing is
- *          wrong, and should only be used during development.
- *
- *          We just skip the first attempt, eventhough JACK will not complain
- *          and do nothing wrong.
+ *  is by design.  The caller, connect_pending_patches(), only passes
+ *  inactive patches whose two ports are known to be present.
  *
- *          That also means that we do not detect actually missing ports.
+ * \return
+ *      Returns the jack_connect() code: 0 if connected, EEXIST if already
+ *      connected, which is not considered a failure, or an error code.
  */
 
-void
+int
 connect_path (patch_record & pr)
 {
-    if (pr.pr_active)
+    int rc = ::jack_connect
+    (
+        jackpatch_client(),
+        CSTR(g_graph.name(pr.pr_src_id)), CSTR(g_graph.name(pr.pr_dst_id))
+    );
+    print_patch(pr, rc != 0);
+    if (rc == 0 || rc == EEXIST)
     {
-        /*
-         * The patch is already active, don't bother JACK with it...
-         */
-
-        return;
+        pr.pr_active = true;
+        g_graph.dirty(true);
+        ++g_connections_made;
     }
     else
     {
-        std::string srcport{make_client_port_name(pr.pr_src)};
-        std::string dstport{make_client_port_name(pr.pr_dst)};
-        bool srcmatch = ! find_known_port(srcport).empty();
-        bool dstmatch = ! find_known_port(dstport).empty();
-        if (! srcmatch || ! dstmatch)
-            return;                         /* Note 2.      */
-
-        int rc = ::jack_connect
-        (
-            jackpatch_client(), CSTR(srcport), CSTR(dstport)
-        );
-        print_patch(pr, rc != 0);
-        if (rc == 0 || rc == EEXIST)
-        {
-            pr.pr_active = true;
-            return;
-        }
-        else
-        {
-            pr.pr_active = false;
-            util::error_printf("JACK connect error %i", rc);
-            return;
-        }
+        pr.pr_active = false;
+        util::error_printf("JACK connect error %i", rc);
     }
+    return rc;
 }
 
+/**
+ *  Calls the function for each patch that has the port as its source or
+ *  destination.  The patches of a port are indexed by the patch graph, so
+ *  the other patches are not looked at.
+ */
+
 void
 do_for_matching_patches
 (
-    const std::string & fullportname,
+    std::string_view fullportname,
     patchfunc func                      // void (* func)(patch_record &)
 )
 {
-#if defined USE_PROCESS_PATCH_SSCANF
-    char client[512];                           /* Linux JACK limit is 64   */
-    char port[512];                             /* Linux JACK limit is 256  */
-    sscanf(CSTR(fullportname), "%[^:]:%[^\n]", client, port);
-#endif
-
-    std::string client;
-    std::string port;
-    bool ok = nsm::extract_client_port(fullportname, client, port);
-    if (ok)
+    port_id id = g_graph.find(fullportname);
+    if (id != jackpatch::patch_graph::c_no_port)
     {
-        for (auto & pr : g_patch_list)
-        {
-            bool srcmatch =
-                client == pr.pr_src.client && port == pr.pr_src.port;
-
-            bool dstmatch
-                = client == pr.pr_dst.client && port == pr.pr_dst.port;
-
-            if (srcmatch || dstmatch)
-                func(pr);
-        }
+        for (std::size_t i : g_graph.patches_of(id))
+            func(g_graph.patch(i));
     }
 }
 
@@ -588,290 +386,295 @@ do_for_matching_patches
 void
 inactivate_path (patch_record & pr)
 {
-    pr.pr_active = false;
+    if (pr.pr_active)
+    {
+        pr.pr_active = false;
+        g_graph.dirty(true);
+    }
 }
 
 void
-inactivate_patch (const std::string & portname)
+inactivate_patch (std::string_view portname)
 {
     do_for_matching_patches(portname, inactivate_path);
 }
 
-void
-activate_patch (const std::string & portname)
-{
-    do_for_matching_patches(portname, connect_path);
-}
-
 /**
  *  Called for every new port, which includes restored-from-file ports on
- *  startup.  It will try to activate a restored connection for every single
- *  port, thus doing an attempt twice: Once for the source-port and then for
- *  the destination-port.
+ *  startup.  The port is only marked present and queued; its patches are
+ *  connected in a batch by connect_pending_patches().  The stamp is the
+ *  registration time of the port, or 0 for now.
  */
 
 void
-handle_new_port (const std::string & portname)
+handle_new_port (std::string_view portname, long long stamp = 0)
 {
-    enqueue_known_port(portname);
-    activate_patch(portname);                       /* this is a new port   */
-    util::info_message("New endpoint registered", portname);
+    port_id id = enqueue_known_port(portname);
+    if (g_pending_ports.empty())
+        g_pending_since = stamp > 0 ? stamp : monotonic_ns() ;
+
+    g_pending_ports.push_back(id);
+    util::info_message("New endpoint registered", std::string(portname));
 }
 
+/**
+ *  Connects the patches of the ports queued by handle_new_port(), once the
+ *  settle window (g_settle_ms) since the first of them has passed, or at
+ *  once if "force" is true.
+ *
+ *  A client registering hundreds of ports used to get a pass over its
+ *  patches and a jack_connect() for each port as it appeared, so that each
+ *  patch was tried twice, once for each of its ports.  Now the patches of
+ *  all the queued ports that are inactive and have both ports present are
+ *  gathered once, deduplicated, and connected in one batch.
+ */
+
 void
-register_prexisting_ports ()
+connect_pending_patches (bool force)
 {
-    const char ** ports = ::jack_get_ports(jackpatch_client(), NULL, NULL, 0);
-    if (not_nullptr(ports))
+    static std::vector<std::size_t> s_batch;    /* keeps its capacity       */
+    if (g_pending_ports.empty())
+        return;
+
+    long long now = monotonic_ns();
+    if (! force && now - g_pending_since < g_settle_ms * 1000000LL)
+        return;
+
+    s_batch.clear();
+    for (port_id id : g_pending_ports)
     {
-        const char ** p;
-        for (p = ports; not_nullptr(*p); ++p)
+        for (std::size_t i : g_graph.patches_of(id))
         {
-            std::string portname {*p};
-            handle_new_port(portname);
+            const patch_record & pr = g_graph.patch(i);
+            if
+            (
+                ! pr.pr_active &&
+                g_graph.known(pr.pr_src_id) && g_graph.known(pr.pr_dst_id)
+            )
+            {
+                s_batch.push_back(i);
+            }
         }
-        ::jack_free(ports);
     }
-}
+    std::sort(s_batch.begin(), s_batch.end());
+    s_batch.erase(std::unique(s_batch.begin(), s_batch.end()), s_batch.end());
 
-/**
- *  Save all current connections to a file.
- *
- *  Strategy:
- *
- *      -   If there are no JACK ports at all don't do anything.
- *      -   Otherwise: Remember all currently known connections where
- *          one, or both, ports are missing from the JACK graph.
- *          We consider these temporarily gone by accident.
- *      -   Clear the current save file.
- *      -   For each currently existing JACK output port, save all of
- *          it's connections.
- *      -   Save all these port-pairs in an empty file. Ports without
- *          connections are not saved.
- *
- *  Notes:
- *
- *      -   Temporary table.
- *          Prepare a temporary table where all connection strings are held
- *          until the file is written at the bottom of this function.
- *          We first add all connections that are temporarily out of order
- *          (see below) and then all currently existing connections.
- *          With C++, we can avoid malloc() and much more by using
- *          lib66::tokenization(), a sortable vector of strings.
- *      -   JACK graph.
- *          Before we forget the current state find all connections that we
- *          have in memory but where one or both ports are currently missing
- *          in the JACK graph.  We don't want to lose connections that are
- *          just temporarily not present.
- *      -   Patch description.
- *          A patch is one connection between a source and a destination.
- *          If an actual jack port source is connected to more than one
- *          destinations it will appear as it's own "patch" in this list.
- *          We only need to consider 1:1 point connections in this loop.
- *      -   Remember missing ports, part 1.
- *          The port does not exist anymore. We need to remember it!
- *          It doesn't matter if the destination port still exists,
- *          The file-writing below will only consider ports that are
- *          currently present and connected.
- *      -   Check connection.
- *          The source port does still exist, but is it's connection
- *          still alive? Do not use jack_port_get_all_connections();
- *          we want to know if a specific destination is still there.
- *          The client is our own jackpatch-jack-client.
- *      -   Magic string.
- *          prepare the magic string that is the step before creating
- *          a struct from with process_patch. port is source client:port
- *          and connection is the destination one.
- *
- */
+    int ports = int(g_pending_ports.size());
+    long long since = g_pending_since;
+    g_pending_ports.clear();
+    if (s_batch.empty())
+        return;
 
-bool
-snapshot (const std::string & file)
-{
-    const char ** jports = ::jack_get_ports
+    int made = 0;
+    int existing = 0;
+    int failed = 0;
+    for (std::size_t i : s_batch)
+    {
+        int rc = connect_path(g_graph.patch(i));
+        if (rc == 0)
+            ++made;
+        else if (rc == EEXIST)
+            ++existing;
+        else
+            ++failed;
+    }
+
+    long long end = monotonic_ns();
+    util::info_printf
     (
-        jackpatch_client(), NULL, NULL, JackPortIsOutput
+        "Connected %d patches for %d new ports in %.3f ms: %d made, "
+        "%d already connected (EEXIST), %d failed", int(s_batch.size()),
+        ports, (end - now) / 1.0e6, made, existing, failed
     );
-    if (is_nullptr(jports))
+    if (util::investigate())
     {
-        util::warn_message("Could not get JACK ports");
-        return false;
+        util::info_printf
+        (
+            "Restored %d connections %.3f ms after the first registration",
+            made + existing, (end - since) / 1.0e6
+        );
     }
+}
 
-    /*
-     * Temporary table. See function banner.
-     */
-
-    lib66::tokenization table;
+/**
+ *  Records a connection (or disconnection) from the output port "src" to
+ *  the input port "dst", as reported by JACK.  A new connection becomes a
+ *  patch.  A disconnected patch is only marked inactive: when a port goes
+ *  away, JACK reports its disconnections first, and the patch must be
+ *  remembered; see snapshot().
+ */
 
-    /*
-     * JACK graph. See function banner.
-     */
+void
+handle_connection (std::string_view src, std::string_view dst, bool on)
+{
+    port_id srcid = g_graph.find(src);
+    port_id dstid = g_graph.find(dst);
+    std::size_t i = jackpatch::patch_graph::c_no_patch;
+    if (srcid != jackpatch::patch_graph::c_no_port)
+        i = g_graph.find_patch(srcid, dstid);
 
-    for (auto & pr : g_patch_list)
+    if (i != jackpatch::patch_graph::c_no_patch)
     {
-        bool remember_this_connection = false;
-
-        /*
-         * Patch description. See function banner. Traverse the list.
-         */
-
-        std::string src_client_port { make_client_port_name(pr.pr_src) };
-        std::string dst_client_port { make_client_port_name(pr.pr_dst) };
-        jack_port_t * jp_t_src = ::jack_port_by_name
+        g_graph.active(i, on);
+    }
+    else if (on)
+    {
+        std::string srcname { src };            /* a new patch              */
+        std::string dstname { dst };
+        patch_record pr {};
+        if
         (
-            jackpatch_client(), CSTR(src_client_port)
-        );
-        if (! jp_t_src)
+            nsm::extract_client_port(srcname, pr.pr_src.client, pr.pr_src.port)
+            &&
+            nsm::extract_client_port(dstname, pr.pr_dst.client, pr.pr_dst.port)
+        )
         {
-            /*
-             * Remember missing ports. See function banner.
-             */
-
-            preserving_msg("source", src_client_port);
-            remember_this_connection = true;
-        }
-        else
-        {
-            /*
-             * Check connection. See function banner.
-             */
-
-            jack_port_t * jp_t_dst = ::jack_port_by_name
-            (
-                jackpatch_client(), V(dst_client_port)
-            );
-            if (! jp_t_dst)
+            pr.pr_active = true;
+            (void) g_graph.add(pr);
+            if (util::investigate())
             {
-                /*
-                 * Remember missing ports. See function banner.
-                 */
-
-                preserving_msg("destination", dst_client_port);
-                remember_this_connection = true;
+                util::info_printf
+                (
+                    "Connected %s |> %s", V(srcname), V(dstname)
+                );
             }
         }
-        if (remember_this_connection)
-        {
-            /*
-             * Why 40?
-             *
-             * "%-40s |> %s\n", V(src_client_port), V(dst_client_port)
-             */
-
-            std::string fmt = util::investigate() ?
-                "'%s' |> '%s'\n" : "%s |> %s\n" ;
-
-            std::string s = util::string_asprintf
-            (
-                fmt, V(src_client_port), V(dst_client_port)
-            );
-            table.push_back(s);
-
-            /*
-             * process_patch(s): infinite loop! Still need to keep these
-             * patch_records! See below.
-             */
-
-            util::info_printf
-            (
-                "Remember ++ %s |> %s", V(src_client_port), V(dst_client_port)
-            );
-        }
     }
-    clear_all_patches();                        /* tabula rasa              */
+}
 
-    /*
-     * We just removed the patch_records we wanted to remember. The size
-     * of the table vector holds the number of remembered records, if
-     * any.
-     */
+/**
+ *  Reads all the current connections from JACK, once, into the patches.
+ *  After that the connect callback keeps them up to date.  If "resync"
+ *  is true, the patches between present ports are first marked inactive,
+ *  because some of their disconnections may have been lost.
+ */
 
-    for (const auto & r : table)
+void
+load_jack_connections (bool resync)
+{
+    if (resync)
     {
-        bool ok = process_patch(r);
-        if (! ok)
+        for (std::size_t i = 0; i < g_graph.size(); ++i)
         {
-            util::warn_message("Could not process", r);
-            break;
+            const patch_record & pr = g_graph.patch(i);
+            if (g_graph.known(pr.pr_src_id) && g_graph.known(pr.pr_dst_id))
+                g_graph.active(i, false);
         }
     }
 
-    const char ** jport;
-    for (jport = jports; not_nullptr(*jport); ++jport)  /* jack_get_ports() */
-    {
-        /*
-         * *jport is a full client:port JACK name, not just the port.
-         */
+    const char ** jports = ::jack_get_ports
+    (
+        jackpatch_client(), NULL, NULL, JackPortIsOutput
+    );
+    if (is_nullptr(jports))
+        return;
 
+    for (const char ** jport = jports; not_nullptr(*jport); ++jport)
+    {
         jack_port_t * jp = ::jack_port_by_name(jackpatch_client(), *jport);
-        if (not_nullptr(jp))
-        {
-            if (util::investigate())
-                util::info_message("JACK port found", *jport);
-        }
-        else
-        {
-            util::warn_message("JACK port not found", *jport);
+        if (is_nullptr(jp))
             continue;
-        }
 
         const char ** connections = ::jack_port_get_all_connections
         (
             jackpatch_client(), jp
         );
-        if (is_nullptr(connections))
+        if (not_nullptr(connections))
         {
-            util::warn_message("No connections for port", *jport);
-            continue;
+            for (const char ** c = connections; not_nullptr(*c); ++c)
+                handle_connection(*jport, *c, true);
+
+            ::jack_free(connections);
         }
+    }
+    ::jack_free(jports);
+}
 
-        const char ** c;
-        for (c = connections; not_nullptr(*c); ++c)
+void
+register_prexisting_ports ()
+{
+    const char ** ports = ::jack_get_ports(jackpatch_client(), NULL, NULL, 0);
+    if (not_nullptr(ports))
+    {
+        const char ** p;
+        for (p = ports; not_nullptr(*p); ++p)
         {
-            /*
-             * Prepare the magic string that is the step before creating
-             * a struct with process_patch(). jport is source client:port
-             * and c (connection) is the destination one.
-             *
-             * Why 40?
-             *
-             * "%-40s |> %s\n", V(src_client_port), V(dst_client_port)
-             */
+            std::string portname {*p};
+            handle_new_port(portname);
+        }
+        ::jack_free(ports);
+    }
+    load_jack_connections(false);               /* fewer EEXIST attempts    */
+    connect_pending_patches(true);
+}
 
-            std::string fmt = util::investigate() ?
-                "'%s' |> '%s'\n" : "%s |> %s\n" ;
+/**
+ *  Save all current connections to a file.
+ *
+ *  Strategy:
+ *
+ *      -   The patch graph is the live model of the connections, kept up
+ *          to date by the JACK callbacks; see handle_connection().  The
+ *          pending notifications are handled first.
+ *      -   If the graph has not changed since the last save to the same
+ *          file, nothing is done.
+ *      -   Otherwise the patches the user disconnected are dropped.  Those
+ *          are the inactive patches whose ports are both still present.
+ *          The patches with a port missing from the JACK graph are kept,
+ *          as the port is considered temporarily gone by accident.
+ *      -   The remaining patches, connected or remembered, are written
+ *          straight from the graph, sorted.  If the lines are the ones
+ *          last written to that file, the file is not rewritten.
+ *
+ *  JACK is not queried, and the file is never parsed back in.
+ */
 
-            std::string s = util::string_asprintf
-            (
-                fmt, *jport, *c
-            );
-            table.push_back(s);
-            if (util::investigate())
-                util::info_message("Patch", s);
+bool
+snapshot (const std::string & file)
+{
+    check_for_new_ports();
+    connect_pending_patches(true);              /* or prune() drops them    */
+    if (! g_graph.dirty() && file == g_saved_file)
+    {
+        util::info_message("Connections unchanged", file);
+        return true;
+    }
 
-            bool ok = process_patch(s);
-            if (! ok)
-            {
-                util::warn_message("Could not process", s);
-                break;
-            }
+    std::size_t dropped = g_graph.prune();
+    if (dropped > 0 && util::investigate())
+        util::info_printf("Forgetting %d disconnected patches", int(dropped));
 
-            /*
-             * Verbose output that an individual connection was saved.
-             * util::info_printf(" ++ %s |> %s\n", *jport, *c);
-             */
-        }
-        free(connections);
+    std::string fmt = util::investigate() ? "'%s' |> '%s'\n" : "%s |> %s\n" ;
+    lib66::tokenization table;
+    table.reserve(g_graph.size());
+    for (const auto & pr : g_graph.patches())
+    {
+        const std::string & src_client_port = g_graph.name(pr.pr_src_id);
+        const std::string & dst_client_port = g_graph.name(pr.pr_dst_id);
+        if (! g_graph.known(pr.pr_src_id))
+            preserving_msg("source", src_client_port);
+        else if (! g_graph.known(pr.pr_dst_id))
+            preserving_msg("destination", dst_client_port);
+
+        table.push_back
+        (
+            util::string_asprintf(fmt, V(src_client_port), V(dst_client_port))
+        );
     }
-    free(jports);
+    std::sort(table.begin(), table.end());
 
-    /*
-     * Sort and write to file
-     */
+    bool success = true;
+    if (file == g_saved_file && table == g_saved_table)
+        util::info_message("Connections unchanged", file);
+    else
+        success = util::file_write_lines(file, table);
 
-    std::sort(table.begin(), table.end());
-    bool success = util::file_write_lines(file, table);
+    if (success)
+    {
+        g_graph.dirty(false);
+        g_saved_file = file;
+        g_saved_table.swap(table);
+    }
     return success;
 }
 
@@ -1153,80 +956,266 @@ init_osc (const std::string & oscport = "")
 }
 
 /**
- *  Reads the JACK ring--buffer into a new port_notification_record.
- *  The caller must check the pointer, then delete it after processing
- *  it.
+ *  Brings the known ports back in line with the JACK graph, after some
+ *  port notifications were lost.  Ports that are gone are removed, and
+ *  new ones are handled as if just registered.
  */
 
-port_notification_record *
-dequeue_new_port ()
+void
+resync_ports ()
 {
-    int sz = 0;
-    int peeksz = ::jack_ringbuffer_peek
-    (
-        jackpatch_ringbuffer(), (char *) &sz, sizeof(int)
-    );
-    if (peeksz == sizeof(int))
+    const char ** ports = ::jack_get_ports(jackpatch_client(), NULL, NULL, 0);
+    std::vector<bool> present;
+    if (not_nullptr(ports))
     {
-        size_t space = ::jack_ringbuffer_read_space(jackpatch_ringbuffer());
-        if (space >= size_t(sz))
+        for (const char ** p = ports; not_nullptr(*p); ++p)
         {
-            port_notification_record * pr =
-                new (std::nothrow) port_notification_record;
+            port_id id = g_graph.intern(*p);
+            if (id >= present.size())
+                present.resize(id + 1, false);
 
-            ::jack_ringbuffer_read(jackpatch_ringbuffer(), (char *) pr, sz);
-            return pr;
+            present[id] = true;
         }
+        ::jack_free(ports);
+    }
+    present.resize(g_graph.port_count(), false);
+    for (port_id id = 0; id < present.size(); ++id)
+    {
+        std::string portname { g_graph.name(id) };
+        if (g_graph.known(id) && ! present[id])
+            remove_known_port(portname);
+        else if (present[id] && ! g_graph.known(id))
+            handle_new_port(portname);
     }
-    return nullptr;
 }
 
+/*
+ *  The time used to stamp the port notifications.  clock_gettime() is
+ *  served by the vDSO, so it is safe in the JACK callback.
+ */
+
+static long long
+monotonic_ns ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ *  Wakes the main loop; see wait_for_events().  Safe in a JACK callback.
+ */
+
+static void
+wake_main_loop ()
+{
+    if (g_wake_fd >= 0)
+    {
+        std::uint64_t one = 1;
+        (void) ::write(g_wake_fd, &one, sizeof one);
+    }
+}
+
+/**
+ *  Waits until a JACK callback wakes us, an OSC message arrives (if
+ *  "osc" is true), or a signal interrupts the wait.  The timeout only
+ *  guards against a signal arriving just before poll() starts, unless
+ *  there is no eventfd, when the ports are polled as before.  This
+ *  replaces the 50 ms sleep of standalone mode and the 200 ms OSC receive
+ *  of NSM mode, so that a new port is handled as soon as it appears.
+ */
+
 void
-check_for_new_ports ()
+wait_for_events (bool osc)
 {
-    port_notification_record * p = nullptr;
-    while (not_nullptr(p = dequeue_new_port()))
+    struct pollfd fds [2];
+    int count = 0;
+    if (g_wake_fd >= 0)
     {
-        if (p->pnr_registered)
-            handle_new_port(std::string(p->pnr_port));
-        else
-            remove_known_port(std::string(p->pnr_port));
+        fds[count].fd = g_wake_fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        ++count;
+    }
+    if (osc)
+    {
+        fds[count].fd = lo_server_get_socket_fd(g_lo_server);
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        ++count;
+    }
+    int timeout = g_wake_fd >= 0 ? 1000 : 50 ;  /* 50 ms: old polling    */
+    if (! g_pending_ports.empty())
+    {
+        long long wait = g_pending_since + g_settle_ms * 1000000LL -
+            monotonic_ns();
 
-        delete p;
+        int settle = wait > 0 ? int((wait + 999999) / 1000000) : 0 ;
+        if (settle < timeout)
+            timeout = settle;                   /* end of the settle window */
+    }
+    int rc = ::poll(fds, nfds_t(count), timeout);
+    if (rc > 0)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if ((fds[i].revents & POLLIN) == 0)
+                continue;
+
+            if (fds[i].fd == g_wake_fd)
+            {
+                std::uint64_t value;
+                (void) ::read(g_wake_fd, &value, sizeof value);
+            }
+            else
+            {
+                while (lo_server_recv_noblock(g_lo_server, 0) > 0)
+                {
+                    // no code
+                }
+            }
+        }
     }
 }
 
+/**
+ *  Reads the port notifications from the JACK ring-buffer, a batch of
+ *  fixed-size records at a time, into a static array.  If the callback
+ *  had to drop any, the ports are resynchronized with jack_get_ports().
+ */
+
 void
-port_registration_callback (jack_port_id_t id, int reg, void * /*arg*/)
+check_for_new_ports ()
 {
-    jack_port_t * p = ::jack_port_by_id(jackpatch_client(), id);
-    const char * jport = ::jack_port_name(p);
-    size_t sz = std::strlen(jport) + sizeof(port_notification_record) + 1;
-    port_notification_record * pr =
-        new (std::nothrow) port_notification_record;
+    static port_notification_record s_batch[PORT_NOTIFICATION_BATCH];
+    const std::size_t recsize = sizeof(port_notification_record);
+    for (;;)
+    {
+        std::size_t count =
+            ::jack_ringbuffer_read_space(jackpatch_ringbuffer()) / recsize;
 
-   /*
-    * This needs some INVESTIGATION
-    */
+        if (count == 0)
+            break;
 
-    if (not_nullptr(pr))
-    {
-        pr->pnr_length = sz;
-        pr->pnr_registered = reg;
-        (void) std::snprintf                        /* pr->pnr_port = jport */
+        if (count > PORT_NOTIFICATION_BATCH)
+            count = PORT_NOTIFICATION_BATCH;
+
+        (void) ::jack_ringbuffer_read
         (
-            pr->pnr_port, sizeof pr->pnr_port, "%s", jport
+            jackpatch_ringbuffer(), (char *) s_batch, count * recsize
         );
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const port_notification_record & p = s_batch[i];
+            std::string_view portname
+            {
+                p.pnr_port, std::size_t(p.pnr_length)
+            };
+            if (p.pnr_kind == notification::connected ||
+                p.pnr_kind == notification::disconnected)
+            {
+                std::string_view other
+                {
+                    p.pnr_other, std::size_t(p.pnr_other_length)
+                };
+                handle_connection
+                (
+                    portname, other, p.pnr_kind == notification::connected
+                );
+            }
+            else if (p.pnr_kind == notification::registered)
+                handle_new_port(portname, p.pnr_stamp);
+            else
+                remove_known_port(portname);
+        }
+    }
 
-        size_t jsize = ::jack_ringbuffer_write
+    long dropped = g_dropped_notifications.load();
+    if (dropped != g_resynced_drops)
+    {
+        util::warn_printf
         (
-            jackpatch_ringbuffer(), (const char *) pr, sz
+            "%ld JACK port notifications dropped; resynchronizing",
+            dropped - g_resynced_drops
         );
-        if (sz != jsize)
-            util::error_message("JACK port notification buffer overrun");
+        g_resynced_drops = dropped;
+        resync_ports();
+        load_jack_connections(true);
+    }
+}
+
+/*
+ *  Copies a port name into a record field, returning its length.
+ */
+
+static int
+copy_port_name (char * destination, const char * name)
+{
+    int len = std::snprintf(destination, c_port_name_max, "%s", name);
+    return len < c_port_name_max ? len : c_port_name_max - 1 ;
+}
+
+/**
+ *  Runs on JACK's notification thread, like the connect callback below.
+ *  They only format a record on the stack and write it whole, or count it
+ *  as dropped if the ring-buffer is full (or the port is already gone).
+ *  No memory is allocated.
+ */
+
+static void
+post_notification (port_notification_record & pr)
+{
+    jack_ringbuffer_t * rb = jackpatch_ringbuffer();
+    if (::jack_ringbuffer_write_space(rb) < sizeof pr)
+    {
+        ++g_dropped_notifications;
+        return;
+    }
+    pr.pnr_stamp = monotonic_ns();
+    (void) ::jack_ringbuffer_write(rb, (const char *) &pr, sizeof pr);
+    wake_main_loop();
+}
 
-        // enqueue_new_port(jport, reg);
+void
+port_registration_callback (jack_port_id_t id, int reg, void * /*arg*/)
+{
+    port_notification_record pr;
+    jack_port_t * p = ::jack_port_by_id(jackpatch_client(), id);
+    const char * jport = not_nullptr(p) ? ::jack_port_name(p) : nullptr ;
+    if (is_nullptr(jport))
+    {
+        ++g_dropped_notifications;
+        return;
     }
+    pr.pnr_kind = reg ? notification::registered : notification::unregistered ;
+    pr.pnr_length = copy_port_name(pr.pnr_port, jport);
+    pr.pnr_other_length = 0;
+    post_notification(pr);
+}
+
+void
+port_connect_callback
+(
+    jack_port_id_t a, jack_port_id_t b, int connect, void * /*arg*/
+)
+{
+    port_notification_record pr;
+    jack_port_t * pa = ::jack_port_by_id(jackpatch_client(), a);
+    jack_port_t * pb = ::jack_port_by_id(jackpatch_client(), b);
+    if (is_nullptr(pa) || is_nullptr(pb))
+    {
+        ++g_dropped_notifications;
+        return;
+    }
+    if ((::jack_port_flags(pa) & JackPortIsOutput) == 0)
+        std::swap(pa, pb);                      /* the source is the output */
+
+    pr.pnr_kind = connect ?
+        notification::connected : notification::disconnected ;
+
+    pr.pnr_length = copy_port_name(pr.pnr_port, ::jack_port_name(pa));
+    pr.pnr_other_length = copy_port_name(pr.pnr_other, ::jack_port_name(pb));
+    post_notification(pr);
 }
 
 /*
@@ -1249,6 +1238,10 @@ jackpatch_client ()
         (
             s_jack_client, port_registration_callback, NULL     /* no arg   */
         );
+        ::jack_set_port_connect_callback
+        (
+            s_jack_client, port_connect_callback, NULL          /* no arg   */
+        );
         s_uninitialized = false;
         if (not_nullptr(s_jack_client))
             util::info_message("JACK client created");
@@ -1313,6 +1306,10 @@ void help ()
 "   --help          Show this screen and exit\n"
 "   --debug         Don't try to connect to NSM, and show verbose status.\n"
 "   --verbose       Show informational message.\n"
+"   --investigate   Show details, such as how long after a port appeared\n"
+"                   its connections were restored.\n"
+"   --settle ms     How long to collect new ports before connecting their\n"
+"                   patches in one batch. Default 25 ms.\n"
 "   --version       Show version and exit.\n"
 "   --save file     Save current connection snapshot to file, then exit.\n"
 
@@ -1336,12 +1333,14 @@ main (int argc, char * argv [])
     {
         { "help",       no_argument, 0, 'h' },
         { "debug",      no_argument, 0, 'd' },
+        { "investigate", no_argument, 0, 'i' },
         { "save",       no_argument, 0, 's' },
+        { "settle",     required_argument, 0, 'S' },
         { "verbose",    no_argument, 0, 'V' },
         { "version",    no_argument, 0, 'v' },
         { 0, 0, 0, 0 }
     };
-    int opt_offset = 0;                             /* --debug --save file  */
+    bool save = false;                              /* --save file          */
     int option_index = 0;
     int c = 0;
     while
@@ -1364,17 +1363,29 @@ main (int argc, char * argv [])
             no_debug = false;
             util::set_investigate(true);
             util::set_verbose(true);
-            ++opt_offset;
+            break;
+
+        case 'i':
+
+            util::set_investigate(true);
             break;
 
         case 's':                               /* save is handled below    */
 
+            save = true;
+            break;
+
+        case 'S':
+
+            g_settle_ms = std::atoi(optarg);
+            if (g_settle_ms < 0)
+                g_settle_ms = 0;
+
             break;
 
         case 'V':
 
             util::set_verbose(true);
-            ++opt_offset;
             break;
 
         case 'v':
@@ -1393,26 +1404,35 @@ main (int argc, char * argv [])
     if (is_nullptr(jrb))
         exit(EXIT_FAILURE);
 
+    g_wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_wake_fd < 0)
+        util::warn_message("No eventfd; polling for new ports");
+
+    /*
+     * getopt_long_only() has moved the file name, if any, after the
+     * options, to argv[optind].
+     */
+
     set_traps();
-    if (argc > 1)
+    if (save || optind < argc)
     {
-        std::string option { argv[opt_offset + 1] };
         maybe_activate_jack_client();
-        if (util::strcompare(option, "--save"))
+        if (save)
         {
-            if (argc > 2)
+            if (optind < argc)
             {
                 /*
                  * To not discard temporarily missing clients we need to
                  * load the current ones from file first, unless debugging.
+                 * The current ports and connections are loaded in any case,
+                 * since the snapshot is made from them.
                  */
 
-                std::string filename { argv[opt_offset + 2] };
+                std::string filename { argv[optind] };
                 if (no_debug)                           // no --debug
-                {
-                    if (read_config(filename))          // --save filename
-                        register_prexisting_ports();
-                }
+                    (void) read_config(filename);       // --save filename
+
+                register_prexisting_ports();
                 util::status_message
                 (
                     "Standalone: Saving current graph to", filename
@@ -1422,7 +1442,7 @@ main (int argc, char * argv [])
             }
             else
             {
-                util::error_message("Option needs a parameter", option);
+                util::error_message("Option needs a parameter", "--save");
                 exit(EXIT_FAILURE);
             }
         }
@@ -1432,7 +1452,7 @@ main (int argc, char * argv [])
              * Enter standalone commandline mode. This is without NSM.
              */
 
-            if (read_config(argv[opt_offset + 1]))
+            if (read_config(argv[optind]))
             {
                 maybe_activate_jack_client();
                 register_prexisting_ports();
@@ -1440,15 +1460,16 @@ main (int argc, char * argv [])
             util::info_message("Monitoring in standalone mode...\n" );
             for (;;)
             {
-                usleep(50000);
+                wait_for_events(false);
                 if (g_die_now)
                     die();
 
                 check_for_new_ports();
+                connect_pending_patches(false);
             }
         }
     }
-    init_osc();
+    init_osc(util::get_env("NSM_CLIENT_PORT"));     /* reserved by nsmd     */
     if (no_debug)
     {
         std::string nsmurl { util::get_env("NSM_URL") };
@@ -1471,9 +1492,12 @@ main (int argc, char * argv [])
     }
     for (;;)
     {
-        lo_server_recv_noblock(g_lo_server, 200);
+        wait_for_events(true);
         if (not_nullptr(jackpatch_client()))
+        {
             check_for_new_ports();
+            connect_pending_patches(false);
+        }
 
         if (g_die_now)
             die();
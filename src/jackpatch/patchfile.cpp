@@ -0,0 +1,336 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          patchfile.cpp
+ *
+ *    This module implements the parser of the .jackpatch files.
+ *
+ * \library       jackpatch66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <algorithm>                    /* std::sort(), std::binary_search  */
+#include <cerrno>                       /* errno                            */
+#include <charconv>                     /* std::from_chars()                */
+#include <cstring>                      /* std::strerror()                  */
+#include <fcntl.h>                      /* open(), O_RDONLY, O_CLOEXEC      */
+#include <sys/mman.h>                   /* mmap(), munmap(), madvise()      */
+#include <sys/stat.h>                   /* fstat()                          */
+#include <unistd.h>                     /* close()                          */
+
+#include "c_macros.h"                   /* V() macro                        */
+#include "patchfile.hpp"                /* jackpatch::patch_file class      */
+#include "util/msgfunctions.hpp"        /* cfg66: util::warn_printf()       */
+
+namespace jackpatch
+{
+
+namespace   // anonymous
+{
+
+/*
+ *  Removes the leading and trailing blanks, including the carriage return
+ *  of a file edited on Windows.
+ */
+
+std::string_view
+trim (std::string_view s)
+{
+    static const char * const s_blanks = " \t\r";
+    std::size_t first = s.find_first_not_of(s_blanks);
+    if (first == std::string_view::npos)
+        return std::string_view();
+
+    std::size_t last = s.find_last_not_of(s_blanks);
+    return s.substr(first, last - first + 1);
+}
+
+/*
+ *  Finds the direction operator, "|>", "|<", or "||".  A lone '|' can be
+ *  part of a port name.
+ */
+
+std::size_t
+find_operator (std::string_view line)
+{
+    static const std::string_view s_directions { "<>|" };
+    std::size_t op = line.find('|');
+    while (op != std::string_view::npos)
+    {
+        if (op + 1 < line.size() &&
+            s_directions.find(line[op + 1]) != std::string_view::npos)
+        {
+            break;
+        }
+        op = line.find('|', op + 1);
+    }
+    return op;
+}
+
+}           // namespace anonymous
+
+const char * const patch_file::c_indexed_header = "#! jackpatch66 indexed";
+
+patch_file::patch_file () :
+    m_clients       (),
+    m_ports         (),
+    m_lines         (0),
+    m_patches       (0),
+    m_bad_lines     (0),
+    m_indexed       (false)
+{
+    // no code
+}
+
+/**
+ *  Sets the names of the live JACK clients.  An empty list means the
+ *  first colon of a name ends the client name.
+ */
+
+void
+patch_file::clients (const std::vector<std::string> & names)
+{
+    m_clients = names;
+    std::sort(m_clients.begin(), m_clients.end());
+    m_clients.erase
+    (
+        std::unique(m_clients.begin(), m_clients.end()), m_clients.end()
+    );
+}
+
+/**
+ *  Maps the file into memory and parses it.
+ *
+ * \return
+ *      Returns false if the file could not be read.  Bad lines are
+ *      reported and skipped; see bad_lines().
+ */
+
+bool
+patch_file::load (const std::string & file, handler h)
+{
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        util::error_message(std::strerror(errno), file);
+        return false;
+    }
+
+    struct stat st;
+    bool result = ::fstat(fd, &st) == 0;
+    if (result && st.st_size > 0)
+    {
+        std::size_t size = std::size_t(st.st_size);
+        void * data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        result = data != MAP_FAILED;
+        if (result)
+        {
+            (void) ::madvise(data, size, MADV_SEQUENTIAL);
+            (void) parse(std::string_view((const char *) data, size), h);
+            (void) ::munmap(data, size);
+        }
+    }
+    else if (result)
+        (void) parse(std::string_view(), h);            /* an empty file    */
+
+    if (! result)
+        util::error_message(std::strerror(errno), file);
+
+    (void) ::close(fd);
+    return result;
+}
+
+/**
+ *  Parses the text of a .jackpatch file, calling the handler with the
+ *  source and destination of each patch.
+ *
+ * \return
+ *      Returns true if there were no bad lines.
+ */
+
+bool
+patch_file::parse (std::string_view text, handler h)
+{
+    m_ports.clear();
+    m_lines = m_patches = m_bad_lines = 0;
+    m_indexed = false;
+
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos)
+            end = text.size();
+
+        std::string_view line = trim(text.substr(pos, end - pos));
+        pos = end + 1;
+        ++m_lines;
+        if (m_lines == 1 && line == c_indexed_header)
+        {
+            m_indexed = true;
+            continue;
+        }
+        if (! parse_line(line, h))
+        {
+            std::string bad { line };
+            ++m_bad_lines;
+            util::warn_printf("Bad line %i: %s", m_lines, V(bad));
+        }
+    }
+    return m_bad_lines == 0;
+}
+
+/**
+ *  Splits a full "client:port" name at the end of the longest live client
+ *  name it starts with, or else at the first colon.
+ *
+ * \return
+ *      Returns the client and port views, which are empty if the name
+ *      has no colon.
+ */
+
+patch_file::endpoint
+patch_file::split (std::string_view fullname) const
+{
+    endpoint result {};
+    std::size_t colon = fullname.find(':');
+    if (colon == std::string_view::npos)
+        return result;
+
+    std::size_t boundary = colon;
+    if (! m_clients.empty())
+    {
+        for
+        (
+            colon = fullname.find(':', colon + 1);
+            colon != std::string_view::npos;
+            colon = fullname.find(':', colon + 1)
+        )
+        {
+            if (known_client(fullname.substr(0, colon)))
+                boundary = colon;
+        }
+    }
+    result.e_client = fullname.substr(0, boundary);
+    result.e_port = fullname.substr(boundary + 1);
+    return result;
+}
+
+/**
+ *  Parses one trimmed line.  A '>' patch goes from left to right, a '<'
+ *  patch from right to left, and '|' makes both.
+ *
+ * \return
+ *      Returns false if the line is not a port definition or a patch.
+ */
+
+bool
+patch_file::parse_line (std::string_view line, handler & h)
+{
+    if (line.empty() || line[0] == '#')
+        return true;
+
+    if (m_indexed && line[0] == '=')
+    {
+        endpoint e = split(trim(line.substr(1)));
+        m_ports.push_back(e);
+        return ! e.e_client.empty() && ! e.e_port.empty();
+    }
+
+    std::size_t op = find_operator(line);
+    if (op == std::string_view::npos)
+        return false;
+
+    std::string_view left = trim(line.substr(0, op));
+    std::string_view right = trim(line.substr(op + 2));
+    endpoint l {};
+    endpoint r {};
+    if (m_indexed)
+    {
+        if (! lookup_port(left, l) || ! lookup_port(right, r))
+            return false;
+    }
+    else
+    {
+        l = split(left);
+        r = split(right);
+    }
+    if (l.e_client.empty() || l.e_port.empty() ||
+        r.e_client.empty() || r.e_port.empty())
+    {
+        return false;
+    }
+
+    char dir = line[op + 1];
+    if (dir == '>')
+    {
+        h(l, r);
+        ++m_patches;
+    }
+    else if (dir == '<')
+    {
+        h(r, l);
+        ++m_patches;
+    }
+    else
+    {
+        h(r, l);
+        h(l, r);
+        m_patches += 2;
+    }
+    return true;
+}
+
+/**
+ *  Looks up a port by its decimal index in an indexed file.
+ */
+
+bool
+patch_file::lookup_port (std::string_view index, endpoint & e) const
+{
+    std::size_t i = 0;
+    const char * last = index.data() + index.size();
+    auto r = std::from_chars(index.data(), last, i);
+    bool result = r.ec == std::errc() && r.ptr == last && i < m_ports.size();
+    if (result)
+        e = m_ports[i];
+
+    return result;
+}
+
+bool
+patch_file::known_client (std::string_view name) const
+{
+    return std::binary_search
+    (
+        m_clients.begin(), m_clients.end(), name,
+        [] (std::string_view a, std::string_view b) { return a < b; }
+    );
+}
+
+}               // namespace jackpatch
+
+/*
+ * patchfile.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,218 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          patchgraph.cpp
+ *
+ *    This module implements the interned patch graph of jackpatch66.
+ *
+ * \library       jackpatch66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include "patchgraph.hpp"               /* jackpatch::patch_graph class     */
+
+namespace jackpatch
+{
+
+patch_graph::patch_graph () :
+    m_names         (),
+    m_ids           (),
+    m_known         (),
+    m_adjacency     (),
+    m_patches       (),
+    m_pairs         (),
+    m_known_count   (0),
+    m_dirty         (false)
+{
+    // no code
+}
+
+/**
+ *  Gets the ID of a full "client:port" name, adding it if new.
+ */
+
+patch_graph::port_id
+patch_graph::intern (std::string_view fullname)
+{
+    auto it = m_ids.find(fullname);
+    if (it != m_ids.end())
+        return it->second;
+
+    port_id result = port_id(m_names.size());
+    m_names.emplace_back(fullname);             /* the only string built    */
+    m_ids.emplace(std::string_view(m_names.back()), result);
+    m_known.push_back(false);
+    m_adjacency.emplace_back();
+    return result;
+}
+
+/**
+ * \return
+ *      Returns the ID of the name, or c_no_port if it was never interned.
+ */
+
+patch_graph::port_id
+patch_graph::find (std::string_view fullname) const
+{
+    auto it = m_ids.find(fullname);
+    return it != m_ids.end() ? it->second : c_no_port ;
+}
+
+/**
+ *  Adds a patch, filling in the IDs of its ports.
+ *
+ * \return
+ *      Returns false if the same patch was already in the graph, in which
+ *      case it is not added again.
+ */
+
+bool
+patch_graph::add (patch_record & pr)
+{
+    pr.pr_src_id = intern(pr.pr_src.client + ":" + pr.pr_src.port);
+    pr.pr_dst_id = intern(pr.pr_dst.client + ":" + pr.pr_dst.port);
+    bool result = find_patch(pr.pr_src_id, pr.pr_dst_id) == c_no_patch;
+    if (result)
+    {
+        m_patches.push_back(pr);
+        index(m_patches.size() - 1);
+        m_dirty = true;
+    }
+    return result;
+}
+
+void
+patch_graph::index (std::size_t i)
+{
+    const patch_record & pr = m_patches[i];
+    m_pairs[pair_key(pr.pr_src_id, pr.pr_dst_id)] = i;
+    m_adjacency[pr.pr_src_id].push_back(i);
+    if (pr.pr_dst_id != pr.pr_src_id)
+        m_adjacency[pr.pr_dst_id].push_back(i);
+}
+
+/**
+ * \return
+ *      Returns the index of the patch from "src" to "dst", or c_no_patch.
+ */
+
+std::size_t
+patch_graph::find_patch (port_id src, port_id dst) const
+{
+    auto it = m_pairs.find(pair_key(src, dst));
+    return it != m_pairs.end() ? it->second : c_no_patch ;
+}
+
+void
+patch_graph::active (std::size_t i, bool flag)
+{
+    if (i < m_patches.size() && m_patches[i].pr_active != flag)
+    {
+        m_patches[i].pr_active = flag;
+        m_dirty = true;
+    }
+}
+
+/**
+ *  Drops the inactive patches whose ports are both present, and rebuilds
+ *  the indexes if any were dropped.
+ *
+ * \return
+ *      Returns the number of patches dropped.
+ */
+
+std::size_t
+patch_graph::prune ()
+{
+    patch_list kept;
+    for (const auto & pr : m_patches)
+    {
+        bool present = known(pr.pr_src_id) && known(pr.pr_dst_id);
+        if (pr.pr_active || ! present)
+            kept.push_back(pr);
+    }
+
+    std::size_t result = m_patches.size() - kept.size();
+    if (result > 0)
+    {
+        m_patches.swap(kept);
+        m_pairs.clear();
+        for (auto & a : m_adjacency)
+            a.clear();
+
+        for (std::size_t i = 0; i < m_patches.size(); ++i)
+            index(i);
+
+        m_dirty = true;
+    }
+    return result;
+}
+
+/**
+ *  Drops all the patches.  The port names and known flags are kept.
+ */
+
+void
+patch_graph::clear ()
+{
+    m_patches.clear();
+    m_pairs.clear();
+    for (auto & a : m_adjacency)
+        a.clear();
+
+    m_dirty = true;
+}
+
+void
+patch_graph::known (port_id id, bool flag)
+{
+    if (id < m_known.size() && m_known[id] != flag)
+    {
+        m_known[id] = flag;
+        m_dirty = true;
+        if (flag)
+            ++m_known_count;
+        else
+            --m_known_count;
+    }
+}
+
+/**
+ * \return
+ *      Returns the indices, in patches(), of the patches that have the
+ *      port as source or destination.
+ */
+
+const patch_graph::index_list &
+patch_graph::patches_of (port_id id) const
+{
+    static const index_list s_none;
+    return id < m_adjacency.size() ? m_adjacency[id] : s_none ;
+}
+
+}               // namespace jackpatch
+
+/*
+ * patchgraph.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -27,7 +27,7 @@
  * \library       nsmctl application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-03-21
- * \updates       2025-04-20
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
@@ -80,12 +80,23 @@
  *          4.  osc_broadcast_handler(). Relays a broadcast.
  */
 
+#include <algorithm>                    /* std::find()                      */
 #include <cerrno>                       /* #include <errno.h>               */
+#include <chrono>                       /* std::chrono::steady_clock        */
 #include <csignal>                      /* std::signal() and <signal.h>     */
 #include <cstdio>                       /* std::getchar()                   */
+#include <cstdlib>                      /* std::atoi()                      */
 #include <cstring>                      /* std::strerror()                  */
+#include <deque>                        /* std::deque<>                     */
+#include <dirent.h>                     /* opendir(3), readdir(3)           */
+#include <fstream>                      /* std::ifstream                    */
 #include <getopt.h>                     /* getopt(3) CLI parsing            */
+#include <iostream>                     /* std::cin                         */
+#include <poll.h>                       /* poll(2)                          */
+#include <sstream>                      /* std::istringstream               */
 #include <string.h>                     /* strdup(3)                        */
+#include <sys/socket.h>                 /* sendto()                         */
+#include <sys/un.h>                     /* struct sockaddr_un               */
 #include <unistd.h>                     /* execvp(3), sleep(3)              */
 
 #include "cfg/appinfo.hpp"              /* cfg66: cfg::set_client_name()    */
@@ -113,15 +124,35 @@ bool s_do_lookup { false };             /* the fallback if the above fails  */
 bool s_do_monitor { false };            /* stay in the app until Ctrl-C     */
 bool s_do_ping { false };
 bool s_do_stop { false };
+bool s_do_stats { false };
+bool s_do_discover { false };
 bool s_is_client_action { false };
 bool s_die_now { false };
 int s_optind { (-1) };
 int s_nsmd_child_pid { 0 };
+std::string s_batch_source;
+std::string s_direct_item;              /* an nsm66d action, e.g. "prepare" */
+std::string s_direct_path;
 std::string s_subject_name;
 std::string s_nsm_url;
+std::vector<std::string> s_cluster_urls;
+int s_timeout_ms { 120 * 1000 };       /* nsmd waits a minute for clients  */
 std::string s_nsmd_path { "nsmd" };
 osc::tag s_action_tag { osc::tag::illegal };
 
+/**
+ *  An action parsed from an "action[@subject]" item.
+ */
+
+using action_item = struct
+{
+    osc::tag ai_tag;
+    std::string ai_subject;
+    std::string ai_path;
+    bool ai_is_client;
+    bool ai_is_stats;
+};
+
 /*
  *  Prints usage message according to POSIX.1-2017.
  */
@@ -144,6 +175,11 @@ help ()
 "                         environment and no --url is provided.\n"
 "   -u, --url url         Connect to an nsmd running at a user-specified URL.\n"
 "                         Example: osc.udp://mycomputer.localdomain:38356/\n"
+"                         Given more than once, the --action goes to all of\n"
+"                         the daemons at once (cluster mode).\n"
+"   -d, --discover        Cluster mode with every nsmd that has a daemon file\n"
+"                         in the run-time directory, plus any --url.\n"
+"   -t, --timeout ms      How long to wait for each reply. Default: 120000.\n"
 "   -n, --nsmd-path path  Path to the nsmd application. Default is \"nsmd\".\n"
 "                         \"build\" loads the executable in ./build/src/nsmctl.\n"
 "   -p, --ping            Ping the server a few times.\n"
@@ -154,6 +190,10 @@ help ()
 "                         If it is a client, the format of item is\n"
 "                         'action@exe'; the client name or ID is required.\n"
 "                         Otherwise, it is just the action name alone.\n"
+"   -b, --batch file      Run the actions listed in the file, one per line,\n"
+"                         or from stdin if the file is '-'. Lines can also\n"
+"                         be 'ping', 'wait' (for all replies), or '# ...'.\n"
+"                         Each reply is printed as 'id path status ms text'.\n"
 "   -c, --clean           Remove the nsm run-time directory. Useful when files\n"
 "                         are left from aborted actions. But BE CAREFUL!\n"
 "   -i, --investigate     Enables extra output for trouble-shooting.\n"
@@ -194,6 +234,9 @@ help_actions ()
         output +=
 "Each client action needs the name of an executable, such as 'qseq66'.\n"
 "The server actions 'open', 'duplicate', & 'new' need a session name.\n"
+"The action 'stats' prints the latency statistics of a running nsmd.\n"
+"The action 'prepare@session' starts the clients of the session to be\n"
+"opened next, while the current one runs; 'discard' stops them.\n"
         ;
         puts(CSTR(output));
     }
@@ -207,40 +250,112 @@ help_actions ()
  *
  *  where the part in brackets is optional for some actions and
  *  required for others.
+ *
+ * \param item
+ *      The action item to parse.
+ *
+ * \param [out] a
+ *      Gets the action. Its tag is osc::tag::illegal if the item is bad,
+ *      except for "stats", which has no osc::tag.
+ *
+ * \return
+ *      Returns true if the item is a valid action.
  */
 
 bool
-parse_action_item (const std::string & item)
+parse_action (const std::string & item, action_item & a)
 {
+    a.ai_tag = osc::tag::illegal;
+    a.ai_subject.clear();
+    a.ai_path.clear();
+    a.ai_is_client = false;
+    a.ai_is_stats = item == "stats";    /* not an NSM message, no osc::tag  */
+    if (a.ai_is_stats)
+    {
+        a.ai_path = "/nsm/server/stats";
+        return true;
+    }
+
     lib66::tokenization t = util::tokenize(item, "@");
-    if (t.size() > 0)
+    if (t.size() > 0 && (t[0] == "prepare" || t[0] == "discard"))
     {
-        std::string msgpath;
-        s_action_tag = osc::tag_name_lookup(t[0]);
-        if (s_action_tag != osc::tag::illegal)
+        /*
+         * nsm66d extensions, which have no osc::tag either.
+         */
+
+        bool needed = t[0] == "prepare";
+        if (needed != (t.size() == 2))
+        {
+            util::error_message("Bad subject for", t[0]);
+            return false;
+        }
+        a.ai_path = "/nsm/server/" + t[0];
+        if (needed)
+            a.ai_subject = t[1];
+
+        return true;
+    }
+    else if (t.size() > 0)
+    {
+        a.ai_tag = osc::tag_name_lookup(t[0]);
+        if (a.ai_tag != osc::tag::illegal)
         {
             bool needed = osc::tag_needs_argument(t[0]);
-            s_is_client_action = osc::tag_name_is_client(t[0]);
-            msgpath = osc::tag_message(s_action_tag);
+            a.ai_is_client = osc::tag_name_is_client(t[0]);
+            a.ai_path = osc::tag_message(a.ai_tag);
             if (needed)
             {
                 if (t.size() == 2)
                 {
-                    s_subject_name = t[1];
-                    msgpath += " ";
-                    msgpath += s_subject_name;
+                    a.ai_subject = t[1];
                 }
                 else
                 {
-                    s_action_tag = osc::tag::illegal;
+                    a.ai_tag = osc::tag::illegal;
                     util::error_message("Subject name missing", t[0]);
                 }
             }
         }
-        if (s_action_tag != osc::tag::illegal)
-            util::status_message("Will send", V(msgpath));
     }
-    return s_action_tag != osc::tag::illegal;
+    return a.ai_tag != osc::tag::illegal;
+}
+
+/**
+ *  Parses the --action item into the global settings.
+ */
+
+bool
+parse_action_item (const std::string & item)
+{
+    action_item a;
+    bool result = parse_action(item, a);
+    if (result)
+    {
+        std::string msgpath = a.ai_path;
+        if (! a.ai_subject.empty())
+        {
+            msgpath += " ";
+            msgpath += a.ai_subject;
+        }
+        if (a.ai_is_stats)
+        {
+            s_do_stats = true;
+        }
+        else if (a.ai_tag == osc::tag::illegal)
+        {
+            s_direct_item = item;       /* sent like a one-line batch       */
+            s_direct_path = a.ai_path;
+            s_subject_name = a.ai_subject;
+        }
+        else
+        {
+            s_action_tag = a.ai_tag;
+            s_subject_name = a.ai_subject;
+            s_is_client_action = a.ai_is_client;
+        }
+        util::status_message("Will send", V(msgpath));
+    }
+    return result;
 }
 
 /**
@@ -264,17 +379,20 @@ parse_cli (int argc, char * argv [])
         { "lookup",         no_argument,        0, 'l' },
         { "monitor",        no_argument,        0, 'm' },
         { "url",            required_argument,  0, 'u' },
+        { "discover",       no_argument,        0, 'd' },
+        { "timeout",        required_argument,  0, 't' },
         { "nsmd-path",      required_argument,  0, 'n' },
         { "ping",           no_argument,        0, 'p' },
         { "quiet",          no_argument,        0, 'q' },
         { "stop",           no_argument,        0, 's' },
         { "clean",          no_argument,        0, 'c' },
         { "action",         required_argument,  0, 'a' },
+        { "batch",          required_argument,  0, 'b' },
         { "help",           no_argument,        0, 'h' },
         { "investigate",    no_argument,        0, 'i' },
         { 0, 0, 0, 0 }
     };
-    const char * const opchars = ":lmu:n:pqsca:hi";
+    const char * const opchars = ":lmu:dt:n:pqsca:b:hi";
     bool result = true;
     int optindex = 0;
     int c = 0;
@@ -301,7 +419,25 @@ parse_cli (int argc, char * argv [])
             case 'u':
 
                 s_do_env_nsm_url = false;
-                s_nsm_url = optarg;
+                if (s_nsm_url.empty())
+                    s_nsm_url = optarg;
+
+                s_cluster_urls.push_back(optarg);
+                break;
+
+            case 'd':
+
+                s_do_discover = true;
+                break;
+
+            case 't':
+
+                s_timeout_ms = std::atoi(optarg);
+                if (s_timeout_ms <= 0)
+                {
+                    util::error_message("Bad --timeout", optarg);
+                    result = false;
+                }
                 break;
 
             case 'n':
@@ -345,6 +481,11 @@ parse_cli (int argc, char * argv [])
                 }
                 break;
 
+            case 'b':
+
+                s_batch_source = optarg;
+                break;
+
             case 'i':
 
                 util::set_investigate(true);
@@ -407,6 +548,262 @@ remove_xdg_run_time_directory ()
     return result;
 }
 
+/**
+ *  Handles each "/reply /nsm/server/stats line" from nsmd. An empty line
+ *  marks the end of the statistics.
+ */
+
+int
+stats_reply_handler
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) types; (void) msg;
+    bool * done = static_cast<bool *>(user_data);
+    if (argc >= 2 && std::string(&argv[0]->s) == "/nsm/server/stats")
+    {
+        std::string line { &argv[1]->s };
+        if (line.empty())
+            *done = true;
+        else
+            printf("%s\n", CSTR(line));
+    }
+    return 0;
+}
+
+/**
+ *  Each daemon file in the XDG runtime "nsm/d" directory holds the UDP URL
+ *  of its daemon, and, on the second line, the URL of its UNIX-domain
+ *  socket, if it has one.
+ */
+
+using daemon_file = struct
+{
+    std::string df_udp_url;
+    std::string df_unix_url;
+};
+
+/*
+ *  Reads every daemon file in the XDG runtime "nsm/d" directory.
+ */
+
+std::vector<daemon_file>
+daemon_files ()
+{
+    std::vector<daemon_file> result;
+    std::string daemondir = util::get_xdg_runtime_directory("nsm");
+    DIR * dir = daemondir.empty() ? nullptr : opendir(CSTR(daemondir + "/d"));
+    if (not_nullptr(dir))
+    {
+        const struct dirent * entry;
+        while (not_nullptr(entry = readdir(dir)))
+        {
+            std::string name { entry->d_name };
+            if (name == "." || name == "..")
+                continue;
+
+            std::ifstream file { daemondir + "/d/" + name };
+            daemon_file df;
+            if (std::getline(file, df.df_udp_url) && ! df.df_udp_url.empty())
+            {
+                if (! std::getline(file, df.df_unix_url))
+                    df.df_unix_url.clear();
+
+                result.push_back(df);
+            }
+        }
+        closedir(dir);
+    }
+    return result;
+}
+
+/**
+ *  Finds the local control socket of the nsmd with the given URL.
+ *
+ * \return
+ *      Returns the UNIX-socket URL, or \a nsmurl if there is none.
+ */
+
+std::string
+local_control_url (const std::string & nsmurl)
+{
+    for (const auto & df : daemon_files())
+    {
+        if (df.df_udp_url == nsmurl && ! df.df_unix_url.empty())
+            return df.df_unix_url;
+    }
+    return nsmurl;
+}
+
+/**
+ *  A liblo server of our own, to get the replies of nsmd without passing
+ *  them through the controller, and the address of nsmd to send to.
+ */
+
+using reply_channel = struct
+{
+    lo_server rc_server;
+    lo_address rc_address;
+    std::string rc_url;
+    std::string rc_socket;
+};
+
+/**
+ *  Opens the reply channel.  The daemon's local socket is preferred; then
+ *  the channel needs a UNIX socket of its own for the replies.  Failing
+ *  that, the UDP URL is used.
+ */
+
+bool
+open_reply_channel (const std::string & nsmurl, reply_channel & rc)
+{
+    rc.rc_server = nullptr;
+    rc.rc_url = local_control_url(nsmurl);
+    rc.rc_address = lo_address_new_from_url(CSTR(rc.rc_url));
+    rc.rc_socket.clear();
+    if
+    (
+        not_nullptr(rc.rc_address) &&
+        lo_address_get_protocol(rc.rc_address) == LO_UNIX
+    )
+    {
+        static int s_channel_count { 0 };
+        rc.rc_socket = util::string_asprintf
+        (
+            "%s/nsmctl-%d-%d.osc",
+            V(util::get_xdg_runtime_directory("nsm")), int(getpid()),
+            ++s_channel_count
+        );
+        rc.rc_server = lo_server_new_with_proto
+        (
+            CSTR(rc.rc_socket), LO_UNIX, NULL
+        );
+        if (is_nullptr(rc.rc_server))
+            rc.rc_socket.clear();
+    }
+    if (is_nullptr(rc.rc_server))
+    {
+        if (not_nullptr(rc.rc_address) && rc.rc_url != nsmurl)
+        {
+            lo_address_free(rc.rc_address);
+            rc.rc_address = lo_address_new_from_url(CSTR(nsmurl));
+        }
+        rc.rc_url = nsmurl;
+        rc.rc_server = lo_server_new(NULL, NULL);
+    }
+    return not_nullptr(rc.rc_server) && not_nullptr(rc.rc_address);
+}
+
+void
+close_reply_channel (reply_channel & rc)
+{
+    if (not_nullptr(rc.rc_address))
+        lo_address_free(rc.rc_address);
+
+    if (not_nullptr(rc.rc_server))
+        lo_server_free(rc.rc_server);
+
+    if (! rc.rc_socket.empty())
+        (void) unlink(CSTR(rc.rc_socket));
+
+    rc.rc_address = nullptr;
+    rc.rc_server = nullptr;
+    rc.rc_socket.clear();
+}
+
+/**
+ *  Sends a request with no argument, or one string argument, on the reply
+ *  channel.  liblo does not send to a UNIX address from the socket of the
+ *  server given, so nsmd would see no sender path and could not reply.
+ *  Over a UNIX channel the message is therefore sent from the channel's
+ *  own bound socket, whose path is then the sender nsmd replies to.
+ *
+ * \return
+ *      Returns a negative value if the message could not be sent.
+ */
+
+int
+channel_send
+(
+    const reply_channel & rc,
+    const std::string & path,
+    const std::string & subject = ""
+)
+{
+    bool unixsocket = ! rc.rc_socket.empty();
+    if (! unixsocket)
+    {
+        return subject.empty() ?
+            lo_send_from
+            (
+                rc.rc_address, rc.rc_server, LO_TT_IMMEDIATE, CSTR(path), ""
+            ) :
+            lo_send_from
+            (
+                rc.rc_address, rc.rc_server, LO_TT_IMMEDIATE, CSTR(path),
+                "s", CSTR(subject)
+            ) ;
+    }
+
+    int result = (-1);
+    const char * daemonpath = lo_address_get_port(rc.rc_address);
+    struct sockaddr_un sa;
+    std::memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    if (not_nullptr(daemonpath) && std::strlen(daemonpath) < sizeof sa.sun_path)
+    {
+        std::strcpy(sa.sun_path, daemonpath);
+        lo_message m = lo_message_new();
+        if (! subject.empty())
+            lo_message_add_string(m, CSTR(subject));
+
+        size_t size = 0;
+        void * data = lo_message_serialise(m, CSTR(path), nullptr, &size);
+        if (not_nullptr(data))
+        {
+            ssize_t count = sendto
+            (
+                lo_server_get_socket_fd(rc.rc_server), data, size, 0,
+                reinterpret_cast<struct sockaddr *>(&sa), sizeof sa
+            );
+            if (count == ssize_t(size))
+                result = int(count);
+
+            free(data);
+        }
+        lo_message_free(m);
+    }
+    return result;
+}
+
+/**
+ *  Asks the nsmd at the URL for its statistics and prints them.
+ */
+
+bool
+print_server_stats (const std::string & nsmurl)
+{
+    bool done = false;
+    reply_channel rc;
+    if (open_reply_channel(nsmurl, rc))
+    {
+        (void) lo_server_add_method
+        (
+            rc.rc_server, "/reply", "ss", stats_reply_handler, &done
+        );
+        util::status_message("Statistics of", rc.rc_url);
+        if (channel_send(rc, "/nsm/server/stats") >= 0)
+        {
+            for (int ms = 0; ! done && ms < 5000; ms += 100)
+                (void) lo_server_recv_noblock(rc.rc_server, 100);
+        }
+    }
+    close_reply_channel(rc);
+    return done;
+}
+
 /**
  *  A helper function for consistency.
  */
@@ -459,6 +856,563 @@ nsm_controller ()
 #endif
 }
 
+/*
+ *  Batch mode.  The actions are read one per line and sent over a single
+ *  reply channel, so that nsmctl starts, announces, and waits only once.
+ *  Each request gets an ID, its line number, and is matched to its reply
+ *  by path; nsmd answers the requests on one path in order.
+ *
+ *  Queries (list, stats, ping) and client actions are pipelined: they are
+ *  sent without waiting for earlier replies.  A session operation (open,
+ *  save, close, ...) waits for everything sent before it, and nothing is
+ *  sent after it until its reply, as nsmd runs one operation at a time
+ *  and later lines usually depend on it.
+ */
+
+using batch_clock = std::chrono::steady_clock;
+
+using request = struct
+{
+    int r_id;
+    std::string r_path;
+    bool r_list;
+    batch_clock::time_point r_sent;
+};
+
+std::deque<request> s_pending;
+int s_batch_failures { 0 };
+
+double
+batch_ms (const request & r)
+{
+    return std::chrono::duration<double, std::milli>
+    (
+        batch_clock::now() - r.r_sent
+    ).count();
+}
+
+void
+batch_print
+(
+    int id, const std::string & path, const std::string & status,
+    double ms, const std::string & text
+)
+{
+    if (ms < 0.0)
+        printf("%d\t%s\t%s\t-\t%s\n", id, CSTR(path), CSTR(status), CSTR(text));
+    else
+        printf
+        (
+            "%d\t%s\t%s\t%.1f\t%s\n",
+            id, CSTR(path), CSTR(status), ms, CSTR(text)
+        );
+
+    fflush(stdout);
+}
+
+/*
+ *  Finds the oldest request waiting for a reply on the path.
+ */
+
+std::deque<request>::iterator
+batch_request (const std::string & path)
+{
+    auto it = s_pending.begin();
+    for ( ; it != s_pending.end(); ++it)
+    {
+        if (it->r_path == path)
+            break;
+    }
+    return it;
+}
+
+/**
+ *  Handles "/reply path [text]".  A list (sessions or statistics) is a
+ *  series of replies ended by an empty one.
+ */
+
+int
+batch_reply_handler
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) msg; (void) user_data;
+    if (argc < 1 || types[0] != 's')
+        return 0;
+
+    auto it = batch_request(&argv[0]->s);
+    if (it != s_pending.end())
+    {
+        std::string text;
+        if (argc >= 2 && types[1] == 's')
+            text = &argv[1]->s;
+
+        if (it->r_list && ! text.empty())
+        {
+            batch_print(it->r_id, it->r_path, "item", -1.0, text);
+        }
+        else
+        {
+            batch_print(it->r_id, it->r_path, "ok", batch_ms(*it), text);
+            s_pending.erase(it);
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Handles "/error path code text".
+ */
+
+int
+batch_error_handler
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) types; (void) msg; (void) user_data;
+    if (argc >= 3)
+    {
+        auto it = batch_request(&argv[0]->s);
+        if (it != s_pending.end())
+        {
+            std::string status = "error " + std::to_string(argv[1]->i);
+            batch_print
+            (
+                it->r_id, it->r_path, status, batch_ms(*it), &argv[2]->s
+            );
+            s_pending.erase(it);
+            ++s_batch_failures;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  Waits until every request sent has its reply, or has timed out.
+ */
+
+void
+batch_drain (reply_channel & rc)
+{
+    while (! s_pending.empty() && ! s_die_now)
+    {
+        (void) lo_server_recv_noblock(rc.rc_server, 50);
+        while (! s_pending.empty())
+        {
+            const request & r = s_pending.front();
+            if (batch_ms(r) < s_timeout_ms)
+                break;
+
+            batch_print(r.r_id, r.r_path, "timeout", batch_ms(r), "");
+            s_pending.pop_front();
+            ++s_batch_failures;
+        }
+    }
+}
+
+bool
+batch_is_query (const action_item & a)
+{
+    return a.ai_is_stats || a.ai_tag == osc::tag::srvlist;
+}
+
+/**
+ *  Runs the actions of a batch.
+ *
+ * \param ctlr
+ *      Sends the client actions, which nsmd does not answer; it knows the
+ *      clients by name.
+ *
+ * \param in
+ *      The batch lines, from a file, stdin, or a single --action.
+ *
+ * \return
+ *      Returns true if every action succeeded.
+ */
+
+bool
+run_batch (nsm::nsmcontroller & ctlr, std::istream & in)
+{
+    reply_channel rc;
+    if (s_nsm_url.empty() || ! open_reply_channel(s_nsm_url, rc))
+    {
+        close_reply_channel(rc);
+        util::error_message("No nsmd connection for the batch");
+        return false;
+    }
+    (void) lo_server_add_method
+    (
+        rc.rc_server, "/reply", NULL, batch_reply_handler, nullptr
+    );
+    (void) lo_server_add_method
+    (
+        rc.rc_server, "/error", "sis", batch_error_handler, nullptr
+    );
+    util::status_message("Batch to", rc.rc_url);
+
+    std::string line;
+    int id = 0;
+    while (! s_die_now && std::getline(in, line))
+    {
+        ++id;
+        std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+
+        if (line == "wait")
+        {
+            batch_drain(rc);
+            continue;
+        }
+
+        action_item a;
+        bool query = true;
+        if (line == "ping")
+        {
+            a.ai_tag = osc::tag::illegal;
+            a.ai_path = "/osc/ping";
+            a.ai_is_client = a.ai_is_stats = false;
+        }
+        else if (parse_action(line, a))
+        {
+            query = batch_is_query(a);
+        }
+        else
+        {
+            batch_print(id, line, "error", -1.0, "Bad action");
+            ++s_batch_failures;
+            continue;
+        }
+        if (a.ai_is_client)
+        {
+            bool ok = ctlr.send_client_message(a.ai_tag, a.ai_subject);
+            batch_print(id, a.ai_path, ok ? "sent" : "failed", -1.0, line);
+            if (! ok)
+                ++s_batch_failures;
+
+            continue;
+        }
+        if (! query)
+            batch_drain(rc);
+
+        int rcode = channel_send(rc, a.ai_path, a.ai_subject);
+        if (rcode < 0)
+        {
+            batch_print(id, a.ai_path, "failed", -1.0, "Cannot send");
+            ++s_batch_failures;
+        }
+        else if (a.ai_tag == osc::tag::srvquit)
+        {
+            batch_print(id, a.ai_path, "sent", -1.0, "");   /* no reply */
+        }
+        else
+        {
+            request r
+            {
+                id, a.ai_path, a.ai_is_stats || a.ai_tag == osc::tag::srvlist,
+                batch_clock::now()
+            };
+            s_pending.push_back(r);
+            if (! query)
+                batch_drain(rc);
+        }
+    }
+    batch_drain(rc);
+    close_reply_channel(rc);
+    return s_batch_failures == 0;
+}
+
+/**
+ *  Runs the batch in the file "source", or from stdin if it is "-".
+ */
+
+bool
+run_batch (nsm::nsmcontroller & ctlr, const std::string & source)
+{
+    if (source == "-")
+        return run_batch(ctlr, std::cin);
+
+    std::ifstream file { source };
+    if (! file)
+    {
+        util::error_message("Cannot read batch", source);
+        return false;
+    }
+    return run_batch(ctlr, file);
+}
+
+/*
+ *  Cluster mode.  One action goes to several daemons at once, e.g. one
+ *  nsmd per machine of a rig, each over a reply channel of its own.  The
+ *  replies are gathered as they come, each daemon with its own timeout,
+ *  so the whole takes as long as the slowest daemon, not the sum.  Then
+ *  the results are printed together: a session list merged over the
+ *  daemons, or each daemon's result and the slowest one.
+ */
+
+using cluster_member = struct
+{
+    std::string cm_url;
+    reply_channel cm_channel;
+    std::string cm_path;
+    bool cm_list;
+    bool cm_done;
+    std::string cm_status;
+    std::string cm_text;
+    double cm_ms;
+    std::vector<std::string> cm_items;
+};
+
+void
+cluster_finish
+(
+    cluster_member & m, const std::string & status, const std::string & text
+)
+{
+    m.cm_done = true;
+    m.cm_status = status;
+    m.cm_text = text;
+}
+
+int
+cluster_reply_handler
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) msg;
+    cluster_member & m = *static_cast<cluster_member *>(user_data);
+    if (m.cm_done || argc < 1 || types[0] != 's' || m.cm_path != &argv[0]->s)
+        return 0;
+
+    std::string text;
+    if (argc >= 2 && types[1] == 's')
+        text = &argv[1]->s;
+
+    if (m.cm_list && ! text.empty())
+        m.cm_items.push_back(text);
+    else
+        cluster_finish(m, "ok", text);
+
+    return 0;
+}
+
+int
+cluster_error_handler
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) types; (void) msg;
+    cluster_member & m = *static_cast<cluster_member *>(user_data);
+    if (! m.cm_done && argc >= 3 && m.cm_path == &argv[0]->s)
+    {
+        cluster_finish
+        (
+            m, "error " + std::to_string(argv[1]->i), &argv[2]->s
+        );
+    }
+    return 0;
+}
+
+/*
+ *  The --url values, and with --discover, the UDP URL of every daemon
+ *  file, without repeats.
+ */
+
+std::vector<std::string>
+cluster_urls ()
+{
+    std::vector<std::string> result { s_cluster_urls };
+    if (s_do_discover)
+    {
+        for (const auto & df : daemon_files())
+            result.push_back(df.df_udp_url);
+    }
+
+    std::vector<std::string> unique;
+    for (const auto & u : result)
+    {
+        if (std::find(unique.begin(), unique.end(), u) == unique.end())
+            unique.push_back(u);
+    }
+    return unique;
+}
+
+/**
+ *  Sends the --action (or a ping, without one) to every daemon of the
+ *  cluster, and prints the merged results.  Client actions are not
+ *  supported, as nsmd does not answer them.
+ *
+ * \return
+ *      Returns true if every daemon replied without an error.
+ */
+
+bool
+run_cluster ()
+{
+    if (s_is_client_action)
+    {
+        util::error_message("Cluster mode takes only server actions");
+        return false;
+    }
+
+    std::string path { "/osc/ping" };
+    bool islist = s_do_stats || s_action_tag == osc::tag::srvlist;
+    if (s_do_stats)
+        path = "/nsm/server/stats";
+    else if (s_action_tag != osc::tag::illegal)
+        path = osc::tag_message(s_action_tag);
+    else if (! s_direct_path.empty())
+        path = s_direct_path;
+
+    std::vector<std::string> urls = cluster_urls();
+    if (urls.empty())
+    {
+        util::error_message("No daemons for the cluster");
+        return false;
+    }
+
+    /*
+     * The members do not move once the handlers point to them.
+     */
+
+    std::vector<cluster_member> members(urls.size());
+    auto start = batch_clock::now();
+    for (std::size_t i = 0; i < urls.size(); ++i)
+    {
+        cluster_member & m = members[i];
+        m.cm_url = urls[i];
+        m.cm_path = path;
+        m.cm_list = islist;
+        m.cm_done = false;
+        m.cm_ms = 0.0;
+        if (! open_reply_channel(urls[i], m.cm_channel))
+        {
+            cluster_finish(m, "failed", "Cannot connect");
+            continue;
+        }
+
+        lo_server srv = m.cm_channel.rc_server;
+        (void) lo_server_add_method
+        (
+            srv, "/reply", NULL, cluster_reply_handler, &m
+        );
+        (void) lo_server_add_method
+        (
+            srv, "/error", "sis", cluster_error_handler, &m
+        );
+
+        int rc = channel_send(m.cm_channel, path, s_subject_name);
+        if (rc < 0)
+            cluster_finish(m, "failed", "Cannot send");
+        else if (s_action_tag == osc::tag::srvquit)
+            cluster_finish(m, "sent", "");              /* no reply         */
+    }
+    util::status_message("Sent to the cluster", path);
+
+    /*
+     * Gather the replies from all the channels together.
+     */
+
+    for (;;)
+    {
+        std::vector<struct pollfd> fds;
+        std::vector<cluster_member *> waiting;
+        double elapsed = std::chrono::duration<double, std::milli>
+        (
+            batch_clock::now() - start
+        ).count();
+        for (auto & m : members)
+        {
+            if (m.cm_done)
+                continue;
+
+            if (elapsed >= s_timeout_ms)
+            {
+                m.cm_ms = elapsed;
+                cluster_finish(m, "timeout", "");
+                continue;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = lo_server_get_socket_fd(m.cm_channel.rc_server);
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+            waiting.push_back(&m);
+        }
+        if (waiting.empty() || s_die_now)
+            break;
+
+        if (poll(fds.data(), nfds_t(fds.size()), 50) > 0)
+        {
+            for (std::size_t i = 0; i < fds.size(); ++i)
+            {
+                if ((fds[i].revents & POLLIN) == 0)
+                    continue;
+
+                cluster_member & m = *waiting[i];
+                while (lo_server_recv_noblock(m.cm_channel.rc_server, 0) > 0)
+                {
+                    // no code, the handlers do the work
+                }
+                if (m.cm_done)
+                {
+                    m.cm_ms = std::chrono::duration<double, std::milli>
+                    (
+                        batch_clock::now() - start
+                    ).count();
+                }
+            }
+        }
+    }
+
+    /*
+     * The merged result.
+     */
+
+    bool result = true;
+    const cluster_member * slowest = nullptr;
+    for (auto & m : members)
+    {
+        close_reply_channel(m.cm_channel);
+        if (m.cm_status != "ok" && m.cm_status != "sent")
+            result = false;
+
+        if (islist)
+        {
+            for (const auto & item : m.cm_items)
+                printf("%s\t%s\n", CSTR(m.cm_url), CSTR(item));
+        }
+        printf
+        (
+            "%s\t%s\t%s\t%.1f\t%s\n", CSTR(m.cm_url), CSTR(path),
+            CSTR(m.cm_status), m.cm_ms, CSTR(m.cm_text)
+        );
+        if (is_nullptr(slowest) || m.cm_ms > slowest->cm_ms)
+            slowest = &m;
+    }
+    if (not_nullptr(slowest))
+    {
+        printf
+        (
+            "all\t%s\t%s\t%.1f\tslowest %s\n", CSTR(path),
+            result ? "ok" : "failed", slowest->cm_ms, CSTR(slowest->cm_url)
+        );
+    }
+    fflush(stdout);
+    return result;
+}
+
 /**
  *  These signals and the signal handler help for a clean exit from
  *  any nsmd child process and nsmctl itself.
@@ -530,6 +1484,9 @@ main (int argc, char * argv [])
     if (! ok)
         return EXIT_FAILURE;
 
+    if (s_do_discover || s_cluster_urls.size() > 1)
+        return run_cluster() ? EXIT_SUCCESS : EXIT_FAILURE ;
+
     nsm::daemon_list & alldaemons { nsm_daemon_list() };
     nsm::nsmcontroller & ctlr { nsm_controller() };
     bool existing_server { false };
@@ -569,6 +1526,7 @@ main (int argc, char * argv [])
     }
 
     bool inited { false };
+    int exitcode { EXIT_SUCCESS };
     if (existing_server)
     {
         // std::string portnumber = osc::extract_port_number(s_nsm_url);
@@ -649,23 +1607,44 @@ main (int argc, char * argv [])
                 }
             }
         }
-        for (;;)
+        /*
+         * Wait for the reply to our announce itself, instead of polling
+         * once a second.  osc_wait() returns as soon as a message comes.
+         */
+
+        while (! ctlr.osc_active())
         {
-            (void) sleep(1);
-            if (ctlr.osc_active())
-            {
-                util::info_message("Going active");
-                break;
-            }
-            else if (s_die_now)
+            if (s_die_now)
                 exit(EXIT_SUCCESS);
+
+            ctlr.osc_wait(50);
         }
+        util::info_message("Going active");
         if (s_do_ping)
         {
             util::status_message("Pinging...");
             if (! ctlr.ping())
                 exit(EXIT_FAILURE);
         }
+        if (s_do_stats)
+        {
+            if (s_nsm_url.empty())
+                util::error_message("No nsmd URL for the statistics");
+            else if (! print_server_stats(s_nsm_url))
+                util::error_message("No statistics from", s_nsm_url);
+        }
+        bool batched = ! s_batch_source.empty() || ! s_direct_item.empty();
+        if (! s_batch_source.empty())
+        {
+            if (! run_batch(ctlr, s_batch_source))
+                exitcode = EXIT_FAILURE;
+        }
+        if (! s_direct_item.empty())
+        {
+            std::istringstream item { s_direct_item };
+            if (! run_batch(ctlr, item))
+                exitcode = EXIT_FAILURE;
+        }
         if (s_action_tag != osc::tag::illegal)
         {
             if (s_action_tag == osc::tag::srvlist)
@@ -705,7 +1684,7 @@ main (int argc, char * argv [])
                     break;
             }
         }
-        else
+        else if (! batched)             /* a batch has its replies already  */
         {
             util::info_message("Waiting 1 second");
             ctlr.osc_wait(1000);        /* wait and check for messages      */
@@ -718,7 +1697,7 @@ main (int argc, char * argv [])
         util::error_message("Could not create OSC server");
         exit(EXIT_FAILURE);
     }
-    return EXIT_SUCCESS;
+    return exitcode;
 }
 
 /*
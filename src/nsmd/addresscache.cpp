@@ -0,0 +1,236 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          addresscache.cpp
+ *
+ *    This module implements the cache of shared OSC peer addresses.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include "addresscache.hpp"             /* nsmd::address_cache class        */
+#include "c_macros.h"                   /* not_nullptr() macro, etc.        */
+
+namespace nsmd
+{
+
+address_cache::address_cache (std::size_t idlecapacity) :
+    m_slots         (),
+    m_keys          (),
+    m_idle          (),
+    m_idle_capacity (idlecapacity),
+    m_hits          (0),
+    m_misses        (0)
+{
+    // no code
+}
+
+/**
+ *  Frees every address, held or not. The cache is a static object of
+ *  the daemon, so this happens only at exit.
+ */
+
+address_cache::~address_cache ()
+{
+    for (auto & s : m_slots)
+        lo_address_free(s.second.s_addr);
+}
+
+/**
+ *  Builds the lookup key of a peer: "host:port/protocol".  The old
+ *  address_matches() compared only the port strings; with the host and
+ *  protocol included, a TCP or UNIX-socket peer cannot alias a UDP one.
+ */
+
+std::string
+address_cache::address_key (lo_address addr)
+{
+    std::string result;
+    if (not_nullptr(addr))
+    {
+        const char * host = lo_address_get_hostname(addr);
+        const char * port = lo_address_get_port(addr);
+        if (not_nullptr(host))
+            result = host;
+
+        result += ':';
+        if (not_nullptr(port))
+            result += port;
+
+        result += '/';
+        result += std::to_string(lo_address_get_protocol(addr));
+    }
+    return result;
+}
+
+/**
+ *  Gets the shared address of the peer that sent a message.
+ *
+ * \param source
+ *      Normally lo_message_get_source(msg). It is only read here.
+ *
+ * \return
+ *      Returns an address that stays valid until release(), or a null
+ *      pointer if the address could not be created.
+ */
+
+lo_address
+address_cache::acquire (lo_address source)
+{
+    if (is_nullptr(source))
+        return nullptr;
+
+    std::string key = address_key(source);
+    lo_address result = lookup(key);
+    if (is_nullptr(result))
+    {
+        result = lo_address_new_with_proto
+        (
+            lo_address_get_protocol(source),
+            lo_address_get_hostname(source),
+            lo_address_get_port(source)
+        );
+        if (not_nullptr(result))
+            insert(key, result);
+    }
+    return result;
+}
+
+/**
+ *  Gets the shared address for a URL, e.g. the one given by a GUI.
+ */
+
+lo_address
+address_cache::acquire (const std::string & url)
+{
+    lo_address addr = lo_address_new_from_url(url.c_str());
+    if (is_nullptr(addr))
+        return nullptr;
+
+    std::string key = address_key(addr);
+    lo_address result = lookup(key);
+    if (not_nullptr(result))
+    {
+        lo_address_free(addr);
+    }
+    else
+    {
+        insert(key, addr);
+        result = addr;
+    }
+    return result;
+}
+
+/**
+ *  Drops one reference. An address that is no longer held becomes the
+ *  most recently used idle one.
+ */
+
+void
+address_cache::release (lo_address addr)
+{
+    auto ki = m_keys.find(addr);
+    if (ki == m_keys.end())
+        return;
+
+    auto si = m_slots.find(ki->second);
+    if (si != m_slots.end() && si->second.s_refs > 0)
+    {
+        if (--si->second.s_refs == 0)
+        {
+            si->second.s_idle = m_idle.insert(m_idle.end(), si->first);
+            evict();
+        }
+    }
+}
+
+/**
+ *  Gets the key of an address that came from the cache, without building
+ *  it again.
+ *
+ * \return
+ *      Returns an empty string for an address that is not cached.
+ */
+
+const std::string &
+address_cache::key (lo_address addr) const
+{
+    static const std::string s_empty;
+    auto ki = m_keys.find(addr);
+    return ki != m_keys.end() ? ki->second : s_empty ;
+}
+
+lo_address
+address_cache::lookup (const std::string & key)
+{
+    auto si = m_slots.find(key);
+    if (si == m_slots.end())
+    {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+
+    slot & s = si->second;
+    if (s.s_refs++ == 0)
+        m_idle.erase(s.s_idle);
+
+    return s.s_addr;
+}
+
+void
+address_cache::insert (const std::string & key, lo_address addr)
+{
+    slot s { addr, 1, m_idle.end() };
+    m_slots.emplace(key, s);
+    m_keys.emplace(addr, key);
+}
+
+/**
+ *  Frees the least recently used idle addresses beyond the capacity.
+ */
+
+void
+address_cache::evict ()
+{
+    while (m_idle.size() > m_idle_capacity)
+    {
+        auto si = m_slots.find(m_idle.front());
+        m_idle.pop_front();
+        if (si != m_slots.end())
+        {
+            lo_address addr = si->second.s_addr;
+            m_keys.erase(addr);
+            m_slots.erase(si);
+            lo_address_free(addr);
+        }
+    }
+}
+
+}               // namespace nsmd
+
+/*
+ * addresscache.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,295 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          childwatch.cpp
+ *
+ *    This module implements the pidfd supervision of the client processes.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cerrno>                       /* errno, EINVAL                    */
+#include <sys/syscall.h>                /* SYS_pidfd_open                   */
+#include <sys/wait.h>                   /* waitid(), waitpid()              */
+#include <unistd.h>                     /* close(), syscall()               */
+#include <vector>                       /* std::vector<>                    */
+
+#include "childwatch.hpp"               /* nsmd::child_watch class          */
+#include "util/msgfunctions.hpp"        /* cfg66: util::info_message()      */
+
+namespace nsmd
+{
+
+/*
+ *  P_PIDFD is an enumeration value in glibc 2.36 and later, and missing
+ *  before, so it cannot be tested with the preprocessor.
+ */
+
+static const idtype_t c_p_pidfd = idtype_t(3);
+
+/*
+ *  glibc only gained a pidfd_open() wrapper in version 2.36.
+ */
+
+static int
+pidfd_open (int pid)
+{
+#if defined SYS_pidfd_open
+    return int(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void) pid;
+    return (-1);
+#endif
+}
+
+/*
+ *  The exit status for the callback.
+ */
+
+static int
+exit_code (int status)
+{
+    return WIFEXITED(status) ? WEXITSTATUS(status) : (-1) ;
+}
+
+child_watch::child_watch (eventloop & loop) :
+    m_loop          (loop),
+    m_ended         (),
+    m_supported     (false),
+    m_waitid_pidfd  (false),
+    m_pidfds        (),
+    m_children      (),
+    m_unwatched     ()
+{
+    // no code
+}
+
+/**
+ *  The descriptors are closed, but not removed from the event loop, which
+ *  might already be gone.
+ */
+
+child_watch::~child_watch ()
+{
+    for (const auto & p : m_pidfds)
+        (void) close(p.second);
+}
+
+/**
+ *  Sets the callback, and checks that the kernel can open a pidfd, and
+ *  wait on one.  Linux 5.3 has pidfd_open(), but waitid(P_PIDFD) only
+ *  came with 5.4; before, it fails with EINVAL.  Waiting on the pidfd of
+ *  nsmd itself, which is not its own child, fails with ECHILD instead.
+ *
+ * \return
+ *      Returns true if pidfds are supported. Otherwise reap_children() is
+ *      needed for every SIGCHLD.
+ */
+
+bool
+child_watch::initialize (ended callback)
+{
+    m_ended = callback;
+    int fd = pidfd_open(int(getpid()));
+    m_supported = fd >= 0;
+    if (m_supported)
+    {
+        siginfo_t info;
+        info.si_pid = 0;
+        int rc = waitid(c_p_pidfd, id_t(fd), &info, WEXITED | WNOHANG);
+        m_waitid_pidfd = rc == 0 || errno != EINVAL;
+        (void) close(fd);
+        util::info_message
+        (
+            m_waitid_pidfd ?
+                "Supervising clients with pidfds" :
+                "Supervising clients with pidfds, reaping them by PID"
+        );
+    }
+    else
+        util::info_message("No pidfd support, supervising with SIGCHLD");
+
+    return m_supported;
+}
+
+/**
+ *  Starts watching a process.
+ *
+ * \param pid
+ *      The process ID.  The process can already have exited, as long as no
+ *      one reaped it.
+ *
+ * \param child
+ *      True if nsmd forked the process, so that it is for us to reap.
+ *
+ * \return
+ *      Returns true if the process is held by a pidfd.  A child that is not
+ *      is reaped by reap_children() instead.
+ */
+
+bool
+child_watch::watch (int pid, bool child)
+{
+    if (pid <= 0)
+        return false;
+
+    if (watching(pid))
+        return true;
+
+    int fd = m_supported ? pidfd_open(pid) : (-1) ;
+    bool result = fd >= 0;
+    if (result)
+    {
+        result = m_loop.add_descriptor(fd, [this, pid] () { handle(pid); });
+        if (result)
+        {
+            m_pidfds[pid] = fd;
+            if (child)
+                (void) m_children.insert(pid);
+        }
+        else
+            (void) close(fd);
+    }
+    if (! result && child)
+        (void) m_unwatched.insert(pid);
+
+    return result;
+}
+
+bool
+child_watch::watching (int pid) const
+{
+    return m_pidfds.find(pid) != m_pidfds.end();
+}
+
+/**
+ *  Called when a pidfd is readable, meaning that its process has exited.
+ *  A child is reaped here with waitid(P_PIDFD), which can reap nothing but
+ *  that very process.  Without P_PIDFD, or if it fails, the child is
+ *  reaped by its PID, which cannot have been reused: the unreaped child
+ *  still holds it.
+ */
+
+void
+child_watch::handle (int pid)
+{
+    auto it = m_pidfds.find(pid);
+    if (it == m_pidfds.end())
+        return;
+
+    int status = (-1);
+    if (m_children.count(pid) > 0)
+    {
+        siginfo_t info;
+        info.si_pid = 0;
+        int rc = m_waitid_pidfd ?
+            waitid(c_p_pidfd, id_t(it->second), &info, WEXITED | WNOHANG) :
+            (-1) ;
+
+        if (rc == 0)
+        {
+            if (info.si_pid == 0)
+                return;                         /* not exited after all     */
+
+            if (info.si_code == CLD_EXITED)
+                status = info.si_status;
+        }
+        else
+        {
+            int wstatus = 0;
+            pid_t reaped = waitpid(pid_t(pid), &wstatus, WNOHANG);
+            if (reaped == 0)
+                return;                         /* not exited after all     */
+
+            if (reaped == pid_t(pid))
+                status = exit_code(wstatus);
+        }
+    }
+    unwatch(pid);
+    report(pid, status);
+}
+
+void
+child_watch::unwatch (int pid)
+{
+    auto it = m_pidfds.find(pid);
+    if (it != m_pidfds.end())
+    {
+        (void) m_loop.remove_descriptor(it->second);
+        (void) close(it->second);
+        m_pidfds.erase(it);
+    }
+    (void) m_children.erase(pid);
+}
+
+void
+child_watch::report (int pid, int status)
+{
+    if (m_ended)
+        m_ended(pid, status);
+}
+
+/**
+ *  Called for SIGCHLD.  Without pidfds, every exited child is reaped here.
+ *  With them, only the children that could not be watched are; waitpid(-1)
+ *  would steal the exit of a watched child from its pidfd.
+ */
+
+void
+child_watch::reap_children ()
+{
+    if (m_supported)
+    {
+        std::vector<int> pids(m_unwatched.begin(), m_unwatched.end());
+        for (int pid : pids)
+        {
+            int status = 0;
+            if (waitpid(pid_t(pid), &status, WNOHANG) == pid_t(pid))
+            {
+                (void) m_unwatched.erase(pid);
+                report(pid, exit_code(status));
+            }
+        }
+    }
+    else
+    {
+        for (;;)
+        {
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, WNOHANG);
+            if (pid <= 0)
+                break;
+
+            (void) m_unwatched.erase(int(pid));
+            report(int(pid), exit_code(status));
+        }
+    }
+}
+
+}               // namespace nsmd
+
+/*
+ * childwatch.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,263 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          clientregistry.cpp
+ *
+ *    This module implements the indexed list of session clients.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <algorithm>                    /* std::find()                      */
+
+#include "addresscache.hpp"             /* nsmd::address_cache::address_key */
+#include "clientregistry.hpp"           /* nsmd::client_registry class      */
+
+namespace nsmd
+{
+
+client_registry::client_registry () :
+    m_clients           (),
+    m_entries           (),
+    m_by_pid            (),
+    m_by_id             (),
+    m_by_address        (),
+    m_by_exe            (),
+    m_pending_replies   (0),
+    m_responsive        (0)
+{
+    // no code
+}
+
+client_registry::~client_registry ()
+{
+    for (auto c : m_clients)
+        c->registry(nullptr);
+}
+
+void
+client_registry::add (Client * c)
+{
+    if (is_nullptr(c) || m_entries.find(c) != m_entries.end())
+        return;
+
+    entry e { 0, "", "", nullptr, "", false, false };
+    m_clients.push_back(c);
+    index(c, e);
+    m_entries.emplace(c, e);
+    c->registry(this);
+}
+
+void
+client_registry::remove (Client * c)
+{
+    auto it = std::find(m_clients.begin(), m_clients.end(), c);
+    if (it != m_clients.end())
+        (void) erase(it);
+}
+
+/**
+ *  Removes the client at the given position, keeping the session order
+ *  of the rest.
+ *
+ * \return
+ *      Returns the position of the next client.
+ */
+
+client_registry::iterator
+client_registry::erase (iterator it)
+{
+    Client * c = *it;
+    auto ei = m_entries.find(c);
+    if (ei != m_entries.end())
+    {
+        unindex(c, ei->second);
+        m_entries.erase(ei);
+    }
+    c->registry(nullptr);
+    return m_clients.erase(it);
+}
+
+void
+client_registry::clear ()
+{
+    for (auto c : m_clients)
+        c->registry(nullptr);
+
+    m_clients.clear();
+    m_entries.clear();
+    m_by_pid.clear();
+    m_by_id.clear();
+    m_by_address.clear();
+    m_by_exe.clear();
+    m_pending_replies = m_responsive = 0;
+}
+
+/**
+ *  Called by the Client setters of indexed fields.
+ */
+
+void
+client_registry::refresh (Client * c)
+{
+    auto ei = m_entries.find(c);
+    if (ei != m_entries.end())
+    {
+        entry & e = ei->second;
+        unindex(c, e);
+        index(c, e);
+    }
+}
+
+/**
+ *  Records the current values of the client in the entry and in the
+ *  indices. The address key is rebuilt only if the address changed.
+ */
+
+void
+client_registry::index (Client * c, entry & e)
+{
+    lo_address addr = c->addr();
+    if (addr != e.e_addr)
+    {
+        e.e_addr = addr;
+        e.e_addr_key = address_cache::address_key(addr);
+    }
+    e.e_pid = c->pid();
+    e.e_client_id = c->client_id();
+    e.e_exe_path = c->exe_path();
+    e.e_reply_pending = c->active() && c->reply_pending();
+    e.e_responsive = c->active() || c->launch_error();
+    if (e.e_pid > 0)
+        m_by_pid[e.e_pid] = c;
+
+    if (! e.e_client_id.empty())
+        m_by_id[e.e_client_id] = c;
+
+    if (! e.e_addr_key.empty())
+        m_by_address[e.e_addr_key] = c;
+
+    m_by_exe.emplace(e.e_exe_path, c);
+    if (e.e_reply_pending)
+        ++m_pending_replies;
+
+    if (e.e_responsive)
+        ++m_responsive;
+}
+
+/**
+ *  Removes the client from the indices, using the values it was indexed
+ *  under.  A key is dropped only if it still refers to this client.
+ */
+
+void
+client_registry::unindex (const Client * c, const entry & e)
+{
+    auto pi = m_by_pid.find(e.e_pid);
+    if (pi != m_by_pid.end() && pi->second == c)
+        m_by_pid.erase(pi);
+
+    auto ii = m_by_id.find(e.e_client_id);
+    if (ii != m_by_id.end() && ii->second == c)
+        m_by_id.erase(ii);
+
+    auto ai = m_by_address.find(e.e_addr_key);
+    if (ai != m_by_address.end() && ai->second == c)
+        m_by_address.erase(ai);
+
+    auto range = m_by_exe.equal_range(e.e_exe_path);
+    for (auto xi = range.first; xi != range.second; ++xi)
+    {
+        if (xi->second == c)
+        {
+            m_by_exe.erase(xi);
+            break;
+        }
+    }
+    if (e.e_reply_pending)
+        --m_pending_replies;
+
+    if (e.e_responsive)
+        --m_responsive;
+}
+
+Client *
+client_registry::by_pid (int pid) const
+{
+    auto it = m_by_pid.find(pid);
+    return it != m_by_pid.end() ? it->second : nullptr ;
+}
+
+Client *
+client_registry::by_id (const std::string & id) const
+{
+    auto it = m_by_id.find(id);
+    return it != m_by_id.end() ? it->second : nullptr ;
+}
+
+Client *
+client_registry::by_address (lo_address addr) const
+{
+    auto it = m_by_address.find(address_cache::address_key(addr));
+    return it != m_by_address.end() ? it->second : nullptr ;
+}
+
+/**
+ *  Finds the slot of a client that nsmd started and that is now
+ *  announcing. The PID from the announce is tried first, so that several
+ *  copies of one executable launched together each get their own slot;
+ *  otherwise (e.g. a wrapper script) any starting client with the same
+ *  executable is taken.
+ */
+
+Client *
+client_registry::expected (const std::string & exe, int pid) const
+{
+    Client * c = by_pid(pid);
+    if (not_nullptr(c))
+    {
+        bool starting =
+            c->exe_path() == exe && ! c->active() &&
+            c->pending_command() == nsm::command::start;
+
+        if (starting)
+            return c;
+    }
+
+    auto range = m_by_exe.equal_range(exe);
+    for (auto xi = range.first; xi != range.second; ++xi)
+    {
+        c = xi->second;
+        if (! c->active() && c->pending_command() == nsm::command::start)
+            return c;
+    }
+    return nullptr;
+}
+
+}               // namespace nsmd
+
+/*
+ * clientregistry.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,557 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          copyengine.cpp
+ *
+ *    This module implements the background copy of a session directory.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The workers never call the util:: message functions, which are not
+ *  known to be thread-safe; they only record the first error, which the
+ *  daemon's thread reports.
+ */
+
+#include <algorithm>                    /* std::sort()                      */
+#include <cerrno>                       /* errno, EXDEV, ENOSYS, etc.       */
+#include <cstring>                      /* std::strerror(), strerror_r()    */
+#include <fcntl.h>                      /* open(), O_RDONLY, etc.           */
+#include <fts.h>                        /* function to traverse directories */
+#include <linux/fs.h>                   /* FICLONE                          */
+#include <sys/eventfd.h>                /* eventfd()                        */
+#include <sys/ioctl.h>                  /* ioctl()                          */
+#include <sys/stat.h>                   /* mkdir(), fchmod(), futimens()    */
+#include <unistd.h>                     /* copy_file_range(), close(), ...  */
+
+#include "copyengine.hpp"               /* nsmd::copy_engine class          */
+#include "util/msgfunctions.hpp"        /* cfg66: util::error_message()     */
+
+namespace nsmd
+{
+
+/**
+ *  The amount copied by one copy_file_range() call, and the progress
+ *  granularity.  It keeps a cancel from waiting long on a huge file.
+ */
+
+static const size_t c_chunk_size = 16 * 1024 * 1024;
+
+/**
+ *  The buffer of the read()/write() fall-back.
+ */
+
+static const size_t c_buffer_size = 1024 * 1024;
+
+copy_engine::copy_engine (std::size_t workers) :
+    m_worker_count      (workers > 0 ? workers : 1),
+    m_event_fd          (-1),
+    m_jobs              (),
+    m_threads           (),
+    m_destination       (),
+    m_bytes_total       (0),
+    m_running           (false),
+    m_made_destination  (false),
+    m_next_job          (0),
+    m_active_workers    (0),
+    m_files_done        (0),
+    m_bytes_done        (0),
+    m_cancelled         (false),
+    m_reflinked         (0),
+    m_ranged            (0),
+    m_streamed          (0),
+    m_error_mutex       (),
+    m_error             ()
+{
+    // no code
+}
+
+copy_engine::~copy_engine ()
+{
+    cancel();
+    (void) wait();
+    if (m_event_fd >= 0)
+        close(m_event_fd);
+}
+
+bool
+copy_engine::initialize ()
+{
+    if (m_event_fd < 0)
+    {
+        m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_event_fd < 0)
+            util::error_message("eventfd() failed", std::strerror(errno));
+    }
+    return m_event_fd >= 0;
+}
+
+/**
+ *  Creates the directory tree at the destination and starts the workers
+ *  copying the files. The destination may already exist as an empty
+ *  directory.
+ *
+ * \return
+ *      Returns false if nothing is running, because the walk failed; see
+ *      error().
+ */
+
+bool
+copy_engine::start
+(
+    const std::string & source,
+    const std::string & destination
+)
+{
+    if (m_running || ! initialize())
+        return false;
+
+    m_jobs.clear();
+    m_error.clear();
+    m_destination = destination;
+    m_made_destination = false;
+    m_bytes_total = 0;
+    m_next_job = 0;
+    m_files_done = 0;
+    m_bytes_done = 0;
+    m_cancelled = false;
+    m_reflinked = 0;
+    m_ranged = 0;
+    m_streamed = 0;
+    if (! scan(source, destination))
+        return false;
+
+    std::sort
+    (
+        m_jobs.begin(), m_jobs.end(),
+        [] (const job & a, const job & b) { return a.j_size > b.j_size; }
+    );
+    for (const auto & j : m_jobs)
+        m_bytes_total += j.j_size;
+
+    std::size_t count = std::min(m_worker_count, m_jobs.size());
+    if (count == 0)
+        count = 1;                              /* to signal the end        */
+
+    m_running = true;
+    m_active_workers = count;
+    for (std::size_t w = 0; w < count; ++w)
+        m_threads.emplace_back(&copy_engine::work, this);
+
+    return true;
+}
+
+/**
+ *  Joins the workers. Returns immediately if the copy already finished.
+ *
+ * \return
+ *      Returns true if every file was copied.
+ */
+
+bool
+copy_engine::wait ()
+{
+    for (auto & t : m_threads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+    m_threads.clear();
+    m_running = false;
+    return ! m_cancelled && m_error.empty();
+}
+
+/**
+ *  Makes the workers stop after their current chunk.
+ */
+
+void
+copy_engine::cancel ()
+{
+    m_cancelled = true;
+}
+
+/**
+ *  Clears the eventfd counter after the workers signalled.
+ */
+
+void
+copy_engine::acknowledge ()
+{
+    uint64_t count;
+    (void) read(m_event_fd, &count, sizeof count);
+}
+
+std::string
+copy_engine::error ()
+{
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    return m_error;
+}
+
+/**
+ *  Removes what was copied of a failed or cancelled copy, so that a
+ *  partial session does not show up in the session list.  Must not be
+ *  called while running().  A destination directory that existed before
+ *  the copy is left alone.
+ */
+
+bool
+copy_engine::remove_destination ()
+{
+    if (m_running || ! m_made_destination)
+        return false;
+
+    char * const paths [] = { &m_destination[0], nullptr };
+    FTS * ftsp = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+    if (ftsp == NULL)
+        return false;
+
+    bool result = true;
+    for (;;)
+    {
+        FTSENT * ent = fts_read(ftsp);
+        if (ent == NULL)
+            break;
+
+        int rc = 0;
+        if (ent->fts_info == FTS_DP)
+            rc = rmdir(ent->fts_path);
+        else if (ent->fts_info != FTS_D)
+            rc = unlink(ent->fts_path);
+
+        if (rc != 0)
+            result = false;
+    }
+    (void) fts_close(ftsp);
+    return result;
+}
+
+/**
+ *  Walks the source tree, making the directories and symbolic links at
+ *  the destination and listing the regular files.  Anything else (FIFOs,
+ *  sockets, devices) is skipped.
+ */
+
+bool
+copy_engine::scan (const std::string & source, const std::string & destination)
+{
+    std::string top = source;
+    char * const paths [] = { &top[0], nullptr };
+    FTS * ftsp = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+    if (ftsp == NULL)
+    {
+        record_error("fts_open() failed", source);
+        return false;
+    }
+
+    bool result = true;
+    while (result)
+    {
+        errno = 0;
+        FTSENT * ent = fts_read(ftsp);
+        if (ent == NULL)
+        {
+            if (errno != 0)
+            {
+                record_error("fts_read() failed", source);
+                result = false;
+            }
+            break;
+        }
+
+        std::string relpath(ent->fts_path + top.length());
+        std::string target = destination + relpath;
+        const struct stat * st = ent->fts_statp;
+        if (ent->fts_info == FTS_D)
+        {
+            mode_t mode = (st->st_mode & 07777) | S_IRWXU;
+            if (mkdir(target.c_str(), mode) == 0)
+            {
+                if (ent->fts_level == FTS_ROOTLEVEL)
+                    m_made_destination = true;
+            }
+            else if (errno != EEXIST)
+            {
+                record_error("mkdir() failed", target);
+                result = false;
+            }
+        }
+        else if (ent->fts_info == FTS_F)
+        {
+            job j
+            {
+                ent->fts_path, target, std::uint64_t(st->st_size),
+                mode_t(st->st_mode & 07777), st->st_atim, st->st_mtim
+            };
+            m_jobs.push_back(j);
+        }
+        else if (ent->fts_info == FTS_SL || ent->fts_info == FTS_SLNONE)
+        {
+            std::vector<char> link(std::size_t(st->st_size) + 1, 0);
+            ssize_t len = readlink(ent->fts_path, link.data(), link.size() - 1);
+            if (len < 0 || symlink(link.data(), target.c_str()) != 0)
+            {
+                record_error("Could not copy symbolic link", ent->fts_path);
+                result = false;
+            }
+        }
+        else if
+        (
+            ent->fts_info == FTS_DNR || ent->fts_info == FTS_ERR ||
+            ent->fts_info == FTS_NS
+        )
+        {
+            errno = ent->fts_errno;
+            record_error("Cannot read", ent->fts_path);
+            result = false;
+        }
+    }
+    (void) fts_close(ftsp);
+    return result;
+}
+
+/**
+ *  A worker takes the next file until none is left, an error occurred, or
+ *  the copy was cancelled.  The last worker to leave signals the end.
+ */
+
+void
+copy_engine::work ()
+{
+    for (;;)
+    {
+        if (m_cancelled)
+            break;
+
+        std::size_t i = m_next_job++;
+        if (i >= m_jobs.size())
+            break;
+
+        if (! copy_file(m_jobs[i]))
+            m_cancelled = true;                 /* stop the other workers   */
+
+        ++m_files_done;
+        notify();
+    }
+    if (--m_active_workers == 0)
+        notify();
+}
+
+/**
+ *  Copies one file: a reflink if the file-system can, else an in-kernel
+ *  copy, else a plain one.  The mode and times of the source are kept.
+ *  A file that cannot be copied completely is removed.
+ */
+
+bool
+copy_engine::copy_file (const job & j)
+{
+    int in = open(j.j_source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        record_error("Cannot open", j.j_source);
+        return false;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int out = open(j.j_destination.c_str(), flags, S_IRUSR | S_IWUSR);
+    if (out < 0)
+    {
+        record_error("Cannot create", j.j_destination);
+        close(in);
+        return false;
+    }
+
+    bool result = false;
+#if defined FICLONE
+    if (ioctl(out, FICLONE, in) == 0)
+    {
+        m_bytes_done += j.j_size;
+        ++m_reflinked;
+        result = true;
+    }
+#endif
+    if (! result)
+    {
+        int rc = copy_range(in, out);
+        if (rc > 0)
+        {
+            ++m_ranged;
+            result = true;
+        }
+        else if (rc == 0)
+        {
+            result = copy_stream(in, out);
+            if (result)
+                ++m_streamed;
+        }
+    }
+    if (result)
+    {
+        const struct timespec times [2] = { j.j_atime, j.j_mtime };
+        (void) fchmod(out, j.j_mode);
+        (void) futimens(out, times);
+    }
+    if (close(out) != 0 && result)
+    {
+        record_error("Cannot write", j.j_destination);
+        result = false;
+    }
+    close(in);
+    if (! result)
+        (void) unlink(j.j_destination.c_str());
+
+    return result;
+}
+
+/**
+ * \return
+ *      Returns 1 if the file was copied, 0 if copy_file_range() does not
+ *      work between these files and nothing was copied, and -1 on error
+ *      or cancellation.
+ */
+
+int
+copy_engine::copy_range (int in, int out)
+{
+    bool first = true;
+    for (;;)
+    {
+        if (m_cancelled)
+            return (-1);
+
+        ssize_t n = copy_file_range(in, nullptr, out, nullptr, c_chunk_size, 0);
+        if (n > 0)
+        {
+            m_bytes_done += std::uint64_t(n);
+            first = false;
+            notify();
+        }
+        else if (n == 0)
+        {
+            return 1;                           /* end of file              */
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            bool unsupported =
+                errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                errno == EOPNOTSUPP || errno == EBADF;
+
+            if (first && unsupported)
+                return 0;
+
+            record_error("copy_file_range() failed", std::string());
+            return (-1);
+        }
+    }
+}
+
+bool
+copy_engine::copy_stream (int in, int out)
+{
+    std::vector<char> buffer(c_buffer_size);
+    std::size_t sincenotify = 0;
+    for (;;)
+    {
+        if (m_cancelled)
+            return false;
+
+        ssize_t n = read(in, buffer.data(), buffer.size());
+        if (n == 0)
+            return true;
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            record_error("read() failed", std::string());
+            return false;
+        }
+
+        const char * p = buffer.data();
+        while (n > 0)
+        {
+            ssize_t w = write(out, p, std::size_t(n));
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                record_error("write() failed", std::string());
+                return false;
+            }
+            p += w;
+            n -= w;
+            m_bytes_done += std::uint64_t(w);
+            sincenotify += std::size_t(w);
+        }
+        if (sincenotify >= c_chunk_size)
+        {
+            sincenotify = 0;
+            notify();
+        }
+    }
+}
+
+void
+copy_engine::notify ()
+{
+    uint64_t one = 1;
+    (void) write(m_event_fd, &one, sizeof one);
+}
+
+/**
+ *  Keeps the first error, with the errno text.  Called by the workers, so
+ *  errno is read first, and the text comes from the thread-safe (GNU)
+ *  strerror_r(), not std::strerror().
+ */
+
+void
+copy_engine::record_error (const std::string & what, const std::string & path)
+{
+    int err = errno;
+    char buffer[256];
+    std::string text = what;
+    if (! path.empty())
+        text += " " + path;
+
+    text += ": ";
+    text += strerror_r(err, buffer, sizeof buffer);
+
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    if (m_error.empty())
+        m_error = text;
+}
+
+}               // namespace nsmd
+
+/*
+ * copyengine.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
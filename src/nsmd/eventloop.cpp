@@ -0,0 +1,348 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          eventloop.cpp
+ *
+ *    This module implements the epoll/timerfd reactor of nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  Handlers may add or remove descriptors and timers, and may even call
+ *  wait_until() recursively (an OSC handler waiting for client replies),
+ *  so no iterator into the containers is held across a callback.
+ */
+
+#include <cerrno>                       /* errno, EINTR                     */
+#include <cstring>                      /* std::strerror()                  */
+#include <sys/epoll.h>                  /* epoll_create1(), epoll_wait()    */
+#include <sys/timerfd.h>                /* timerfd_create(), timerfd_set... */
+#include <unistd.h>                     /* close(), read()                  */
+
+#include "eventloop.hpp"                /* nsmd::eventloop class            */
+#include "util/msgfunctions.hpp"        /* cfg66: util::error_message()     */
+
+namespace nsmd
+{
+
+/**
+ *  The maximum number of ready descriptors handled per epoll_wait().
+ */
+
+static const int c_max_events = 16;
+
+eventloop::eventloop () :
+    m_epoll_fd          (-1),
+    m_timer_fd          (-1),
+    m_next_timer_id     (0),
+    m_descriptors       (),
+    m_timers            (),
+    m_timer_deadlines   (),
+    m_idle_handlers     ()
+{
+    // no code
+}
+
+eventloop::~eventloop ()
+{
+    if (m_timer_fd >= 0)
+        close(m_timer_fd);
+
+    if (m_epoll_fd >= 0)
+        close(m_epoll_fd);
+}
+
+/**
+ *  Creates the epoll set and the timerfd.  The timerfd is handled
+ *  internally and is not in m_descriptors.
+ */
+
+bool
+eventloop::initialize ()
+{
+    if (active())
+        return true;
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0)
+    {
+        util::error_message("epoll_create1() failed", std::strerror(errno));
+        return false;
+    }
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timer_fd < 0)
+    {
+        util::error_message("timerfd_create() failed", std::strerror(errno));
+        close(m_epoll_fd);
+        m_epoll_fd = (-1);
+        return false;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = m_timer_fd;
+    return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &ev) == 0;
+}
+
+/**
+ *  Adds a descriptor that is to be watched for readability.  Adding the
+ *  same descriptor again replaces its handler.
+ */
+
+bool
+eventloop::add_descriptor (int fd, handler h)
+{
+    bool result = active() && fd >= 0;
+    if (result)
+    {
+        bool exists = m_descriptors.find(fd) != m_descriptors.end();
+        m_descriptors[fd] = h;
+        if (! exists)
+        {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            result = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+            if (! result)
+            {
+                m_descriptors.erase(fd);
+                util::error_message("epoll_ctl() failed", std::strerror(errno));
+            }
+        }
+    }
+    return result;
+}
+
+bool
+eventloop::remove_descriptor (int fd)
+{
+    auto it = m_descriptors.find(fd);
+    bool result = it != m_descriptors.end();
+    if (result)
+    {
+        m_descriptors.erase(it);
+        (void) epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    return result;
+}
+
+/**
+ *  Schedules a callback after the given number of milliseconds.
+ *
+ * \return
+ *      Returns an ID usable with cancel_timer(). It is never 0.
+ */
+
+eventloop::timer_id
+eventloop::add_timer (long ms, handler h, bool periodic)
+{
+    timer_id id = ++m_next_timer_id;
+    if (id == 0)
+        id = ++m_next_timer_id;
+
+    if (ms < 0)
+        ms = 0;
+
+    clock::time_point deadline = clock::now() + std::chrono::milliseconds(ms);
+    timer t { id, periodic ? ms : 0, h };
+    m_timers.emplace(timer_key(deadline, id), t);
+    m_timer_deadlines[id] = deadline;
+    arm_timer();
+    return id;
+}
+
+bool
+eventloop::cancel_timer (timer_id id)
+{
+    auto it = m_timer_deadlines.find(id);
+    bool result = it != m_timer_deadlines.end();
+    if (result)
+    {
+        m_timers.erase(timer_key(it->second, id));
+        m_timer_deadlines.erase(it);
+        arm_timer();
+    }
+    return result;
+}
+
+/**
+ *  Adds a handler to be called at the end of each run_once().
+ */
+
+void
+eventloop::add_idle (handler h)
+{
+    m_idle_handlers.push_back(h);
+}
+
+/**
+ *  Arms the timerfd for the earliest deadline, or disarms it.
+ */
+
+void
+eventloop::arm_timer ()
+{
+    if (m_timer_fd < 0)
+        return;
+
+    struct itimerspec its;
+    its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+    its.it_value.tv_sec = its.it_value.tv_nsec = 0;
+    if (! m_timers.empty())
+    {
+        clock::duration d = m_timers.begin()->first.first - clock::now();
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>
+        (
+            d
+        ).count();
+        if (ns <= 0)
+            ns = 1;                         /* zero would disarm the timer  */
+
+        its.it_value.tv_sec = time_t(ns / 1000000000LL);
+        its.it_value.tv_nsec = long(ns % 1000000000LL);
+    }
+    (void) timerfd_settime(m_timer_fd, 0, &its, nullptr);
+}
+
+/**
+ *  Runs every timer whose deadline has passed.  Each one is removed (or
+ *  re-scheduled, if periodic) before its callback runs.
+ */
+
+void
+eventloop::fire_expired_timers ()
+{
+    uint64_t expirations;
+    (void) read(m_timer_fd, &expirations, sizeof expirations);
+    for (;;)
+    {
+        if (m_timers.empty())
+            break;
+
+        auto it = m_timers.begin();
+        clock::time_point now = clock::now();
+        if (it->first.first > now)
+            break;
+
+        timer t = it->second;
+        m_timers.erase(it);
+        if (t.t_interval_ms > 0)
+        {
+            clock::time_point next =
+                now + std::chrono::milliseconds(t.t_interval_ms);
+
+            m_timers.emplace(timer_key(next, t.t_id), t);
+            m_timer_deadlines[t.t_id] = next;
+        }
+        else
+            m_timer_deadlines.erase(t.t_id);
+
+        if (t.t_callback)
+            t.t_callback();
+    }
+    arm_timer();
+}
+
+/**
+ *  Waits once for activity and dispatches it.
+ *
+ * \param timeout_ms
+ *      The longest time to block; -1 blocks until there is an event.
+ *
+ * \return
+ *      Returns true if at least one descriptor or timer was handled.
+ */
+
+bool
+eventloop::run_once (long timeout_ms)
+{
+    if (! active())
+        return false;
+
+    struct epoll_event events[c_max_events];
+    int count = epoll_wait(m_epoll_fd, events, c_max_events, int(timeout_ms));
+    if (count < 0)
+    {
+        if (errno != EINTR)
+            util::error_message("epoll_wait() failed", std::strerror(errno));
+
+        count = 0;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = events[i].data.fd;
+        if (fd == m_timer_fd)
+        {
+            fire_expired_timers();
+        }
+        else
+        {
+            auto it = m_descriptors.find(fd);
+            if (it != m_descriptors.end())
+            {
+                handler h = it->second;     /* the handler may remove it    */
+                if (h)
+                    h();
+            }
+        }
+    }
+    for (auto & h : m_idle_handlers)
+        h();
+
+    return count > 0;
+}
+
+/**
+ *  Dispatches events until the predicate holds or the timeout expires.
+ *  The predicate is checked once up front, and then only after events.
+ *
+ * \return
+ *      Returns the final value of the predicate.
+ */
+
+bool
+eventloop::wait_until (predicate done, long timeout_ms)
+{
+    if (done())
+        return true;
+
+    bool expired = false;
+    timer_id t = add_timer(timeout_ms, [&expired] () { expired = true; });
+    bool result = false;
+    for (;;)
+    {
+        (void) run_once(-1);
+        result = done();
+        if (result || expired)
+            break;
+    }
+    (void) cancel_timer(t);
+    return result;
+}
+
+}               // namespace nsmd
+
+/*
+ * eventloop.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
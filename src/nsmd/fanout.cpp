@@ -0,0 +1,326 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          fanout.cpp
+ *
+ *    This module implements the serialise-once OSC fan-out.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cstring>                      /* std::memcpy()                    */
+#include <netdb.h>                      /* getaddrinfo(), freeaddrinfo()    */
+
+#include "fanout.hpp"                   /* nsmd::fanout class               */
+#include "c_macros.h"                   /* not_nullptr() macro, etc.        */
+
+namespace nsmd
+{
+
+/*
+ *  The peers resolved are forgotten once there are this many, which only
+ *  happens with scripts that use a new port for every message.
+ */
+
+static const std::size_t c_max_peers = 256;
+
+fanout::fanout () :
+    m_path          (),
+    m_message       (nullptr),
+    m_buffer        (),
+    m_size          (0),
+    m_peers         (),
+    m_sent          (0),
+    m_fallbacks     (0)
+{
+    // no code
+}
+
+fanout::~fanout ()
+{
+    clear();
+}
+
+void
+fanout::clear ()
+{
+    if (not_nullptr(m_message))
+    {
+        lo_message_free(m_message);
+        m_message = nullptr;
+    }
+    m_path.clear();
+    m_size = 0;
+}
+
+/**
+ *  Builds and serialises the message to send.
+ *
+ * \param path
+ *      The OSC path of the message.
+ *
+ * \param types
+ *      The type string of the arguments, as given to an OSC handler.
+ *
+ * \param argv
+ *      The arguments, as given to an OSC handler.
+ *
+ * \param first
+ *      The index of the first argument to send; the ones before are
+ *      skipped (e.g. the destination path of a broadcast).
+ *
+ * \param argc
+ *      The number of arguments in \a argv.
+ *
+ * \return
+ *      Returns false if an argument has an unknown type, or the message
+ *      could not be serialised.  Then send() does nothing.
+ */
+
+bool
+fanout::build
+(
+    const std::string & path,
+    const char * types,
+    lo_arg ** argv,
+    int first,
+    int argc
+)
+{
+    clear();
+    lo_message m = lo_message_new();
+    bool result = not_nullptr(m);
+    for (int i = first; result && i < argc; ++i)
+    {
+        lo_arg * a = argv[i];
+        switch (types[i])
+        {
+            case 's':
+
+                result = lo_message_add_string(m, &a->s) == 0;
+                break;
+
+            case 'S':
+
+                result = lo_message_add_symbol(m, &a->S) == 0;
+                break;
+
+            case 'i':
+
+                result = lo_message_add_int32(m, a->i) == 0;
+                break;
+
+            case 'h':
+
+                result = lo_message_add_int64(m, a->h) == 0;
+                break;
+
+            case 'f':
+
+                result = lo_message_add_float(m, a->f) == 0;
+                break;
+
+            case 'd':
+
+                result = lo_message_add_double(m, a->d) == 0;
+                break;
+
+            case 'c':
+
+                result = lo_message_add_char(m, char(a->c)) == 0;
+                break;
+
+            case 'm':
+
+                result = lo_message_add_midi(m, a->m) == 0;
+                break;
+
+            case 't':
+
+                result = lo_message_add_timetag(m, a->t) == 0;
+                break;
+
+            case 'b':
+            {
+                lo_blob b = lo_blob_new
+                (
+                    int32_t(lo_blob_datasize((lo_blob) a)),
+                    lo_blob_dataptr((lo_blob) a)
+                );
+                result = not_nullptr(b);
+                if (result)
+                {
+                    result = lo_message_add_blob(m, b) == 0;
+                    lo_blob_free(b);                /* the message copies it */
+                }
+                break;
+            }
+            case 'T':
+
+                result = lo_message_add_true(m) == 0;
+                break;
+
+            case 'F':
+
+                result = lo_message_add_false(m) == 0;
+                break;
+
+            case 'N':
+
+                result = lo_message_add_nil(m) == 0;
+                break;
+
+            case 'I':
+
+                result = lo_message_add_infinitum(m) == 0;
+                break;
+
+            default:
+
+                result = false;
+                break;
+        }
+    }
+    if (result)
+    {
+        std::size_t length = lo_message_length(m, path.c_str());
+        if (m_buffer.size() < length)
+            m_buffer.resize(length);
+
+        std::size_t size = length;
+        result = not_nullptr
+        (
+            lo_message_serialise(m, path.c_str(), m_buffer.data(), &size)
+        );
+        if (result)
+        {
+            m_path = path;
+            m_message = m;
+            m_size = size;
+        }
+    }
+    if (! result && not_nullptr(m))
+        lo_message_free(m);
+
+    return result;
+}
+
+/**
+ *  Sends the message built last to one peer.
+ *
+ * \param server
+ *      The server whose socket sends the message, so that replies come
+ *      back to it.
+ *
+ * \param to
+ *      The peer address.
+ *
+ * \param key
+ *      The key of the peer in the address cache.
+ *
+ * \return
+ *      Returns true if the message was sent.
+ */
+
+bool
+fanout::send (lo_server server, lo_address to, const std::string & key)
+{
+    if (is_nullptr(m_message) || is_nullptr(to))
+        return false;
+
+    bool result = false;
+    if (lo_address_get_protocol(to) == LO_UDP)
+    {
+        const peer & p = resolve(to, key);
+        if (p.p_length > 0)
+        {
+            ssize_t rc = sendto
+            (
+                lo_server_get_socket_fd(server), m_buffer.data(), m_size,
+                MSG_DONTWAIT, (const struct sockaddr *) &p.p_addr, p.p_length
+            );
+            result = rc == ssize_t(m_size);
+        }
+    }
+    if (! result)
+    {
+        ++m_fallbacks;
+        result = lo_send_message_from
+        (
+            to, server, m_path.c_str(), m_message
+        ) >= 0;
+    }
+    if (result)
+        ++m_sent;
+
+    return result;
+}
+
+/**
+ *  Looks up the socket address of a peer, resolving it the first time.
+ *  Only numeric hosts are resolved, so this never waits on DNS.
+ */
+
+const fanout::peer &
+fanout::resolve (lo_address to, const std::string & key)
+{
+    auto pi = m_peers.find(key);
+    if (pi != m_peers.end())
+        return pi->second;
+
+    if (m_peers.size() >= c_max_peers)
+        m_peers.clear();
+
+    peer p;
+    std::memset(&p, 0, sizeof p);
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+    struct addrinfo * info = nullptr;
+    const char * host = lo_address_get_hostname(to);
+    const char * port = lo_address_get_port(to);
+    if (not_nullptr(host) && not_nullptr(port))
+    {
+        if (getaddrinfo(host, port, &hints, &info) == 0 && not_nullptr(info))
+        {
+            if (info->ai_addrlen <= sizeof p.p_addr)
+            {
+                std::memcpy(&p.p_addr, info->ai_addr, info->ai_addrlen);
+                p.p_length = socklen_t(info->ai_addrlen);
+            }
+            freeaddrinfo(info);
+        }
+    }
+    return m_peers.emplace(key, p).first->second;
+}
+
+}               // namespace nsmd
+
+/*
+ * fanout.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
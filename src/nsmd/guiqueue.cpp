@@ -0,0 +1,160 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          guiqueue.cpp
+ *
+ *    This module implements the coalescing queue of GUI messages.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include "c_macros.h"                   /* not_nullptr() macro, etc.        */
+#include "guiqueue.hpp"                 /* nsmd::gui_queue class            */
+
+namespace nsmd
+{
+
+gui_queue::gui_queue (std::size_t maxbundle) :
+    m_items         (),
+    m_keyed         (),
+    m_max_bundle    (maxbundle),
+    m_sent          (0),
+    m_merged        (0)
+{
+    // no code
+}
+
+gui_queue::~gui_queue ()
+{
+    clear();
+}
+
+/**
+ *  Queues a message, taking ownership of it.
+ *
+ * \param key
+ *      If not empty, a queued message with the same key is dropped in
+ *      favor of this one.
+ */
+
+void
+gui_queue::post
+(
+    const std::string & path, lo_message m,
+    const std::string & key
+)
+{
+    if (is_nullptr(m))
+        return;
+
+    if (! key.empty())
+    {
+        auto ki = m_keyed.find(key);
+        if (ki != m_keyed.end())
+        {
+            lo_message_free(ki->second->g_message);
+            m_items.erase(ki->second);
+            m_keyed.erase(ki);
+            ++m_merged;
+        }
+    }
+
+    item i { path, key, m };
+    auto it = m_items.insert(m_items.end(), i);
+    if (! key.empty())
+        m_keyed[key] = it;
+}
+
+/**
+ *  Sends everything queued, in order, as bundles of at most m_max_bundle
+ *  bytes.  A lone message is sent as a plain message.
+ */
+
+void
+gui_queue::flush (lo_address addr, lo_server srv)
+{
+    if (m_items.empty())
+        return;
+
+    if (is_nullptr(addr))
+    {
+        clear();
+        return;
+    }
+    if (m_items.size() == 1)
+    {
+        item & i = m_items.front();
+        (void) lo_send_message_from(addr, srv, i.g_path.c_str(), i.g_message);
+        ++m_sent;
+        clear();
+        return;
+    }
+
+    lo_bundle bundle = nullptr;
+    std::size_t bytes = 0;
+    for (auto & i : m_items)
+    {
+        std::size_t len = lo_message_length(i.g_message, i.g_path.c_str()) + 4;
+        if (not_nullptr(bundle) && bytes + len > m_max_bundle)
+        {
+            (void) lo_send_bundle_from(addr, srv, bundle);
+            lo_bundle_free_recursive(bundle);
+            bundle = nullptr;
+        }
+        if (is_nullptr(bundle))
+        {
+            bundle = lo_bundle_new(LO_TT_IMMEDIATE);
+            bytes = 16;                             /* "#bundle" + timetag  */
+        }
+        lo_bundle_add_message(bundle, i.g_path.c_str(), i.g_message);
+        i.g_message = nullptr;                      /* the bundle owns it   */
+        bytes += len;
+        ++m_sent;
+    }
+    if (not_nullptr(bundle))
+    {
+        (void) lo_send_bundle_from(addr, srv, bundle);
+        lo_bundle_free_recursive(bundle);
+    }
+    clear();
+}
+
+void
+gui_queue::clear ()
+{
+    for (auto & i : m_items)
+    {
+        if (not_nullptr(i.g_message))
+            lo_message_free(i.g_message);
+    }
+    m_items.clear();
+    m_keyed.clear();
+}
+
+}               // namespace nsmd
+
+/*
+ * guiqueue.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,148 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          headroom.cpp
+ *
+ *    This module implements the memory and CPU headroom check.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cstdio>                       /* std::fopen(), std::fscanf()      */
+#include <cstring>                      /* std::strncmp()                   */
+#include <unistd.h>                     /* sysconf()                        */
+
+#include "headroom.hpp"                 /* nsmd::headroom class             */
+#include "util/strfunctions.hpp"        /* cfg66: util::string_asprintf()   */
+
+namespace nsmd
+{
+
+headroom::headroom (long minfreemib, double maxload) :
+    m_min_free_mib  (minfreemib),
+    m_max_load      (maxload)
+{
+    // no code
+}
+
+/**
+ * \return
+ *      Returns the memory available for new processes, in MiB, or -1 if
+ *      it cannot be read.
+ */
+
+long
+headroom::available_mib ()
+{
+    long result = (-1);
+    std::FILE * f = std::fopen("/proc/meminfo", "r");
+    if (f != nullptr)
+    {
+        char line[128];
+        while (std::fgets(line, sizeof line, f) != nullptr)
+        {
+            long kib;
+            if (std::sscanf(line, "MemAvailable: %ld kB", &kib) == 1)
+            {
+                result = kib / 1024;
+                break;
+            }
+        }
+        std::fclose(f);
+    }
+    return result;
+}
+
+/**
+ * \return
+ *      Returns the one-minute load average per on-line CPU, or -1.0 if it
+ *      cannot be read.
+ */
+
+double
+headroom::load_per_cpu ()
+{
+    double result = (-1.0);
+    std::FILE * f = std::fopen("/proc/loadavg", "r");
+    if (f != nullptr)
+    {
+        double load;
+        if (std::fscanf(f, "%lf", &load) == 1)
+        {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            result = load / double(cpus > 0 ? cpus : 1);
+        }
+        std::fclose(f);
+    }
+    return result;
+}
+
+/**
+ *  Checks the limits.  A value that cannot be read is not held against
+ *  the client.
+ *
+ * \param [out] reason
+ *      Gets the limit exceeded, if any.
+ *
+ * \return
+ *      Returns true if there is room for another client.
+ */
+
+bool
+headroom::allows (std::string & reason) const
+{
+    reason.clear();
+    if (m_min_free_mib > 0)
+    {
+        long mib = available_mib();
+        if (mib >= 0 && mib < m_min_free_mib)
+        {
+            reason = util::string_asprintf
+            (
+                "%ld MiB available, below %ld MiB", mib, m_min_free_mib
+            );
+            return false;
+        }
+    }
+    if (m_max_load > 0.0)
+    {
+        double load = load_per_cpu();
+        if (load > m_max_load)
+        {
+            reason = util::string_asprintf
+            (
+                "load %.2f per CPU, above %.2f", load, m_max_load
+            );
+            return false;
+        }
+    }
+    return true;
+}
+
+}               // namespace nsmd
+
+/*
+ * headroom.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -27,7 +27,7 @@
  * \library       nsm66d application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-02-05
- * \updates       2025-04-19
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
@@ -35,32 +35,58 @@
  */
 
 #include <cctype>                       /* std::isupper()                   */
+#include <cstddef>                      /* offsetof()                       */
 #include <cerrno>                       /* #include <errno.h>               */
 #include <csignal>                      /* std::signal() and <signal.h>     */
 #include <cstring>                      /* std::strerror()                  */
 #include <cstdlib>                      /* std::getenv(), std::rand()       */
+#include <ctime>                        /* std::time()                      */
+#include <list>                         /* std::list                        */
+#include <map>                          /* std::map                         */
+#include <memory>                       /* std::shared_ptr, make_shared()   */
+#include <set>                          /* std::set                         */
+#include <vector>                       /* std::vector                      */
 
-#include <fts.h>                        /* function to traverse directories */
 #include <getopt.h>                     /* GNU get command-line option      */
+#include <netinet/in.h>                 /* struct sockaddr_in, htonl()      */
 #include <stdio.h>                      /* vasprintf()                      */
+#include <sys/socket.h>                 /* socket(), bind(), getsockname()  */
 #include <sys/signalfd.h>               /* struct signalfd_siginfo          */
 #include <sys/time.h>                   /* getttimeofday()                  */
+#include <sys/un.h>                     /* struct sockaddr_un               */
 #include <sys/wait.h>                   /* wait() or waitpid()              */
 #include <unistd.h>                     /* execvp()                         */
 
+#include "addresscache.hpp"             /* nsmd::address_cache class        */
+#include "childwatch.hpp"               /* nsmd::child_watch class          */
+#include "clientregistry.hpp"           /* nsmd::client_registry class      */
+#include "copyengine.hpp"               /* nsmd::copy_engine class          */
+#include "eventloop.hpp"                /* nsmd::eventloop reactor          */
+#include "fanout.hpp"                   /* nsmd::fanout class               */
+#include "guiqueue.hpp"                 /* nsmd::gui_queue class            */
+#include "headroom.hpp"                 /* nsmd::headroom class             */
+#include "operation.hpp"                /* nsmd::operation class            */
+#include "placement.hpp"                /* nsmd::placement class            */
+#include "procsampler.hpp"              /* nsmd::proc_sampler class         */
+#include "runtimestats.hpp"             /* nsmd::runtime_stats class        */
+#include "sessionindex.hpp"             /* nsmd::session_index class        */
+#include "sessionplan.hpp"              /* nsmd::session_plan class         */
+#include "sessionwriter.hpp"            /* nsmd::session_writer class       */
+#include "spawner.hpp"                  /* nsmd::spawner class              */
+#include "tracer.hpp"                   /* nsmd::tracer, trace_scope        */
 #include "nsm66d.hpp"                   /* err-codes, Client class, etc.    */
 #include "cfg/appinfo.hpp"              /* cfg66: cfg::set_client_name()    */
 #include "osc/messages.hpp"             /* nsm66: osc::tag enumeration      */
 #include "nsm/helpers.hpp"              /* nsm66: nsm::session_triplets     */
 #include "util/msgfunctions.hpp"        /* cfg66: util::string_asprintf()   */
-#include "util/filefunctions.hpp"       /* cfg66: util::file_write_lines()  */
-#include "util/ftswalker.hpp"           /* cfg66: util::fts_copy_direc...() */
+#include "util/filefunctions.hpp"       /* cfg66: util::file_exists()       */
 
 #define NSMD66_APP_NAME                 "nsm66d"
 #define NSMD66_APP_TITLE                "Nsmd 66"
 #define NSMD_VERSION_STRING             "1.6.1"
 
-static client_list s_client_list;
+static nsmd::address_cache s_address_cache;
+static nsmd::client_registry s_client_list;
 static osc::endpoint * s_osc_server;
 static lo_address s_gui_address;
 static bool s_gui_is_active{false};
@@ -69,7 +95,65 @@ static std::string s_session_path;
 static std::string s_session_name;
 static std::string s_lockfile_directory;
 static std::string s_daemon_file;
-static nsm::command s_pending_operation = nsm::command::none;
+static std::string s_unix_socket;
+static lo_server s_unix_server{nullptr};
+static lo_address s_unix_peer{nullptr};
+static nsmd::eventloop s_event_loop;
+static nsmd::operation s_operation{s_event_loop};
+static nsmd::child_watch s_child_watch{s_event_loop};
+static nsmd::spawner s_spawner;
+static nsmd::session_index s_session_index;
+static nsmd::session_writer s_session_writer;
+static nsmd::gui_queue s_gui_queue;
+static nsmd::copy_engine s_copy_engine;
+static nsmd::fanout s_fanout;
+static nsmd::runtime_stats s_runtime_stats;
+static nsmd::tracer s_tracer;
+
+static bool s_parallel_launch{false};
+
+/*
+ *  Set once the daemon starts to exit; from then on no operation is
+ *  started and no queued client is launched.  The signal that asked for
+ *  the exit is noted by handle_signal_clean_exit() and acted on by the
+ *  main loop.  See start_exit().
+ */
+
+static bool s_exiting{false};
+static volatile std::sig_atomic_t s_exit_signal{0};
+
+/*
+ *  The /proc sampling of the clients, every s_sample_ms (0 disables it),
+ *  optionally pushed to the GUI as /nsm/gui/client/resources.
+ */
+
+static nsmd::proc_sampler s_proc_sampler;
+static long s_sample_ms{2000};
+static bool s_sample_gui{false};
+
+/*
+ *  The next session, prepared while the current one runs.  Its clients are
+ *  held in their own registry, out of the session, until it is opened; see
+ *  prepare_session().
+ */
+
+static nsmd::client_registry s_held_clients;
+static client_list s_prepare_queue;
+static nsmd::eventloop::timer_id s_prepare_timer{0};
+static std::string s_prepared_path;
+static std::string s_prepared_name;
+static nsmd::headroom s_headroom;
+static struct timeval s_session_load_time;
+
+/*
+ *  Each liblo server that is created without a port number tries a short
+ *  sequence of ports derived from rand() plus time(NULL) (seconds), retrying
+ *  on a collision.  Every freshly exec'ed client starts with the same rand()
+ *  state, so only this many clients can reliably find a free port within
+ *  one wall-clock second.  See launch_next_client_slot().
+ */
+
+static const int s_launch_burst_limit{12};
 
 static std::string s_session_subdir{"nsm"};
 static std::string s_session_file{"session.nsm"};
@@ -85,8 +169,10 @@ Client::Client () :
     m_reply_message     (),
     m_pending_command   (0),
     m_command_sent_time (),
+    m_launch_time       (),
     m_gui_visible       (true),
     m_label             (),
+    m_registry          (nullptr),
     m_addr              (),
     m_name              (),
     m_exe_path          (),
@@ -99,7 +185,8 @@ Client::Client () :
     m_pre_existing      (false),
     m_status            (),
     m_launch_error      (nsm::error::ok),
-    m_name_with_id      ()
+    m_name_with_id      (),
+    m_attributes        ()
 {
     // no other code
 }
@@ -114,8 +201,10 @@ Client::Client
     m_reply_message     (),
     m_pending_command   (0),
     m_command_sent_time (),
+    m_launch_time       (),
     m_gui_visible       (true),
     m_label             (),
+    m_registry          (nullptr),
     m_addr              (),
     m_name              (name),
     m_exe_path          (exe),
@@ -128,7 +217,8 @@ Client::Client
     m_pre_existing      (false),
     m_status            (),
     m_launch_error      (nsm::error::ok),
-    m_name_with_id      ()
+    m_name_with_id      (),
+    m_attributes        ()
 {
     // no other code
 }
@@ -138,37 +228,237 @@ Client::pending_command (int command)
 {
     gettimeofday(&m_command_sent_time, NULL);
     m_pending_command = command;
+    reindex();
 }
 
-double
-Client::ms_since_last_command () const
+/**
+ *  The address of an announced client comes from s_address_cache; see
+ *  the announce handler.
+ */
+
+Client::~Client ()
+{
+    if (not_nullptr(m_addr))
+        s_address_cache.release(m_addr);
+}
+
+void
+Client::reindex ()
+{
+    if (not_nullptr(m_registry))
+        m_registry->refresh(this);
+}
+
+/*
+ *  Returns the milliseconds elapsed since the given time-stamp.
+ */
+
+static double
+elapsed_ms (const struct timeval & since)
 {
     struct timeval now;
     gettimeofday(&now, NULL);
 
-    double elapsedms = (now.tv_sec - m_command_sent_time.tv_sec) * 1000.0;
-    elapsedms += (now.tv_usec - m_command_sent_time.tv_usec) / 1000.0;
+    double elapsedms = (now.tv_sec - since.tv_sec) * 1000.0;
+    elapsedms += (now.tv_usec - since.tv_usec) / 1000.0;
     return elapsedms;
 }
 
+double
+Client::ms_since_last_command () const
+{
+    return elapsed_ms(m_command_sent_time);
+}
+
+void
+Client::launch_stamp ()
+{
+    gettimeofday(&m_launch_time, NULL);
+}
+
+double
+Client::ms_since_launch () const
+{
+    return elapsed_ms(m_launch_time);
+}
+
 /*-------------------------------------------------------------------------
  * Helper functions
  *-------------------------------------------------------------------------*/
 
-void handle_signal_clean_exit (int signal);     /* defined way below        */
+static void start_exit (const std::string & name);  /* way below      */
 
 /*
  * GUI sends:
  *
  *  send(s_gui_addr, cmdpath, client ID, client label) has many calls.
  *  send(lo_message_get_source(), /error|/reply, path, errorcode, message)
+ *
+ *  The "_ex" versions are for handlers that wait for clients before
+ *  replying. By then lo_message_get_source() would return the sender of
+ *  the last message dispatched during the wait, so such a handler pins
+ *  its sender on entry with an nsmd::address_ref and passes that.
+ */
+
+/*
+ *  GUI messages go through s_gui_queue, which the event loop flushes as
+ *  bundles after each iteration; see flush_gui_queue(). Use gui_post()
+ *  for events and gui_update() for the state of a client (status, label,
+ *  progress, dirty, GUI visibility), which a later update of the same
+ *  kind for the same client supersedes while still queued.
  */
 
+static void flush_gui_queue ();
+
+template <typename... Args>
 void
-gui_send (const char * msg, const std::string & s1, const std::string & s2)
+gui_post (const char * path, Args... args)
+{
+    if (s_gui_is_active)
+    {
+        lo_message m = lo_message_new();
+        nsmd::message_build(m, args...);
+        s_gui_queue.post(path, m);
+    }
+}
+
+template <typename... Args>
+void
+gui_update (const char * path, const std::string & clientid, Args... args)
 {
     if (s_gui_is_active)
-        s_osc_server->send(s_gui_address, msg, CSTR(s1), CSTR(s2));
+    {
+        std::string key = std::string(path) + " " + clientid;
+        lo_message m = lo_message_new();
+        nsmd::message_build(m, clientid, args...);
+        s_gui_queue.post(path, m, key);
+    }
+}
+
+static bool
+gui_path_is_state (const std::string & path)
+{
+    return
+        path == "/nsm/gui/client/status" ||
+        path == "/nsm/gui/client/label" ||
+        path == "/nsm/gui/client/resources";
+}
+
+void
+gui_send (const char * msg, const std::string & s1, const std::string & s2)
+{
+    if (gui_path_is_state(msg))
+        gui_update(msg, s1, s2);
+    else
+        gui_post(msg, s1, s2);
+}
+
+/*
+ *  Replies go back through the server the message came in on.  A message
+ *  from the local UNIX socket is read by handle_unix_input(), which keeps
+ *  the socket path of its sender in s_unix_peer while it is dispatched;
+ *  liblo's own source address of such a message has no path to reply to.
+ *  The path is the "port" of a UNIX lo_address, so it survives the copy
+ *  made by the address cache, for the replies of the "_ex" handlers.
+ */
+
+static lo_address
+message_source (lo_message msg)
+{
+    return not_nullptr(s_unix_peer) ? s_unix_peer : lo_message_get_source(msg);
+}
+
+static bool
+is_unix_peer (lo_address addr)
+{
+    return not_nullptr(s_unix_server) && not_nullptr(addr) &&
+        lo_address_get_protocol(addr) == LO_UNIX;
+}
+
+/*
+ *  Sends serialised OSC data from the local socket to a UNIX peer, and
+ *  frees the data.
+ */
+
+static int
+unix_send (lo_address addr, void * data, size_t size)
+{
+    int result = (-1);
+    const char * peer = lo_address_get_port(addr);
+    struct sockaddr_un sa;
+    std::memset(&sa, 0, sizeof sa);
+    sa.sun_family = AF_UNIX;
+    if
+    (
+        not_nullptr(data) && not_nullptr(peer) &&
+        std::strlen(peer) < sizeof sa.sun_path
+    )
+    {
+        std::strcpy(sa.sun_path, peer);
+        ssize_t count = sendto
+        (
+            lo_server_get_socket_fd(s_unix_server), data, size, 0,
+            reinterpret_cast<struct sockaddr *>(&sa), sizeof sa
+        );
+        if (count == ssize_t(size))
+            result = int(count);
+        else
+            util::warn_message("Cannot reply on local socket", peer);
+    }
+    free(data);
+    return result;
+}
+
+static int
+send_message_to (lo_address addr, const char * path, lo_message m)
+{
+    if (! is_unix_peer(addr))
+        return lo_send_message_from(addr, s_osc_server->server(), path, m);
+
+    size_t size = 0;
+    void * data = lo_message_serialise(m, path, nullptr, &size);
+    return unix_send(addr, data, size);
+}
+
+static int
+send_bundle_to (lo_address addr, lo_bundle b)
+{
+    if (! is_unix_peer(addr))
+        return lo_send_bundle_from(addr, s_osc_server->server(), b);
+
+    size_t size = 0;
+    void * data = lo_bundle_serialise(b, nullptr, &size);
+    return unix_send(addr, data, size);
+}
+
+static void
+send_error_to
+(
+    lo_address addr, const std::string & path,
+    int errcode, const char * errmsg
+)
+{
+    lo_message m = lo_message_new();
+    lo_message_add_string(m, CSTR(path));
+    lo_message_add_int32(m, errcode);
+    lo_message_add_string(m, errmsg);
+    (void) send_message_to(addr, "/error", m);
+    lo_message_free(m);
+}
+
+static void
+send_reply_to
+(
+    lo_address addr, const std::string & path, const char * replymsg
+)
+{
+    lo_message m = lo_message_new();
+    lo_message_add_string(m, CSTR(path));
+    if (not_nullptr(replymsg))
+        lo_message_add_string(m, replymsg);
+
+    (void) send_message_to(addr, "/reply", m);
+    lo_message_free(m);
 }
 
 void
@@ -178,28 +468,18 @@ error_send
     int errcode, const char * errmsg
 )
 {
-    s_osc_server->send
-    (
-        lo_message_get_source(msg), "/error", CSTR(path), errcode, errmsg
-    );
+    send_error_to(message_source(msg), path, errcode, errmsg);
 }
 
 void
 error_send_ex
 (
-    lo_message msg, const std::string & path,
+    lo_address senderaddr, const std::string & path,
     int errcode, const char * errmsg
 )
 {
-    lo_address senderaddr = lo_address_new_from_url
-    (
-        lo_address_get_url(lo_message_get_source(msg))
-    );
     util::warn_message(std::string(errmsg));
-    s_osc_server->send
-    (
-        senderaddr, "/error", CSTR(path), errcode, errmsg
-    );
+    send_error_to(senderaddr, path, errcode, errmsg);
 }
 
 void
@@ -209,28 +489,18 @@ reply_send
     const char * replymsg
 )
 {
-    s_osc_server->send
-    (
-        lo_message_get_source(msg), "/reply", CSTR(path), replymsg
-    );
+    send_reply_to(message_source(msg), path, replymsg);
 }
 
 void
 reply_send_ex
 (
-    lo_message msg, const std::string & path,
+    lo_address senderaddr, const std::string & path,
     const char * replymsg
 )
 {
-    lo_address senderaddr = lo_address_new_from_url
-    (
-        lo_address_get_url(lo_message_get_source(msg))
-    );
     util::info_message("Reply", std::string(replymsg));
-    s_osc_server->send
-    (
-        senderaddr, "/reply", CSTR(path), replymsg
-    );
+    send_reply_to(senderaddr, path, replymsg);
 }
 
 /*
@@ -264,20 +534,24 @@ signal_descriptor ()
  *  is SIGCHLD, then this function calls handle_sigchld().
  *
  *  The signalfd_siginfo structure has a lot of members, but we use only
- *  one so far.
+ *  one so far.  Several child exits can be queued by the time the event
+ *  loop gets here, so all records are drained; handle_sigchld() then
+ *  reaps every exited child in one pass.
  */
 
 void
 handle_child_signal ()
 {
     int sd = signal_descriptor();
+    bool sigchld = false;
     struct signalfd_siginfo fdsi;
-    ssize_t s = read(sd, &fdsi, sizeof(struct signalfd_siginfo));
-    if (s == sizeof(struct signalfd_siginfo))
+    while (read(sd, &fdsi, sizeof fdsi) == ssize_t(sizeof fdsi))
     {
         if (fdsi.ssi_signo == SIGCHLD)
-            handle_sigchld();
+            sigchld = true;
     }
+    if (sigchld)
+        handle_sigchld();
 }
 
 /*
@@ -306,7 +580,7 @@ gui_msg_send (const std::string & format, va_list vargs)
         int count = vasprintf(&s, CSTR(format), vargs);
         if (count != (-1))
         {
-            s_osc_server->send(s_gui_address, "/nsm/gui/server/message", s);
+            gui_post("/nsm/gui/server/message", s);
             free(s);
         }
     }
@@ -321,6 +595,22 @@ gui_msg (std::string format, ...)
     va_end(vargs);
 }
 
+/*
+ *  A server message that a later one with the same key supersedes while
+ *  still queued, for running progress.
+ */
+
+static void
+gui_msg_update (const std::string & key, const std::string & text)
+{
+    if (s_gui_is_active)
+    {
+        lo_message m = lo_message_new();
+        nsmd::message_build(m, text);
+        s_gui_queue.post("/nsm/gui/server/message", m, key);
+    }
+}
+
 /*-------------------------------------------------------------------------
  * Application functions
  *-------------------------------------------------------------------------*/
@@ -339,30 +629,21 @@ clients_have_errors ()
 Client *
 get_client_by_pid (int pid)
 {
-    for (auto c : s_client_list)
-    {
-        if (c->pid() == pid)
-            return c;
-    }
-    return nullptr;
+    return s_client_list.by_pid(pid);
 }
 
 /**
- *  Need to do it the brute force way. Can't get auto to work; we
- *  need the iterator.
- *
- *  Is there a better way, like client_list::clear()?
+ *  The registry is emptied first, so that no Client is deleted while
+ *  still indexed.
  */
 
 void
 clear_clients ()
 {
-    client_list & cl = s_client_list;
-    for (client_list::iterator i = cl.begin(); i != cl.end(); ++i)
-    {
-        delete *i;
-        i = cl.erase(i);
-    }
+    nsmd::client_registry::container doomed = s_client_list.clients();
+    s_client_list.clear();
+    for (auto c : doomed)
+        delete c;
 }
 
 /*
@@ -407,7 +688,8 @@ handle_client_process_death (int pid)
             gui_send("/nsm/gui/client/status", c->client_id(), c->status());
 
             /*
-             *  This will not remove the client's save-data.
+             *  This will not remove the client's save-data.  The client is
+             *  gone after this, so nothing below may touch it.
              */
 
             s_client_list.remove(c);
@@ -441,63 +723,84 @@ handle_client_process_death (int pid)
                     "/nsm/gui/client/status", c->client_id(), c->status()
                 );
             }
+            c->pending_command(nsm::command::none);
+            c->active(false);
+            c->pid(0);
         }
-        c->pending_command(nsm::command::none);
-        c->active(false);
-        c->pid(0);
     }
 }
 
 /*
- *  Make it not NULL to enable information storage in status.
- *  Note that -1 means wait for any child process. pid_t is a signed
- *  integer.
- *
- *  Compare to waitpid(2).
+ *  A held client of the prepared session is not in the session, so its end
+ *  is only logged, and it is dropped.
  */
 
-void
-handle_sigchld ()
+static bool
+held_client_ended (int pid)
 {
-    for (;;)
+    Client * c = s_held_clients.by_pid(pid);
+    bool result = not_nullptr(c);
+    if (result)
     {
-        int status = 1;
-        pid_t pid = waitpid(-1, &status, WNOHANG);
-        if (pid <= 0)
-        {
-            break;      /* no child process ended this loop; check again    */
-        }
-        else
-        {
-            /*
-             * One child process has stopped. Find which and figure out the
-             * stop-conditions.
-             */
+        util::warn_message("Prepared client ended", c->name_with_id());
+        s_held_clients.remove(c);
+        delete c;
+    }
+    return result;
+}
 
-            Client * c = get_client_by_pid(pid);
-            if (not_nullptr(c))
-            {
-                /*
-                 * The following will not trigger with normal crashes, e.g.
-                 * segfaults or python tracebacks.
-                 */
+/*
+ *  Called by the child watch, exactly once for each client process that
+ *  ended, with its exit status, or -1 if it was killed by a signal or is
+ *  not our child.
+ */
 
-                if (WIFEXITED(status)) /* true if child terminated normally */
-                {
-                    if (WEXITSTATUS(status) == 255) /* exit(-1) in launch() */
-                        c->launch_error(true);
-                }
-            }
+static void
+handle_process_ended (int pid, int exitcode)
+{
+    if (held_client_ended(pid))
+        return;
 
-            /*
-             * Call even if Client was already null. This will check itself
-             * again and was expected. To be called for the majority of
-             * nsmd's development.
-             */
+    Client * c = get_client_by_pid(pid);
+    if (not_nullptr(c))
+    {
+        /*
+         * The following will not trigger with normal crashes, e.g.
+         * segfaults or python tracebacks.
+         */
 
-            handle_client_process_death(pid);
+        if (exitcode == nsmd::spawner::c_exec_failed)  /* old C library   */
+            c->launch_error(true);
+
+        int pc = c->pending_command();
+        if (pc == nsm::command::quit || pc == nsm::command::kill)
+        {
+            s_runtime_stats.latency
+            (
+                c->name_with_id(), "quit", c->ms_since_last_command()
+            );
         }
     }
+
+    /*
+     * Call even if Client was already null. This will check itself
+     * again and was expected. To be called for the majority of
+     * nsmd's development.
+     */
+
+    handle_client_process_death(pid);
+}
+
+/*
+ *  With pidfds, the children are reaped by their descriptors, and this
+ *  only reaps the few that could not be watched.  Otherwise it reaps every
+ *  exited child, with waitpid(-1).
+ */
+
+void
+handle_sigchld ()
+{
+    s_child_watch.reap_children();
 }
 
 /**
@@ -551,9 +854,9 @@ set_name (const std::string & name)
 bool
 address_matches (lo_address addr1, lo_address addr2)
 {
-    std::string url1 = lo_address_get_port(addr1);
-    std::string url2 = lo_address_get_port(addr2);
-    return url1 == url2;
+    return
+        nsmd::address_cache::address_key(addr1) ==
+        nsmd::address_cache::address_key(addr2);
 }
 
 /**
@@ -587,7 +890,7 @@ is_a_client_id (const std::string & s)
 Client *
 get_client_by_name
 (
-    const client_list & cl,
+    const nsmd::client_registry & cl,
     const std::string & name
 )
 {
@@ -599,53 +902,39 @@ get_client_by_name
     return nullptr;
 }
 
+/**
+ *  Names are not unique and are not indexed, but client IDs are.
+ */
+
 Client *
 get_client_by_id
 (
-    const client_list & cl,
+    const nsmd::client_registry & cl,
     const std::string & id
 )
 {
     if (is_a_client_id(id))
-    {
-        for (auto & c : cl)
-        {
-            if (c->client_id() == id)
-                return c;
-        }
-    }
+        return cl.by_id(id);
     else
-    {
         return get_client_by_name(cl, id);
-    }
-    return nullptr;
 }
 
 Client *
 get_client_by_name_and_id
 (
-    const client_list & cl,
+    const nsmd::client_registry & cl,
     const std::string & name,
     const std::string & id
 )
 {
-    for (auto & c : cl)
-    {
-        if (c->client_id() == id && c->name() == name)
-            return c;
-    }
-    return nullptr;
+    Client * c = cl.by_id(id);
+    return not_nullptr(c) && c->name() == name ? c : nullptr ;
 }
 
 Client *
 get_client_by_address (lo_address addr)
 {
-    for (auto & c : s_client_list)
-    {
-        if (address_matches(c->addr(), addr))
-            return c;
-    }
-    return nullptr;
+    return s_client_list.by_address(addr);
 }
 
 /**
@@ -672,19 +961,15 @@ get_client_by_address (lo_address addr)
 bool
 replies_still_pending ()
 {
-    for (const auto & c : s_client_list)
-    {
-        if (c->active() && c->reply_pending())
-            return true;
-    }
-    return false;
+    return s_client_list.pending_replies() > 0;
 }
 
 /**
  *  This was renamed from number_of_active_clients() in version 1.4 to reflect
  *  that not only active == true clients are in a state where waiting has
  *  ended, but also clients that never started. It is used in
- *  wait_for_announce() only, which added a 5000ms delay to startup.
+ *  add_announce_phase() only; the wait used to add a 5000ms delay to
+ *  startup.
  *
  *  We are sadly unable to distinguish between a client that has a slow
  *  announce and a client without NSM-support. However, this is mitigated by
@@ -693,20 +978,15 @@ replies_still_pending ()
  *
  *  Optimisation:
  *
- *      Clients that never launched (e.g. file not found) will be checked
- *      many times/second here. We skip them by counting them.
+ *      Clients that never launched (e.g. file not found) are counted as
+ *      responsive.  The count is kept by the client registry, so this
+ *      check, made after every event during the wait, is O(1).
  */
 
 int
 number_of_reponsive_clients ()
 {
-    int responsive = 0;
-    for (const auto & c : s_client_list)
-    {
-        if (c->active() || c->launch_error())
-            ++responsive;
-    }
-    return responsive;
+    return s_client_list.responsive();
 }
 
 bool
@@ -723,65 +1003,392 @@ process_is_running (int pid)
     return false;
 }
 
+/*
+ *  Only the clients not held by a pidfd are polled.  The PIDs are gathered
+ *  first, as handle_client_process_death() can remove a client.
+ */
+
 void
 purge_dead_clients ()
 {
-    client_list tmp(s_client_list);     /* why a copy?  */
-    for (const auto & c : tmp)
+    nsmd::trace_scope ts(s_tracer, "purge_dead_clients");
+    std::vector<int> pids;
+    for (const auto & c : s_client_list.clients())
     {
-        if (c->pid())
-        {
-            if (! process_is_running(c->pid()))
-                handle_client_process_death(c->pid());
-        }
+        if (c->pid() > 0 && ! s_child_watch.watching(c->pid()))
+            pids.push_back(c->pid());
+    }
+    for (int pid : pids)
+    {
+        if (! process_is_running(pid))
+            handle_client_process_death(pid);
+    }
+    pids.clear();
+    for (const auto & c : s_held_clients.clients())
+    {
+        if (c->pid() > 0 && ! s_child_watch.watching(c->pid()))
+            pids.push_back(c->pid());
+    }
+    for (int pid : pids)
+    {
+        if (! process_is_running(pid))
+            (void) held_client_ended(pid);
     }
 }
 
-void
-wait (long timeout)
-{
-    handle_child_signal();              /* uses signalfd_siginfo and read() */
-    s_osc_server->wait(timeout);
-    purge_dead_clients();
-}
+/*
+ *  Samples the resource use of each running client, from a timer, so that
+ *  no OSC handler pays for it.  The samples of the clients that are gone
+ *  are dropped by the sweep.
+ */
 
 void
-wait_for_announce ()
+sample_clients ()
 {
-    int n = 5 * 1000;
-    gui_msg("Waiting for announcements from clients");
-    size_t active = 0;
-    while (n > 0)
+    nsmd::trace_scope ts(s_tracer, "sample_clients");
+    for (const auto & c : s_client_list.clients())
     {
-        n -= 100;
-        wait(100);
-        active = size_t(number_of_reponsive_clients());
-        if (s_client_list.size() == active)
-            break;
+        if (c->pid() > 0 && s_proc_sampler.sample(c->pid(), c->name_with_id()))
+        {
+            if (s_sample_gui)
+            {
+                std::string line = s_proc_sampler.summary(c->pid());
+                if (! line.empty())
+                {
+                    gui_send
+                    (
+                        "/nsm/gui/client/resources", c->client_id(), line
+                    );
+                }
+            }
+        }
     }
-    gui_msg
-    (
-        "Done. %lu out of %lu clients announced (or failed to launch) "
-        "within the initialization grace period",
-        active, s_client_list.size()
-    );
+    s_proc_sampler.sweep();
 }
 
-void
-wait_for_replies ()
-{
-    int n = 60 * 1000;                                          /* 60 seconds */
-    gui_msg("Waiting for clients to reply to commands");
-    while (n > 0)
+/*
+ *  The liblo server handle. Only the socket descriptor is needed by the
+ *  event loop; message dispatch remains liblo's job.
+ */
+
+static lo_server
+osc_server_handle ()
+{
+    return s_osc_server->server();
+}
+
+/*
+ *  Sends the queued GUI messages. Called after every event-loop
+ *  iteration, and before anything is sent to the GUI directly.
+ */
+
+static void
+flush_gui_queue ()
+{
+    s_gui_queue.flush(s_gui_address, osc_server_handle());
+}
+
+/*
+ *  Dispatches every OSC message that is queued on the server socket.
+ *  The handlers run as they always did, just from the event loop.
+ */
+
+static void
+handle_osc_input ()
+{
+    lo_server srv = osc_server_handle();
+    while (lo_server_recv_noblock(srv, 0) > 0)
+    {
+        // no code, the method handlers do the work
+    }
+}
+
+/*
+ *  Reads the datagrams of the local socket itself, rather than with
+ *  lo_server_recv_noblock(), to get the socket path of each sender, and
+ *  has liblo dispatch them.  A sender with no path of its own (an unbound
+ *  socket) is still served, but cannot get a reply.  The buffer is as big
+ *  as the socket's receive buffer, which bounds a datagram; MSG_TRUNC makes
+ *  recvfrom() return the real size, so that a datagram that still did not
+ *  fit is dropped, not dispatched cut short.
+ */
+
+static void
+handle_unix_input ()
+{
+    static std::vector<char> s_buffer;
+    int fd = lo_server_get_socket_fd(s_unix_server);
+    if (s_buffer.empty())
+    {
+        int rcvbuf = 0;
+        socklen_t optlen = sizeof rcvbuf;
+        if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen) != 0)
+            rcvbuf = 0;
+
+        s_buffer.resize(std::size_t(rcvbuf > 65536 ? rcvbuf : 65536));
+    }
+    for (;;)
     {
-        n -= 100;
-        wait(100);
-        if (! replies_still_pending())
+        struct sockaddr_un sa;
+        socklen_t salen = sizeof sa;
+        std::memset(&sa, 0, sizeof sa);
+        ssize_t count = recvfrom
+        (
+            fd, s_buffer.data(), s_buffer.size(), MSG_DONTWAIT | MSG_TRUNC,
+            reinterpret_cast<struct sockaddr *>(&sa), &salen
+        );
+        if (count <= 0)
             break;
+
+        if (std::size_t(count) > s_buffer.size())
+        {
+            util::warn_printf
+            (
+                "Dropped a %ld-byte local datagram; the limit is %lu",
+                long(count), s_buffer.size()
+            );
+            continue;
+        }
+
+        std::size_t offset = offsetof(struct sockaddr_un, sun_path);
+        if (salen > socklen_t(offset) && sa.sun_path[0] != 0)
+        {
+            std::string peer(sa.sun_path, strnlen(sa.sun_path, salen - offset));
+            s_unix_peer = lo_address_new_with_proto(LO_UNIX, NULL, V(peer));
+        }
+        (void) lo_server_dispatch_data(s_unix_server, s_buffer.data(), count);
+        if (not_nullptr(s_unix_peer))
+        {
+            lo_address_free(s_unix_peer);
+            s_unix_peer = nullptr;
+        }
+    }
+}
+
+/*
+ *  The copy progress last reported, in percent, and the bytes as text.
+ */
+
+static int s_copy_percent{-1};
+
+static std::string
+byte_count (std::uint64_t bytes)
+{
+    const double mib = 1024.0 * 1024.0;
+    return bytes >= 1024 * mib ?
+        util::string_asprintf("%.1f GiB", bytes / (1024 * mib)) :
+        util::string_asprintf("%.1f MiB", bytes / mib) ;
+}
+
+/*
+ *  Called when the copy workers signal. The progress goes to the GUI once
+ *  per percent, and superseded messages are dropped by the GUI queue.
+ */
+
+static void
+handle_copy_progress ()
+{
+    s_copy_engine.acknowledge();
+
+    std::uint64_t total = s_copy_engine.bytes_total();
+    std::uint64_t done = s_copy_engine.bytes_done();
+    int percent = total > 0 ? int(done * 100 / total) : 100 ;
+    if (percent != s_copy_percent)
+    {
+        s_copy_percent = percent;
+        gui_msg_update
+        (
+            "copy",
+            util::string_asprintf
+            (
+                "Copying session: %d%% (%s of %s, %lu of %lu files)",
+                percent, V(byte_count(done)), V(byte_count(total)),
+                (unsigned long) s_copy_engine.files_done(),
+                (unsigned long) s_copy_engine.files_total()
+            )
+        );
+    }
+}
+
+/**
+ *  Sets up the reactor: the child watch, with the SIGCHLD signalfd as its
+ *  fallback, the OSC socket, and a once-a-second purge_dead_clients() for
+ *  the client processes that are not held by a pidfd (only clients that
+ *  nsmd did not start itself, on a kernel with pidfds).
+ */
+
+static bool
+start_event_loop ()
+{
+    bool result = s_event_loop.initialize();
+    if (result)
+    {
+        (void) s_child_watch.initialize(handle_process_ended);
+        result = s_event_loop.add_descriptor
+        (
+            signal_descriptor(), handle_child_signal
+        );
+    }
+    if (result)
+    {
+        int oscfd = lo_server_get_socket_fd(osc_server_handle());
+        result = s_event_loop.add_descriptor(oscfd, handle_osc_input);
+    }
+    if (result && not_nullptr(s_unix_server))
+    {
+        (void) s_event_loop.add_descriptor
+        (
+            lo_server_get_socket_fd(s_unix_server), handle_unix_input
+        );
+    }
+    if (result && s_session_index.descriptor() >= 0)
+    {
+        (void) s_event_loop.add_descriptor
+        (
+            s_session_index.descriptor(),
+            [] () { s_session_index.handle_events(); }
+        );
+    }
+    if (result && s_copy_engine.initialize())
+    {
+        (void) s_event_loop.add_descriptor
+        (
+            s_copy_engine.descriptor(), handle_copy_progress
+        );
+    }
+    if (result)
+    {
+        (void) s_event_loop.add_timer(1000, purge_dead_clients, true);
+        if (s_sample_ms > 0)
+            (void) s_event_loop.add_timer(s_sample_ms, sample_clients, true);
+
+        s_event_loop.add_idle([] () { s_operation.step(); });
+        s_event_loop.add_idle(flush_gui_queue);
+    }
+
+    return result;
+}
+
+/*
+ *  How long the phases of an operation wait on the clients, in ms.
+ */
+
+static const long c_announce_timeout_ms = 5 * 1000;
+static const long c_reply_timeout_ms = 60 * 1000;
+static const long c_quit_timeout_ms = 10 * 1000;
+
+/**
+ *  Adds the wait for announcements from the clients just launched.  We
+ *  cannot tell a slow client from one without NSM support, so the phase
+ *  ends after a few seconds even if some clients never announced; that is
+ *  not an error.
+ */
+
+static void
+add_announce_phase ()
+{
+    s_operation.add_phase
+    (
+        "announce",
+        [] () { gui_msg("Waiting for announcements from clients"); },
+        [] ()
+        {
+            size_t responsive = size_t(number_of_reponsive_clients());
+            return s_client_list.size() == responsive;
+        },
+        c_announce_timeout_ms,
+        [] ()
+        {
+            size_t active = size_t(number_of_reponsive_clients());
+            gui_msg
+            (
+                "Done. %lu out of %lu clients announced (or failed to launch) "
+                "within the initialization grace period",
+                active, s_client_list.size()
+            );
+        }
+    );
+}
+
+/**
+ *  The state of one wait for replies: the deadline timer of each client
+ *  with a pending command, and the clients whose deadline has passed.
+ *  The timers capture the client ID, not the Client pointer, because a
+ *  client can die (and be deleted) while we wait.
+ */
+
+using reply_wait = struct
+{
+    std::map<std::string, nsmd::eventloop::timer_id> rw_deadlines;
+    std::set<std::string> rw_expired;
+};
+
+/**
+ *  Checks that every client with a pending command has replied or run
+ *  out of time.  Each client gets its own deadline, counted from the time
+ *  its command was sent.  A client that announces late, and only then is
+ *  sent "open", gets its deadline when it is first seen here.
+ */
+
+static bool
+replies_are_done (std::shared_ptr<reply_wait> rw)
+{
+    if (s_client_list.pending_replies() == 0)
+        return true;
+
+    bool result = true;
+    for (const auto & c : s_client_list)
+    {
+        if (c->active() && c->reply_pending())
+        {
+            std::string id = c->client_id();
+            if (rw->rw_deadlines.find(id) == rw->rw_deadlines.end())
+            {
+                long since = long(c->ms_since_last_command());
+                rw->rw_deadlines[id] = s_event_loop.add_timer
+                (
+                    c_reply_timeout_ms - since,
+                    [id, rw] () { rw->rw_expired.insert(id); }
+                );
+            }
+            if (rw->rw_expired.find(id) == rw->rw_expired.end())
+                result = false;
+        }
     }
-    gui_msg("Done waiting");
+    return result;
+}
+
+/**
+ *  Adds the wait for the clients to reply to their commands.  The phase
+ *  ends as soon as the slowest client has replied or passed its own
+ *  deadline, so it never lasts longer than that client needs.  As a
+ *  backstop, the phase as a whole is limited to twice the per-client
+ *  timeout.
+ */
+
+static void
+add_reply_phase ()
+{
+    auto rw = std::make_shared<reply_wait>();
+    s_operation.add_phase
+    (
+        "replies",
+        [] () { gui_msg("Waiting for clients to reply to commands"); },
+        [rw] () { return replies_are_done(rw); },
+        2 * c_reply_timeout_ms,
+        [rw] ()
+        {
+            for (const auto & d : rw->rw_deadlines)
+                (void) s_event_loop.cancel_timer(d.second);
 
-    /* FIXME: do something about unresponsive clients */
+            for (const auto & c : s_client_list)
+            {
+                if (c->active() && c->reply_pending())
+                    util::warn_message("No reply from", V(c->name_with_id()));
+            }
+            gui_msg("Done waiting");
+        }
+    );
 }
 
 std::string
@@ -793,35 +1400,119 @@ get_client_project_path (const std::string & session_path, Client * c)
     );
 }
 
+/**
+ *  Reserves a free UDP port for a client that is about to be launched.  The
+ *  kernel picks the port (a bind to port 0), so no two reservations collide
+ *  while their sockets are held open.  The caller closes each descriptor
+ *  just before spawning its client, which is told its port via
+ *  NSM_CLIENT_PORT.  Clients that honor it (jackpatch66 and nsm-proxy66 do)
+ *  never race each other for a port.
+ *
+ * \param [out] port
+ *      Receives the reserved port number as a string.
+ *
+ * \return
+ *      Returns the descriptor holding the reservation, or -1 on failure.
+ */
+
+static int
+reserve_client_port (std::string & port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd >= 0)
+    {
+        struct sockaddr_in sa;
+        socklen_t salen = sizeof sa;
+        std::memset(&sa, 0, sizeof sa);
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+        sa.sin_port = 0;                            /* let the kernel pick  */
+
+        bool ok = bind(fd, (struct sockaddr *) &sa, sizeof sa) == 0;
+        if (ok)
+            ok = getsockname(fd, (struct sockaddr *) &sa, &salen) == 0;
+
+        if (ok)
+        {
+            port = std::to_string(int(ntohs(sa.sin_port)));
+        }
+        else
+        {
+            close(fd);
+            fd = (-1);
+        }
+    }
+    return fd;
+}
+
+/**
+ *  Clients that ignore NSM_CLIENT_PORT still let liblo pick a port.  Since
+ *  liblo's port sequence depends on the second of the day, we let no more
+ *  than s_launch_burst_limit clients start within the same second.  The
+ *  cost is at most a wait for the next second boundary per burst, instead
+ *  of a fixed 100 ms for every client.
+ *
+ * 
+eturn
+ *      Returns 0 if a client can be launched now, which takes the slot, or
+ *      else the milliseconds to the next second, to wait for in a timer.
+ */
+
+static long
+launch_next_client_slot ()
+{
+    static time_t s_burst_second = 0;
+    static int s_burst_count = 0;
+    time_t now = time(NULL);
+    if (now != s_burst_second)
+    {
+        s_burst_second = now;
+        s_burst_count = 0;
+    }
+    if (s_burst_count >= s_launch_burst_limit)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (1000000L - tv.tv_usec) / 1000 + 1;
+    }
+    ++s_burst_count;
+    return 0;
+}
+
 /*
  *  Notes:
  *
- *      1. After the fork(): This is code of the child process. It will
- *         be executed after launch() has finished.
- *      2. Ensure the launched process can receive SIGCHLD.  Unblocking
- *         SIGCHLD here does NOT unblock it for nsmd itself.
- *      3. The program was not started. Causes: not installed on the
+ *      1. The program is started by posix_spawnp(); see nsmd::spawner.
+ *         NSM_URL and NSM_CLIENT_PORT are set in the environment given to
+ *         it, not in the daemon's, and SIGCHLD is unblocked for the child
+ *         only.  The client's placement attributes, if any, are applied
+ *         by the spawner; see nsmd::placement.
+ *      2. The program was not started. Causes: not installed on the
  *         current system, and the session was transferred from another
- *         system, or permission denied (no executable flag).
- *         Since we are running in a forked child process, Client c does
- *         exist, but points to a memory copy, not the real client.
- *         So we can't set any error code or status in the client object.
- *         Instead we check the exit return code in handle_sigchld() and
- *         set the bool client->launch_error to true.
- *      4. This is code of the parent process. It is executed right at this
- *         point, before the child.
- *      5. Normal launch. Setting launch_error to false is not redundant:
+ *         system, or permission denied (no executable flag).  The client
+ *         is kept, "stopped" with a label, as if it had died at once,
+ *         so that the user can see it and fix it.
+ *      3. Normal launch. Setting launch_error to false is not redundant:
  *         a previous launch-error fixed by the user, and then resume,
  *         needs this reset.
- *      6. At this point, we do not know if launched program will start or
+ *      4. At this point, we do not know if launched program will start or
  *         fail. And we do not know if it has nsm-support or not. This will
  *         be decided if it announces.
  */
 
 bool
-launch (const std::string & executable, const std::string & clientid)
+launch
+(
+    const std::string & executable,
+    const std::string & clientid,
+    const std::string & clientport = "",
+    nsmd::client_registry & registry = s_client_list,
+    const std::string & attributes = ""
+)
 {
-    Client * c = get_client_by_id(s_client_list, clientid);
+    nsmd::trace_scope ts(s_tracer, "launch", clientid);
+    bool insession = &registry == &s_client_list;
+    Client * c = get_client_by_id(registry, clientid);
     if (is_nullptr(c))
     {
         std::string base { basename(STR(executable)) } ;
@@ -837,7 +1528,7 @@ launch (const std::string & executable, const std::string & clientid)
                 util::string_asprintf("%s.%s",
                 V(c->name()), V(c->client_id()))
             );
-            s_client_list.push_back(c);
+            registry.add(c);
         }
         else
         {
@@ -846,53 +1537,72 @@ launch (const std::string & executable, const std::string & clientid)
         }
     }
 
-    std::string url = s_osc_server->url();
-    int pid;
-    if (! (pid = fork()))                               /* see Note 1       */
+    c->attributes(attributes);
+
+    nsmd::spawner::environment env
     {
-        char * const args [] = { STR(executable), nullptr };
+        { "NSM_URL", s_osc_server->url() },
+        { "NSM_CLIENT_PORT", clientport }               /* empty: unset     */
+    };
+    if (insession)
         gui_msg("Launching %s", V(executable));
-        setenv("NSM_URL", CSTR(url), 1);
 
-        sigset_t mask;
-        sigemptyset(&mask);
-        sigaddset(&mask, SIGCHLD);
-        sigprocmask(SIG_UNBLOCK, &mask, NULL);          /* see Note 2       */
-        errno = 0;                                      /* strerror(3)      */
-        if (execvp(CSTR(executable), args) == (-1))     /* see Note 3       */
+    nsmd::placement where;
+    (void) where.parse(c->attributes());
+
+    struct timeval spawntime;
+    gettimeofday(&spawntime, NULL);
+    s_tracer.begin("spawn", CSTR(clientid));
+    int pid = int                                       /* see Note 1       */
+    (
+        s_spawner.spawn(executable, env, where.empty() ? nullptr : &where)
+    );
+    s_tracer.end("spawn", CSTR(clientid));
+    s_runtime_stats.latency(c->name_with_id(), "spawn", elapsed_ms(spawntime));
+    if (pid == 0)                                       /* see Note 2       */
+    {
+        util::error_printf
+        (
+            "Error starting process %s: %s",
+            V(executable), V(s_spawner.error_message())
+        );
+        c->pending_command(nsm::command::none);
+        c->pid(0);
+        c->launch_error(true);
+        c->label("Launch error!");
+        c->status("stopped");
+        if (insession)
         {
-            int ec = errno;
-            util::error_printf
-            (
-                "Error starting process %s: %s",
-                V(executable), std::strerror(ec)
-            );
-            exit(-1);                                   /* i.e. 255         */
+            gui_send("/nsm/gui/client/new", c->client_id(), c->exe_path());
+            gui_send("/nsm/gui/client/status", c->client_id(), c->status());
+            gui_send("/nsm/gui/client/label", c->client_id(), c->label());
         }
+        return false;
     }
-
-    /*
-     * Parent process code.
-     */
-
-    c->pending_command(nsm::command::start);            /* see Note 4       */
+    c->pending_command(nsm::command::start);
+    c->launch_stamp();
     c->pid(pid);                                        /* set client's PID */
+    (void) s_child_watch.watch(pid, true);
     util::info_printf
     (
         "Process %s has pid: %i", V(executable), pid    /* no name yet      */
     );
-    c->launch_error(false);                             /* see Note 5       */
+    c->launch_error(false);                             /* see Note 3       */
     c->status("launch");
 
     /*
      * A second message may get send with c->name, if the client sends
-     * announce(). See Note 6. The tab names of the messages are:
-     * tag::guinew, tag::guistatus, and tag::guilabel.
+     * announce(). See Note 4. The tab names of the messages are:
+     * tag::guinew, tag::guistatus, and tag::guilabel.  A held client is
+     * not shown until its session is opened.
      */
 
-    gui_send("/nsm/gui/client/new", c->client_id(), c->exe_path());
-    gui_send("/nsm/gui/client/status", c->client_id(), c->status());
-    gui_send("/nsm/gui/client/label", c->client_id(), "");
+    if (insession)
+    {
+        gui_send("/nsm/gui/client/new", c->client_id(), c->exe_path());
+        gui_send("/nsm/gui/client/status", c->client_id(), c->status());
+        gui_send("/nsm/gui/client/label", c->client_id(), "");
+    }
     return true;
 }
 
@@ -948,17 +1658,19 @@ command_client_to_switch (Client * c, const std::string & new_client_id)
 void
 purge_inactive_clients ()
 {
-    client_list & cl = s_client_list;
-    for (client_list::iterator i = cl.begin(); i != cl.end(); ++i)
+    nsmd::trace_scope ts(s_tracer, "purge_inactive_clients");
+    for (auto i = s_client_list.begin(); i != s_client_list.end(); /* ++i */)
     {
         Client * c = *i;
         if (! c->active())
         {
             c->status("removed");
             gui_send("/nsm/gui/client/status", c->client_id(), c->status());
-            delete *i;
             i = s_client_list.erase(i);
+            delete c;
         }
+        else
+            ++i;
     }
 }
 
@@ -1002,7 +1714,7 @@ OSC_HANDLER( add )
             );
             return osc::osc_msg_handled();
         }
-        if (launch(clientname, NULL))
+        if (launch(clientname, ""))
         {
             reply_send(msg, path, "Launched");
         }
@@ -1038,6 +1750,62 @@ OSC_HANDLER( add )
  *  first.
 */
 
+/*
+ *  A held client of the prepared session announced.  It is opened in the
+ *  prepared session's directory at once, so that it is loaded by the time
+ *  that session is opened, but it stays out of the session and the GUI.
+ */
+
+static void
+announce_held_client
+(
+    lo_message msg, const char * path, Client * c,
+    const std::string & clientname, const std::string & caps, int pid
+)
+{
+    c->pid(pid);
+    (void) s_child_watch.watch(pid, false);
+    c->capabilities(caps);
+    if (not_nullptr(c->addr()))
+        s_address_cache.release(c->addr());
+
+    c->addr(s_address_cache.acquire(lo_message_get_source(msg)));
+    c->name(clientname);
+    c->active(true);
+    c->name_with_id
+    (
+        util::string_asprintf("%s.%s", V(c->name()), V(c->client_id()))
+    );
+    util::info_printf
+    (
+        "Prepared client %s announced %.1f ms after launch",
+        V(c->name_with_id()), c->ms_since_launch()
+    );
+    s_runtime_stats.latency
+    (
+        c->name_with_id(), "announce", c->ms_since_launch()
+    );
+    s_osc_server->send
+    (
+        lo_message_get_source(msg), "/reply", path,
+        "Ack'ed as NSM client (started ourselves)", NSMD66_APP_TITLE,
+        ":server-control:broadcast:optional-gui:"
+    );
+    c->status("held");
+
+    std::string client_project_path = get_client_project_path
+    (
+        s_prepared_path, c
+    );
+    s_osc_server->send
+    (
+        lo_message_get_source(msg), "/nsm/client/open",
+        CSTR(client_project_path), CSTR(s_prepared_name),
+        CSTR(c->name_with_id())
+    );
+    c->pending_command(nsm::command::open);
+}
+
 OSC_HANDLER( announce )
 {
     (void) types; (void) user_data;             /* hide unused parameters   */
@@ -1061,33 +1829,32 @@ OSC_HANDLER( announce )
             return osc::osc_msg_handled();
         }
 
+        Client * held = is_nullptr(s_client_list.by_pid(pid)) ?
+            s_held_clients.expected(exe, pid) : nullptr ;
+
+        if (not_nullptr(held) && major <= NSM_API_VERSION_MAJOR)
+        {
+            announce_held_client(msg, path, held, clientname, caps, pid);
+            return osc::osc_msg_handled();
+        }
+
         bool expected_client = false;
-        Client * c = nullptr;
-        for (auto & ci : s_client_list)
+        Client * c = s_client_list.expected(exe, pid);
+        if (not_nullptr(c))
         {
-            if
-            (
-                ci->exe_path() == exe && ! ci->active() &&
-                ci->pending_command() == nsm::command::start
-            )
-            {
-                /*
-                 * We think we've found the slot we were looking for.
-                 */
+            /*
+             * We think we've found the slot we were looking for.
+             */
 
-                util::info_message("Client was expected", ci->name());
-                c = ci;
-                break;
-            }
+            util::info_message("Client was expected", c->name());
+            expected_client = true;
         }
-        if (is_nullptr(c))
+        else
         {
             c = new (std::nothrow) Client();
             c->exe_path(exe);           /* executable path from argv[2]     */
             c->client_id(nsm::generate_client_id("n----"));
         }
-        else
-            expected_client = true;
 
         if (major > NSM_API_VERSION_MAJOR)
         {
@@ -1104,14 +1871,12 @@ OSC_HANDLER( announce )
             return osc::osc_msg_handled();
         }
         c->pid(pid);                    /* PID comes from argv[5]           */
+        (void) s_child_watch.watch(pid, false);     /* if not our child     */
         c->capabilities(caps);          /* capabilities from argv[1]        */
-        c->addr
-        (
-            lo_address_new_from_url
-            (
-                lo_address_get_url(lo_message_get_source(msg))
-            )
-        );
+        if (not_nullptr(c->addr()))
+            s_address_cache.release(c->addr());
+
+        c->addr(s_address_cache.acquire(lo_message_get_source(msg)));
 
         /*
          * Replace executable's name with the clients self-reported pretty name.
@@ -1124,8 +1889,23 @@ OSC_HANDLER( announce )
             util::string_asprintf("%s.%s", V(c->name()), V(c->client_id()))
         );
         util::info_printf("Process %s has pid: %i", V(c->name_with_id()), pid);
-        if (! expected_client)
-            s_client_list.push_back(c);
+        if (expected_client)
+        {
+            util::info_printf
+            (
+                "Client %s announced %.1f ms after launch, "
+                "+%.1f ms into the session load",
+                V(c->name_with_id()), c->ms_since_launch(),
+                elapsed_ms(s_session_load_time)
+            );
+            s_runtime_stats.latency
+            (
+                c->name_with_id(), "announce", c->ms_since_launch()
+            );
+            s_tracer.instant("announced", CSTR(c->client_id()));
+        }
+        else
+            s_client_list.add(c);
 
         util::info_printf
         (
@@ -1151,9 +1931,9 @@ OSC_HANDLER( announce )
             gui_send("/nsm/gui/client/status", c->client_id(), c->status());
             if (c->is_capable_of(":optional-gui:"))
             {
-                s_osc_server->send
+                gui_post
                 (
-                    s_gui_address, "/nsm/gui/client/has_optional_gui",
+                    "/nsm/gui/client/has_optional_gui",
                     CSTR(c->client_id())
                 );
             }
@@ -1195,25 +1975,35 @@ OSC_HANDLER( announce )
  *  The path format is "%s/session.nsm".
  *
  *  We could use filefunctions to assemble the file-name.
+ *
+ *  The file is written by nsmd::session_writer: not at all if the client
+ *  list did not change, else atomically through a temporary file.
  */
 
 int
 save_session_file ()
 {
+    nsmd::trace_scope ts(s_tracer, "save_session_file");
     std::string sessionfile = util::string_asprintf
     (
         s_path_fmt, V(s_session_path)
     );
-    lib66::tokenization textlist;
+    std::string text;
     for (const auto & c : s_client_list)
     {
-        std::string line = util::string_asprintf
+        text += util::string_asprintf
         (
             "%s:%s:%s", V(c->name()), V(c->exe_path()), V(c->client_id())
         );
-        textlist.push_back(line);
+        if (! c->attributes().empty())
+            text += ":" + c->attributes();
+
+        text += "\n";
     }
-    bool result = util::file_write_lines(sessionfile, textlist);
+    bool result = s_session_writer.write(sessionfile, text);
+    if (result)
+        s_session_index.add(s_session_index.relative(s_session_path));
+
     return result ? 0 : 1 ;
 }
 
@@ -1222,7 +2012,7 @@ save_session_file ()
  */
 
 Client *
-client_by_name (const std::string & name, client_list & cl)
+client_by_name (const std::string & name, nsmd::client_registry & cl)
 {
     for (const auto & c : cl)
     {
@@ -1233,53 +2023,13 @@ client_by_name (const std::string & name, client_list & cl)
 }
 
 /*
- *  This replaced the Loop 1, Loop 2 ... 60 message from
- *  wait_for_dumb_clients_to_die(), where one couldn't see which client
- *  actually was hanging.
- */
-
-bool
-dumb_clients_are_alive ()
-{
-    for (const auto & c : s_client_list)
-    {
-        if (c->is_dumb_client() && c->pid() > 0)
-        {
-            util::info_message("Waiting for", V(c->name_with_id()));
-            return true;
-        }
-    }
-    return false;
-}
-
-void
-wait_for_dumb_clients_to_die ()
-{
-
-    gui_msg("Waiting for dumb clients to die...");
-    for (int i = 0; i < 6; ++i)
-    {
-        if (dumb_clients_are_alive())
-        {
-            handle_child_signal();
-            usleep(50000);
-        }
-        else
-            break;
-    }
-    gui_msg("Done waiting");
-
-    /* FIXME: give up on remaining clients and purge them */
-}
-
-/*
- *  This replaced the Loop 1, Loop 2 ... 60 message from
- *  wait_for_dumb_clients_to_die(), where one couldn't see which client
+ *  This replaced the Loop 1, Loop 2 ... 60 message of the old blocking
+ *  wait for the clients to die, where one couldn't see which client
  *  actually was hanging.
  */
 
 bool
-killed_clients_are_alive ()
+killed_clients_are_alive (bool report = true)
 {
     for (const auto & c : s_client_list)
     {
@@ -1290,7 +2040,9 @@ killed_clients_are_alive ()
 
         if (quit_kill && c->pid() > 0)
         {
-            util::info_message("Waiting for", V(c->name_with_id()));
+            if (report)
+                util::info_message("Waiting for", V(c->name_with_id()));
+
             return true;
         }
     }
@@ -1298,41 +2050,31 @@ killed_clients_are_alive ()
 }
 
 /**
- * The clients that are still alive are dangerous to the user.  Their GUI
- * will be most likely hidden or non-responsive, their JACK client still
- * open. And now the session will close, maybe even nsmd will quit.
- * The hanging process is left open and invisible to the user. As a last
- * resort it must be killed until we lose control over the process.
+ *  The last resort for clients that did not die when told to quit.  Only
+ *  the clients that were told to quit (or were stopped) are killed; a
+ *  client kept for a session switch is left alone.
  */
 
-void
-wait_for_killed_clients_to_die ()
+static void
+kill_remaining_clients ()
 {
-    const int timeout = 10;             /* instead of 30                    */
-    util::info_printf("Waiting %d seconds for killed clients to die", timeout);
-    for (int i = 0; i < timeout; ++i)
-    {
-        if (! killed_clients_are_alive())
-        {
-            util::info_message("All clients have died.");
-            return;
-        }
-        handle_child_signal();
-        purge_dead_clients();
-        s_osc_server->check();          /* check OSC for /progress messages */
-        sleep(1);
-    }
+    if (! killed_clients_are_alive(false))
+        return;
 
     util::warn_message("Killed clients are still alive");
     for (const auto & c : s_client_list)
     {
-        if (c->pid() > 0 )
+        bool quit_kill =
+            c->pending_command() == nsm::command::quit ||
+            c->pending_command() == nsm::command::kill
+            ;
+
+        if (quit_kill && c->pid() > 0)
         {
             util::warn_message("SIGKILL to", V(c->name_with_id()));
             kill(c->pid(), SIGKILL);
         }
     }
-    return;
 }
 
 void
@@ -1359,11 +2101,44 @@ command_all_clients_to_save ()
         }
         for (auto & c : s_client_list)
             command_client_to_save(c);
-
-        wait_for_replies();
     }
 }
 
+/**
+ *  Adds the phases of saving the session: writing session.nsm and
+ *  commanding the clients to save, then waiting for their replies.
+ */
+
+static void
+add_save_phases ()
+{
+    s_operation.add_phase("save", command_all_clients_to_save);
+    add_reply_phase();
+}
+
+/**
+ *  Adds the check, before a session is left, that all clients saved.
+ */
+
+static void
+add_save_check_phase ()
+{
+    s_operation.add_phase
+    (
+        "check",
+        [] ()
+        {
+            if (clients_have_errors())
+            {
+                s_operation.fail
+                (
+                    nsm::error::general, "Some clients could not save"
+                );
+            }
+        }
+    );
+}
+
 void
 command_client_to_stop (Client * c)
 {
@@ -1427,31 +2202,114 @@ delete_lock_file (const std::string & filename)
 }
 
 /*
- *  Empty string = no current session.
+ *  Stops the clients of the prepared session, if any, and forgets it.
  */
 
-void
-close_session ()
+static void
+discard_prepared ()
 {
-    if (! s_session_path.empty())
+    if (s_prepare_timer != 0)
     {
-        for (auto & c : s_client_list)
-            command_client_to_quit(c);
+        (void) s_event_loop.cancel_timer(s_prepare_timer);
+        s_prepare_timer = 0;
+    }
+    for (auto & nc : s_prepare_queue)
+        delete nc;
 
-        wait_for_killed_clients_to_die();
-        purge_inactive_clients();
-        clear_clients();
+    s_prepare_queue.clear();
+    while (! s_held_clients.empty())
+    {
+        Client * c = *s_held_clients.begin();
+        util::info_message("Stopping prepared client", c->name_with_id());
+        if (c->pid() > 0)
+            kill(c->pid(), SIGTERM);
 
-        std::string sessionlock = nsm::get_lock_file_name
+        s_held_clients.remove(c);
+        delete c;
+    }
+    if (! s_prepared_path.empty())
+        util::info_message("Discarded prepared session", s_prepared_path);
+
+    s_prepared_path.clear();
+    s_prepared_name.clear();
+}
+
+/*
+ *  Closing a session is split around the wait for the clients to quit, so
+ *  that the wait can be a phase of an operation; see add_close_phases().
+ */
+
+static void
+close_session_begin ()
+{
+    discard_prepared();
+    for (auto & c : s_client_list)
+        command_client_to_quit(c);
+}
+
+static void
+close_session_end ()
+{
+    purge_inactive_clients();
+    clear_clients();
+
+    std::string sessionlock = nsm::get_lock_file_name
+    (
+        s_lockfile_directory, s_session_name, s_session_path
+    );
+    delete_lock_file(sessionlock);
+    util::info_message("Session closed", s_session_path);
+    if (s_gui_is_active)
+    {
+        util::info_printf
         (
-            s_lockfile_directory, s_session_name, s_session_path
+            "GUI messages: %ld sent, %ld merged away",
+            s_gui_queue.sent(), s_gui_queue.merged()
         );
-        delete_lock_file(sessionlock);
-        util::info_message("Session closed", s_session_path);
-        s_session_path.clear();
-        s_session_name.clear();
-        gui_send("/nsm/gui/session/name", "", "");
     }
+    util::info_printf
+    (
+        "Session file: %ld written (%lu bytes), %ld unchanged, %ld failed",
+        s_session_writer.writes(),
+        (unsigned long) s_session_writer.bytes_written(),
+        s_session_writer.skips(), s_session_writer.failures()
+    );
+    s_session_path.clear();
+    s_session_name.clear();
+    gui_send("/nsm/gui/session/name", "", "");
+}
+
+/**
+ *  Adds the wait for the clients that were told to quit.  However the
+ *  phase ends (all died, timed out, or cancelled) the clients still alive
+ *  are killed, and then the "end" action, if any, is run.  The clients
+ *  still alive are dangerous to the user: their GUI will most likely be
+ *  hidden or non-responsive, their JACK client still open, and maybe
+ *  nsmd is about to quit.  As a last resort they must be killed before
+ *  we lose control over the process.
+ */
+
+static void
+add_quit_phase (nsmd::operation::action begin, nsmd::operation::action end)
+{
+    s_operation.add_phase
+    (
+        "quit", begin,
+        [] () { return ! killed_clients_are_alive(false); },
+        c_quit_timeout_ms,
+        [end] ()
+        {
+            kill_remaining_clients();
+            if (end)
+                end();
+        }
+    );
+}
+
+static void
+add_close_phases ()
+{
+    add_quit_phase(close_session_begin, close_session_end);
 }
 
 void
@@ -1476,30 +2334,34 @@ tell_all_clients_session_is_loaded ()
         tell_client_session_is_loaded(c);
 }
 
+/*
+ *  The session file is read by nsmd::session_plan instead of
+ *  nsm::parse_session_lines(), so that the optional start attributes of
+ *  each client are kept.
+ */
+
 client_list
 parse_session_file (const std::string & sessionfile)
 {
     client_list result;
-    nsm::session_triplets lineitems = nsm::parse_session_lines(sessionfile);
-    bool ok = ! lineitems.empty();
+    nsmd::session_plan plan;
+    bool ok = plan.read(sessionfile);
     if (ok)
     {
-        for (const auto & lineitem : lineitems)
+        for (const auto & e : plan.entries())
         {
             Client * c = new (std::nothrow) Client
             (
-                lineitem.st_client_name,
-                lineitem.st_client_exe,
-                lineitem.st_client_id
+                e.se_name, e.se_exe, e.se_id
             );
             if (not_nullptr(c))
             {
                 std::string namewithid = util::string_asprintf
                 (
-                    "%s.%s",
-                    V(lineitem.st_client_name), V(lineitem.st_client_id)
+                    "%s.%s", V(e.se_name), V(e.se_id)
                 );
                 c->name_with_id(namewithid);
+                c->attributes(e.se_attributes);
                 result.push_back(c);
             }
         }
@@ -1508,17 +2370,215 @@ parse_session_file (const std::string & sessionfile)
 }
 
 /*
+ *  Preparing the next session.  "/nsm/server/prepare name" starts the
+ *  clients of that session that the open will have to launch, while the
+ *  current session keeps running: the entries that a :switch: client of
+ *  the current session will take over are left out, as are those with
+ *  the ID of a current client.  The clients are started one at a time,
+ *  c_prepare_spacing_ms apart, and only while nsmd::headroom allows it;
+ *  otherwise the next one waits c_prepare_retry_ms.
+ *
+ *  A held client is told to open its project in the prepared session at
+ *  once.  When that session is opened, load_session_prepare() takes the
+ *  held clients out of the clients to launch, and adopt_held_clients()
+ *  moves them into the session, so that the open only has to switch the
+ *  current clients and tell all of them that the session is loaded.
+ */
+
+static const long c_prepare_spacing_ms = 500;
+static const long c_prepare_retry_ms = 2 * 1000;
+
+static void
+prepare_launch_next ()
+{
+    s_prepare_timer = 0;
+
+    long delay = c_prepare_spacing_ms;
+    std::string reason;
+    if (s_prepare_queue.empty())
+    {
+        return;
+    }
+    else if (s_headroom.allows(reason))
+    {
+        Client * nc = s_prepare_queue.front();
+        s_prepare_queue.pop_front();
+        bool ok = launch
+        (
+            nc->exe_path(), nc->client_id(), "",
+            s_held_clients, nc->attributes()
+        );
+        if (ok)
+        {
+            Client * c = s_held_clients.by_id(nc->client_id());
+            if (not_nullptr(c))
+                c->status("held");
+        }
+        delete nc;
+    }
+    else
+    {
+        util::warn_message("Holding back prepared client", reason);
+        delay = c_prepare_retry_ms;
+    }
+    if (s_prepare_queue.empty())
+    {
+        util::info_printf
+        (
+            "Session %s prepared with %lu clients",
+            V(s_prepared_name), s_held_clients.size()
+        );
+    }
+    else
+        s_prepare_timer = s_event_loop.add_timer(delay, prepare_launch_next);
+}
+
+/*
+ *  Starts preparing the session at "path".  Any earlier preparation is
+ *  discarded first.
+ *
+ * \return
+ *      Returns nsm::error::ok, or the error for load_error_message().
+ */
+
+static int
+prepare_session (const std::string & path)
+{
+    std::string relativepath = path.substr(s_session_root.length() + 1);
+    if (! session_already_exists(relativepath))
+        return nsm::error::no_such_file;
+
+    std::string name = util::filename_base(path);
+    std::string sessionlock = nsm::get_lock_file_name
+    (
+        s_lockfile_directory, name, path
+    );
+    if (util::file_exists(sessionlock))
+        return nsm::error::session_locked;
+
+    discard_prepared();
+
+    std::string sessionfile = util::string_asprintf("%s/session.nsm", V(path));
+    client_list entries = parse_session_file(sessionfile);
+    if (entries.empty())
+        return nsm::error::create_failed;
+
+    client_map switchers;
+    for (auto & c : s_client_list)
+    {
+        if (c->is_capable_of(":switch:"))
+            switchers[c->name()]++;
+    }
+    for (auto & nc : entries)
+    {
+        bool taken = switchers[nc->name()] > 0;
+        if (taken)
+            switchers[nc->name()]--;
+
+        if (taken || not_nullptr(s_client_list.by_id(nc->client_id())))
+            delete nc;
+        else
+            s_prepare_queue.push_back(nc);
+    }
+    s_prepared_path = path;
+    s_prepared_name = name;
+    util::info_printf
+    (
+        "Preparing session %s: %lu clients to start",
+        V(name), s_prepare_queue.size()
+    );
+    prepare_launch_next();
+    return nsm::error::ok;
+}
+
+/*
+ *  Takes the held clients that match a client of the session being opened
+ *  out of "newclients", into "adopted".  The rest of the preparation is
+ *  dropped, as is all of it if another session is opened.
+ */
+
+static void
+take_held_clients
+(
+    const std::string & path, client_list & newclients, client_list & adopted
+)
+{
+    if (path == s_prepared_path)
+    {
+        for (auto i = newclients.begin(); i != newclients.end(); /* ++i */)
+        {
+            Client * nc = *i;
+            Client * c = s_held_clients.by_id(nc->client_id());
+            if (not_nullptr(c) && c->exe_path() == nc->exe_path())
+            {
+                s_held_clients.remove(c);
+                adopted.push_back(c);
+                i = newclients.erase(i);
+                delete nc;
+            }
+            else
+                ++i;
+        }
+        util::info_printf
+        (
+            "Opening prepared session with %lu held clients",
+            adopted.size()
+        );
+    }
+    discard_prepared();
+}
+
+/*
+ *  Moves the adopted clients into the session, and shows them in the GUI.
+ */
+
+static void
+adopt_held_clients (client_list & adopted)
+{
+    for (auto & c : adopted)
+    {
+        if (c->status() == "held")
+            c->status(c->reply_pending() ? "open" : "ready");
+
+        s_client_list.add(c);
+        if (s_gui_is_active)
+        {
+            gui_send("/nsm/gui/client/new", c->client_id(), c->name());
+            gui_send("/nsm/gui/client/status", c->client_id(), c->status());
+            if (c->is_capable_of(":optional-gui:"))
+            {
+                gui_post
+                (
+                    "/nsm/gui/client/has_optional_gui",
+                    CSTR(c->client_id())
+                );
+            }
+        }
+    }
+    adopted.clear();
+}
+
+/*
+ *  Loading a session is split around the waits for the clients; see
+ *  add_load_phases().
+ *
  *  Parameter "path" is the absolute path to the session including the session
  *  root, without session.nsm. First check if the session file actually
- *  exists, before closing the current one.
+ *  exists, before closing the current one.  Then the clients that are not
+ *  needed, or cannot switch, are told to quit.  The clients of the new session
+ *  are returned in "newclients".
  */
 
-int
-load_session_file (const std::string & path)
+static int
+load_session_prepare
+(
+    const std::string & path, client_list & newclients, client_list & adopted
+)
 {
     bool havepath = ! s_session_path.empty();
     bool havename = ! s_session_name.empty();
     std::string relativepath = path.substr(s_session_root.length() + 1);
+    gettimeofday(&s_session_load_time, NULL);
     util::info_message("Loading session", path);
     if (! session_already_exists(relativepath))
     {
@@ -1570,12 +2630,14 @@ load_session_file (const std::string & path)
         return nsm::error::session_locked;
     }
 
-    client_list newclients = parse_session_file(sessionfile);
+    newclients = parse_session_file(sessionfile);
     if (newclients.empty())
         return nsm::error::create_failed;
     else
         s_session_path = path;
 
+    take_held_clients(path, newclients, adopted);
+
     util::info_message("Commanding unneeded/dumb clients to quit");
 
     /*
@@ -1616,16 +2678,54 @@ load_session_file (const std::string & path)
                 command_client_to_quit(c);
         }
     }
+    return nsm::error::ok;
+}
 
-    /*
-     * wait_for_replies()
-     * wait_for_dumb_clients_to_die()
-     */
+/**
+ *  A client of the current tier not yet launched.  In a parallel launch it
+ *  holds the reservation of its port until just before its launch; see
+ *  reserve_client_port().
+ */
 
-    wait_for_killed_clients_to_die();
-    purge_inactive_clients();
-    for (auto & c : s_client_list)
-        c->pre_existing(true);
+using launch_slot = struct
+{
+    Client * ls_client;
+    std::string ls_port;
+    int ls_reservation;
+};
+
+/**
+ *  The new clients still to be launched, by start tier, the clients of the
+ *  current tier not yet launched, and the wait for the announces of the
+ *  tier launched last.  See nsmd::session_plan and add_load_phases().
+ */
+
+using launch_plan = struct
+{
+    std::vector<std::vector<Client *>> lp_tiers;
+    std::size_t lp_next;
+    std::list<launch_slot> lp_queue;
+    bool lp_parallel;
+    nsmd::eventloop::timer_id lp_launch_timer;
+    std::vector<std::string> lp_waiting;
+    bool lp_expired;
+    nsmd::eventloop::timer_id lp_timer;
+};
+
+/*
+ *  Once the unneeded clients are gone, the remaining clients are told to
+ *  switch to the new session.  The other new clients are grouped into
+ *  their start tiers, to be launched by launch_next_tier().  The tiers
+ *  are worked out over all the new clients, so that a client can start
+ *  "after" one that switches.
+ */
+
+static void
+load_session_switch (client_list & newclients, launch_plan & lp)
+{
+    purge_inactive_clients();
+    for (auto & c : s_client_list)
+        c->pre_existing(true);
 
     /*
      * In a duplicated session, clients will have the same IDs, so be sure to
@@ -1633,6 +2733,9 @@ load_session_file (const std::string & path)
      */
 
     util::info_message("Commanding smart clients to switch");
+    nsmd::session_plan::entry_list entries;
+    std::vector<Client *> candidates;
+    std::set<Client *> launches;
     for (auto & nc : newclients)
     {
         Client * c = get_client_by_name_and_id
@@ -1644,34 +2747,244 @@ load_session_file (const std::string & path)
 
         /*
          * Since we already shut down clients not capable of ':switch:', we
-         * can assume that these are capable. Otherwise, sleep a little bit
-         * because liblo derives its sequence of port numbers from the system
-         * time (second resolution), and if too many clients start at once
-         * they won't be able to find a free port.
+         * can assume that these are capable.
          */
 
         if (not_nullptr(c) && c->pre_existing() && ! c->reply_pending())
         {
             command_client_to_switch(c, nc->client_id());
+            c->attributes(nc->attributes());
         }
         else
+            launches.insert(nc);
+
+        nsmd::session_plan::entry e
         {
-            usleep(100 * 1000);
-            launch(nc->exe_path(), nc->client_id());
+            nc->name(), nc->exe_path(), nc->client_id(), nc->attributes()
+        };
+        entries.push_back(e);
+        candidates.push_back(nc);
+    }
+    for (const auto & tier : nsmd::session_plan::tiers(entries))
+    {
+        std::vector<Client *> clients;
+        for (std::size_t i : tier)
+        {
+            if (launches.count(candidates[i]) > 0)
+                clients.push_back(candidates[i]);
         }
+        if (! clients.empty())
+            lp.lp_tiers.push_back(clients);
     }
+}
 
-    /*
-     * This part is a little tricky... the clients need some time to send
-     * their 'announce' messages before we send them 'open' and know that
-     * a reply is pending, so continue waiting until they finish.
-     * wait_for_replies() must check for OSC messages immediately, even if
-     * no replies seem to be pending yet. Dumb clients will never send an
-     * 'announce message', so we need to give up waiting on them fairly soon.
-     */
+/*
+ *  Launches the next client of the current tier.  Unless in parallel, the
+ *  clients are spaced c_launch_spacing_ms apart, because liblo derives its
+ *  sequence of port numbers from the system time (second resolution), and
+ *  if too many clients start at once they won't be able to find a free
+ *  port.  In parallel they are started back-to-back, each on its reserved
+ *  port, as long as launch_next_client_slot() allows.  Any wait is an
+ *  event-loop timer, so that the loop is not put to sleep.  With "now"
+ *  set, the rest of the queue is launched at once; that is for a
+ *  cancelled load.
+ *
+ *  launch() creates the Client from the executable, and is given the
+ *  attributes, for the placement of the process and to be saved again.
+ */
+
+static const long c_launch_spacing_ms = 100;
+
+static void
+launch_queued (std::shared_ptr<launch_plan> lp, bool now = false)
+{
+    if (lp->lp_launch_timer != 0)
+    {
+        (void) s_event_loop.cancel_timer(lp->lp_launch_timer);
+        lp->lp_launch_timer = 0;
+    }
+    while (! s_exiting && ! lp->lp_queue.empty())
+    {
+        long delay = 0;
+        if (lp->lp_parallel && ! now)
+        {
+            delay = launch_next_client_slot();
+            if (delay > 0)
+            {
+                lp->lp_launch_timer = s_event_loop.add_timer
+                (
+                    delay,
+                    [lp] () { lp->lp_launch_timer = 0; launch_queued(lp); }
+                );
+                break;
+            }
+        }
+
+        launch_slot ls = lp->lp_queue.front();
+        Client * nc = ls.ls_client;
+        lp->lp_queue.pop_front();
+        if (ls.ls_reservation >= 0)
+            close(ls.ls_reservation);
+
+        launch
+        (
+            nc->exe_path(), nc->client_id(), ls.ls_port,
+            s_client_list, nc->attributes()
+        );
+        if (lp->lp_parallel)
+        {
+            util::info_printf
+            (
+                "Launched %s on port %s at +%.1f ms", V(nc->name_with_id()),
+                ls.ls_port.empty() ? "?" : V(ls.ls_port),
+                elapsed_ms(s_session_load_time)
+            );
+        }
+        else
+        {
+            util::info_printf
+            (
+                "Launched %s at +%.1f ms", V(nc->name_with_id()),
+                elapsed_ms(s_session_load_time)
+            );
+            if (! now && ! lp->lp_queue.empty())
+            {
+                lp->lp_launch_timer = s_event_loop.add_timer
+                (
+                    c_launch_spacing_ms,
+                    [lp] () { lp->lp_launch_timer = 0; launch_queued(lp); }
+                );
+                break;
+            }
+        }
+    }
+}
+
+/*
+ *  Queues the clients of one tier for launch_queued().  In parallel a port
+ *  is reserved for every client first, with all reservations held open at
+ *  once so that they are distinct.
+ */
+
+static void
+launch_tier
+(
+    std::shared_ptr<launch_plan> lp,
+    const std::vector<Client *> & clients, bool parallel
+)
+{
+    lp->lp_parallel = parallel;
+    for (auto & nc : clients)
+    {
+        launch_slot ls{nc, "", (-1)};
+        if (parallel)
+        {
+            ls.ls_reservation = reserve_client_port(ls.ls_port);
+            if (ls.ls_reservation < 0)
+                util::warn_message("No port reserved for", nc->name());
+        }
+        lp->lp_queue.push_back(ls);
+    }
+    launch_queued(lp);
+}
+
+/*
+ *  Launches the next tier.  The clients of a tiered session are started
+ *  in parallel within their tier; an untiered session (all in one tier)
+ *  is launched as before.  If more tiers follow, the wait for this tier's
+ *  announces is given the announce grace period.
+ */
+
+static void
+launch_next_tier (std::shared_ptr<launch_plan> lp)
+{
+    if (lp->lp_timer != 0)
+    {
+        (void) s_event_loop.cancel_timer(lp->lp_timer);
+        lp->lp_timer = 0;
+    }
+
+    const std::vector<Client *> & tier = lp->lp_tiers[lp->lp_next++];
+    bool tiered = lp->lp_tiers.size() > 1;
+    if (tiered)
+    {
+        util::info_printf
+        (
+            "Starting tier %lu of %lu (%lu clients) at +%.1f ms",
+            lp->lp_next, lp->lp_tiers.size(), tier.size(),
+            elapsed_ms(s_session_load_time)
+        );
+    }
+    launch_tier(lp, tier, s_parallel_launch || tiered);
+    lp->lp_waiting.clear();
+    for (const auto & nc : tier)
+        lp->lp_waiting.push_back(nc->client_id());
+
+    lp->lp_expired = false;
+    if (lp->lp_next < lp->lp_tiers.size())
+    {
+        lp->lp_timer = s_event_loop.add_timer
+        (
+            c_announce_timeout_ms,
+            [lp] () { lp->lp_timer = 0; lp->lp_expired = true; }
+        );
+    }
+}
+
+/*
+ *  True when every client of the tier launched last has announced, or
+ *  failed to launch, or is gone.
+ */
 
-    wait_for_announce();
-    wait_for_replies();
+static bool
+tier_has_announced (const launch_plan & lp)
+{
+    for (const auto & id : lp.lp_waiting)
+    {
+        Client * c = s_client_list.by_id(id);
+        if (not_nullptr(c) && ! c->active() && ! c->launch_error())
+            return false;
+    }
+    return true;
+}
+
+/*
+ *  Launches the tiers that follow, each once the one before is launched
+ *  and has announced.  Returns true once every client of the last tier is
+ *  launched.
+ */
+
+static bool
+load_session_launch (std::shared_ptr<launch_plan> lp)
+{
+    while (lp->lp_next < lp->lp_tiers.size())
+    {
+        if (! lp->lp_queue.empty())
+            return false;
+        else if (lp->lp_expired)
+        {
+            util::warn_printf
+            (
+                "Start tier %lu did not announce in time; going on",
+                lp->lp_next
+            );
+        }
+        else if (! tier_has_announced(*lp))
+            return false;
+
+        launch_next_tier(lp);
+    }
+    return lp->lp_queue.empty();
+}
+
+/*
+ *  Once the clients have announced and replied, or ran out of time, the
+ *  session is marked as loaded.
+ */
+
+static void
+load_session_finish ()
+{
     tell_all_clients_session_is_loaded();
 
     /*
@@ -1680,9 +2993,17 @@ load_session_file (const std::string & path)
      * We can create the lockfile now.
      */
 
+    std::string sessionlock = nsm::get_lock_file_name
+    (
+        s_lockfile_directory, s_session_name, s_session_path
+    );
     nsm::write_lock_file(sessionlock, s_session_path, s_osc_server->url());
     util::info_message("Session was loaded", s_session_path);
-    newclients.clear();
+    util::info_printf
+    (
+        "Session %s opened in %.1f ms", V(s_session_name),
+        elapsed_ms(s_session_load_time)
+    );
     if (s_gui_is_active)
     {
         /*
@@ -1692,7 +3013,7 @@ load_session_file (const std::string & path)
          * session root.
          */
 
-        std::string relativepath = path.substr(s_session_root.length() + 1);
+        std::string relativepath = s_session_index.relative(s_session_path);
         util::info_printf
         (
             "Informing GUI: session %s, relative path %s",
@@ -1700,148 +3021,421 @@ load_session_file (const std::string & path)
         );
         gui_send("/nsm/gui/session/name", s_session_name, relativepath);
     }
-    return nsm::error::ok;
 }
 
-OSC_HANDLER( save )
+static const char *
+load_error_message (int err)
 {
-    (void) types; (void) argc; (void) argv; (void) user_data;
-    if (s_pending_operation != nsm::command::none)
+    const char * result;
+    switch (err)
+    {
+        case nsm::error::create_failed:
+
+            result = "Could not create session file";
+            break;
+
+        case nsm::error::session_locked:
+
+            result = "Session is locked by another process";
+            break;
+
+        case nsm::error::no_such_file:
+
+            result = "The named session does not exist";
+            break;
+
+        default:
+
+            result = "Unknown error";
+            break;
+    }
+    return result;
+}
+
+/**
+ *  Adds the phases of loading the session at "path":
+ *
+ *      -#  Check the session and tell the unneeded clients to quit.
+ *      -#  Wait for them to die.
+ *      -#  Switch the remaining clients and launch the new ones, tier by
+ *          tier, each tier once the one before has announced.  See
+ *          nsmd::session_plan.
+ *      -#  Wait for the new clients to announce.  They need some time to
+ *          send their 'announce' messages before we send them 'open' and
+ *          know that a reply is pending.  Dumb clients will never
+ *          announce, so we give up waiting on them fairly soon.
+ *      -#  Wait for the replies to 'open' and 'switch'.
+ *      -#  Tell the clients the session is loaded, and lock it.
+ *
+ *  Once the first step succeeds, the launch and the last step are done
+ *  even if the operation is cancelled, so that the session is left loaded
+ *  with whatever clients are up, not half-way.
+ */
+
+static void
+add_load_phases (const std::string & path)
+{
+    auto newclients = std::make_shared<client_list>();
+    auto adopted = std::make_shared<client_list>();
+    auto prepared = std::make_shared<bool>(false);
+    s_operation.add_phase
+    (
+        "load",
+        [path, newclients, adopted, prepared] ()
+        {
+            int err = load_session_prepare(path, *newclients, *adopted);
+            if (err == nsm::error::ok)
+                *prepared = true;
+            else
+                s_operation.fail(err, load_error_message(err));
+        }
+    );
+    add_quit_phase(nullptr, nullptr);
+
+    auto lp = std::make_shared<launch_plan>();
+    lp->lp_next = 0;
+    lp->lp_parallel = false;
+    lp->lp_launch_timer = 0;
+    lp->lp_expired = false;
+    lp->lp_timer = 0;
+    s_operation.add_phase
+    (
+        "launch",
+        [newclients, adopted, prepared, lp] ()
+        {
+            if (*prepared)
+            {
+                load_session_switch(*newclients, *lp);
+                adopt_held_clients(*adopted);
+                newclients->clear();
+                if (! lp->lp_tiers.empty())
+                    launch_next_tier(lp);
+            }
+        },
+        [lp] () { return load_session_launch(lp); },
+        0,
+        [lp] ()
+        {
+            launch_queued(lp, true);                    /* cancelled        */
+            while (lp->lp_next < lp->lp_tiers.size())
+            {
+                launch_next_tier(lp);
+                launch_queued(lp, true);
+            }
+            lp->lp_tiers.clear();
+        },
+        true
+    );
+    add_announce_phase();
+    add_reply_phase();
+    s_operation.add_final_phase
+    (
+        "loaded",
+        [prepared] ()
+        {
+            if (*prepared)
+                load_session_finish();
+        }
+    );
+}
+
+/**
+ *  Makes the completion of an operation: the requester gets "/reply path
+ *  okmessage" or "/error path code message".  The requester's address is
+ *  held from the cache until then.
+ */
+
+static nsmd::operation::completion
+reply_when_done
+(
+    std::shared_ptr<nsmd::address_ref> sender,
+    const std::string & path,
+    const std::string & okmessage
+)
+{
+    return [sender, path, okmessage] (int code, const std::string & errmsg)
+    {
+        if (code == nsm::error::ok)
+            reply_send_ex(sender->get(), path, CSTR(okmessage));
+        else
+            error_send_ex(sender->get(), path, code, CSTR(errmsg));
+    };
+}
+
+static std::shared_ptr<nsmd::address_ref>
+requester (lo_message msg)
+{
+    return std::make_shared<nsmd::address_ref>
+    (
+        s_address_cache, message_source(msg)
+    );
+}
+
+/*
+ *  Only one operation runs at a time; other requests get an error.  Once
+ *  the daemon is exiting, no operation is started at all.
+ */
+
+static bool
+operation_is_pending (lo_address sender, const std::string & path)
+{
+    bool result = s_exiting || s_operation.busy();
+    if (result)
     {
         error_send_ex
         (
-            msg, path, nsm::error::operation_pending, "An operation pending"
+            sender, path, nsm::error::operation_pending,
+            s_exiting ? "Server is exiting" : "An operation pending"
         );
-        return osc::osc_msg_handled();
     }
+    return result;
+}
+
+/*
+ *  The session operations below are started by their handler, which
+ *  returns at once; the event loop runs the phases, and the requester
+ *  gets the reply when the operation is complete.  See nsmd::operation.
+ */
+
+OSC_HANDLER( save )
+{
+    (void) types; (void) argc; (void) argv; (void) user_data;
+    auto sender = requester(msg);
+    if (operation_is_pending(sender->get(), path))
+        return osc::osc_msg_handled();
+
     if (s_session_path.empty())
     {
         error_send_ex
         (
-            msg, path, nsm::error::no_session_open, "No session to save"
+            sender->get(), path, nsm::error::no_session_open,
+            "No session to save"
         );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
-    command_all_clients_to_save();
-    reply_send_ex(msg, path, "Saved");
-    s_pending_operation = nsm::command::none;
+    s_operation.prepare
+    (
+        nsm::command::save, path, reply_when_done(sender, path, "Saved")
+    );
+    add_save_phases();
+    s_operation.start();
     return osc::osc_msg_handled();
 }
 
+/*
+ *  Copies the current session to the new session directory, in the
+ *  background; see nsmd::copy_engine.  The phase ends when the workers are
+ *  done.  If the copy fails, or the operation is cancelled, the partial
+ *  copy is removed.
+ */
+
+static void
+add_copy_phase (const std::string & name, const std::string & spath)
+{
+    s_operation.add_phase
+    (
+        "copy",
+        [spath] ()
+        {
+            (void) nsm::mkpath(spath, false);       /* the parents only     */
+            s_copy_percent = -1;
+            gui_msg("Copying session to %s", V(spath));
+
+            nsmd::trace_scope ts(s_tracer, "copy scan");
+            if (! s_copy_engine.start(s_session_path, spath))
+            {
+                s_operation.fail
+                (
+                    nsm::error::create_failed, "Could not copy the session"
+                );
+            }
+        },
+        [] () { return s_copy_engine.finished(); },
+        0,
+        [name, spath] ()
+        {
+            if (! s_copy_engine.finished())
+                s_copy_engine.cancel();         /* operation was cancelled  */
+
+            bool ok = s_copy_engine.wait();
+            if (ok)
+                ok = util::file_is_directory(spath);
+
+            if (ok)
+            {
+                util::info_printf
+                (
+                    "Copied %lu files, %s: %ld reflinked, %ld in-kernel, "
+                    "%ld read/write",
+                    (unsigned long) s_copy_engine.files_total(),
+                    V(byte_count(s_copy_engine.bytes_total())),
+                    s_copy_engine.reflinked(), s_copy_engine.ranged(),
+                    s_copy_engine.streamed()
+                );
+                s_session_index.add(name);
+                if (s_gui_is_active)
+                    gui_post("/nsm/gui/session/session", name);
+
+                util::info_message
+                (
+                    "Attempting to open during DUPLICATE", spath
+                );
+            }
+            else
+            {
+                std::string e = s_copy_engine.error();
+                util::error_printf
+                (
+                    "Could not copy %s to %s: %s", V(s_session_path),
+                    V(spath), e.empty() ? "cancelled" : V(e)
+                );
+                if (! s_copy_engine.remove_destination())
+                    util::warn_message("Partial copy left in", spath);
+
+                s_operation.fail
+                (
+                    nsm::error::create_failed, "Could not copy the session"
+                );
+            }
+        }
+    );
+}
+
 OSC_HANDLER( duplicate )
 {
     (void) types; (void) user_data;             /* hide unused parameters   */
+    auto sender = requester(msg);
     if (argc < 1)
         return (-1);
 
-    if (s_pending_operation != nsm::command::none)
-    {
-        error_send_ex
-        (
-            msg, path, nsm::error::operation_pending, "An operation pending"
-        );
+    if (operation_is_pending(sender->get(), path))
         return osc::osc_msg_handled();
-    }
-    s_pending_operation = nsm::command::duplicate;
+
     if (s_session_path.empty())
     {
         error_send_ex
         (
-            msg, path, nsm::error::no_session_open, "No session to save"
+            sender->get(), path, nsm::error::no_session_open,
+            "No session to save"
         );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
     if (! path_is_valid(&argv[0]->s))
     {
         error_send_ex
         (
-            msg, path, nsm::error::create_failed, "Invalid session name"
+            sender->get(), path, nsm::error::create_failed,
+            "Invalid session name"
         );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
     if (session_already_exists(&argv[0]->s))
     {
         error_send_ex
         (
-            msg, path, nsm::error::create_failed, "Session name already exists"
+            sender->get(), path, nsm::error::create_failed,
+            "Session name already exists"
         );
-        s_pending_operation = nsm::command::none;
-        return osc::osc_msg_handled();
-    }
-    command_all_clients_to_save();
-    if ( clients_have_errors() )
-    {
-        error_send_ex
-        (
-            msg, path, nsm::error::general, "Some clients could not save"
-        );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
 
+    /*
+     * The original session is still open. The load will close it, and
+     * possibly ::switch::.
+     */
+
+    std::string name = &argv[0]->s;
     std::string spath = util::string_asprintf
     (
-        "%s/%s", V(s_session_root), &argv[0]->s
+        "%s/%s", V(s_session_root), V(name)
+    );
+    std::string p = path;
+    s_operation.prepare
+    (
+        nsm::command::duplicate, p, reply_when_done(sender, p, "Duplicated")
+    );
+    add_save_phases();
+    add_save_check_phase();
+    add_copy_phase(name, spath);
+    add_load_phases(spath);
+    s_operation.add_phase
+    (
+        "reply", [sender, p] () { reply_send_ex(sender->get(), p, "Loaded"); }
     );
-    (void) nsm::mkpath(spath, false);
+    s_operation.start();
+    return osc::osc_msg_handled();
+}
 
-    /* FIXME:
-     *
-     *  Code a recursive copy instead of calling the shell.
-     */
+/*
+ *  Creates the new session directory and session file, and locks it.
+ */
 
-#if defined USE_OLD_CODE
-    std::string cmd = util::string_asprintf
+static void
+add_create_phase
+(
+    std::shared_ptr<nsmd::address_ref> sender,
+    const std::string & path,
+    const std::string & name
+)
+{
+    s_operation.add_phase
     (
-        "cp -R \"%s\" \"%s\"", V(s_session_path), V(spath)
-    );
-    system(CSTR(cmd));
-#else
-    bool ok = util::fts_copy_directory(s_session_path, spath);
-    if (ok)
-        ok = util::file_is_directory(spath);
+        "create",
+        [sender, path, name] ()
+        {
+            gui_msg("Creating new session \"%s\"", V(name));
 
-    if (! ok)
-    {
-        util::error_printf
-        (
-            "Could not copy %s to %s", V(s_session_path), V(spath)
-        );
-    }
-#endif
-    if (s_gui_is_active)        // && ok  [TODO]
-    {
-        s_osc_server->send
-        (
-            s_gui_address, "/nsm/gui/session/session", &argv[0]->s
-        );
-    }
-    util::info_message("Attempting to open during DUPLICATE", spath);
+            std::string spath = util::string_asprintf
+            (
+                "%s/%s", V(s_session_root), V(name)
+            );
+            if (! nsm::mkpath(spath, true))
+            {
+                s_operation.fail
+                (
+                    nsm::error::create_failed,
+                    "Could not create session directory"
+                );
+                return;
+            }
+            s_session_path = spath;
+            set_name(s_session_path);
 
-    /*
-     * The original session is still open. load_session_file() will close it,
-     * and possibly ::switch::
-     */
+            std::string sessionlock = nsm::get_lock_file_name
+            (
+                s_lockfile_directory, s_session_name, s_session_path
+            );
+            nsm::write_lock_file
+            (
+                sessionlock, s_session_path, s_osc_server->url()
+            );
+            reply_send_ex(sender->get(), path, "Created." );
+            if (s_gui_is_active)
+            {
+                gui_send("/nsm/gui/session/session", name, "");
 
-    if (load_session_file(spath) == nsm::error::ok)
-    {
-        reply_send_ex(msg, path, "Loaded");
-    }
-    else
-    {
-        error_send_ex
-        (
-            msg, path, nsm::error::no_such_file, "No such file"
-        );
-        s_pending_operation = nsm::command::none;
-        return (-1);
-    }
-    reply_send_ex(msg, path, "Duplicated");
-    s_pending_operation = nsm::command::none;
-    return osc::osc_msg_handled();
+                /*
+                 * Send two parameters to signal that the session was loaded:
+                 * simple session-name, relative session path below session
+                 * root.
+                 */
+
+                std::string relativepath =
+                    s_session_index.relative(s_session_path);
+
+                util::info_printf
+                (
+                    "Informing GUI of session %s, relative path %s",
+                    V(s_session_name), V(relativepath)
+                );
+                gui_send
+                (
+                    "/nsm/gui/session/name", s_session_name, relativepath
+                );
+            }
+            save_session_file();
+        }
+    );
 }
 
 /*
@@ -1851,416 +3445,414 @@ OSC_HANDLER( duplicate )
 OSC_HANDLER( newsrv )
 {
     (void) types; (void) user_data;             /* hide unused parameters   */
+    auto sender = requester(msg);
     if (argc < 1)
         return (-1);
 
-    if (s_pending_operation != nsm::command::none)
-    {
-        error_send_ex
-        (
-            msg, path, nsm::error::operation_pending, "An operation pending"
-        );
+    if (operation_is_pending(sender->get(), path))
         return osc::osc_msg_handled();
-    }
-    s_pending_operation = nsm::command::new_session;
+
     if (! path_is_valid(&argv[0]->s))
     {
         error_send_ex
         (
-            msg, path, nsm::error::create_failed, "Invalid session name"
+            sender->get(), path, nsm::error::create_failed,
+            "Invalid session name"
         );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
     if (session_already_exists(&argv[0]->s))
     {
         error_send_ex
         (
-            msg, path, nsm::error::create_failed, "Session name already exists"
+            sender->get(), path, nsm::error::create_failed,
+            "Session name already exists"
         );
-        s_pending_operation = nsm::command::none;
         return osc::osc_msg_handled();
     }
-    if (! s_session_path.empty())   /* Already a session running?  */
-    {
-        command_all_clients_to_save();
-        close_session();
-    }
-    gui_msg("Creating new session \"%s\"", &argv[0]->s);
 
-    std::string spath = util::string_asprintf
+    std::string p = path;
+    s_operation.prepare
     (
-        "%s/%s", V(s_session_root), &argv[0]->s
+        nsm::command::new_session, p,
+        reply_when_done(sender, p, "Session created")
     );
-    if (! nsm::mkpath(spath, true))
-    {
-        error_send_ex
-        (
-            msg, path, nsm::error::create_failed, "Could not create session directory"
-        );
-        s_pending_operation = nsm::command::none;
-        return osc::osc_msg_handled();
-    }
-    s_session_path = spath;
-    set_name(s_session_path);
-
-    std::string sessionlock = nsm::get_lock_file_name
-    (
-        s_lockfile_directory, s_session_name, s_session_path
-    );
-    nsm::write_lock_file(sessionlock, s_session_path, s_osc_server->url());
-    reply_send_ex(msg, path, "Created." );
-
-    if (s_gui_is_active)
+    if (! s_session_path.empty())   /* Already a session running?  */
     {
-        gui_send("/nsm/gui/session/session", &argv[0]->s, "");
-
-        /*
-         * Send two parameters to signal that the session was loaded:
-         * simple session-name, relative session path below session root.
-         */
-
-        std::string relativepath = path;
-        relativepath = relativepath.substr(s_session_root.length() + 1);
-        util::info_printf
-        (
-            "Informing GUI of session %s, relative path %s",
-            V(s_session_name), V(relativepath)
-        );
-        gui_send("/nsm/gui/session/name", s_session_name, relativepath);
+        add_save_phases();
+        add_close_phases();
     }
-    save_session_file();
-    reply_send_ex(msg, path, "Session created");
-    s_pending_operation = nsm::command::none;
+    add_create_phase(sender, p, &argv[0]->s);
+    s_operation.start();
     return osc::osc_msg_handled();
 }
 
-/*
- *  The argument compar() specifies a user-defined function which may be used to
- *  order the traversal of the hierarchy.  It takes two pointers to pointers to
- *  FTSENT structures as arguments and should return a negative value, zero, or a
- *  positive value to indicate if the file referenced by its first argument comes
- *  before, in any order with respect to, or after, the file referenced by its
- *  second argument. The fts_accpath, fts_path, and fts_pathlen fields of the
- *  FTSENT structures may never be used in this comparison. If the fts_info field
- *  is set to FTS_NS or FTS_NSOK, the fts_statp field may not either.  If the
- *  compare() argument is NULL, the directory traversal order is in the order
- *  listed in path_argv for the root paths, and in the order listed in the
- *  directory for everything else.
+/**
+ *  The largest OSC bundle sent in reply to /nsm/server/list or stats. It
+ *  keeps a long list of sessions to a few datagrams, each well below what liblo
+ *  (and a GUI's receive buffer) can take over UDP.
  */
 
-int
-fts_comparer_to_process_files_before_dirs
-(
-    const FTSENT ** first,
-    const FTSENT ** second
-)
+static const size_t c_max_list_bundle = 4096;
+
+/**
+ *  Sends the items, e.g. the names of the sessions from the session
+ *  index, as "/reply /nsm/server/list name" messages packed into bounded
+ *  bundles.  As a marker that all items were sent, the last reply is an
+ *  empty string, which is impossible to conflict with a session name.
+ */
+
+template <typename C>
+static void
+send_reply_list (lo_address addr, const char * path, const C & items)
 {
-    if ((*first)->fts_info & FTS_F)
-        return (-1);                                /* first    */
-    else if ((*second)->fts_info & FTS_F)
-        return 1;                                 /* last     */
-    else
-        return strcmp((*first)->fts_name, (*second)->fts_name);
-}
+    const char * replypath = "/reply";
+    lo_bundle bundle = nullptr;
+    size_t bytes = 0;
+    auto flush = [&] ()
+    {
+        if (not_nullptr(bundle))
+        {
+            (void) send_bundle_to(addr, bundle);
+            lo_bundle_free_recursive(bundle);
+            bundle = nullptr;
+        }
+    };
+    auto append = [&] (const std::string & name)
+    {
+        lo_message m = lo_message_new();
+        lo_message_add_string(m, path);
+        lo_message_add_string(m, CSTR(name));
 
-static lo_address s_list_response_address;
+        size_t len = lo_message_length(m, replypath) + 4;   /* + size field */
+        if (not_nullptr(bundle) && bytes + len > c_max_list_bundle)
+            flush();
+
+        if (is_nullptr(bundle))
+        {
+            bundle = lo_bundle_new(LO_TT_IMMEDIATE);
+            bytes = 16;                             /* "#bundle" + timetag  */
+        }
+        lo_bundle_add_message(bundle, replypath, m);
+        bytes += len;
+    };
+    for (const auto & item : items)
+        append(item);
+
+    append("");
+    flush();
+}
 
 /*
- *  Parse the s_session_root recursively for session.nsm files and send
- *  names with "/nsm/server/list".
+ *  Sends the sessions below s_session_root with "/nsm/server/list".
  *
  *  Sessions can be structured with sub-directories. The file session.nsm
- *  marks a real session and is a 'leaf' of the session tree.
- *
- *  No other sessions are allowed below a dir containing session.nsm.
- *
- *  We use fts to walk the s_session_root, plus an array of paths to
- *  traverse. Each path must be null terminated and the list must end
- *  with a NULL pointer.
- *
- *  fts():
- *
- *      Two  structures (and associated types) are defined in <fts.h>.
- *      The first type is FTS, a structure representing the file hierarchy.
- *      itself. The second type is FTSENT,the structure representing a file
- *      in the hierarchy. Normally, an FTSENT structure is returned for
- *      every file in the file hierarchy.
- *
- *      -   1st parameter: The list of paths to traverse.
- *      -   2nd parameter: An options parameter. Must include either
- *          FTS_PHYSICAL or FTS_LOGICAL---they change how symbolic links
- *          are handled.
- *      -   3rd parameter is a comparator which you can optionally provide
- *          to change the traversal of the filesystem hierarchy.
- *
- *      Our comparator processes files before directories; we depend on that
- *      to remember if we are already in a session-directory.
+ *  marks a real session and is a 'leaf' of the session tree.  The walk of
+ *  the session root is done once, by the session index, which inotify
+ *  then keeps current. Without inotify the index is rebuilt here.
  */
 
 OSC_HANDLER( list )
 {
     (void) argc; (void) argv; (void) types; (void) user_data;
     gui_msg("Listing sessions");
-    s_list_response_address = lo_message_get_source(msg);
-
-    char * const paths [] = { STR(s_session_root), nullptr };
-    FTS * ftsp = fts_open
-    (
-        paths, FTS_LOGICAL,
-        fts_comparer_to_process_files_before_dirs       /* defined above    */
-    );
-    if (ftsp == NULL)
+    nsmd::address_ref sender(s_address_cache, message_source(msg));
+    if (s_session_index.descriptor() < 0)
     {
-        util::error_message("fts_open() failed");
-        exit(EXIT_FAILURE);
+        nsmd::trace_scope ts(s_tracer, "session index rebuild");
+        (void) s_session_index.rebuild();
     }
 
-    /*
-     * The loop will call fts_read() enough times to get each file.
-     */
-
-    FTSENT * currentsession = NULL;
-    for (;;)
-    {
-        FTSENT * ent = fts_read(ftsp); /* get next item; file or directory  */
-        if (ent == NULL)
-        {
-            if (errno == 0)                 /* no more items, done  */
-            {
-                break;
-            }
-            else
-            {
-                util::error_message("fts_read() failed");
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        /*
-         * Handle Types of Files. Given an entry, determine if it is a file
-         * or a directory. The FTS_D bit == "entering a directory". The
-         * FTS_DP == "leaving a directory". FTS_F == "a file".
-         * FTS_SKIP means "skip descendants of this directory".
-         */
+    send_reply_list(sender.get(), path, s_session_index.sessions());
+    return osc::osc_msg_handled();
+}
 
-        if (ent->fts_info & FTS_D)
-        {
-            if (currentsession != NULL)
-            {
-                /*
-                 * Setup that no descendants of this file are visited.
-                 */
+/*
+ *  Sends the statistics of the daemon, one line of text per reply, in the
+ *  same way as "/nsm/server/list": the latency histograms of the clients,
+ *  the time spent per OSC path, and the counters of the daemon's parts.
+ */
 
-                int err = fts_set(ftsp, ent, FTS_SKIP);
-                if (err != 0)
-                {
-                    util::error_message("fts_set() failed");
-                    exit(EXIT_FAILURE);
-                }
-            }
-        }
-        else if (ent->fts_info & FTS_DP)
-        {
-            if (ent == currentsession)
-                currentsession = NULL;
-        }
-        else if (ent->fts_info & FTS_F)
-        {
-            /*
-             * basename(3)
-             */
+OSC_HANDLER( stats )
+{
+    (void) argc; (void) argv; (void) types; (void) user_data;
+    nsmd::address_ref sender(s_address_cache, message_source(msg));
+    std::vector<std::string> lines = s_runtime_stats.report();
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "gui sent=%ld merged=%ld", s_gui_queue.sent(), s_gui_queue.merged()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "address-cache hits=%ld misses=%ld size=%lu",
+            s_address_cache.hits(), s_address_cache.misses(),
+            s_address_cache.size()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "spawn started=%ld failed=%ld",
+            s_spawner.spawned(), s_spawner.failures()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "broadcast sent=%ld fallbacks=%ld",
+            s_fanout.sent(), s_fanout.fallbacks()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "session-file writes=%ld unchanged=%ld failed=%ld bytes=%lu",
+            s_session_writer.writes(), s_session_writer.skips(),
+            s_session_writer.failures(),
+            (unsigned long) s_session_writer.bytes_written()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "copy reflinked=%ld ranged=%ld streamed=%ld",
+            s_copy_engine.reflinked(), s_copy_engine.ranged(),
+            s_copy_engine.streamed()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "prepared session=%s held=%lu queued=%lu",
+            s_prepared_name.empty() ? "none" : V(s_prepared_name),
+            s_held_clients.size(), s_prepare_queue.size()
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "clients=%lu operation=%s", s_client_list.size(),
+            s_operation.busy() ? V(s_operation.name()) : "none"
+        )
+    );
+    lines.push_back
+    (
+        util::string_asprintf
+        (
+            "resources processes=%lu samples=%ld interval=%ld ms",
+            s_proc_sampler.size(), s_proc_sampler.samples(), s_sample_ms
+        )
+    );
+    send_reply_list(sender.get(), path, lines);
+    return osc::osc_msg_handled();
+}
 
-            if (util::strcompare("session.nsm", basename(ent->fts_path)))
-            {
-                std::string s = ent->fts_path;          /* session path     */
+/*
+ *  Sends the resource use of the clients, one line per client, as
+ *  "/nsm/server/list" does: the latest CPU, memory, and I/O sample, with
+ *  the mean and peak over the recent samples.  See nsmd::proc_sampler.
+ */
 
-                /*
-                 * This code starts at the end of the session-root par of
-                 * the file-name and copies the rest of the root to the
-                 * beginning.
-                 *
-                 *      memmove
-                 *      (
-                 *          s, s + strlen( s_session_root ) + 1,
-                 *          (strlen( s ) - strlen( s_session_root )) + 1
-                 *      );
-                 *
-                 * It basically gets the relative path.
-                 */
+OSC_HANDLER( resources )
+{
+    (void) argc; (void) argv; (void) types; (void) user_data;
+    nsmd::address_ref sender(s_address_cache, message_source(msg));
+    send_reply_list(sender.get(), path, s_proc_sampler.report());
+    return osc::osc_msg_handled();
+}
 
-                std::string rest = path;
-                rest = rest.substr(s_session_root.length() + 1);
-                s_osc_server->send
-                (
-                    s_list_response_address, "/reply", "/nsm/server/list",
-                    rest
-                );
+OSC_HANDLER( open )
+{
+    (void) types; (void) user_data;             /* hide unused parameters   */
+    auto sender = requester(msg);
+    if (argc < 1)
+        return (-1);
 
-                /*
-                 * Save the directory entry. not the session.nsm entry.
-                 */
+    gui_msg("Opening session %s", &argv[0]->s);
+    if (operation_is_pending(sender->get(), path))
+        return osc::osc_msg_handled();
 
-                currentsession = ent->fts_parent;
-            }
-        }
+    std::string spath = util::string_asprintf
+    (
+        "%s/%s", V(s_session_root), &argv[0]->s
+    );
+    util::info_message("Attempting to open", spath);
+    s_operation.prepare
+    (
+        nsm::command::open, path, reply_when_done(sender, path, "Loaded")
+    );
+    if (! s_session_path.empty())
+    {
+        add_save_phases();
+        add_save_check_phase();
     }
+    add_load_phases(spath);
+    s_operation.start();
+    return osc::osc_msg_handled();
+}
 
-    /*
-     * Close fts and check for error from the closing.
-     */
+OSC_HANDLER( quit )
+{
+    (void) types; (void) argv;
+    (void) argc; (void) msg; (void) user_data;
+    start_exit(path);
+    return osc::osc_msg_handled();
+}
 
-    if (fts_close(ftsp) == (-1))
-        util::error_message("fts_close() failed");
+OSC_HANDLER( abort )
+{
+    (void) argc; (void) argv; (void) types; (void) user_data;
+    auto sender = requester(msg);
+    if (operation_is_pending(sender->get(), path))
+        return osc::osc_msg_handled();
 
-    /*
-     * As a marker that all sessions were sent, reply with an empty string,
-     * which is impossible to conflict with a session name.
-     */
+    if (s_session_path.empty())
+    {
+        error_send_ex
+        (
+            sender->get(), path, nsm::error::no_session_open,
+            "No session to abort"
+        );
+        return osc::osc_msg_handled();
+    }
 
-    s_osc_server->send
+    gui_msg("Commanding clients to quit");
+    s_operation.prepare
     (
-        s_list_response_address, "/reply", "/nsm/server/list", ""
+        nsm::command::close, path, reply_when_done(sender, path, "Aborted")
     );
+    add_close_phases();
+    s_operation.start();
     return osc::osc_msg_handled();
 }
 
-OSC_HANDLER( open )
+OSC_HANDLER( close )
 {
-    (void) types; (void) user_data;             /* hide unused parameters   */
-    if (argc < 1)
-        return (-1);
+    (void) argc; (void) argv; (void) types; (void) user_data;
+    auto sender = requester(msg);
+    if (operation_is_pending(sender->get(), path))
+        return osc::osc_msg_handled();
 
-    gui_msg("Opening session %s", &argv[0]->s);
-    if ( s_pending_operation != nsm::command::none )
+    if (s_session_path.empty())
     {
         error_send_ex
         (
-            msg, path, nsm::error::operation_pending, "An operation pending"
+            sender->get(), path, nsm::error::no_session_open,
+            "No session to close"
         );
         return osc::osc_msg_handled();
     }
-    s_pending_operation = nsm::command::open;
-    if (! s_session_path.empty())
-    {
-        command_all_clients_to_save();
-        if (clients_have_errors())
-        {
-            error_send_ex
-            (
-                msg, path, nsm::error::general, "Some clients could not save"
-            );
-            s_pending_operation = nsm::command::none;
-            return osc::osc_msg_handled();
-        }
-    }
-
-    std::string spath = util::string_asprintf
+    s_operation.prepare
+    (
+        nsm::command::close, path, reply_when_done(sender, path, "Closed")
+    );
+    add_save_phases();
+    s_operation.add_phase
     (
-        "%s/%s", V(s_session_root), &argv[0]->s
+        "close", [] () { gui_msg("Commanding clients to close"); }
     );
-    util::info_message("Attempting to open", spath);
+    add_close_phases();
+    s_operation.start();
+    return osc::osc_msg_handled();
+}
+
+/*
+ *  An nsm66d extension: "/nsm/server/cancel" stops the running operation.
+ *  Its requester gets an error reply, and the canceller gets "Cancelled".
+ */
 
-    int err = load_session_file(spath);
-    if (err == nsm::error::ok)
+OSC_HANDLER( cancel )
+{
+    (void) argc; (void) argv; (void) types; (void) user_data;
+    nsmd::address_ref sender(s_address_cache, message_source(msg));
+    if (s_operation.cancel(nsm::error::general, "Operation cancelled"))
     {
-        reply_send_ex(msg, path, "Loaded");
+        reply_send_ex(sender.get(), path, "Cancelled");
     }
     else
     {
-        const char * m;
-        switch (err)
-        {
-            case nsm::error::create_failed:
-
-                m = "Could not create session file";
-                break;
-
-            case nsm::error::session_locked:
-
-                m = "Session is locked by another process";
-                break;
-
-            case nsm::error::no_such_file:
-
-                m = "The named session does not exist";
-                break;
-
-            default:
-                m = "Unknown error";
-                break;
-        }
-        error_send_ex(msg, path, err, m);
+        error_send_ex
+        (
+            sender.get(), path, nsm::error::general, "No operation to cancel"
+        );
     }
-    util::info_message("Done");
-    s_pending_operation = nsm::command::none;
     return osc::osc_msg_handled();
 }
 
-OSC_HANDLER( quit )
-{
-    (void) path; (void) types; (void) argv;
-    (void) argc; (void) msg; (void) user_data;
-    close_session();
-    handle_signal_clean_exit(0);
-    return osc::osc_msg_handled();
-}
+/*
+ *  nsm66d extensions: "/nsm/server/prepare name" starts the clients of the
+ *  session to be opened next, held out of the current session, and
+ *  "/nsm/server/discard" stops them.  See prepare_session().
+ */
 
-OSC_HANDLER( abort )
+OSC_HANDLER( prepare )
 {
-    (void) argc; (void) argv; (void) types; (void) user_data;
-    if (s_pending_operation != nsm::command::none)
+    (void) types; (void) user_data;             /* hide unused parameters   */
+    auto sender = requester(msg);
+    if (argc < 1)
+        return (-1);
+
+    if (operation_is_pending(sender->get(), path))
+        return osc::osc_msg_handled();
+
+    std::string spath = util::string_asprintf
+    (
+        "%s/%s", V(s_session_root), &argv[0]->s
+    );
+    if (s_session_path.empty())
     {
         error_send_ex
         (
-            msg, path, nsm::error::operation_pending, "An operation pending"
+            sender->get(), path, nsm::error::no_session_open,
+            "No session is open to prepare the next one from"
         );
-        return osc::osc_msg_handled();
     }
-    s_pending_operation = nsm::command::close;
-    if (s_session_path.empty())
+    else if (spath == s_session_path)
     {
         error_send_ex
         (
-            msg, path, nsm::error::no_session_open, "No session to abort"
+            sender->get(), path, nsm::error::general,
+            "The named session is already open"
         );
-        s_pending_operation = nsm::command::none;
-        return osc::osc_msg_handled();
     }
-
-    gui_msg("Commanding clients to quit");
-    close_session();
-    reply_send_ex(msg, path, "Aborted");
-    s_pending_operation = nsm::command::none;
+    else
+    {
+        int err = prepare_session(spath);
+        if (err == nsm::error::ok)
+            reply_send_ex(sender->get(), path, "Preparing");
+        else
+            error_send_ex(sender->get(), path, err, load_error_message(err));
+    }
     return osc::osc_msg_handled();
 }
 
-OSC_HANDLER( close )
+OSC_HANDLER( discard )
 {
     (void) argc; (void) argv; (void) types; (void) user_data;
-    if (s_pending_operation != nsm::command::none)
+    nsmd::address_ref sender(s_address_cache, message_source(msg));
+    if (s_prepared_path.empty())
     {
         error_send_ex
         (
-            msg, path, nsm::error::operation_pending, "An operation pending"
+            sender.get(), path, nsm::error::general, "No session prepared"
         );
-        return osc::osc_msg_handled();
     }
-    s_pending_operation = nsm::command::close;
-    if (s_session_path.empty())
+    else
     {
-        error_send_ex
-        (
-            msg, path, nsm::error::no_session_open, "No session to close"
-        );
-        s_pending_operation = nsm::command::none;
-        return osc::osc_msg_handled();
+        discard_prepared();
+        reply_send_ex(sender.get(), path, "Discarded");
     }
-    command_all_clients_to_save();
-    gui_msg("Commanding clients to close");
-    close_session();
-    reply_send_ex(msg, path, "Closed");
-    s_pending_operation = nsm::command::none;
     return osc::osc_msg_handled();
 }
 
@@ -2279,39 +3871,31 @@ OSC_HANDLER( broadcast )
     if (! util::strncompare(to_path, nsm_path))     /* length predetermined */
         return osc::osc_msg_handled();
 
-    osc::osc_value_list new_args;
-    for (int i = 1; i < argc; ++i)
+    /*
+     * The message is serialised once and its bytes sent to every client
+     * but the sender.  The addresses come from the address cache, so the
+     * sender is matched by its cache key, with no URL built.
+     */
+
+    lo_server srv = osc_server_handle();
+    const std::string sender = nsmd::address_cache::address_key
+    (
+        message_source(msg)
+    );
+    if (s_fanout.build(to_path, types, argv, 1, argc))
     {
-        switch (types[i])
+        for (const auto & c : s_client_list)
         {
-            case 's':
-
-                new_args.push_back(osc::osc_string(&argv[i]->s));
-                break;
-
-            case 'i':
-
-                new_args.push_back(osc::osc_int(argv[i]->i));
-                break;
+            if (is_nullptr(c->addr()))
+                continue;
 
-            case 'f':
-
-                new_args.push_back(osc::osc_float(argv[i]->f));
-                break;
+            const std::string & key = s_address_cache.key(c->addr());
+            if (key != sender)
+                (void) s_fanout.send(srv, c->addr(), key);
         }
     }
-
-    std::string sender_url = lo_address_get_url(lo_message_get_source(msg));
-    for (const auto & c : s_client_list)
-    {
-        if (is_nullptr(c->addr()))
-            continue;
-
-        std::string url = lo_address_get_url(c->addr());
-        if (util::strcompare(sender_url, url))
-            s_osc_server->send(c->addr(), to_path, new_args);
-
-    }
+    else
+        util::warn_message("Cannot relay broadcast", to_path);
 
     /*
      * Also relay to attached GUI so that the broadcast can be
@@ -2320,11 +3904,11 @@ OSC_HANDLER( broadcast )
 
     if (s_gui_is_active)
     {
-        std::string u1 = lo_address_get_url(s_gui_address);
-        if (util::strcompare(u1, sender_url))
+        const std::string & key = s_address_cache.key(s_gui_address);
+        if (key != sender && s_fanout.build(path, types, argv, 0, argc))
         {
-            new_args.push_front(osc::osc_string(to_path));
-            s_osc_server->send(s_gui_address, path, new_args);
+            flush_gui_queue();                  /* keep the GUI's order     */
+            (void) s_fanout.send(srv, s_gui_address, key);
         }
     }
     return osc::osc_msg_handled();
@@ -2346,9 +3930,9 @@ OSC_HANDLER( progress )
         c->progress(argv[0]->f);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/progress",
+                "/nsm/gui/client/progress",
                 CSTR(c->client_id()), c->progress()
             );
         }
@@ -2367,9 +3951,9 @@ OSC_HANDLER( is_dirty )
         c->dirty(true);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/dirty",
+                "/nsm/gui/client/dirty",
                 CSTR(c->client_id()), c->dirty()
             );
         }
@@ -2388,9 +3972,9 @@ OSC_HANDLER( is_clean )
         c->dirty(false);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/dirty",
+                "/nsm/gui/client/dirty",
                 CSTR(c->client_id()), c->dirty()
             );
         }
@@ -2409,9 +3993,9 @@ OSC_HANDLER( gui_is_hidden )
         c->gui_visible(false);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/gui_visible",
+                "/nsm/gui/client/gui_visible",
                 CSTR(c->client_id()), c->gui_visible()
             );
         }
@@ -2430,9 +4014,9 @@ OSC_HANDLER( gui_is_shown )
         c->gui_visible(true);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/gui_visible",
+                "/nsm/gui/client/gui_visible",
                 CSTR(c->client_id()), c->gui_visible()
             );
         }
@@ -2449,9 +4033,9 @@ OSC_HANDLER( message )
     {
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_post
             (
-                s_gui_address, "/nsm/gui/client/message",
+                "/nsm/gui/client/message",
                 CSTR(c->client_id()), argv[0]->i, &argv[1]->s
             );
         }
@@ -2474,9 +4058,9 @@ OSC_HANDLER( label )
         c->label(&argv[0]->s);
         if (s_gui_is_active)
         {
-            s_osc_server->send
+            gui_update
             (
-                s_gui_address, "/nsm/gui/client/label",
+                "/nsm/gui/client/label",
                 CSTR(c->client_id()), c->label()
             );
         }
@@ -2488,6 +4072,53 @@ OSC_HANDLER( label )
  * Response handlers
  *--------------------------------------------------------------------------*/
 
+/*
+ *  Records the time a client took to answer a save or an open.  An open
+ *  sent by command_client_to_switch() leaves the status "switch".
+ */
+
+static void
+record_reply_latency (Client * c)
+{
+    const char * kind = nullptr;
+    if (c->pending_command() == nsm::command::save)
+        kind = "save";
+    else if (c->pending_command() == nsm::command::open)
+        kind = c->status() == "switch" ? "switch" : "open" ;
+
+    if (not_nullptr(kind))
+    {
+        s_runtime_stats.latency
+        (
+            c->name_with_id(), kind, c->ms_since_last_command()
+        );
+    }
+}
+
+/*
+ *  The reply of a held client, to the open sent by announce_held_client().
+ *  It is not shown in the GUI.
+ */
+
+static Client *
+held_reply (lo_message msg, int errcode, const std::string & message)
+{
+    Client * c = s_held_clients.by_address(lo_message_get_source(msg));
+    if (not_nullptr(c))
+    {
+        c->set_reply(errcode, message);
+        util::info_printf
+        (
+            "Prepared client \"%s\" replied with: %s (%i) in %fms",
+            V(c->name_with_id()), V(message), errcode,
+            c->ms_since_last_command()
+        );
+        record_reply_latency(c);
+        c->pending_command(nsm::command::none);
+    }
+    return c;
+}
+
 OSC_HANDLER( error )
 {
     (void) path; (void) types; (void) user_data;
@@ -2506,10 +4137,13 @@ OSC_HANDLER( error )
             V(c->name_with_id()), V(message), err_code,
             c->ms_since_last_command()
         );
+        record_reply_latency(c);
         c->pending_command(nsm::command::none);
         c->status("error");
         gui_send("/nsm/gui/client/status", c->client_id(), c->status());
     }
+    else if (not_nullptr(c = held_reply(msg, argv[1]->i, &argv[2]->s)))
+        c->status("error");
     else
         util::warn_message("Error from unknown client");
 
@@ -2532,10 +4166,13 @@ OSC_HANDLER( reply )
             "Client \"%s\" replied with: %s in %fms",
             V(c->name_with_id()), V(message), c->ms_since_last_command()
         );
+        record_reply_latency(c);
         c->pending_command(nsm::command::none);
         c->status("ready");
         gui_send("/nsm/gui/client/status", c->client_id(), c->status());
     }
+    else if (not_nullptr(c = held_reply(msg, nsm::error::ok, &argv[1]->s)))
+        c->status("held");
     else
         util::warn_message("Reply from unknown client");
 
@@ -2555,12 +4192,12 @@ OSC_HANDLER( stop )
     {
         command_client_to_stop(c);
         if (s_gui_is_active)
-            s_osc_server->send(s_gui_address, "/reply", "Client stopped");
+            gui_post("/reply", "Client stopped");
     }
     else
     {
         if (s_gui_is_active)
-            s_osc_server->send(s_gui_address, "/error", -10, "No such client.");
+            gui_post("/error", -10, "No such client.");
     }
     return osc::osc_msg_handled();
 }
@@ -2579,13 +4216,13 @@ OSC_HANDLER( remove )
             s_client_list.remove(c);
             delete c;
             if (s_gui_is_active)
-                s_osc_server->send(s_gui_address, "/reply", "Client removed");
+                gui_post("/reply", "Client removed");
         }
     }
     else
     {
         if (s_gui_is_active)
-            s_osc_server->send(s_gui_address, "/error", -10, "No such client");
+            gui_post("/error", -10, "No such client");
     }
     return osc::osc_msg_handled();
 }
@@ -2599,7 +4236,12 @@ OSC_HANDLER( resume )
     {
         if (c->pid() == 0 && ! c->active())
         {
-            if (! launch(c->exe_path(), c->client_id()))
+            bool ok = launch
+            (
+                c->exe_path(), c->client_id(), "",
+                s_client_list, c->attributes()
+            );
+            if (! ok)
             {
                 // TODO
             }
@@ -2669,7 +4311,14 @@ void
 announce_gui (const std::string & url, bool is_reply)
 {
     util::info_message("GUI announced from URL", V(url));
-    s_gui_address = lo_address_new_from_url(CSTR(url));
+    lo_address guiaddr = s_address_cache.acquire(url);
+    if (not_nullptr(s_gui_address))
+    {
+        flush_gui_queue();                      /* still for the old GUI    */
+        s_address_cache.release(s_gui_address);
+    }
+
+    s_gui_address = guiaddr;
     s_gui_is_active = true;
     if (is_reply)
     {
@@ -2678,7 +4327,7 @@ announce_gui (const std::string & url, bool is_reply)
          * running one.
          */
 
-        s_osc_server->send(s_gui_address, "/nsm/gui/gui_announce", "hi");
+        gui_post("/nsm/gui/gui_announce", "hi");
     }
     else
     {
@@ -2687,7 +4336,7 @@ announce_gui (const std::string & url, bool is_reply)
          * running GUI.
          */
 
-        s_osc_server->send(s_gui_address, "/nsm/gui/server_announce", "hi");
+        gui_post("/nsm/gui/server_announce", "hi");
     }
 
     /*
@@ -2695,7 +4344,7 @@ announce_gui (const std::string & url, bool is_reply)
      * For the general information we need to send this message:
      */
 
-    s_osc_server->send(s_gui_address, "/nsm/gui/session/root", s_session_root);
+    gui_post("/nsm/gui/session/root", s_session_root);
 
     /*
      * Send session name and relative path. If both are empty, it signals that
@@ -2708,7 +4357,7 @@ announce_gui (const std::string & url, bool is_reply)
     if (s_session_name.empty())
     {
         util::info_message("Informing GUI", "No session running");
-        s_osc_server->send(s_gui_address, "/nsm/gui/session/name", "", "");
+        gui_post("/nsm/gui/session/name", "", "");
     }
     else
     {
@@ -2727,40 +4376,40 @@ announce_gui (const std::string & url, bool is_reply)
         for (const auto & klient : s_client_list)
         {
             Client * c = klient;
-            s_osc_server->send /* we send new twice. see announce() comment */
+            gui_post /* we send new twice. see announce() comment */
             (
-                s_gui_address, "/nsm/gui/client/new",
+                "/nsm/gui/client/new",
                 CSTR(c->client_id()), CSTR(c->exe_path())
             );
             if (! c->status().empty())
             {
-                s_osc_server->send
+                gui_update
                 (
-                    s_gui_address, "/nsm/gui/client/status",
+                    "/nsm/gui/client/status",
                     CSTR(c->client_id()), CSTR(c->status())
                 );
             }
             if (c->is_capable_of(":optional-gui:"))
             {
-                s_osc_server->send
+                gui_post
                 (
-                    s_gui_address, "/nsm/gui/client/has_optional_gui",
+                    "/nsm/gui/client/has_optional_gui",
                     CSTR(c->client_id())
                 );
             }
             if (! c->label().empty())
             {
-                s_osc_server->send
+                gui_update
                 (
-                    s_gui_address, "/nsm/gui/client/label",
+                    "/nsm/gui/client/label",
                     CSTR(c->client_id()), CSTR(c->label())
                 );
             }
             if (c->active())
             {
-                s_osc_server->send              /* upgrade to pretty-name   */
+                gui_post                        /* upgrade to pretty-name   */
                 (
-                    s_gui_address, "/nsm/gui/client/new",
+                    "/nsm/gui/client/new",
                     CSTR(c->client_id()), CSTR(c->name())
                 );
             }
@@ -2773,9 +4422,9 @@ announce_gui (const std::string & url, bool is_reply)
             "Informing GUI: session %s, relative path %s",
             V(s_session_name), V(relativepath)
         );
-        s_osc_server->send
+        gui_post
         (
-            s_gui_address, "/nsm/gui/session/name",
+            "/nsm/gui/session/name",
             CSTR(s_session_name), relativepath
         );
     }
@@ -2794,7 +4443,7 @@ OSC_HANDLER( ping )
 {
     (void) msg; (void) argc; (void) argv; (void) types; (void) user_data;
 
-    s_osc_server->send(lo_message_get_source(msg), "/reply", path);
+    send_reply_to(message_source(msg), path, nullptr);
     return osc::osc_msg_handled();
 }
 
@@ -2837,6 +4486,24 @@ void help ()
 "  --gui-url url         Connect to running NSM legacy-gui.\n"
 "                        Example: osc.udp://mycomputer.localdomain:38356/.\n"
 "  --detach              Detach from console.\n"
+"  --parallel-launch     Start all clients of a session at once, instead of\n"
+"                        one every 100 ms. Each client is given a reserved\n"
+"                        port in NSM_CLIENT_PORT.\n"
+"  --fsync               Flush session.nsm to disk (fsync) when saving.\n"
+"  --trace file          Record a trace of the daemon's work, written to\n"
+"                        'file' at exit in Chrome trace JSON format, for\n"
+"                        chrome://tracing or ui.perfetto.dev.\n"
+"  --prepare-min-free MiB\n"
+"                        Start a client of a prepared session (see\n"
+"                        /nsm/server/prepare) only while this much memory\n"
+"                        is available. Default: 1024. 0 disables.\n"
+"  --prepare-max-load x  ... and while the load average per CPU is at most\n"
+"                        x. Default: 0.8. 0 disables.\n"
+"  --sample-ms ms        Sample the CPU, memory, and I/O use of each client\n"
+"                        every 'ms', for /nsm/server/resources.\n"
+"                        Default: 2000. 0 disables.\n"
+"  --sample-gui          Also send each sample to the GUI, as\n"
+"                        /nsm/gui/client/resources.\n"
 "  --quiet               Suppress messages except warnings and errors.\n"
 "\n\n"
 "nsmd can be run headless with existing sessions. To create new ones it\n"
@@ -2883,6 +4550,132 @@ make_daemon_directory ()
     return result;
 }
 
+/*
+ *  The local control socket.  Loopback UDP can drop datagrams under load,
+ *  and limits their size to 64 KiB, which a long /nsm/server/list can
+ *  reach.  UNIX-domain datagrams are reliable and ordered, are bounded by
+ *  the socket buffer instead, and skip the IP stack.  It
+ *  lives in the XDG runtime lock directory, and its URL is the second
+ *  line of the daemon file; the first line is still the UDP URL, which the
+ *  clients get as NSM_URL.  Failing to create it is not fatal.
+ */
+
+static bool
+open_unix_server ()
+{
+    s_unix_socket = util::string_asprintf
+    (
+        "%s/nsmd-%d.osc", V(s_lockfile_directory), int(getpid())
+    );
+    (void) unlink(V(s_unix_socket));            /* a stale one, same PID    */
+    s_unix_server = lo_server_new_with_proto(V(s_unix_socket), LO_UNIX, NULL);
+    if (is_nullptr(s_unix_server))
+    {
+        util::warn_message("No local control socket", s_unix_socket);
+        s_unix_socket.clear();
+        return false;
+    }
+    util::info_message("Local control socket", s_unix_socket);
+    return true;
+}
+
+static std::string
+unix_server_url ()
+{
+    std::string result;
+    char * url = not_nullptr(s_unix_server) ?
+        lo_server_get_url(s_unix_server) : nullptr ;
+
+    if (not_nullptr(url))
+    {
+        result = url;
+        free(url);
+    }
+    return result;
+}
+
+static void
+close_unix_server ()
+{
+    if (not_nullptr(s_unix_server))
+    {
+        lo_server_free(s_unix_server);
+        s_unix_server = nullptr;
+        (void) unlink(V(s_unix_socket));
+    }
+}
+
+/**
+ *  Every method handler is registered through osc_timed(), which times
+ *  the handler for s_runtime_stats, and traces it with the ID of the
+ *  client that sent the message.  The user-data of the method points
+ *  to the real handler; the handlers themselves do not use user-data.
+ *  A std::list keeps the addresses of the handlers stable.  The /reply
+ *  and /error handlers added by osc::lowrapper are not timed.
+ *
+ *  The methods are also added to the local UNIX-socket server, if there is
+ *  one, with an empty pattern accepting any arguments, as liblo would have
+ *  it otherwise.  It does not get /reply and /error; the clients reply on
+ *  the NSM_URL they were given, which is the UDP one.
+ */
+
+static std::list<osc::method_handler> s_timed_handlers;
+
+static int
+osc_timed
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    osc::method_handler f = *static_cast<osc::method_handler *>(user_data);
+    const char * id = nullptr;
+    if (s_tracer.enabled())
+    {
+        Client * c = get_client_by_address(lo_message_get_source(msg));
+        if (not_nullptr(c))
+            id = c->client_id().c_str();
+    }
+
+    auto begin = nsmd::eventloop::clock::now();
+    int result;
+    {
+        nsmd::trace_scope ts(s_tracer, path, id);
+        result = f(path, types, argv, argc, msg, nullptr);
+    }
+    double ms = std::chrono::duration<double, std::milli>
+    (
+        nsmd::eventloop::clock::now() - begin
+    ).count();
+    s_runtime_stats.handled(not_nullptr(path) ? path : "?", ms);
+    return result;
+}
+
+static void
+add_timed_method
+(
+    const std::string & msg,
+    const std::string & pattern,
+    osc::method_handler f,
+    const std::string & argument_description
+)
+{
+    s_timed_handlers.push_back(f);
+    (void) s_osc_server->add_method
+    (
+        msg, pattern, osc_timed, &s_timed_handlers.back(),
+        V(argument_description)
+    );
+    if (not_nullptr(s_unix_server))
+    {
+        (void) lo_server_add_method
+        (
+            s_unix_server, V(msg), pattern.empty() ? nullptr : V(pattern),
+            osc_timed, &s_timed_handlers.back()
+        );
+    }
+}
+
 /**
  *  Adds an OSC handler function using endpoint::add_method().
  *  It first calls osc::tag_lookup() [see the messages module]
@@ -2916,12 +4709,7 @@ add_method
 {
     std::string msg, pattern;
     if (osc::tag_lookup(t, msg, pattern))
-    {
-        (void) s_osc_server->add_method
-        (
-            msg, pattern, f, NULL, V(argument_description)
-        );
-    }
+        add_timed_method(msg, pattern, f, argument_description);
 }
 
 /**
@@ -2996,34 +4784,105 @@ add_methods ()
     add_method(osc::tag::srvopen, OSC_NAME( open ), "name");
     add_method(osc::tag::srvclose, OSC_NAME( close ), "");
     add_method(osc::tag::srvquit, OSC_NAME( quit ), "");
+
+    /*
+     * Not NSM messages, so there is no osc::tag for them.
+     */
+
+    add_timed_method("/nsm/server/cancel", "", OSC_NAME( cancel ), "");
+    add_timed_method("/nsm/server/stats", "", OSC_NAME( stats ), "");
+    add_timed_method
+    (
+        "/nsm/server/resources", "", OSC_NAME( resources ), ""
+    );
+    add_timed_method("/nsm/server/prepare", "s", OSC_NAME( prepare ), "name");
+    add_timed_method("/nsm/server/discard", "", OSC_NAME( discard ), "");
     add_method(osc::tag::null, OSC_NAME( null ), "");
 }
 
 /*
- * We want a clean exit even when things go wrong.
+ *  The end of a clean exit, once the session, if any, is closed.
  */
 
-void
-handle_signal_clean_exit (int sig)
+static void
+exit_daemon ()
+{
+    flush_gui_queue();
+    if (s_tracer.enabled())
+        (void) s_tracer.dump();
+
+    if (util::file_delete(s_daemon_file))
+        util::info_message("Deleted daemon file", s_daemon_file);
+
+    close_unix_server();
+    exit(0);
+}
+
+/*
+ *  Starts a clean exit.  Any running operation is abandoned, and the
+ *  session is closed by the phases of a new one, so that the event loop
+ *  keeps running while the clients quit; the daemon exits from its last
+ *  phase.  Since s_exiting is set, no other operation can start meanwhile.
+ */
+
+static void
+start_exit (const std::string & name)
+{
+    if (s_exiting)
+        return;
+
+    s_exiting = true;
+    s_operation.abandon();
+    s_operation.prepare(nsm::command::quit, name, nullptr);
+    if (! s_session_path.empty())
+        add_close_phases();
+
+    s_operation.add_final_phase("exit", exit_daemon);
+    s_operation.start();
+}
+
+static std::string
+signal_name (int sig)
 {
-    std::string signame { "SIG ?" };
+    std::string result { "SIG ?" };
     if (sig == 0)
-        signame = "None";
+        result = "None";
     else if (sig == 1)
-        signame = "SIGHUP";
+        result = "SIGHUP";
     else if (sig == 2)
-        signame = "SIGINT";
+        result = "SIGINT";
     else if (sig == 11)
-        signame = "SIGSEGV";
+        result = "SIGSEGV";
     else if (sig == 15)
-        signame = "SIGTERM";
+        result = "SIGTERM";
 
-    util::status_printf("Handling signal %d (%s)\n", sig, V(signame));
-    close_session();
-    if (util::file_delete(s_daemon_file))
-        util::info_message("Deleted daemon file", s_daemon_file);
+    return result;
+}
 
-    exit(0);
+/*
+ * We want a clean exit even when things go wrong.  The signal is only
+ * noted here; the main loop then calls start_exit().  After a SIGSEGV we
+ * cannot go on, so the clients are told to quit and the daemon exits at
+ * once.
+ */
+
+void
+handle_signal_clean_exit (int sig)
+{
+    if (sig == SIGSEGV)
+    {
+        util::status_printf("Handling signal %d (%s)\n", sig, "SIGSEGV");
+        s_exiting = true;
+        s_operation.abandon();
+        if (! s_session_path.empty())
+        {
+            close_session_begin();
+            close_session_end();
+        }
+        exit_daemon();
+    }
+    else
+        s_exit_signal = sig;
 }
 
 /**
@@ -3068,6 +4927,13 @@ main (int argc, char * argv [])
         { "version",        no_argument,        0, 'v' },
         { "load-session",   required_argument,  0, 'l'},
         { "quiet",          no_argument,        0, 'q'},    /* no info msgs */
+        { "parallel-launch", no_argument,       0, 'P'},
+        { "fsync",          no_argument,        0, 'F'},
+        { "trace",          required_argument,  0, 'T'},
+        { "prepare-min-free", required_argument, 0, 'M'},
+        { "prepare-max-load", required_argument, 0, 'L'},
+        { "sample-ms",      required_argument,  0, 'S'},
+        { "sample-gui",     no_argument,        0, 'G'},
         { 0, 0, 0, 0 }
     };
     int option_index = 0;
@@ -3127,6 +4993,44 @@ main (int argc, char * argv [])
             util::set_verbose(false);
             break;
 
+        case 'P':
+
+            util::info_message("Parallel client launch enabled");
+            s_parallel_launch = true;
+            break;
+
+        case 'F':
+
+            util::info_message("Session files are flushed to disk on save");
+            s_session_writer.use_fsync(true);
+            break;
+
+        case 'T':
+
+            if (s_tracer.enable(optarg))
+                s_operation.trace(s_tracer);
+            break;
+
+        case 'M':
+
+            s_headroom.min_free_mib(std::atol(optarg));
+            break;
+
+        case 'L':
+
+            s_headroom.max_load(std::atof(optarg));
+            break;
+
+        case 'S':
+
+            s_sample_ms = std::atol(optarg);
+            break;
+
+        case 'G':
+
+            s_sample_gui = true;
+            break;
+
         case 'h':
 
             help();
@@ -3168,6 +5072,11 @@ main (int argc, char * argv [])
 
             std::string url = s_osc_server->url();
             url += "\n";
+            if (open_unix_server())
+            {
+                url += unix_server_url();
+                url += "\n";
+            }
             ok = util::file_write_string(s_daemon_file, url);
             if (ok)
             {
@@ -3198,6 +5107,17 @@ main (int argc, char * argv [])
         announce_gui(gui_url, false);
     }
     add_methods();                              /* response handlers        */
+    {
+        nsmd::trace_scope ts(s_tracer, "session index build");
+        if (! s_session_index.build(s_session_root, s_session_file))
+            util::warn_message("Session index incomplete", s_session_root);
+    }
+
+    if (! start_event_loop())
+    {
+        util::error_message("Failed to start the event loop, exiting");
+        exit(EXIT_FAILURE);
+    }
     if (! load_session.empty())                 /* this is a session name   */
     {
         /*
@@ -3208,7 +5128,17 @@ main (int argc, char * argv [])
         (
             "%s/%s", V(s_session_root), V(load_session)
         );
-        load_session_file(spath);
+        s_operation.prepare
+        (
+            nsm::command::open, "--load-session",
+            [] (int code, const std::string & errmsg)
+            {
+                if (code != nsm::error::ok)
+                    util::error_message("Could not load session", errmsg);
+            }
+        );
+        add_load_phases(spath);
+        s_operation.start();
     }
     if (detach)
     {
@@ -3234,8 +5164,18 @@ main (int argc, char * argv [])
     int start_ppid = getppid();                         /* get parent pid   */
     for (;;)
     {
-        wait(1000);
-        if (start_ppid != getppid())
+        (void) s_event_loop.run_once(1000);
+        if (s_exit_signal != 0)
+        {
+            int sig = int(s_exit_signal);
+            s_exit_signal = 0;
+            util::status_printf
+            (
+                "Handling signal %d (%s)\n", sig, V(signal_name(sig))
+            );
+            start_exit("exit");
+        }
+        if (start_ppid != getppid() && ! s_exiting)
         {
             util::warn_printf
             (
@@ -3245,7 +5185,7 @@ main (int argc, char * argv [])
                 "Try to shut down cleanly.",
                 int(start_ppid), int(getppid())
             );
-            handle_signal_clean_exit(0);                /* 0 == no signal   */
+            start_exit("exit");
         }
     }
 
@@ -3253,7 +5193,7 @@ main (int argc, char * argv [])
      * Code after here will not be executed if nsmd is stopped with any
      * abort-signal like SIGINT. Without a signal handler clients will remain
      * active ("zombies") without nsmd as parent. Therefore exit is handled by
-     * handle_signal_clean_exit().
+     * handle_signal_clean_exit() and start_exit().
      */
 
     return EXIT_SUCCESS;
@@ -0,0 +1,321 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          operation.cpp
+ *
+ *    This module implements the phased session operation of nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include "operation.hpp"                /* nsmd::operation class            */
+#include "util/msgfunctions.hpp"        /* cfg66: util::info_printf()       */
+
+namespace nsmd
+{
+
+operation::operation (eventloop & loop) :
+    m_loop          (loop),
+    m_command       (0),
+    m_name          (),
+    m_phases        (),
+    m_current       (0),
+    m_started       (false),
+    m_expired       (false),
+    m_stepping      (false),
+    m_timer         (0),
+    m_error         (0),
+    m_message       (),
+    m_completion    (),
+    m_begin_time    (),
+    m_tracer        (nullptr),
+    m_serial        (0)
+{
+    // no code
+}
+
+/**
+ *  Begins building a new operation. The caller must first check that no
+ *  operation is busy().
+ *
+ * \param command
+ *      The nsm::command value of the operation, which must not be 0.
+ *
+ * \param name
+ *      The name used in log messages, normally the OSC path.
+ *
+ * \param done
+ *      Called once, when the operation has ended, with the nsm::error
+ *      code (0 for success) and the error message.
+ */
+
+void
+operation::prepare (int command, const std::string & name, completion done)
+{
+    reset();
+    m_command = command;
+    m_name = name;
+    m_completion = done;
+    m_begin_time = eventloop::clock::now();
+    ++m_serial;
+    if (m_tracer != nullptr)
+        m_tracer->async_begin(m_name.c_str(), m_serial);
+}
+
+void
+operation::add_phase
+(
+    const std::string & name,
+    action start,
+    predicate done,
+    long timeout_ms,
+    action finish,
+    bool isfinal
+)
+{
+    phase p { name, start, done, timeout_ms, finish, isfinal };
+    m_phases.push_back(p);
+}
+
+/**
+ *  Adds a phase that runs whether or not the operation failed.
+ */
+
+void
+operation::add_final_phase (const std::string & name, action start)
+{
+    add_phase(name, start, nullptr, 0, nullptr, true);
+}
+
+void
+operation::start ()
+{
+    step();
+}
+
+/**
+ *  Runs phases until one has to wait, or the operation is complete.
+ *  Called by start() and then after every event-loop iteration.
+ */
+
+void
+operation::step ()
+{
+    if (! busy() || m_stepping)
+        return;
+
+    m_stepping = true;
+    while (m_current < m_phases.size())
+    {
+        phase & p = m_phases[m_current];
+        if (failed() && ! p.p_final)
+        {
+            ++m_current;                        /* skip it entirely         */
+            continue;
+        }
+        if (! m_started)
+        {
+            m_started = true;
+            m_expired = false;
+            if (m_tracer != nullptr)
+                m_tracer->async_begin(p.p_name.c_str(), m_serial);
+
+            if (p.p_start)
+                p.p_start();
+
+            if (! failed() && p.p_done && p.p_timeout_ms > 0)
+            {
+                m_timer = m_loop.add_timer
+                (
+                    p.p_timeout_ms, [this] () { m_expired = true; }
+                );
+            }
+        }
+
+        bool done = failed() || ! p.p_done || p.p_done();
+        if (! done && m_expired)
+        {
+            util::warn_message
+            (
+                "Operation phase timed out", m_name + " " + p.p_name
+            );
+            done = true;
+        }
+        if (! done)
+            break;
+
+        end_phase();
+    }
+    m_stepping = false;
+    if (busy() && m_current >= m_phases.size())
+        complete();
+}
+
+void
+operation::end_phase ()
+{
+    if (m_timer != 0)
+    {
+        (void) m_loop.cancel_timer(m_timer);
+        m_timer = 0;
+    }
+
+    if (m_tracer != nullptr)
+        m_tracer->async_end(m_phases[m_current].p_name.c_str(), m_serial);
+
+    action finish = m_phases[m_current].p_finish;
+    m_started = false;
+    ++m_current;
+    if (finish)
+        finish();
+}
+
+/**
+ *  Marks the operation as failed. The first failure wins. The remaining
+ *  phases, other than the final ones, are skipped.
+ */
+
+void
+operation::fail (int code, const std::string & message)
+{
+    if (busy() && m_error == 0)
+    {
+        m_error = code != 0 ? code : (-1) ;
+        m_message = message;
+    }
+}
+
+/**
+ *  Cancels the running operation. The current phase is finished without
+ *  waiting any longer, the final phases are run, and the requester gets
+ *  the given error.  Clients that are still working (e.g. saving) are
+ *  not interrupted; their late replies are handled as usual.
+ *
+ * \return
+ *      Returns false if there was no operation to cancel.
+ */
+
+bool
+operation::cancel (int code, const std::string & message)
+{
+    bool result = busy();
+    if (result)
+    {
+        util::warn_message
+        (
+            "Cancelling operation", m_name + " " + phase_name()
+        );
+        fail(code, message);
+        if (! m_stepping)
+        {
+            if (m_started)
+                end_phase();
+
+            step();
+        }
+    }
+    return result;
+}
+
+/**
+ *  Drops the running operation at once, without running any more of its
+ *  phases or its completion.  Used when the daemon exits, and closes the
+ *  session itself.
+ */
+
+void
+operation::abandon ()
+{
+    if (busy())
+    {
+        util::warn_message
+        (
+            "Abandoning operation", m_name + " " + phase_name()
+        );
+        if (m_tracer != nullptr)
+        {
+            if (m_started)
+                m_tracer->async_end(phase_name().c_str(), m_serial);
+
+            m_tracer->async_end(m_name.c_str(), m_serial);
+        }
+        reset();
+    }
+}
+
+std::string
+operation::phase_name () const
+{
+    return m_current < m_phases.size() ?
+        m_phases[m_current].p_name : std::string() ;
+}
+
+void
+operation::complete ()
+{
+    double ms = std::chrono::duration<double, std::milli>
+    (
+        eventloop::clock::now() - m_begin_time
+    ).count();
+    util::info_printf
+    (
+        "Operation %s %s in %.1f ms", m_name.c_str(),
+        failed() ? "failed" : "done", ms
+    );
+    if (m_tracer != nullptr)
+        m_tracer->async_end(m_name.c_str(), m_serial);
+
+    completion done = m_completion;
+    int code = m_error;
+    std::string message = m_message;
+    reset();                                    /* busy() is now false      */
+    if (done)
+        done(code, message);
+}
+
+void
+operation::reset ()
+{
+    if (m_timer != 0)
+    {
+        (void) m_loop.cancel_timer(m_timer);
+        m_timer = 0;
+    }
+    m_command = 0;
+    m_name.clear();
+    m_phases.clear();
+    m_current = 0;
+    m_started = false;
+    m_expired = false;
+    m_error = 0;
+    m_message.clear();
+    m_completion = nullptr;
+}
+
+}               // namespace nsmd
+
+/*
+ * operation.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,434 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          placement.cpp
+ *
+ *    This module implements the CPU, scheduling, and cgroup placement of
+ *    the clients.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cctype>                       /* std::toupper()                   */
+#include <cerrno>                       /* errno                            */
+#include <cstdlib>                      /* std::strtol()                    */
+#include <cstring>                      /* std::strerror()                  */
+#include <fcntl.h>                      /* open(), O_WRONLY, O_CLOEXEC      */
+#include <fstream>                      /* std::ifstream                    */
+#include <sys/resource.h>               /* setpriority()                    */
+#include <unistd.h>                     /* write(), close()                 */
+
+#include "c_macros.h"                   /* V() macro                        */
+#include "placement.hpp"                /* nsmd::placement class            */
+#include "sessionplan.hpp"              /* nsmd::session_plan attributes    */
+#include "util/filefunctions.hpp"       /* cfg66: make_directory_path()     */
+#include "util/msgfunctions.hpp"        /* cfg66: util::warn_message()      */
+
+namespace nsmd
+{
+
+namespace   // anonymous
+{
+
+const char * const s_cgroup_root = "/sys/fs/cgroup";
+
+bool
+to_long (const std::string & text, long & value)
+{
+    if (text.empty())
+        return false;
+
+    char * end = nullptr;
+    errno = 0;
+    value = std::strtol(text.c_str(), &end, 10);
+    return errno == 0 && end != nullptr && *end == 0;
+}
+
+/*
+ *  Gets the value of the last of the key's attributes, if there is one.
+ */
+
+bool
+last_value
+(
+    const std::string & attributes,
+    const std::string & key,
+    std::string & value
+)
+{
+    std::vector<std::string> values =
+        session_plan::attribute_values(attributes, key);
+
+    bool result = ! values.empty();
+    if (result)
+        value = values.back();
+
+    return result;
+}
+
+/*
+ *  Converts "512M" and the like to bytes.  The cgroup files take bytes,
+ *  or "max".
+ */
+
+bool
+memory_bytes (const std::string & text, std::string & bytes)
+{
+    if (text == "max")
+    {
+        bytes = text;
+        return true;
+    }
+
+    std::string digits = text;
+    long long scale = 1;
+    char suffix = digits.empty() ? 0 : digits.back() ;
+    std::string units { "KMGT" };
+    std::size_t unit = units.find(char(std::toupper(suffix)));
+    if (suffix != 0 && unit != std::string::npos)
+    {
+        digits.pop_back();
+        scale = 1LL << (10 * (unit + 1));
+    }
+
+    long value;
+    bool result = to_long(digits, value) && value > 0;
+    if (result)
+        bytes = std::to_string((long long) value * scale);
+
+    return result;
+}
+
+bool
+write_text (const std::string & path, const std::string & text)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    ssize_t count = ::write(fd, text.data(), text.size());
+    bool result = count == ssize_t(text.size());
+    int error = errno;
+    (void) ::close(fd);
+    errno = error;
+    return result;
+}
+
+}           // namespace anonymous
+
+placement::placement () :
+    m_cpus          (),
+    m_policy        (-1),
+    m_nice          (0),
+    m_has_nice      (false),
+    m_cgroup        (),
+    m_cpu_weight    (0),
+    m_memory_high   ()
+{
+    // no code
+}
+
+/**
+ *  Gets the placement attributes of a client.  Bad values are reported
+ *  and left out; the rest of the placement still applies.
+ *
+ * \return
+ *      Returns false if any value was bad.
+ */
+
+bool
+placement::parse (const std::string & attributes)
+{
+    bool result = true;
+    *this = placement();
+    for (const auto & v : session_plan::attribute_values(attributes, "cpus"))
+    {
+        std::size_t dash = v.find_first_of('-');
+        long first, last;
+        bool ok = dash == std::string::npos ?
+            to_long(v, first) : to_long(v.substr(0, dash), first) ;
+
+        if (ok)
+        {
+            last = first;
+            if (dash != std::string::npos)
+                ok = to_long(v.substr(dash + 1), last);
+        }
+        ok = ok && first >= 0 && first <= last && last < CPU_SETSIZE;
+        if (ok)
+        {
+            for (long cpu = first; cpu <= last; ++cpu)
+                m_cpus.push_back(int(cpu));
+        }
+        else
+        {
+            util::warn_message("Bad cpus attribute", v);
+            result = false;
+        }
+    }
+
+    std::string value;
+    if (last_value(attributes, "sched", value))
+    {
+        if (value == "other")
+            m_policy = SCHED_OTHER;
+        else if (value == "batch")
+            m_policy = SCHED_BATCH;
+        else if (value == "idle")
+            m_policy = SCHED_IDLE;
+        else
+        {
+            util::warn_message("Bad sched attribute", value);
+            result = false;
+        }
+    }
+    if (last_value(attributes, "nice", value))
+    {
+        long nice;
+        if (to_long(value, nice) && nice >= -20 && nice <= 19)
+        {
+            m_nice = int(nice);
+            m_has_nice = true;
+        }
+        else
+        {
+            util::warn_message("Bad nice attribute", value);
+            result = false;
+        }
+    }
+    if (last_value(attributes, "cgroup", value))
+    {
+        if (value.empty() || value.find("..") != std::string::npos)
+        {
+            util::warn_message("Bad cgroup attribute", value);
+            result = false;
+        }
+        else
+            m_cgroup = value;
+    }
+    if (last_value(attributes, "cpu.weight", value))
+    {
+        long weight;
+        if (to_long(value, weight) && weight >= 1 && weight <= 10000)
+            m_cpu_weight = weight;
+        else
+        {
+            util::warn_message("Bad cpu.weight attribute", value);
+            result = false;
+        }
+    }
+    if (last_value(attributes, "memory.high", value))
+    {
+        if (! memory_bytes(value, m_memory_high))
+        {
+            util::warn_message("Bad memory.high attribute", value);
+            result = false;
+        }
+    }
+    if ((m_cpu_weight > 0 || ! m_memory_high.empty()) && m_cgroup.empty())
+        util::warn_message("cpu.weight and memory.high need a cgroup");
+
+    return result;
+}
+
+/**
+ *  Fills a CPU set for sched_setaffinity() and the like.
+ *
+ * \return
+ *      Returns false if there are no "cpus" attributes.
+ */
+
+bool
+placement::cpu_set (cpu_set_t & set) const
+{
+    CPU_ZERO(&set);
+    for (int cpu : m_cpus)
+        CPU_SET(cpu, &set);
+
+    return has_cpus();
+}
+
+/**
+ *  Applies the scheduling class, the nice value, and the cgroup to a
+ *  running process.  The spawner only falls back to this when it cannot
+ *  place the child before its exec; then they reach only the main thread
+ *  of a client that has started others already.
+ *
+ * \return
+ *      Returns false if any part failed; each failure is reported.
+ */
+
+bool
+placement::apply (pid_t pid) const
+{
+    bool result = true;
+    if (has_policy())
+    {
+        struct sched_param param;
+        param.sched_priority = 0;       /* the only one of these classes    */
+        if (sched_setscheduler(pid, m_policy, &param) != 0)
+        {
+            util::warn_printf
+            (
+                "Cannot set the scheduling class of PID %d: %s",
+                int(pid), std::strerror(errno)
+            );
+            result = false;
+        }
+    }
+    if (m_has_nice && setpriority(PRIO_PROCESS, id_t(pid), m_nice) != 0)
+    {
+        util::warn_printf
+        (
+            "Cannot set nice %d for PID %d: %s",
+            m_nice, int(pid), std::strerror(errno)
+        );
+        result = false;
+    }
+    if (! m_cgroup.empty())
+    {
+        std::string dir = prepare_cgroup();
+        result = ! dir.empty() && move_to_cgroup(pid, dir) && result;
+    }
+    return result;
+}
+
+/**
+ *  Finds the directory of the cgroup.  A relative name is placed beside
+ *  the cgroup of nsm66d, the one its line "0::/path" of /proc/self/cgroup
+ *  names, because a cgroup v2 group that holds processes cannot also
+ *  hand its controllers down to groups below it.
+ *
+ * \return
+ *      Returns an empty string if there is no cgroup v2 hierarchy.
+ */
+
+std::string
+placement::cgroup_directory () const
+{
+    if (m_cgroup.empty())
+        return std::string();
+
+    if (m_cgroup[0] == '/')
+        return std::string(s_cgroup_root) + m_cgroup;
+
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 3, "0::") == 0)
+        {
+            std::string own = line.substr(3);
+            std::size_t slash = own.find_last_of('/');
+            std::string parent = slash == std::string::npos ?
+                std::string() : own.substr(0, slash) ;
+
+            return std::string(s_cgroup_root) + parent + "/" + m_cgroup;
+        }
+    }
+    return std::string();
+}
+
+/**
+ *  Creates the cgroup if needed, enables the controllers its limits need
+ *  in the group above it (which fails harmlessly if they are enabled
+ *  already or cannot be), and writes the limits.  A limit that cannot be
+ *  written is reported, and the cgroup is used anyway.
+ *
+ * \return
+ *      Returns the directory of the cgroup, or an empty string if there is
+ *      none or it cannot be created.
+ */
+
+std::string
+placement::prepare_cgroup () const
+{
+    std::string dir = cgroup_directory();
+    if (dir.empty())
+    {
+        util::warn_message("No cgroup v2 hierarchy for", m_cgroup);
+        return dir;
+    }
+    if (! util::make_directory_path(dir, 0755))
+    {
+        util::warn_printf
+        (
+            "Cannot create cgroup %s: %s", V(dir), std::strerror(errno)
+        );
+        return std::string();
+    }
+
+    std::string parent = dir.substr(0, dir.find_last_of('/'));
+    std::string control = parent + "/cgroup.subtree_control";
+    if (m_cpu_weight > 0)
+    {
+        (void) write_text(control, "+cpu");
+        if (! write_text(dir + "/cpu.weight", std::to_string(m_cpu_weight)))
+        {
+            util::warn_printf
+            (
+                "Cannot set cpu.weight of %s: %s", V(dir), std::strerror(errno)
+            );
+        }
+    }
+    if (! m_memory_high.empty())
+    {
+        (void) write_text(control, "+memory");
+        if (! write_text(dir + "/memory.high", m_memory_high))
+        {
+            util::warn_printf
+            (
+                "Cannot set memory.high of %s: %s",
+                V(dir), std::strerror(errno)
+            );
+        }
+    }
+    return dir;
+}
+
+/*
+ *  Moves a running process into a cgroup made by prepare_cgroup().
+ */
+
+bool
+placement::move_to_cgroup (pid_t pid, const std::string & dir) const
+{
+    bool result = write_text(dir + "/cgroup.procs", std::to_string(pid));
+    if (! result)
+    {
+        util::warn_printf
+        (
+            "Cannot move PID %d to %s: %s",
+            int(pid), V(dir), std::strerror(errno)
+        );
+    }
+    return result;
+}
+
+}               // namespace nsmd
+
+/*
+ * placement.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,356 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          procsampler.cpp
+ *
+ *    This module implements the /proc sampling of the supervised processes.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <algorithm>                    /* std::sort()                      */
+#include <cstdio>                       /* std::snprintf(), std::sscanf()   */
+#include <cstring>                      /* std::strrchr(), std::strstr()    */
+#include <fcntl.h>                      /* open(), O_RDONLY, O_CLOEXEC      */
+#include <unistd.h>                     /* read(), close(), sysconf()       */
+
+#include "c_macros.h"                   /* V() macro                        */
+#include "nsmd/procsampler.hpp"         /* nsmd::proc_sampler class         */
+#include "util/strfunctions.hpp"        /* cfg66: util::string_asprintf()   */
+
+namespace nsmd
+{
+
+namespace   // anonymous
+{
+
+/*
+ *  Reads a small /proc file whole, as a null-terminated string.  The
+ *  files read here are far smaller than the buffers.
+ */
+
+bool
+read_proc (pid_t pid, const char * file, char * buffer, std::size_t size)
+{
+    char path [48];
+    (void) std::snprintf(path, sizeof path, "/proc/%d/%s", int(pid), file);
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    ssize_t count = ::read(fd, buffer, size - 1);
+    (void) ::close(fd);
+    if (count <= 0)
+        return false;
+
+    buffer[count] = 0;
+    return true;
+}
+
+}           // namespace anonymous
+
+proc_sampler::proc_sampler () :
+    m_processes         (),
+    m_ticks_per_second  (double(sysconf(_SC_CLK_TCK))),
+    m_page_kib          (sysconf(_SC_PAGESIZE) / 1024),
+    m_samples           (0)
+{
+    if (m_ticks_per_second <= 0.0)
+        m_ticks_per_second = 100.0;
+
+    if (m_page_kib <= 0)
+        m_page_kib = 4;
+}
+
+/**
+ *  Samples one process, adding it if it is new.
+ *
+ * \param pid
+ *      The process ID.
+ *
+ * \param name
+ *      The name reported for the process, e.g. "Carla.nABCD".
+ *
+ * \return
+ *      Returns false if the process could not be read, e.g. because it
+ *      has exited.
+ */
+
+bool
+proc_sampler::sample (pid_t pid, const std::string & name)
+{
+    unsigned long long ticks;
+    unsigned long majflt;
+    long rsspages;
+    if (! read_counters(pid, ticks, majflt, rsspages))
+        return false;
+
+    unsigned long long readbytes = 0;
+    unsigned long long writebytes = 0;
+    bool io = read_io(pid, readbytes, writebytes);
+    clock::time_point now = clock::now();
+    auto it = m_processes.find(pid);
+    if (it == m_processes.end() || it->second.p_name != name)
+    {
+        process p {};                   /* a new process, or a reused PID   */
+        p.p_name = name;
+        p.p_stamp = now;
+        p.p_ticks = ticks;
+        p.p_read_bytes = readbytes;
+        p.p_write_bytes = writebytes;
+        p.p_major_faults = majflt;
+        p.p_io = io;
+        p.p_seen = true;
+        m_processes[pid] = p;
+        return true;
+    }
+
+    process & p = it->second;
+    double seconds = std::chrono::duration<double>(now - p.p_stamp).count();
+    if (seconds <= 0.0)
+        seconds = 1.0e-6;
+
+    reading s {};
+    s.r_cpu_percent = 100.0 *
+        double(ticks - p.p_ticks) / m_ticks_per_second / seconds;
+
+    s.r_rss_kib = rsspages * m_page_kib;
+    s.r_major_faults = long(majflt - p.p_major_faults);
+    if (io && p.p_io)
+    {
+        s.r_read_kibps = double(readbytes - p.p_read_bytes) / 1024.0 / seconds;
+        s.r_write_kibps =
+            double(writebytes - p.p_write_bytes) / 1024.0 / seconds;
+    }
+    else
+        s.r_read_kibps = s.r_write_kibps = (-1.0);
+
+    p.p_window[p.p_next] = s;
+    p.p_next = (p.p_next + 1) % c_window;
+    if (p.p_count < c_window)
+        ++p.p_count;
+
+    p.p_stamp = now;
+    p.p_ticks = ticks;
+    p.p_read_bytes = readbytes;
+    p.p_write_bytes = writebytes;
+    p.p_major_faults = majflt;
+    p.p_io = io;
+    p.p_seen = true;
+    ++m_samples;
+    return true;
+}
+
+/**
+ *  Forgets the processes not sampled since the previous sweep.
+ */
+
+void
+proc_sampler::sweep ()
+{
+    for (auto it = m_processes.begin(); it != m_processes.end(); /* inside */)
+    {
+        if (it->second.p_seen)
+        {
+            it->second.p_seen = false;
+            ++it;
+        }
+        else
+            it = m_processes.erase(it);
+    }
+}
+
+/**
+ *  Gets the latest sample of a process.
+ *
+ * \return
+ *      Returns false if the process has no sample yet.
+ */
+
+bool
+proc_sampler::latest (pid_t pid, reading & s) const
+{
+    auto it = m_processes.find(pid);
+    bool result = it != m_processes.end() && it->second.p_count > 0;
+    if (result)
+    {
+        const process & p = it->second;
+        s = p.p_window[(p.p_next + c_window - 1) % c_window];
+    }
+    return result;
+}
+
+/**
+ *  Makes one line of text for a process, or an empty string if it has no
+ *  sample yet.
+ */
+
+std::string
+proc_sampler::summary (pid_t pid) const
+{
+    auto it = m_processes.find(pid);
+    if (it == m_processes.end() || it->second.p_count == 0)
+        return std::string();
+
+    return util::string_asprintf("%s pid=%d ", V(it->second.p_name), int(pid))
+        + summary(it->second);
+}
+
+/**
+ *  Makes one line of text per sampled process, sorted by name.
+ */
+
+std::vector<std::string>
+proc_sampler::report () const
+{
+    std::vector<std::string> result;
+    for (const auto & entry : m_processes)
+    {
+        std::string line = summary(entry.first);
+        if (! line.empty())
+            result.push_back(line);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/*
+ *  The latest values, with the mean and peak over the window.
+ */
+
+std::string
+proc_sampler::summary (const process & p) const
+{
+    const reading & last = p.p_window[(p.p_next + c_window - 1) % c_window];
+    double cpusum = 0.0;
+    double cpumax = 0.0;
+    long rssmax = 0;
+    double readsum = 0.0;
+    double writesum = 0.0;
+    long faults = 0;
+    for (int i = 0; i < p.p_count; ++i)
+    {
+        const reading & s = p.p_window[i];
+        cpusum += s.r_cpu_percent;
+        if (s.r_cpu_percent > cpumax)
+            cpumax = s.r_cpu_percent;
+
+        if (s.r_rss_kib > rssmax)
+            rssmax = s.r_rss_kib;
+
+        readsum += s.r_read_kibps;
+        writesum += s.r_write_kibps;
+        faults += s.r_major_faults;
+    }
+
+    double n = double(p.p_count);
+    std::string io = last.r_read_kibps < 0.0 ?
+        std::string("io=n/a") :
+        util::string_asprintf
+        (
+            "read=%.1f write=%.1f KiB/s", readsum / n, writesum / n
+        ) ;
+
+    return util::string_asprintf
+    (
+        "cpu=%.1f%% mean=%.1f%% max=%.1f%% rss=%ld max=%ld KiB %s "
+        "majflt=%ld n=%d",
+        last.r_cpu_percent, cpusum / n, cpumax, last.r_rss_kib, rssmax,
+        V(io), faults, p.p_count
+    );
+}
+
+/*
+ *  Gets the CPU ticks and major faults from /proc/<pid>/stat, and the
+ *  resident pages from /proc/<pid>/statm.  The command name in the stat
+ *  file can hold blanks and parentheses, so the fields are counted from
+ *  the last ')'.
+ */
+
+bool
+proc_sampler::read_counters
+(
+    pid_t pid,
+    unsigned long long & ticks,
+    unsigned long & majflt,
+    long & rsspages
+) const
+{
+    char buffer [1024];
+    if (! read_proc(pid, "stat", buffer, sizeof buffer))
+        return false;
+
+    const char * fields = std::strrchr(buffer, ')');
+    if (fields == nullptr)
+        return false;
+
+    unsigned long long utime;
+    unsigned long long stime;
+    int count = std::sscanf
+    (
+        fields + 1,
+        " %*c %*d %*d %*d %*d %*d %*u %*u %*u %lu %*u %llu %llu",
+        &majflt, &utime, &stime
+    );
+    if (count != 3)
+        return false;
+
+    ticks = utime + stime;
+    if (! read_proc(pid, "statm", buffer, sizeof buffer))
+        return false;
+
+    return std::sscanf(buffer, "%*d %ld", &rsspages) == 1;
+}
+
+/*
+ *  Gets the bytes read from and written to storage.
+ */
+
+bool
+proc_sampler::read_io
+(
+    pid_t pid,
+    unsigned long long & readbytes,
+    unsigned long long & writebytes
+) const
+{
+    char buffer [512];
+    if (! read_proc(pid, "io", buffer, sizeof buffer))
+        return false;
+
+    const char * r = std::strstr(buffer, "\nread_bytes:");
+    const char * w = std::strstr(buffer, "\nwrite_bytes:");
+    return
+        r != nullptr && w != nullptr &&
+        std::sscanf(r, " read_bytes: %llu", &readbytes) == 1 &&
+        std::sscanf(w, " write_bytes: %llu", &writebytes) == 1;
+}
+
+}               // namespace nsmd
+
+/*
+ * procsampler.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,224 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          runtimestats.cpp
+ *
+ *    This module implements the runtime statistics of nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cmath>                        /* std::ceil(), std::ldexp()        */
+
+#include "runtimestats.hpp"             /* nsmd::runtime_stats class        */
+#include "util/strfunctions.hpp"        /* cfg66: util::string_asprintf()   */
+
+namespace nsmd
+{
+
+/*-------------------------------------------------------------------------
+ * histogram
+ *-------------------------------------------------------------------------*/
+
+histogram::histogram () :
+    m_buckets       (),
+    m_count         (0),
+    m_sum_ms        (0.0),
+    m_min_ms        (0.0),
+    m_max_ms        (0.0)
+{
+    m_buckets.fill(0);
+}
+
+void
+histogram::add (double ms)
+{
+    if (ms < 0.0)
+        ms = 0.0;
+
+    unsigned long us = (unsigned long)(ms * 1000.0);
+    int b = 0;
+    while (us > 0 && b < c_buckets - 1)
+    {
+        us >>= 1;
+        ++b;
+    }
+    ++m_buckets[b];
+    if (m_count == 0 || ms < m_min_ms)
+        m_min_ms = ms;
+
+    if (m_count == 0 || ms > m_max_ms)
+        m_max_ms = ms;
+
+    ++m_count;
+    m_sum_ms += ms;
+}
+
+/**
+ *  Gets the upper bound, in milliseconds, of the bucket that holds the
+ *  given fraction (0 to 1) of the samples.  It is never more than the
+ *  largest sample.
+ */
+
+double
+histogram::percentile_ms (double p) const
+{
+    if (m_count == 0)
+        return 0.0;
+
+    long rank = long(std::ceil(p * m_count));
+    if (rank < 1)
+        rank = 1;
+
+    long seen = 0;
+    for (int b = 0; b < c_buckets; ++b)
+    {
+        seen += m_buckets[b];
+        if (seen >= rank)
+        {
+            double bound = std::ldexp(1.0, b) / 1000.0;
+            return bound < m_max_ms ? bound : m_max_ms ;
+        }
+    }
+    return m_max_ms;
+}
+
+std::string
+histogram::summary () const
+{
+    return util::string_asprintf
+    (
+        "n=%ld mean=%.2f min=%.2f p50<=%.2f p90<=%.2f p99<=%.2f max=%.2f ms",
+        m_count, mean_ms(), m_min_ms, percentile_ms(0.50),
+        percentile_ms(0.90), percentile_ms(0.99), m_max_ms
+    );
+}
+
+/*-------------------------------------------------------------------------
+ * runtime_stats
+ *-------------------------------------------------------------------------*/
+
+runtime_stats::runtime_stats () :
+    m_commands      (),
+    m_clients       (),
+    m_handlers      ()
+{
+    // no code
+}
+
+/**
+ *  Records one client latency.
+ *
+ * \param client
+ *      The client's name with ID, e.g. "Carla.nABCD".
+ *
+ * \param kind
+ *      "announce", "save", "open", "switch", or "quit".
+ *
+ * \param ms
+ *      The latency in milliseconds.
+ */
+
+void
+runtime_stats::latency
+(
+    const std::string & client,
+    const std::string & kind,
+    double ms
+)
+{
+    m_commands[kind].add(ms);
+    m_clients[client][kind].add(ms);
+}
+
+/**
+ *  Records the time spent in the OSC method handler of a path.
+ */
+
+void
+runtime_stats::handled (const std::string & path, double ms)
+{
+    m_handlers[path].add(ms);
+}
+
+/**
+ *  Makes one line of text per histogram: first all clients together by
+ *  kind, then each client by kind, then each OSC path.
+ */
+
+std::vector<std::string>
+runtime_stats::report () const
+{
+    std::vector<std::string> result;
+    for (const auto & k : m_commands)
+    {
+        result.push_back
+        (
+            util::string_asprintf
+            (
+                "all %s: %s", k.first.c_str(), k.second.summary().c_str()
+            )
+        );
+    }
+    for (const auto & c : m_clients)
+    {
+        for (const auto & k : c.second)
+        {
+            result.push_back
+            (
+                util::string_asprintf
+                (
+                    "client %s %s: %s", c.first.c_str(), k.first.c_str(),
+                    k.second.summary().c_str()
+                )
+            );
+        }
+    }
+    for (const auto & h : m_handlers)
+    {
+        result.push_back
+        (
+            util::string_asprintf
+            (
+                "osc %s: %s", h.first.c_str(), h.second.summary().c_str()
+            )
+        );
+    }
+    return result;
+}
+
+void
+runtime_stats::clear ()
+{
+    m_commands.clear();
+    m_clients.clear();
+    m_handlers.clear();
+}
+
+}               // namespace nsmd
+
+/*
+ * runtimestats.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,439 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionindex.cpp
+ *
+ *    This module implements the session index of nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ *
+ *  The fts code came from the old OSC_HANDLER( list ), but errors are now
+ *  logged and survived instead of calling exit().
+ */
+
+#include <cerrno>                       /* errno, EAGAIN                    */
+#include <cstring>                      /* std::strcmp(), std::strerror()   */
+#include <fts.h>                        /* function to traverse directories */
+#include <sys/inotify.h>                /* inotify_init1(), etc.            */
+#include <unistd.h>                     /* close(), read()                  */
+
+#include "sessionindex.hpp"             /* nsmd::session_index class        */
+#include "util/msgfunctions.hpp"        /* cfg66: util::error_message()     */
+
+namespace nsmd
+{
+
+/**
+ *  The events of interest on a watched directory.
+ */
+
+static const uint32_t c_watch_mask =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+/**
+ *  The fts comparator orders files before directories. The walk depends
+ *  on that: the session file of a directory is seen before any of its
+ *  sub-directories, which can then be skipped.  The fts_info field is
+ *  an enumeration, not a bit-mask, so it is compared with "==", not "&".
+ */
+
+static int
+fts_comparer_to_process_files_before_dirs
+(
+    const FTSENT ** first,
+    const FTSENT ** second
+)
+{
+    if ((*first)->fts_info == FTS_F)
+        return (-1);                                /* first    */
+    else if ((*second)->fts_info == FTS_F)
+        return 1;                                   /* last     */
+    else
+        return std::strcmp((*first)->fts_name, (*second)->fts_name);
+}
+
+static std::string
+join_path (const std::string & reldir, const std::string & name)
+{
+    return reldir.empty() ? name : reldir + "/" + name ;
+}
+
+session_index::session_index () :
+    m_root          (),
+    m_session_file  (),
+    m_sessions      (),
+    m_inotify_fd    (-1),
+    m_watches       (),
+    m_watch_ids     ()
+{
+    // no code
+}
+
+session_index::~session_index ()
+{
+    if (m_inotify_fd >= 0)
+        close(m_inotify_fd);
+}
+
+/**
+ *  Walks the session root and starts watching it.  If inotify is not
+ *  available, descriptor() returns -1 and the caller should rebuild()
+ *  before each use.
+ *
+ * \return
+ *      Returns false if the walk failed; the index then holds whatever
+ *      was found before the failure.
+ */
+
+bool
+session_index::build
+(
+    const std::string & root,
+    const std::string & sessionfile
+)
+{
+    m_root = root;
+    m_session_file = sessionfile;
+    if (m_inotify_fd < 0)
+    {
+        m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify_fd < 0)
+        {
+            util::warn_message
+            (
+                "inotify_init1() failed, sessions rescanned per list",
+                std::strerror(errno)
+            );
+        }
+    }
+    return rebuild();
+}
+
+bool
+session_index::rebuild ()
+{
+    clear();
+    return scan("");
+}
+
+void
+session_index::clear ()
+{
+    if (m_inotify_fd >= 0)
+    {
+        for (const auto & w : m_watches)
+            (void) inotify_rm_watch(m_inotify_fd, w.first);
+    }
+    m_watches.clear();
+    m_watch_ids.clear();
+    m_sessions.clear();
+}
+
+std::string
+session_index::full_path (const std::string & reldir) const
+{
+    return reldir.empty() ? m_root : m_root + "/" + reldir ;
+}
+
+/**
+ *  Converts a full path below the root to the relative form used in the
+ *  index.
+ *
+ * \return
+ *      Returns an empty string for the root itself or for a path that is
+ *      not below the root.
+ */
+
+std::string
+session_index::relative (const std::string & fullpath) const
+{
+    std::string result;
+    std::string::size_type rootlen = m_root.length();
+    bool below =
+        fullpath.length() > rootlen + 1 &&
+        fullpath.compare(0, rootlen, m_root) == 0 && fullpath[rootlen] == '/';
+
+    if (below)
+        result = fullpath.substr(rootlen + 1);
+
+    return result;
+}
+
+void
+session_index::add (const std::string & relpath)
+{
+    if (! relpath.empty())
+        (void) m_sessions.insert(relpath);
+}
+
+void
+session_index::remove (const std::string & relpath)
+{
+    (void) m_sessions.erase(relpath);
+}
+
+/**
+ *  Walks one directory tree, adding its sessions and watching each
+ *  directory that is not below a session.
+ */
+
+bool
+session_index::scan (const std::string & reldir)
+{
+    std::string top = full_path(reldir);
+    char * const paths [] = { &top[0], nullptr };
+    FTS * ftsp = fts_open
+    (
+        paths, FTS_LOGICAL | FTS_NOCHDIR,
+        fts_comparer_to_process_files_before_dirs
+    );
+    if (ftsp == NULL)
+    {
+        util::error_message("fts_open() failed", top);
+        return false;
+    }
+
+    bool result = true;
+    FTSENT * currentsession = NULL;
+    for (;;)
+    {
+        errno = 0;
+        FTSENT * ent = fts_read(ftsp);  /* get next item; file or directory */
+        if (ent == NULL)
+        {
+            if (errno != 0)
+            {
+                util::error_message("fts_read() failed", std::strerror(errno));
+                result = false;
+            }
+            break;
+        }
+        if (ent->fts_info == FTS_D)
+        {
+            if (currentsession != NULL)
+                (void) fts_set(ftsp, ent, FTS_SKIP);    /* no descendants   */
+            else
+                watch(relative(ent->fts_path));
+        }
+        else if (ent->fts_info == FTS_DP)
+        {
+            if (ent == currentsession)
+                currentsession = NULL;
+        }
+        else if (ent->fts_info == FTS_F)
+        {
+            if (m_session_file == ent->fts_name)
+            {
+                /*
+                 * The path buffer is shared; the parent's path is only
+                 * the first fts_pathlen bytes of it.
+                 */
+
+                const FTSENT * parent = ent->fts_parent;
+                std::string dir(parent->fts_path, parent->fts_pathlen);
+                add(relative(dir));
+                currentsession = ent->fts_parent;
+            }
+        }
+        else if (ent->fts_info == FTS_DNR || ent->fts_info == FTS_ERR)
+        {
+            util::warn_message
+            (
+                "Cannot read", std::string(ent->fts_path) + ": " +
+                std::strerror(ent->fts_errno)
+            );
+        }
+    }
+    if (fts_close(ftsp) == (-1))
+        util::error_message("fts_close() failed");
+
+    return result;
+}
+
+void
+session_index::watch (const std::string & reldir)
+{
+    if (m_inotify_fd < 0 || m_watch_ids.find(reldir) != m_watch_ids.end())
+        return;
+
+    std::string dir = full_path(reldir);
+    int wd = inotify_add_watch(m_inotify_fd, dir.c_str(), c_watch_mask);
+    if (wd >= 0)
+    {
+        m_watches[wd] = reldir;
+        m_watch_ids[reldir] = wd;
+    }
+    else
+    {
+        util::warn_message
+        (
+            "inotify_add_watch() failed", reldir + ": " + std::strerror(errno)
+        );
+    }
+}
+
+/**
+ *  Drops a directory that was removed or moved away: its session, the
+ *  sessions below it, and their watches.
+ */
+
+void
+session_index::forget (const std::string & reldir)
+{
+    std::string prefix = reldir + "/";
+    auto si = m_sessions.lower_bound(reldir);
+    while (si != m_sessions.end())
+    {
+        bool below =
+            *si == reldir || si->compare(0, prefix.length(), prefix) == 0;
+
+        if (below)
+            si = m_sessions.erase(si);
+        else if (*si > prefix)
+            break;
+        else
+            ++si;
+    }
+    unwatch(reldir, true);
+}
+
+/**
+ *  Removes the watches of the directories below a directory, and of the
+ *  directory itself if \a self is true.
+ */
+
+void
+session_index::unwatch (const std::string & reldir, bool self)
+{
+    std::string prefix = reldir + "/";
+    for (auto wi = m_watch_ids.begin(); wi != m_watch_ids.end(); /* ++wi */)
+    {
+        const std::string & d = wi->first;
+        bool below = d.compare(0, prefix.length(), prefix) == 0;
+        if (below || (self && d == reldir))
+        {
+            (void) inotify_rm_watch(m_inotify_fd, wi->second);
+            m_watches.erase(wi->second);
+            wi = m_watch_ids.erase(wi);
+        }
+        else
+            ++wi;
+    }
+}
+
+/**
+ *  Reads all pending inotify events.
+ *
+ *      -   A new directory (created or moved in) is scanned, unless it is
+ *          inside a session.
+ *      -   A directory removed or moved away is forgotten.
+ *      -   A session file created or moved in adds its directory, and one
+ *          removed or moved away removes it.  A directory can arrive
+ *          before its session file, e.g. when a session is duplicated, so
+ *          its sub-directories were watched by the scan; as they are now
+ *          inside a session, those watches are removed.
+ *      -   An event-queue overflow rebuilds the whole index.
+ */
+
+void
+session_index::handle_events ()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;)
+    {
+        ssize_t len = read(m_inotify_fd, buffer, sizeof buffer);
+        if (len <= 0)
+            break;                              /* EAGAIN: all events read  */
+
+        bool overflow = false;
+        for (char * p = buffer; p < buffer + len; )
+        {
+            const struct inotify_event * ev =
+                reinterpret_cast<const struct inotify_event *>(p);
+
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+
+            auto wi = m_watches.find(ev->wd);
+            if (wi == m_watches.end())
+                continue;
+
+            std::string reldir = wi->second;
+            if (ev->mask & IN_IGNORED)
+            {
+                m_watch_ids.erase(reldir);
+                m_watches.erase(wi);
+                continue;
+            }
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                if (reldir.empty())
+                    util::warn_message("Session root removed", m_root);
+
+                continue;
+            }
+            if (ev->len == 0)
+                continue;
+
+            std::string name = ev->name;
+            bool arrived = (ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+            bool departed = (ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+            if (ev->mask & IN_ISDIR)
+            {
+                std::string child = join_path(reldir, name);
+                if (arrived && ! contains(reldir))
+                    (void) scan(child);
+                else if (departed)
+                    forget(child);
+            }
+            else if (name == m_session_file)
+            {
+                if (arrived)
+                {
+                    add(reldir);
+                    unwatch(reldir, false);
+                }
+                else if (departed)
+                    remove(reldir);
+            }
+        }
+        if (overflow)
+        {
+            util::warn_message("inotify queue overflow, rescanning", m_root);
+            (void) rebuild();
+        }
+    }
+}
+
+}               // namespace nsmd
+
+/*
+ * sessionindex.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
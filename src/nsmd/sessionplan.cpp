@@ -0,0 +1,287 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionplan.cpp
+ *
+ *    This module implements the parsing of session.nsm and the start
+ *    tiers of its clients.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <algorithm>                    /* std::max()                       */
+#include <cstdlib>                      /* std::atoi()                      */
+#include <functional>                   /* std::function<>                  */
+#include <fstream>                      /* std::ifstream                    */
+#include <map>                          /* std::map<>                       */
+
+#include "sessionplan.hpp"              /* nsmd::session_plan class         */
+#include "util/msgfunctions.hpp"        /* cfg66: util::warn_message()      */
+
+namespace nsmd
+{
+
+session_plan::session_plan () :
+    m_entries       ()
+{
+    // no code
+}
+
+/**
+ *  Reads the session file, replacing the entries.
+ *
+ * \return
+ *      Returns true if the file could be read and held at least one
+ *      client.
+ */
+
+bool
+session_plan::read (const std::string & sessionfile)
+{
+    m_entries.clear();
+
+    std::ifstream file(sessionfile);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        entry e;
+        if (parse_line(line, e))
+            m_entries.push_back(e);
+        else if (line.find_first_not_of(" \t\r") != std::string::npos)
+            util::warn_message("Bad session line", line);
+    }
+    return ! m_entries.empty();
+}
+
+/**
+ *  Splits "name:exe:id[:attributes]".  The name cannot hold a colon,
+ *  and neither can the ID, but the executable can.
+ */
+
+bool
+session_plan::parse_line (const std::string & line, entry & e)
+{
+    std::string text = line;
+    if (! text.empty() && text.back() == '\r')
+        text.pop_back();
+
+    std::size_t first = text.find_first_of(':');
+    std::size_t last = text.find_last_of(':');
+    if (first == std::string::npos || first == last)
+        return false;
+
+    std::string attributes;
+    if (text.find_first_of('=', last) != std::string::npos)
+    {
+        attributes = text.substr(last + 1);
+        text.erase(last);
+        last = text.find_last_of(':');
+        if (first == last)
+            return false;
+    }
+    e.se_name = text.substr(0, first);
+    e.se_exe = text.substr(first + 1, last - first - 1);
+    e.se_id = text.substr(last + 1);
+    e.se_attributes = attributes;
+    return ! e.se_name.empty() && ! e.se_exe.empty() && ! e.se_id.empty();
+}
+
+/**
+ *  Gets every value of a key in a comma-separated attribute list.
+ */
+
+std::vector<std::string>
+session_plan::attribute_values
+(
+    const std::string & attributes,
+    const std::string & key
+)
+{
+    std::vector<std::string> result;
+    std::size_t pos = 0;
+    while (pos <= attributes.size())
+    {
+        std::size_t comma = attributes.find_first_of(',', pos);
+        if (comma == std::string::npos)
+            comma = attributes.size();
+
+        std::string item = attributes.substr(pos, comma - pos);
+        std::size_t equal = item.find_first_of('=');
+        if (equal != std::string::npos && item.substr(0, equal) == key)
+            result.push_back(item.substr(equal + 1));
+
+        pos = comma + 1;
+    }
+    return result;
+}
+
+/**
+ *  A session is tiered if any of its clients has a start attribute.
+ */
+
+bool
+session_plan::is_tiered (const entry_list & entries)
+{
+    for (const auto & e : entries)
+    {
+        if
+        (
+            ! attribute_values(e.se_attributes, "tier").empty() ||
+            ! attribute_values(e.se_attributes, "after").empty()
+        )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+is_jackpatch (const session_plan::entry & e)
+{
+    std::size_t slash = e.se_exe.find_last_of('/');
+    std::string base = slash == std::string::npos ?
+        e.se_exe : e.se_exe.substr(slash + 1) ;
+
+    return base.compare(0, 9, "jackpatch") == 0;
+}
+
+/**
+ *  Works out the start tiers.  The level of a client is the larger of its
+ *  "tier" and one more than the level of each client it starts "after".
+ *  The levels are found depth-first along the "after" edges.  An edge
+ *  that closes a cycle is reported and dropped, so that the clients of
+ *  the cycle keep the order of their other edges.  A jackpatch client
+ *  goes last only if no other client starts after it.  Empty levels are
+ *  dropped.
+ */
+
+session_plan::tier_list
+session_plan::tiers (const entry_list & entries)
+{
+    tier_list result;
+    if (entries.empty())
+        return result;
+
+    if (! is_tiered(entries))
+    {
+        std::vector<std::size_t> all;
+        for (std::size_t i = 0; i < entries.size(); ++i)
+            all.push_back(i);
+
+        result.push_back(all);
+        return result;
+    }
+
+    std::map<std::string, std::size_t> byid;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        byid[entries[i].se_id] = i;
+
+    std::vector<int> level(entries.size(), 0);
+    std::vector<std::vector<std::size_t>> after(entries.size());
+    std::vector<bool> last(entries.size(), false);
+    std::vector<bool> needed(entries.size(), false);
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        const entry & e = entries[i];
+        for (const auto & t : attribute_values(e.se_attributes, "tier"))
+            level[i] = std::max(level[i], std::max(std::atoi(t.c_str()), 0));
+
+        for (const auto & id : attribute_values(e.se_attributes, "after"))
+        {
+            auto it = byid.find(id);
+            if (it == byid.end())
+                util::warn_message("Start after unknown client", id);
+            else if (it->second != i)
+            {
+                after[i].push_back(it->second);
+                needed[it->second] = true;
+            }
+        }
+        last[i] =
+            attribute_values(e.se_attributes, "tier").empty() &&
+            attribute_values(e.se_attributes, "after").empty() &&
+            is_jackpatch(e);
+    }
+
+    enum class mark { unvisited, visiting, done };
+    std::vector<mark> state(entries.size(), mark::unvisited);
+    std::function<void (std::size_t)> visit = [&] (std::size_t i)
+    {
+        state[i] = mark::visiting;
+        for (std::size_t d : after[i])
+        {
+            if (state[d] == mark::visiting)
+            {
+                util::warn_message
+                (
+                    "Start dependency cycle; dropped",
+                    entries[i].se_id + " after " + entries[d].se_id
+                );
+                continue;
+            }
+            if (state[d] == mark::unvisited)
+                visit(d);
+
+            level[i] = std::max(level[i], level[d] + 1);
+        }
+        state[i] = mark::done;
+    };
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        if (needed[i])
+            last[i] = false;
+
+        if (state[i] == mark::unvisited)
+            visit(i);
+    }
+
+    int top = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        if (! last[i])
+            top = std::max(top, level[i]);
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        if (last[i])
+            level[i] = top + 1;
+    }
+
+    std::map<int, std::vector<std::size_t>> bylevel;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        bylevel[level[i]].push_back(i);
+
+    for (const auto & lv : bylevel)
+        result.push_back(lv.second);
+
+    return result;
+}
+
+}               // namespace nsmd
+
+/*
+ * sessionplan.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
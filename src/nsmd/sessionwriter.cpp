@@ -0,0 +1,259 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          sessionwriter.cpp
+ *
+ *    This module implements the writer of session.nsm files.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cerrno>                       /* errno                            */
+#include <cstdio>                       /* std::rename()                    */
+#include <cstring>                      /* std::strerror()                  */
+#include <fcntl.h>                      /* open(), O_WRONLY, etc.           */
+#include <sys/stat.h>                   /* stat(), fchmod()                 */
+#include <unistd.h>                     /* access(), fsync(), write()       */
+
+#include "sessionwriter.hpp"            /* nsmd::session_writer class       */
+#include "util/msgfunctions.hpp"        /* cfg66: util::error_message()     */
+
+namespace nsmd
+{
+
+session_writer::session_writer () :
+    m_fsync         (false),
+    m_file          (),
+    m_have_hash     (false),
+    m_hash          (0),
+    m_size          (0),
+    m_mtime         (),
+    m_writes        (0),
+    m_skips         (0),
+    m_failures      (0),
+    m_bytes_written (0)
+{
+    // no code
+}
+
+/**
+ *  The 64-bit FNV-1a hash. The session file is small, and this is only
+ *  used to detect a change, so nothing stronger is needed.
+ */
+
+std::uint64_t
+session_writer::hash (const std::string & text)
+{
+    std::uint64_t result = 14695981039346656037ULL;
+    for (unsigned char c : text)
+    {
+        result ^= c;
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+/**
+ *  Writes the session file, unless it already holds this text.
+ *
+ * \return
+ *      Returns true if the file now holds the text, whether written or
+ *      not.  Returns false if the file is write-protected or could not be
+ *      replaced.
+ */
+
+bool
+session_writer::write (const std::string & filename, const std::string & text)
+{
+    std::uint64_t h = hash(text);
+    if (unchanged(filename, h))
+    {
+        ++m_skips;
+        return true;
+    }
+
+    const char * fname = filename.c_str();
+    if (access(fname, F_OK) == 0 && access(fname, W_OK) != 0)
+    {
+        util::warn_message("Session file is write-protected", filename);
+        ++m_failures;
+        return false;
+    }
+
+    bool result = replace(filename, text);
+    if (result)
+    {
+        ++m_writes;
+        m_bytes_written += text.size();
+        remember(filename, h);
+    }
+    else
+        ++m_failures;
+
+    return result;
+}
+
+/**
+ *  Checks the file against the hash. The hash of the file is known if we
+ *  wrote (or read) it last and its size and time did not change since;
+ *  otherwise the file is read again, which also covers the first save
+ *  after a session was opened.
+ */
+
+bool
+session_writer::unchanged (const std::string & filename, std::uint64_t h)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+    {
+        m_have_hash = false;
+        return false;
+    }
+
+    bool known =
+        m_have_hash && filename == m_file && st.st_size == m_size &&
+        st.st_mtim.tv_sec == m_mtime.tv_sec &&
+        st.st_mtim.tv_nsec == m_mtime.tv_nsec;
+
+    if (! known)
+    {
+        m_have_hash = false;
+
+        int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        std::string text;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof buffer)) > 0)
+            text.append(buffer, std::size_t(n));
+
+        close(fd);
+        if (n < 0)
+            return false;
+
+        remember(filename, hash(text));
+    }
+    return m_have_hash && m_hash == h;
+}
+
+/**
+ *  Writes a temporary file next to the session file and renames it into
+ *  place. The temporary file gets the mode of the file it replaces.
+ */
+
+bool
+session_writer::replace (const std::string & filename, const std::string & text)
+{
+    std::string temp = filename + ".tmp";
+    struct stat st;
+    bool keepmode = stat(filename.c_str(), &st) == 0;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd = open(temp.c_str(), flags, 0666);
+    if (fd < 0)
+    {
+        util::error_message
+        (
+            "Cannot create", temp + ": " + std::strerror(errno)
+        );
+        return false;
+    }
+    if (keepmode)
+        (void) fchmod(fd, st.st_mode & 07777);
+
+    bool result = true;
+    const char * p = text.data();
+    std::size_t remaining = text.size();
+    while (result && remaining > 0)
+    {
+        ssize_t n = ::write(fd, p, remaining);
+        if (n < 0)
+        {
+            if (errno != EINTR)
+                result = false;
+        }
+        else
+        {
+            p += n;
+            remaining -= std::size_t(n);
+        }
+    }
+    if (result && m_fsync && fsync(fd) != 0)
+        result = false;
+
+    if (close(fd) != 0)
+        result = false;
+
+    if (result && std::rename(temp.c_str(), filename.c_str()) != 0)
+        result = false;
+
+    if (! result)
+    {
+        util::error_message
+        (
+            "Cannot write", filename + ": " + std::strerror(errno)
+        );
+        (void) unlink(temp.c_str());
+    }
+    else if (m_fsync)
+    {
+        /*
+         * The rename is only durable once the directory is flushed.
+         */
+
+        std::string::size_type slash = filename.find_last_of('/');
+        std::string dir = slash == std::string::npos ?
+            std::string(".") : filename.substr(0, slash) ;
+
+        int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0)
+        {
+            (void) fsync(dfd);
+            close(dfd);
+        }
+    }
+    return result;
+}
+
+void
+session_writer::remember (const std::string & filename, std::uint64_t h)
+{
+    struct stat st;
+    m_have_hash = stat(filename.c_str(), &st) == 0;
+    if (m_have_hash)
+    {
+        m_file = filename;
+        m_hash = h;
+        m_size = st.st_size;
+        m_mtime = st.st_mtim;
+    }
+}
+
+}               // namespace nsmd
+
+/*
+ * sessionwriter.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,396 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          spawner.cpp
+ *
+ *    This module implements the starting of the client processes.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cerrno>                       /* errno, ENOSYS                    */
+#include <cstring>                      /* std::strerror(), std::memset()   */
+#include <fcntl.h>                      /* open(), O_DIRECTORY, O_CLOEXEC   */
+#include <pthread.h>                    /* pthread_sigmask(), affinity      */
+#include <sched.h>                      /* cpu_set_t, sched_setscheduler()  */
+#include <signal.h>                     /* sigset_t, sigdelset()            */
+#include <spawn.h>                      /* posix_spawnp()                   */
+#include <sys/resource.h>               /* setpriority()                    */
+#include <sys/syscall.h>                /* SYS_clone3                       */
+#include <sys/wait.h>                   /* waitpid()                        */
+#include <unistd.h>                     /* syscall(), pipe2(), execvpe()    */
+
+#if defined __linux__
+#include <linux/sched.h>                /* struct clone_args                */
+#endif
+
+#if defined SYS_clone3 && defined CLONE_INTO_CGROUP
+#define NSMD_HAVE_CLONE3
+#endif
+
+#include "placement.hpp"                /* nsmd::placement class            */
+#include "spawner.hpp"                  /* nsmd::spawner class              */
+#include "util/msgfunctions.hpp"        /* cfg66: util::warn_message()      */
+
+extern char ** environ;
+
+namespace nsmd
+{
+
+#if defined NSMD_HAVE_CLONE3
+
+namespace   // anonymous
+{
+
+/*
+ *  What the child of clone_placed() failed to do, sent back on a pipe.
+ */
+
+enum child_step
+{
+    step_exec,
+    step_cpus,
+    step_sched,
+    step_nice
+};
+
+using child_report = struct
+{
+    int cr_step;
+    int cr_error;
+};
+
+/*
+ *  Called in the child, so only async-signal-safe calls are made.
+ */
+
+void
+report_step (int fd, int step)
+{
+    child_report r { step, errno };
+    ssize_t count = ::write(fd, &r, sizeof r);
+    (void) count;
+}
+
+}           // namespace anonymous
+
+#endif      // defined NSMD_HAVE_CLONE3
+
+spawner::spawner () :
+    m_error     (0),
+    m_spawned   (0),
+    m_failures  (0)
+{
+    // no code
+}
+
+/**
+ *  Starts a process.
+ *
+ * \param executable
+ *      The program, looked up in PATH if it has no slash.  It is also
+ *      the only argument.
+ *
+ * \param env
+ *      The variables to change in the daemon's environment for the child.
+ *
+ * \param where
+ *      The CPUs, scheduling class, nice value, and cgroup of the child, if
+ *      not null.  They are set before the exec if clone3() is available,
+ *      otherwise the CPUs are, and the rest once the child runs.  A
+ *      placement that fails is reported, but does not stop the start.
+ *
+ * \return
+ *      Returns the PID of the child, or 0 if it could not be started, in
+ *      which case error() and error_message() tell why.
+ */
+
+pid_t
+spawner::spawn
+(
+    const std::string & executable,
+    const environment & env,
+    const placement * where
+)
+{
+    std::vector<std::string> variables;
+    for (char ** e = environ; e != nullptr && *e != nullptr; ++e)
+    {
+        std::string variable { *e };
+        bool replaced = false;
+        for (const auto & v : env)
+        {
+            std::size_t n = v.first.size();
+            if (variable.compare(0, n, v.first) == 0 && variable[n] == '=')
+            {
+                replaced = true;
+                break;
+            }
+        }
+        if (! replaced)
+            variables.push_back(variable);
+    }
+    for (const auto & v : env)
+    {
+        if (! v.second.empty())
+            variables.push_back(v.first + "=" + v.second);
+    }
+
+    std::vector<char *> envp;
+    for (auto & v : variables)
+        envp.push_back(&v[0]);
+
+    envp.push_back(nullptr);
+
+    std::string program { executable };
+    char * const argv [] = { &program[0], nullptr };
+
+    /*
+     * nsmd blocks SIGCHLD for its signalfd; the client must get it.  The
+     * other blocked signals stay blocked, as they did after fork().
+     */
+
+    sigset_t mask;
+    pthread_sigmask(SIG_BLOCK, nullptr, &mask);
+    sigdelset(&mask, SIGCHLD);
+
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGPIPE);
+
+    pid_t pid = 0;
+    bool placed = false;
+    if (where != nullptr && ! where->empty())
+        pid = clone_placed(argv, envp.data(), mask, *where, placed);
+
+    if (placed)
+    {
+        if (pid > 0)
+            ++m_spawned;
+        else
+            ++m_failures;
+
+        return pid;
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags
+    (
+        &attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF
+    );
+
+    /*
+     * The child inherits the CPU set of the thread that spawns it.
+     */
+
+    cpu_set_t saved, cpus;
+    bool pinned = false;
+    if (where != nullptr && where->cpu_set(cpus))
+    {
+        pthread_t self = pthread_self();
+        pinned =
+            pthread_getaffinity_np(self, sizeof saved, &saved) == 0 &&
+            pthread_setaffinity_np(self, sizeof cpus, &cpus) == 0;
+
+        if (! pinned)
+            util::warn_message("Cannot set the CPUs of", executable);
+    }
+
+    m_error = posix_spawnp
+    (
+        &pid, program.c_str(), nullptr, &attr, argv, envp.data()
+    );
+    posix_spawnattr_destroy(&attr);
+    if (pinned)
+        (void) pthread_setaffinity_np(pthread_self(), sizeof saved, &saved);
+
+    if (m_error == 0)
+    {
+        ++m_spawned;
+        if (where != nullptr)
+            (void) where->apply(pid);           /* late, see clone_placed() */
+    }
+    else
+    {
+        ++m_failures;
+        pid = 0;
+    }
+    return pid;
+}
+
+/*
+ *  Starts a placed child with clone3(), in its cgroup, and has it set its
+ *  own CPUs, scheduling class, and nice value before its exec.  As it is
+ *  done in the child, the policy is not limited to the ones that
+ *  posix_spawnattr_setschedpolicy() takes, which leaves out SCHED_BATCH
+ *  and SCHED_IDLE.  CLONE_VFORK holds the daemon until the exec, like
+ *  posix_spawnp(), but without CLONE_VM the page tables are copied, so
+ *  this path is only taken for a client with a placement.  The child
+ *  reports its failures on a close-on-exec pipe: a failed exec is an
+ *  error of the spawn, the others are warnings.
+ *
+ * \param [out] placed
+ *      Set to true if the child was cloned, whether or not its exec
+ *      worked.  If false, the caller starts it with posix_spawnp().
+ */
+
+pid_t
+spawner::clone_placed
+(
+    char * const argv [],
+    char * const envp [],
+    const sigset_t & mask,
+    const placement & where,
+    bool & placed
+)
+{
+    placed = false;
+#if defined NSMD_HAVE_CLONE3
+    int cgroupfd = (-1);
+    if (where.has_cgroup())
+    {
+        std::string dir = where.prepare_cgroup();
+        if (! dir.empty())
+            cgroupfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    int fds [2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+    {
+        if (cgroupfd >= 0)
+            ::close(cgroupfd);
+
+        return 0;
+    }
+
+    cpu_set_t cpus;
+    bool pincpus = where.cpu_set(cpus);
+    struct clone_args args;
+    std::memset(&args, 0, sizeof args);
+    args.flags = CLONE_VFORK;
+    args.exit_signal = SIGCHLD;
+    if (cgroupfd >= 0)
+    {
+        args.flags |= CLONE_INTO_CGROUP;
+        args.cgroup = __u64(cgroupfd);
+    }
+
+    long rc = syscall(SYS_clone3, &args, sizeof args);
+    if (rc == 0)
+    {
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof sa);
+        sa.sa_handler = SIG_DFL;
+        (void) sigaction(SIGCHLD, &sa, nullptr);
+        (void) sigaction(SIGPIPE, &sa, nullptr);
+        (void) sigprocmask(SIG_SETMASK, &mask, nullptr);
+        ::close(fds[0]);
+        if (pincpus && sched_setaffinity(0, sizeof cpus, &cpus) != 0)
+            report_step(fds[1], step_cpus);
+
+        if (where.has_policy())
+        {
+            struct sched_param param;
+            param.sched_priority = 0;
+            if (sched_setscheduler(0, where.policy(), &param) != 0)
+                report_step(fds[1], step_sched);
+        }
+        if (where.has_nice())
+        {
+            if (setpriority(PRIO_PROCESS, 0, where.nice_value()) != 0)
+                report_step(fds[1], step_nice);
+        }
+        execvpe(argv[0], argv, envp);
+        report_step(fds[1], step_exec);
+        _exit(c_exec_failed);
+    }
+
+    int error = errno;
+    ::close(fds[1]);
+    if (cgroupfd >= 0)
+        ::close(cgroupfd);
+
+    pid_t pid = 0;
+    if (rc > 0)
+    {
+        placed = true;
+        pid = pid_t(rc);
+        m_error = 0;
+
+        child_report r;
+        while (::read(fds[0], &r, sizeof r) == ssize_t(sizeof r))
+        {
+            const char * what = r.cr_step == step_cpus ? "CPUs" :
+                r.cr_step == step_sched ? "scheduling class" :
+                r.cr_step == step_nice ? "nice value" : nullptr ;
+
+            if (what == nullptr)
+                m_error = r.cr_error;
+            else
+            {
+                util::warn_printf
+                (
+                    "Cannot set the %s of %s: %s",
+                    what, argv[0], std::strerror(r.cr_error)
+                );
+            }
+        }
+        if (m_error != 0)
+        {
+            (void) waitpid(pid, nullptr, 0);
+            pid = 0;
+        }
+    }
+    else
+    {
+        util::warn_printf
+        (
+            "clone3() failed (%s), %s is placed after it starts",
+            std::strerror(error), argv[0]
+        );
+    }
+    ::close(fds[0]);
+    return pid;
+#else
+    (void) argv; (void) envp; (void) mask; (void) where;
+    return 0;
+#endif
+}
+
+std::string
+spawner::error_message () const
+{
+    return m_error == 0 ? std::string() : std::string(std::strerror(m_error));
+}
+
+}               // namespace nsmd
+
+/*
+ * spawner.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
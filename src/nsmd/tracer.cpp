@@ -0,0 +1,208 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          tracer.cpp
+ *
+ *    This module implements the event trace recorder of nsm66d.
+ *
+ * \library       nsm66d application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cstdio>                       /* std::fopen(), std::fprintf()     */
+#include <unistd.h>                     /* getpid()                         */
+
+#include "tracer.hpp"                   /* nsmd::tracer class               */
+#include "util/msgfunctions.hpp"        /* cfg66: util::info_message()      */
+
+namespace nsmd
+{
+
+/*
+ *  A bounded copy that always terminates the destination.
+ */
+
+static void
+copy_text (char * destination, const char * source, std::size_t size)
+{
+    std::size_t i = 0;
+    if (source != nullptr)
+    {
+        for ( ; i < size - 1 && source[i] != 0; ++i)
+            destination[i] = source[i];
+    }
+    destination[i] = 0;
+}
+
+/*
+ *  Writes a JSON string, escaping what JSON requires.
+ */
+
+static void
+write_json_string (std::FILE * f, const char * s)
+{
+    std::fputc('"', f);
+    for ( ; *s != 0; ++s)
+    {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\')
+            std::fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            std::fprintf(f, "\\u%04x", c);
+        else
+            std::fputc(c, f);
+    }
+    std::fputc('"', f);
+}
+
+tracer::tracer () :
+    m_enabled       (false),
+    m_file          (),
+    m_events        (),
+    m_next          (0),
+    m_count         (0),
+    m_origin        ()
+{
+    // no code
+}
+
+/**
+ *  Allocates the ring buffer and starts recording.
+ *
+ * \param file
+ *      The JSON file written by dump().
+ *
+ * \param capacity
+ *      The number of events kept; older ones are overwritten.
+ */
+
+bool
+tracer::enable (const std::string & file, std::size_t capacity)
+{
+    bool result = ! file.empty() && capacity > 0;
+    if (result)
+    {
+        m_file = file;
+        m_events.resize(capacity);
+        m_next = m_count = 0;
+        m_origin = clock::now();
+        m_enabled = true;
+        util::info_message("Tracing to", file);
+    }
+    return result;
+}
+
+void
+tracer::record (char phase, const char * name, const char * id, unsigned s)
+{
+    event & e = m_events[m_next];
+    e.t_time = clock::now();
+    e.t_async_id = s;
+    e.t_phase = phase;
+    copy_text(e.t_name, name, c_name_size);
+    copy_text(e.t_id, id, c_id_size);
+    if (++m_next == m_events.size())
+        m_next = 0;
+
+    if (m_count < m_events.size())
+        ++m_count;
+}
+
+/**
+ *  Writes the recorded events, oldest first, to the trace file.  The
+ *  events stay recorded, so a later dump has them too.
+ */
+
+bool
+tracer::dump ()
+{
+    if (! m_enabled)
+        return false;
+
+    std::FILE * f = std::fopen(m_file.c_str(), "w");
+    if (f == nullptr)
+    {
+        util::error_message("Cannot write trace", m_file);
+        return false;
+    }
+
+    int pid = int(getpid());
+    std::size_t first = m_count < m_events.size() ? 0 : m_next ;
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (std::size_t n = 0; n < m_count; ++n)
+    {
+        const event & e = m_events[(first + n) % m_events.size()];
+        double us = std::chrono::duration<double, std::micro>
+        (
+            e.t_time - m_origin
+        ).count();
+        std::fprintf(f, "%s{\"name\":", n > 0 ? ",\n" : "");
+        write_json_string(f, e.t_name);
+        std::fprintf
+        (
+            f, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":1",
+            e.t_phase, us, pid
+        );
+        if (e.t_phase == 'b' || e.t_phase == 'e')
+            std::fprintf(f, ",\"cat\":\"operation\",\"id\":%u", e.t_async_id);
+        else if (e.t_phase == 'i')
+            std::fprintf(f, ",\"s\":\"t\"");
+
+        if (e.t_id[0] != 0)
+        {
+            std::fprintf(f, ",\"args\":{\"client\":");
+            write_json_string(f, e.t_id);
+            std::fprintf(f, "}");
+        }
+        std::fprintf(f, "}");
+    }
+    std::fprintf(f, "\n]}\n");
+
+    bool result = std::fclose(f) == 0;
+    if (result)
+    {
+        util::info_printf
+        (
+            "Wrote %lu trace events to %s", m_count, m_file.c_str()
+        );
+    }
+    return result;
+}
+
+/*-------------------------------------------------------------------------
+ * trace_scope
+ *-------------------------------------------------------------------------*/
+
+void
+trace_scope::start (const char * id)
+{
+    copy_text(m_id, id, tracer::c_id_size);
+    m_tracer.begin(m_name, m_id[0] != 0 ? m_id : nullptr);
+}
+
+}               // namespace nsmd
+
+/*
+ * tracer.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,320 @@
+/*
+ *  This file is part of nsm66d.
+ *
+ *  nsm66d is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  nsm66d is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66d; if not, write to the Free Software Foundation, Inc., 59
+ *  Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          childset.cpp
+ *
+ *    This module implements the wrapped executables of a multi-child
+ *    nsm-proxy66.
+ *
+ * \library       nsm-proxy66 application
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       GNU GPL v2 or above
+ */
+
+#include <cerrno>                       /* errno                            */
+#include <csignal>                      /* ::kill(), sigprocmask()          */
+#include <cstdlib>                      /* std::atoi(), setenv()            */
+#include <cstring>                      /* std::strerror()                  */
+#include <sys/wait.h>                   /* WIFEXITED() etc.                 */
+#include <unistd.h>                     /* fork(), execvp()                 */
+
+#include "c_macros.h"                   /* V() macro                        */
+#include "nsmproxy/childset.hpp"        /* nsmproxy::child_set class        */
+#include "util/filefunctions.hpp"       /* cfg66: util::file_read_lines()   */
+#include "util/msgfunctions.hpp"        /* cfg66: util::info_printf()       */
+#include "util/strfunctions.hpp"        /* cfg66: util::string_asprintf()   */
+
+namespace nsmproxy
+{
+
+namespace   // anonymous
+{
+
+/*
+ *  The values are indented by a tab, as nsm-proxy has always written them.
+ */
+
+std::string
+value_of (const std::string & line)
+{
+    std::size_t first = line.find_first_not_of("\t ");
+    return first == std::string::npos ? std::string() : line.substr(first) ;
+}
+
+}           // namespace anonymous
+
+child_set::child_set () :
+    m_children      (),
+    m_by_pid        (),
+    m_client_id     (),
+    m_display_name  ()
+{
+    // no code
+}
+
+/**
+ *  Sets the NSM client ID and session name given to each child.
+ */
+
+void
+child_set::session (const std::string & clientid, const std::string & name)
+{
+    m_client_id = clientid;
+    m_display_name = name;
+}
+
+/**
+ *  Reads the children from a configuration file and starts them.  Keys
+ *  before the first "executable" entry are ignored.
+ *
+ * \return
+ *      Returns false if the file could not be read or names no children.
+ */
+
+bool
+child_set::restore (const std::string & file)
+{
+    lib66::tokenization lines;
+    bool result = util::file_read_lines(file, lines);
+    if (result)
+    {
+        std::vector<child> children;
+        for (std::size_t i = 0; i + 1 < lines.size(); ++i)
+        {
+            const std::string & key = lines[i];
+            if (key.empty() || key[0] == '\t')
+                continue;
+
+            std::string value = value_of(lines[++i]);
+            if (key == "executable")
+            {
+                child c { value, "", "", "", 0, SIGTERM, 0, 0 };
+                children.push_back(c);
+            }
+            else if (children.empty())
+                continue;
+            else if (key == "arguments")
+                children.back().c_arguments = value;
+            else if (key == "config file")
+                children.back().c_config_file = value;
+            else if (key == "label")
+                children.back().c_label = value;
+            else if (key == "save signal")
+                children.back().c_save_signal = std::atoi(V(value));
+            else if (key == "stop signal")
+                children.back().c_stop_signal = std::atoi(V(value));
+        }
+        result = ! children.empty();
+        if (result)
+        {
+            kill();                             /* the old ones are orphans */
+            m_by_pid.clear();
+            m_children = children;
+            start_all();
+        }
+    }
+    return result;
+}
+
+/**
+ *  Writes the settings of all the children.
+ */
+
+bool
+child_set::dump (const std::string & file) const
+{
+    lib66::tokenization lines;
+    for (const auto & c : m_children)
+    {
+        lines.push_back("executable");
+        lines.push_back("\t" + c.c_executable);
+        lines.push_back("arguments");
+        lines.push_back("\t" + c.c_arguments);
+        if (! c.c_config_file.empty())
+        {
+            lines.push_back("config file");
+            lines.push_back("\t" + c.c_config_file);
+        }
+        lines.push_back("save signal");
+        lines.push_back("\t" + std::to_string(c.c_save_signal));
+        lines.push_back("stop signal");
+        lines.push_back("\t" + std::to_string(c.c_stop_signal));
+        if (! c.c_label.empty())
+        {
+            lines.push_back("label");
+            lines.push_back("\t" + c.c_label);
+        }
+    }
+    return util::file_write_lines(file, lines);
+}
+
+/**
+ *  Adds a child, as the GUI's "start" does, and starts it.
+ *
+ * \param guisettings
+ *      The label and signals the GUI sent just before the start.
+ */
+
+bool
+child_set::add
+(
+    const std::string & executable,
+    const std::string & arguments,
+    const std::string & configfile,
+    const settings & guisettings
+)
+{
+    child c
+    {
+        executable, arguments, configfile, guisettings.s_label,
+        guisettings.s_save_signal, guisettings.s_stop_signal, 0, 0
+    };
+    m_children.push_back(c);
+    return start(m_children.size() - 1);
+}
+
+void
+child_set::start_all ()
+{
+    for (std::size_t i = 0; i < m_children.size(); ++i)
+    {
+        if (m_children[i].c_pid == 0)
+            (void) start(i);
+    }
+}
+
+/**
+ *  Sends the save signal to each running child that has one.
+ */
+
+void
+child_set::save ()
+{
+    for (const auto & c : m_children)
+    {
+        if (c.c_pid != 0 && c.c_save_signal != 0)
+            (void) ::kill(c.c_pid, c.c_save_signal);
+    }
+}
+
+/**
+ *  Sends the stop signal to each running child.  They are forgotten when
+ *  they are reaped.
+ */
+
+void
+child_set::kill ()
+{
+    for (const auto & c : m_children)
+    {
+        if (c.c_pid != 0)
+            (void) ::kill(c.c_pid, c.c_stop_signal);
+    }
+}
+
+/**
+ *  Finds the child of an exit status from waitpid().
+ *
+ * \param label
+ *      Set to the label, or else the executable, of the child.
+ *
+ * \return
+ *      Returns ending::unknown if the PID is not one of the children.
+ */
+
+child_set::ending
+child_set::reap (pid_t pid, int status, std::string & label)
+{
+    auto it = m_by_pid.find(pid);
+    if (it == m_by_pid.end())
+        return ending::unknown;
+
+    child & c = m_children[it->second];
+    m_by_pid.erase(it);
+    c.c_pid = 0;
+    c.c_status = status;
+    label = c.c_label.empty() ? c.c_executable : c.c_label ;
+    if (WIFSIGNALED(status))
+    {
+        int sig = WTERMSIG(status);
+        bool stopped =
+            sig == SIGTERM || sig == SIGHUP || sig == SIGINT || sig == SIGKILL;
+
+        return stopped ? ending::normal : ending::abnormal ;
+    }
+    return WEXITSTATUS(status) == 0 ? ending::normal : ending::abnormal ;
+}
+
+/*
+ *  Forks a child.  The SIGCHLD mask that the proxy uses for its signalfd
+ *  is inherited, so it is undone before the exec.
+ */
+
+bool
+child_set::start (std::size_t index)
+{
+    child & c = m_children[index];
+    std::string command = util::string_asprintf
+    (
+        "exec %s %s >error-%d.log 2>&1",
+        V(c.c_executable), V(c.c_arguments), int(index)
+    );
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        setenv("NSM_CLIENT_ID", V(m_client_id), 1);
+        setenv("NSM_SESSION_NAME", V(m_display_name), 1);
+        if (! c.c_config_file.empty())
+            setenv("CONFIG_FILE", V(c.c_config_file), 1);
+
+        unsetenv("NSM_URL");
+
+        char sh [] = "sh";
+        char dashc [] = "-c";
+        char * args [] = { sh, dashc, &command[0], NULL };
+        execvp("/bin/sh", args);
+        _exit(EXIT_FAILURE);
+    }
+
+    bool result = pid > 0;
+    if (result)
+    {
+        c.c_pid = pid;
+        m_by_pid[pid] = index;
+        util::info_printf("Started %s, PID %d", V(c.c_executable), int(pid));
+    }
+    else
+        util::error_message("Error starting process", std::strerror(errno));
+
+    return result;
+}
+
+}               // namespace nsmproxy
+
+/*
+ * childset.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -27,24 +27,31 @@
  * \library       nsm-proxy66 application
  * \author        Chris Ahlstrom and other authors; see documentation
  * \date          2025-02-25
- * \updates       2025-04-16
+ * \updates       2026-10-14
  * \version       $Revision$
  * \license       GNU GPL v2 or above
  *
- *   To do.
+ *  With the --multi option, one nsm-proxy66 wraps several executables as a
+ *  single composite NSM client; see the nsmproxy::child_set class.  Either
+ *  way, the main loop sleeps in poll() on the SIGCHLD signalfd and the OSC
+ *  socket, so an idle proxy does not wake up at all.
  */
 
 #include <cerrno>                       /* #include <errno.h>               */
+#include <chrono>                       /* std::chrono::steady_clock        */
 #include <csignal>                      /* std::signal() and <signal.h>     */
 #include <cstring>                      /* std::strerror()                  */
 #include <cstdlib>                      /* std::getenv(), std::rand()       */
 #include <getopt.h>                     /* GNU get command-line option      */
+#include <poll.h>                       /* poll(), struct pollfd            */
 #include <sys/signalfd.h>               /* struct signalfd_siginfo          */
 #include <sys/wait.h>                   /* wait() or waitpid()              */
 
 #include "cfg/appinfo.hpp"              /* cfg66: cfg::set_client_name()    */
 #include "nsm/nsmcodes.hpp"             /* nsm66: nsm::error enumeration    */
 #include "nsm/nsmproxy.hpp"             /* nsm66: nsm::nsmproxy class       */
+#include "nsmd/procsampler.hpp"         /* nsmd::proc_sampler class         */
+#include "nsmproxy/childset.hpp"        /* nsmproxy::child_set class        */
 #include "nsmproxy/nsm-proxy66.hpp"     /* nsm66: nsmp-proxy66 header       */
 #include "osc/lowrapper.hpp"            /* nsm66: LO_TT_IMMEDIATE_2 macro   */
 #include "osc/messages.hpp"             /* cfg66: osc::tag enumeration      */
@@ -66,6 +73,15 @@ static int g_die_now = 0;
 static int g_signal_fd;
 static std::string g_nsm_client_id;
 static std::string g_nsm_display_name;
+static bool g_multi = false;            /* --multi, a composite client      */
+
+/*
+ *  In --multi mode, the label and signals the GUI sends before its start
+ *  are for the child to be added, not for the last one.
+ */
+
+static nsmproxy::child_set::settings g_pending { "", 0, SIGTERM };
+static long g_sample_ms = 0;            /* --sample, 0 disables it          */
 
 nsm::nsmproxy &
 nsm_proxy ()
@@ -74,12 +90,99 @@ nsm_proxy ()
     return s_nsm_proxy;
 }
 
+nsmproxy::child_set &
+proxy_children ()
+{
+    static nsmproxy::child_set s_proxy_children;
+    return s_proxy_children;
+}
+
+nsmd::proc_sampler &
+proxy_sampler ()
+{
+    static nsmd::proc_sampler s_proxy_sampler;
+    return s_proxy_sampler;
+}
+
+/*
+ *  Samples the resource use of the running children.  The samples of
+ *  those that have ended are dropped by the sweep.
+ */
+
+void
+sample_children ()
+{
+    for (const auto & c : proxy_children().children())
+    {
+        if (c.c_pid != 0)
+        {
+            const std::string & name =
+                c.c_label.empty() ? c.c_executable : c.c_label ;
+
+            (void) proxy_sampler().sample(c.c_pid, name);
+        }
+    }
+    proxy_sampler().sweep();
+}
+
 bool
 snapshot (const std::string & file)
 {
+    if (g_multi)
+    {
+        std::string path = util::string_asprintf
+        (
+            "%s/%s", V(file), NSM_PROXY_CONFIG_FILE_NAME
+        );
+        return proxy_children().dump(path);
+    }
     return nsm_proxy().dump(file);
 }
 
+/*
+ *  Sends the settings of the last child to the GUI, as nsmproxy::update()
+ *  does for the only child.
+ */
+
+void
+update_children (lo_address to)
+{
+    nsmproxy::child_set::child * c = proxy_children().last();
+    if (is_nullptr(c))
+        return;
+
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/label", "s", V(c->c_label)
+    );
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/arguments", "s", V(c->c_arguments)
+    );
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/executable", "s", V(c->c_executable)
+    );
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/config_file", "s", V(c->c_config_file)
+    );
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/save_signal", "i", c->c_save_signal
+    );
+    lo_send_from
+    (
+        to, g_osc_server, LO_TT_IMMEDIATE_2,
+        "/nsm/proxy/stop_signal", "i", c->c_stop_signal
+    );
+}
+
 #if 0
 
 void
@@ -114,7 +217,9 @@ open (const std::string & file)
     (
         "%s/%s", V(file), NSM_PROXY_CONFIG_FILE_NAME
     );
-    bool result = nsm_proxy().restore(path);
+    bool result = g_multi ?
+        proxy_children().restore(path) : nsm_proxy().restore(path) ;
+
     return result;
 }
 
@@ -188,7 +293,11 @@ osc_save
     (void) types; (void) argc; (void) argv; (void) msg; (void) user_data;
 
     bool r = snapshot(g_project_file);
-    nsm_proxy().save();
+    if (g_multi)
+        proxy_children().save();
+    else
+        nsm_proxy().save();
+
     if (r)
     {
         lo_send_from
@@ -314,6 +423,8 @@ osc_open
         const std::string & client_id = &argv[2]->s;
         g_nsm_client_id = client_id;
         g_nsm_display_name = display_name;
+        if (g_multi)
+            proxy_children().session(client_id, display_name);
 
         bool ok = util::make_directory_path(new_path, 0777);
         if (ok)
@@ -354,7 +465,12 @@ osc_open
             "/reply", "ss", path, "OK"
         );
         if (g_gui_address)
-            nsm_proxy().update(g_gui_address);
+        {
+            if (g_multi)
+                update_children(g_gui_address);
+            else
+                nsm_proxy().update(g_gui_address);
+        }
     }
     return osc::osc_msg_handled();
 }
@@ -373,7 +489,12 @@ osc_label
 {
     (void) path; (void) types; (void) msg; (void) user_data;
     if (argc >= 1)
-        nsm_proxy().label(&argv[0]->s);
+    {
+        if (g_multi)
+            g_pending.s_label = &argv[0]->s;
+        else
+            nsm_proxy().label(&argv[0]->s);
+    }
 
     return osc::osc_msg_handled();
 }
@@ -390,7 +511,12 @@ osc_save_signal
 {
     (void) path; (void) types; (void) msg; (void) user_data;
     if (argc >= 1)
-        nsm_proxy().save_signal(argv[0]->i);
+    {
+        if (g_multi)
+            g_pending.s_save_signal = argv[0]->i;
+        else
+            nsm_proxy().save_signal(argv[0]->i);
+    }
 
     return osc::osc_msg_handled();
 }
@@ -407,7 +533,12 @@ osc_stop_signal
 {
     (void) path; (void) types; (void) msg; (void) user_data;
     if (argc >= 1)
-        nsm_proxy().stop_signal(argv[0]->i);
+    {
+        if (g_multi)
+            g_pending.s_stop_signal = argv[0]->i;
+        else
+            nsm_proxy().stop_signal(argv[0]->i);
+    }
 
     return osc::osc_msg_handled();
 }
@@ -423,6 +554,25 @@ osc_start
 )
 {
     (void) path; (void) types; (void) msg; (void) user_data;
+    if (g_multi)
+    {
+        /*
+         * Each start from the GUI adds another child.
+         */
+
+        if (argc >= 3)
+        {
+            bool ok = proxy_children().add
+            (
+                &argv[0]->s, &argv[1]->s, &argv[2]->s, g_pending
+            );
+            g_pending = nsmproxy::child_set::settings { "", 0, SIGTERM };
+            if (ok)
+                hide_gui();
+        }
+        snapshot(g_project_file);
+        return osc::osc_msg_handled();
+    }
     snapshot(g_project_file);
     if (argc >= 3)
     {
@@ -444,7 +594,11 @@ osc_kill
 {
     (void) path; (void) types; (void) argc; (void) argv;
     (void) msg; (void) user_data;
-    nsm_proxy().kill();
+    if (g_multi)
+        proxy_children().kill();
+    else
+        nsm_proxy().kill();
+
     return osc::osc_msg_handled();
 }
 
@@ -463,11 +617,45 @@ osc_update
     (
         lo_address_get_url(lo_message_get_source(msg))
     );
-    nsm_proxy().update(to);
+    if (g_multi)
+        update_children(to);
+    else
+        nsm_proxy().update(to);
+
     g_gui_address = to;
     return osc::osc_msg_handled();
 }
 
+/*
+ *  Sends the resource use of the children, one "/reply" per child, then an
+ *  empty one, as nsm66d does for /nsm/server/resources.
+ */
+
+int
+osc_resources
+(
+    const char * path,
+    const char * types,
+    lo_arg ** argv, int argc,
+    lo_message msg,
+    void * user_data
+)
+{
+    (void) types; (void) argc; (void) argv; (void) user_data;
+    lo_address to = lo_message_get_source(msg);
+    std::vector<std::string> lines = proxy_sampler().report();
+    lines.push_back("");
+    for (const auto & line : lines)
+    {
+        lo_send_from
+        (
+            to, g_osc_server, LO_TT_IMMEDIATE_2,
+            "/reply", "ss", path, V(line)
+        );
+    }
+    return osc::osc_msg_handled();
+}
+
 void
 signal_handler (int /*x*/)
 {
@@ -542,6 +730,15 @@ add_methods ()
     add_method(osc::tag::proxykill, OSC_NAME( kill ), "");
     add_method(osc::tag::proxystart, OSC_NAME( start ), "");
     add_method(osc::tag::proxyupdate, OSC_NAME( update ), "");
+
+    /*
+     * Not an NSM message, so there is no osc::tag for it.
+     */
+
+    lo_server_add_method
+    (
+        g_osc_server, "/nsm/proxy/resources", "", OSC_NAME( resources ), NULL
+    );
 }
 
 void
@@ -563,10 +760,47 @@ die ()
         util::info_message("Killing GUI");
         ::kill(s_gui_pid, SIGTERM);
     }
-    nsm_proxy().kill();
+    if (g_multi)
+        proxy_children().kill();
+    else
+        nsm_proxy().kill();
+
     exit(EXIT_SUCCESS);
 }
 
+/*
+ *  In multi mode, one child ending does not end the proxy.  An error exit
+ *  is reported to the NSM server, and the proxy quits only when the last
+ *  child has stopped.
+ */
+
+void
+reap_child (pid_t pid, int status)
+{
+    std::string label;
+    nsmproxy::child_set::ending e = proxy_children().reap(pid, status, label);
+    if (e == nsmproxy::child_set::ending::normal)
+    {
+        util::info_message("Child stopped", label);
+        if (proxy_children().running() == 0)
+            g_die_now = true;
+    }
+    else if (e == nsmproxy::child_set::ending::abnormal)
+    {
+        std::string text = util::string_asprintf
+        (
+            "%s exited abnormally, status %d", V(label),
+            WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status)
+        );
+        util::warn_message(text);
+        lo_send_from
+        (
+            g_nsm_lo_address, g_osc_server, LO_TT_IMMEDIATE_2,
+            "/nsm/client/message", "is", 1, V(text)
+        );
+    }
+}
+
 void
 handle_sigchld ()
 {
@@ -587,6 +821,11 @@ handle_sigchld ()
             s_gui_pid = 0;
             continue;                           /* we don't care...         */
         }
+        if (g_multi)
+        {
+            reap_child(pid, status);
+            continue;
+        }
 
         if (WIFSIGNALED(status))                /* process killed w/signal  */
         {
@@ -637,6 +876,10 @@ help ()
     "  nsm-proxy --help\n"
     "\n"
     "Options:\n"
+    "  --multi               Wrap several executables as one NSM client\n"
+    "  --sample ms           With --multi, sample the CPU, memory, and I/O\n"
+    "                        use of each child every 'ms', for\n"
+    "                        /nsm/proxy/resources. Default: 0, off\n"
     "  --help                Show this screen\n"
     "\n"
     ;
@@ -652,6 +895,8 @@ main ( int argc, char **argv )
 
     static struct option long_options [] =
     {
+        { "multi", no_argument, 0, 'm' },
+        { "sample", required_argument, 0, 's' },
         { "help", no_argument, 0, 'h' },
         { 0, 0, 0, 0 }
     };
@@ -665,6 +910,16 @@ main ( int argc, char **argv )
     {
         switch (c)
         {
+            case 'm':
+
+                g_multi = true;
+                break;
+
+            case 's':
+
+                g_sample_ms = std::atol(optarg);
+                break;
+
             case 'h':
 
                 help();
@@ -672,7 +927,7 @@ main ( int argc, char **argv )
                 break;
         }
     }
-    init_osc(NULL);
+    init_osc(util::get_env("NSM_CLIENT_PORT"));     /* reserved by nsmd     */
 
     /*
      * TODO: lookup the URL if necessary.
@@ -693,21 +948,79 @@ main ( int argc, char **argv )
         exit(EXIT_FAILURE);
     }
 
-    struct signalfd_siginfo fdsi;
-
     /*
-     * listen for sigchld signals and process OSC messages forever
+     * Listen for SIGCHLD signals and process OSC messages forever.  The
+     * loop used to wake up every 500 ms; now it sleeps until one of them
+     * is ready.  A SIGTERM (etc.) interrupts poll() with EINTR, so that
+     * g_die_now is still seen.  Only the sampling of --sample wakes it on
+     * a schedule.
      */
 
+    using sample_clock = std::chrono::steady_clock;
+    bool sampling = g_multi && g_sample_ms > 0;
+    sample_clock::time_point next_sample = sample_clock::now();
+
+    struct pollfd fds [2];
+    fds[0].fd = g_signal_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = lo_server_get_socket_fd(g_osc_server);
+    fds[1].events = POLLIN;
     for (;;)
     {
-        ssize_t s = read(g_signal_fd, &fdsi, sizeof(struct signalfd_siginfo));
-        if (s == sizeof(struct signalfd_siginfo))
+        int timeout = (-1);
+        if (sampling)
+        {
+            sample_clock::time_point now = sample_clock::now();
+            if (now >= next_sample)
+            {
+                sample_children();
+                next_sample = now + std::chrono::milliseconds(g_sample_ms);
+            }
+            timeout = int
+            (
+                std::chrono::duration_cast<std::chrono::milliseconds>
+                (
+                    next_sample - now
+                ).count()
+            ) + 1;
+        }
+
+        int n = poll(fds, 2, timeout);
+        if (n < 0 && errno != EINTR)
         {
-            if (fdsi.ssi_signo == SIGCHLD)
-                handle_sigchld();
+            util::error_message("poll() failed", std::strerror(errno));
+            g_die_now = true;
+        }
+        else if (n > 0)
+        {
+            if (fds[0].revents & POLLIN)
+            {
+                /*
+                 * Signals can coalesce, and handle_sigchld() reaps every
+                 * child that is done, so one call covers them all.
+                 */
+
+                struct signalfd_siginfo fdsi;
+                bool sigchld = false;
+                while
+                (
+                    read(g_signal_fd, &fdsi, sizeof fdsi) == sizeof fdsi
+                )
+                {
+                    if (fdsi.ssi_signo == SIGCHLD)
+                        sigchld = true;
+                }
+                if (sigchld)
+                    handle_sigchld();
+            }
+            if (fds[1].revents & POLLIN)
+            {
+                while (lo_server_recv_noblock(g_osc_server, 0) > 0)
+                {
+                    // no code
+                }
+            }
         }
-        lo_server_recv_noblock(g_osc_server, 500);
         if (g_die_now)
             die();
     }
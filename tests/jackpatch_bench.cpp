@@ -0,0 +1,439 @@
+/*
+ *  This file is part of nsm66.
+ *
+ *  nsm66 is free software; you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation; either version 2 of the License, or (at your option) any later
+ *  version.
+ *
+ *  nsm66 is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66; if not, write to the Free Software Foundation, Inc., 59 Temple
+ *  Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          jackpatch_bench.cpp
+ *
+ *      A benchmark of the loading of .jackpatch files by jackpatch66.
+ *
+ * \library       nsm66
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       See above.
+ *
+ *  The benchmark writes a synthetic patch file, by default of 10000 lines,
+ *  in both the text and the indexed formats, and times:
+ *
+ *      -   "parse": jackpatch::patch_file::load() alone, with a handler
+ *          that only counts the patches.
+ *      -   "load": the same, adding each patch to a patch graph, as
+ *          read_config() does.
+ *
+ *  No JACK server is needed.  The live JACK client list is faked, and
+ *  includes an a2jmidid client whose name has a colon in it, so each
+ *  patch is also checked against the names it was written from.
+ *
+ *  The results go to standard output as CSV lines, "format,lines,
+ *  operation,best_ms,median_ms,result", after a "#" header line.  The
+ *  result is "ok", "slow" (the median is over the budget), or "wrong";
+ *  the exit status is a failure unless all are "ok".
+ */
+
+#include <algorithm>                    /* std::sort()                      */
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <cstdio>                       /* std::printf(), std::fprintf()    */
+#include <cstdlib>                      /* EXIT_SUCCESS, std::atoi()        */
+#include <fstream>                      /* std::ofstream                    */
+#include <getopt.h>                     /* getopt_long()                    */
+#include <string>                       /* std::string                      */
+#include <unistd.h>                     /* unlink(), rmdir()                */
+#include <unordered_map>                /* std::unordered_map<>             */
+#include <vector>                       /* std::vector<>                    */
+
+#include "patchfile.hpp"                /* jackpatch::patch_file class      */
+#include "patchgraph.hpp"               /* jackpatch::patch_graph class     */
+
+namespace   // anonymous
+{
+
+using bench_clock = std::chrono::steady_clock;
+
+/**
+ *  One patch as written to the file, to check the parse against.
+ */
+
+using expected_patch = struct
+{
+    std::string x_src_client;
+    std::string x_src_port;
+    std::string x_dst_client;
+    std::string x_dst_port;
+};
+
+int s_lines { 10000 };
+int s_runs { 20 };
+double s_budget_ms { 50.0 };
+std::vector<expected_patch> s_patches;
+
+/*
+ *  The live JACK clients.  The a2j client has a colon in its name, and the
+ *  seq66 ports start with the a2j client name, so only the live list can
+ *  split them right.
+ */
+
+const std::vector<std::string> s_clients
+{
+    "PulseAudio JACK Sink",
+    "a2j:Launchpad Mini [20]",
+    "fluidsynth-midi",
+    "seq66.nPSLM",
+    "system"
+};
+
+std::string
+port_name (std::size_t client, int index)
+{
+    std::string number = std::to_string(index);
+    if (client == 1)
+        return "Launchpad Mini MIDI 1 (capture): midi_" + number;
+    else if (client == 3)
+        return "a2j:Launchpad Mini [20]:in_" + number;
+    else
+        return "port_" + number;
+}
+
+/*
+ *  Makes s_lines distinct patches, spread over the clients.
+ */
+
+void
+make_patches ()
+{
+    std::size_t n = s_clients.size();
+    s_patches.clear();
+    s_patches.reserve(std::size_t(s_lines));
+    for (int i = 0; i < s_lines; ++i)
+    {
+        std::size_t src = std::size_t(i) % n;
+        std::size_t dst = (src + 1 + std::size_t(i / 5) % (n - 1)) % n;
+        expected_patch x
+        {
+            s_clients[src], port_name(src, i / 5),
+            s_clients[dst], port_name(dst, (i / 5 + 1) % 2000)
+        };
+        s_patches.push_back(x);
+    }
+}
+
+bool
+write_text (const std::string & file)
+{
+    std::ofstream out(file);
+    for (const auto & x : s_patches)
+    {
+        out << x.x_src_client << ":" << x.x_src_port << " |> "
+            << x.x_dst_client << ":" << x.x_dst_port << "\n";
+    }
+    return bool(out);
+}
+
+/*
+ *  Writes the indexed format, defining each port name once, in the order
+ *  it is first used.
+ */
+
+bool
+write_indexed (const std::string & file)
+{
+    std::ofstream out(file);
+    std::vector<std::string> names;
+    std::unordered_map<std::string, std::size_t> ids;
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    auto index = [&names, &ids] (const std::string & name)
+    {
+        auto it = ids.emplace(name, names.size());
+        if (it.second)
+            names.push_back(name);
+
+        return it.first->second;
+    };
+    for (const auto & x : s_patches)
+    {
+        std::size_t s = index(x.x_src_client + ":" + x.x_src_port);
+        std::size_t d = index(x.x_dst_client + ":" + x.x_dst_port);
+        pairs.emplace_back(s, d);
+    }
+    out << jackpatch::patch_file::c_indexed_header << "\n";
+    for (const auto & name : names)
+        out << "= " << name << "\n";
+
+    for (const auto & p : pairs)
+        out << p.first << " |> " << p.second << "\n";
+
+    return bool(out);
+}
+
+/*
+ *  Parses the file once, comparing each patch with the one written.
+ */
+
+bool
+verify (jackpatch::patch_file & pf, const std::string & file)
+{
+    std::size_t count = 0;
+    std::size_t wrong = 0;
+    bool result = pf.load
+    (
+        file,
+        [&count, &wrong]
+        (
+            const jackpatch::patch_file::endpoint & src,
+            const jackpatch::patch_file::endpoint & dst
+        )
+        {
+            if (count < s_patches.size())
+            {
+                const expected_patch & x = s_patches[count];
+                if (src.e_client != x.x_src_client ||
+                    src.e_port != x.x_src_port ||
+                    dst.e_client != x.x_dst_client ||
+                    dst.e_port != x.x_dst_port)
+                {
+                    ++wrong;
+                }
+            }
+            ++count;
+        }
+    );
+    if (wrong > 0 || count != s_patches.size())
+    {
+        std::fprintf
+        (
+            stderr, "%s: %zu patches, %zu wrong\n", file.c_str(), count, wrong
+        );
+        result = false;
+    }
+    return result;
+}
+
+double
+elapsed_ms (bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>
+    (
+        bench_clock::now() - start
+    ).count();
+}
+
+double
+time_parse (jackpatch::patch_file & pf, const std::string & file)
+{
+    std::size_t count = 0;
+    bench_clock::time_point start = bench_clock::now();
+    (void) pf.load
+    (
+        file,
+        [&count]
+        (
+            const jackpatch::patch_file::endpoint &,
+            const jackpatch::patch_file::endpoint &
+        )
+        {
+            ++count;
+        }
+    );
+    return elapsed_ms(start);
+}
+
+/*
+ *  Loads the patches into a fresh graph, copying the names the way
+ *  jackpatch66's add_patch() does.
+ */
+
+double
+time_load (jackpatch::patch_file & pf, const std::string & file)
+{
+    jackpatch::patch_graph graph;
+    bench_clock::time_point start = bench_clock::now();
+    (void) pf.load
+    (
+        file,
+        [&graph]
+        (
+            const jackpatch::patch_file::endpoint & src,
+            const jackpatch::patch_file::endpoint & dst
+        )
+        {
+            patch_record pr {};
+            pr.pr_src.client.assign(src.e_client.data(), src.e_client.size());
+            pr.pr_src.port.assign(src.e_port.data(), src.e_port.size());
+            pr.pr_dst.client.assign(dst.e_client.data(), dst.e_client.size());
+            pr.pr_dst.port.assign(dst.e_port.data(), dst.e_port.size());
+            (void) graph.add(pr);
+        }
+    );
+    double result = elapsed_ms(start);
+    if (graph.size() != s_patches.size())
+        result = -1.0;
+
+    return result;
+}
+
+/*
+ *  Runs one operation s_runs times and prints its line.
+ */
+
+bool
+run_operation
+(
+    jackpatch::patch_file & pf,
+    const char * format,
+    const char * op,
+    const std::string & file,
+    bool correct
+)
+{
+    std::vector<double> times;
+    bool failed = ! correct;
+    for (int r = 0; r < s_runs; ++r)
+    {
+        double ms = std::string(op) == "parse" ?
+            time_parse(pf, file) : time_load(pf, file) ;
+
+        if (ms < 0.0)
+            failed = true;
+
+        times.push_back(ms);
+    }
+    std::sort(times.begin(), times.end());
+
+    double median = times[times.size() / 2];
+    bool slow = median > s_budget_ms;
+    std::printf
+    (
+        "%s,%d,%s,%.3f,%.3f,%s\n", format, s_lines, op, times.front(), median,
+        failed ? "wrong" : (slow ? "slow" : "ok")
+    );
+    std::fflush(stdout);
+    return ! failed && ! slow;
+}
+
+void
+help ()
+{
+    std::printf
+    (
+"jackpatch_bench - times the loading of .jackpatch files\n\n"
+"Usage: jackpatch_bench [ options ]\n\n"
+"   --lines n          The number of patches in the file. Default 10000.\n"
+"   --runs n           The number of timed runs of each. Default 20.\n"
+"   --budget-ms ms     The longest median allowed. Default 50.\n"
+"   --help             Show this help.\n"
+    );
+}
+
+bool
+parse_cli (int argc, char * argv [])
+{
+    static struct option long_opts [] =
+    {
+        { "lines",          required_argument,  0, 'l' },
+        { "runs",           required_argument,  0, 'r' },
+        { "budget-ms",      required_argument,  0, 'b' },
+        { "help",           no_argument,        0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != (-1))
+    {
+        switch (c)
+        {
+            case 'l':
+
+                s_lines = std::atoi(optarg);
+                break;
+
+            case 'r':
+
+                s_runs = std::atoi(optarg);
+                break;
+
+            case 'b':
+
+                s_budget_ms = std::atof(optarg);
+                break;
+
+            case 'h':
+
+                help();
+                exit(EXIT_SUCCESS);
+                break;
+
+            default:
+
+                return false;
+        }
+    }
+    return s_lines > 0 && s_runs > 0 && s_budget_ms > 0.0;
+}
+
+}           // namespace anonymous
+
+/*
+ * main() routine
+ */
+
+int
+main (int argc, char * argv [])
+{
+    if (! parse_cli(argc, argv))
+    {
+        help();
+        return EXIT_FAILURE;
+    }
+
+    char root [] = "/tmp/jackpatch-bench-XXXXXX";
+    if (mkdtemp(root) == nullptr)
+    {
+        std::perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    std::string text = std::string(root) + "/text.jackpatch";
+    std::string indexed = std::string(root) + "/indexed.jackpatch";
+    make_patches();
+
+    bool ok = write_text(text) && write_indexed(indexed);
+    if (ok)
+    {
+        jackpatch::patch_file pf;
+        pf.clients(s_clients);
+
+        bool textok = verify(pf, text);
+        bool indexedok = verify(pf, indexed) && pf.indexed();
+        std::printf("# format,lines,operation,best_ms,median_ms,result\n");
+        ok = run_operation(pf, "text", "parse", text, textok);
+        ok = run_operation(pf, "text", "load", text, textok) && ok;
+        ok = run_operation(pf, "indexed", "parse", indexed, indexedok) && ok;
+        ok = run_operation(pf, "indexed", "load", indexed, indexedok) && ok;
+    }
+    else
+        std::fprintf(stderr, "Cannot write the patch files\n");
+
+    (void) unlink(text.c_str());
+    (void) unlink(indexed.c_str());
+    (void) rmdir(root);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
+
+/*
+ * jackpatch_bench.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,702 @@
+/*
+ *  This file is part of nsm66.
+ *
+ *  nsm66 is free software; you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation; either version 2 of the License, or (at your option) any later
+ *  version.
+ *
+ *  nsm66 is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66; if not, write to the Free Software Foundation, Inc., 59 Temple
+ *  Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          jackpatch_jack_bench.cpp
+ *
+ *      A benchmark of jackpatch66 against a JACK server with the dummy
+ *      backend, and synthetic JACK clients.
+ *
+ * \library       nsm66
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       See above.
+ *
+ *  The harness starts its own jackd, with the dummy driver and a private
+ *  server name, so that a running JACK server is not disturbed.  It is
+ *  also a minimal NSM server for jackpatch66, which it runs with NSM_URL
+ *  pointing at itself.  For each size, a "clients x ports x fanout" triple,
+ *  it:
+ *
+ *      -   Opens the clients, each with "ports" outputs and as many inputs.
+ *          Output k of client i goes to input k of each of the "fanout"
+ *          clients after it, which gives clients x ports x fanout
+ *          connections.  They are written to a .jackpatch file, but not
+ *          made.
+ *      -   "restore": sends /nsm/client/open for that file, and times
+ *          until every connection exists.  This is read_config() and the
+ *          restore of register_prexisting_ports().
+ *      -   "hotplug": closes the first client, which drops its
+ *          connections, then opens it again, and times from the new ports
+ *          to the restore of all its connections.
+ *      -   "save": sends /nsm/client/save, a snapshot() after the changes.
+ *      -   "resave": saves again, with nothing changed.
+ *
+ *  The connections are counted with a port connect callback.  If jackd
+ *  cannot be started, the benchmark is skipped (exit code 77).
+ *
+ *  The results go to standard output as CSV lines, "clients,ports,fanout,
+ *  connections,operation,ms,result", after a "#" header line, for
+ *  comparison between builds.
+ */
+
+#include <atomic>                       /* std::atomic<>                    */
+#include <cerrno>                       /* errno                            */
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <csignal>                      /* kill(), SIGTERM                  */
+#include <cstdio>                       /* std::printf(), std::fprintf()    */
+#include <cstdlib>                      /* EXIT_SUCCESS, setenv()           */
+#include <cstring>                      /* std::strerror()                  */
+#include <fstream>                      /* std::ofstream                    */
+#include <ftw.h>                        /* nftw()                           */
+#include <getopt.h>                     /* getopt_long()                    */
+#include <string>                       /* std::string                      */
+#include <sys/wait.h>                   /* waitpid()                        */
+#include <unistd.h>                     /* fork(), execvp(), usleep()       */
+#include <vector>                       /* std::vector<>                    */
+
+#include <jack/jack.h>                  /* JACK C API                       */
+
+#include "lo/lo.h"                      /* liblo C API                      */
+
+namespace   // anonymous
+{
+
+using bench_clock = std::chrono::steady_clock;
+
+/**
+ *  One benchmark size.
+ */
+
+using bench_size = struct
+{
+    int bs_clients;
+    int bs_ports;
+    int bs_fanout;
+};
+
+/**
+ *  The reply the harness waits for: "/reply path ...", or any "/error
+ *  path ...".
+ */
+
+using expectation = struct
+{
+    std::string e_path;
+    bool e_done;
+    bool e_failed;
+    std::string e_error;
+};
+
+const int c_exit_skip = 77;             /* meson: the test was skipped      */
+const long c_timeout_ms = 120000;
+
+std::string s_jackpatch_path;
+std::string s_jackd_path { "jackd" };
+std::string s_root;
+std::vector<bench_size> s_sizes
+{
+    { 10, 5, 2 }, { 20, 10, 5 }, { 30, 20, 5 }, { 50, 20, 10 }
+};
+int s_settle_ms { -1 };
+bool s_verbose { false };
+
+std::atomic<long> s_connections { 0 };
+std::vector<jack_client_t *> s_clients;
+lo_address s_jackpatch = nullptr;       /* set by the announce              */
+
+void
+connect_callback (jack_port_id_t, jack_port_id_t, int connect, void *)
+{
+    if (connect != 0)
+        ++s_connections;
+    else
+        --s_connections;
+}
+
+std::string
+client_name (int index)
+{
+    return "jpbench-" + std::to_string(index);
+}
+
+/*
+ *  Opens a synthetic client with its ports, and activates it, since JACK
+ *  does not connect the ports of an inactive client.  A client just closed
+ *  can take a moment to release its name.
+ */
+
+bool
+open_client (int index, int ports)
+{
+    std::string name = client_name(index);
+    jack_client_t * c = nullptr;
+    for (int attempt = 0; attempt < 50 && c == nullptr; ++attempt)
+    {
+        jack_status_t status;
+        c = jack_client_open
+        (
+            name.c_str(), jack_options_t(JackNoStartServer | JackUseExactName),
+            &status
+        );
+        if (c == nullptr)
+            usleep(10000);
+    }
+    if (c == nullptr)
+        return false;
+
+    for (int k = 0; k < ports; ++k)
+    {
+        std::string n = std::to_string(k);
+        if
+        (
+            jack_port_register
+            (
+                c, ("out_" + n).c_str(), JACK_DEFAULT_AUDIO_TYPE,
+                JackPortIsOutput, 0
+            ) == nullptr ||
+            jack_port_register
+            (
+                c, ("in_" + n).c_str(), JACK_DEFAULT_AUDIO_TYPE,
+                JackPortIsInput, 0
+            ) == nullptr
+        )
+        {
+            jack_client_close(c);
+            return false;
+        }
+    }
+    if (jack_activate(c) != 0)
+    {
+        jack_client_close(c);
+        return false;
+    }
+    s_clients[std::size_t(index)] = c;
+    return true;
+}
+
+void
+close_clients ()
+{
+    for (auto & c : s_clients)
+    {
+        if (c != nullptr)
+            jack_client_close(c);
+
+        c = nullptr;
+    }
+    s_clients.clear();
+}
+
+/*
+ *  Writes the patch file of a size.
+ *
+ * \return
+ *      Returns the number of connections, or 0 if the file could not be
+ *      written.  The number of them that include the first client is
+ *      returned in "first".
+ */
+
+long
+write_patches (const std::string & file, const bench_size & bs, long & first)
+{
+    std::ofstream out(file);
+    long result = 0;
+    first = 0;
+    for (int i = 0; i < bs.bs_clients; ++i)
+    {
+        for (int f = 1; f <= bs.bs_fanout; ++f)
+        {
+            int j = (i + f) % bs.bs_clients;
+            for (int k = 0; k < bs.bs_ports; ++k)
+            {
+                out << client_name(i) << ":out_" << k << " |> "
+                    << client_name(j) << ":in_" << k << "\n";
+                ++result;
+                if (i == 0 || j == 0)
+                    ++first;
+            }
+        }
+    }
+    return bool(out) ? result : 0 ;
+}
+
+pid_t
+start_child (const std::vector<std::string> & arguments)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<std::string> args { arguments };
+        std::vector<char *> argv;
+        for (auto & a : args)
+            argv.push_back(&a[0]);
+
+        argv.push_back(nullptr);
+        if (! s_verbose)
+        {
+            if (freopen("/dev/null", "w", stdout) == nullptr)
+                std::perror("freopen");
+
+            if (freopen("/dev/null", "w", stderr) == nullptr)
+                std::perror("freopen");
+        }
+        execvp(argv[0], argv.data());
+        std::fprintf
+        (
+            stderr, "Cannot run %s: %s\n", argv[0], std::strerror(errno)
+        );
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+void
+stop_child (pid_t pid)
+{
+    if (pid > 0)
+    {
+        kill(pid, SIGTERM);
+        (void) waitpid(pid, nullptr, 0);
+    }
+}
+
+/*
+ *  Starts jackd with enough ports for the largest size.
+ */
+
+pid_t
+start_jackd (const std::string & server)
+{
+    int ports = 0;
+    for (const auto & bs : s_sizes)
+    {
+        if (bs.bs_clients * bs.bs_ports * 2 > ports)
+            ports = bs.bs_clients * bs.bs_ports * 2;
+    }
+    ports += 256;
+    return start_child
+    (
+        {
+            s_jackd_path, "--no-realtime", "--name", server,
+            "--port-max", std::to_string(ports),
+            "-d", "dummy", "-r", "48000", "-p", "1024"
+        }
+    );
+}
+
+/*
+ *  The NSM server side of the harness.
+ */
+
+int
+announce_handler
+(
+    const char *, const char *, lo_arg **, int, lo_message msg, void * srv
+)
+{
+    lo_address source = lo_message_get_source(msg);
+    if (s_jackpatch != nullptr)
+        lo_address_free(s_jackpatch);
+
+    s_jackpatch = lo_address_new_from_url(lo_address_get_url(source));
+    lo_send_from
+    (
+        s_jackpatch, static_cast<lo_server>(srv), LO_TT_IMMEDIATE, "/reply",
+        "ssss", "/nsm/server/announce", "Welcome", "jackpatch_jack_bench",
+        ":server-control:"
+    );
+    return 0;
+}
+
+int
+reply_handler
+(
+    const char * path, const char *, lo_arg ** argv, int argc,
+    lo_message, void * user_data
+)
+{
+    expectation * e = static_cast<expectation *>(user_data);
+    if (argc < 1 || std::string(&argv[0]->s) != e->e_path)
+        return 0;
+
+    e->e_done = true;
+    if (std::string(path) == "/error")
+    {
+        e->e_failed = true;
+        if (argc >= 3)
+            e->e_error = &argv[2]->s;
+    }
+    return 0;
+}
+
+double
+elapsed_ms (bench_clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>
+    (
+        bench_clock::now() - begin
+    ).count();
+}
+
+/*
+ *  Serves OSC until the reply has come (if "e" is given) and there are
+ *  "count" connections (if count >= 0), or the timeout.
+ */
+
+bool
+wait_for (lo_server srv, expectation * e, long count)
+{
+    bench_clock::time_point limit =
+        bench_clock::now() + std::chrono::milliseconds(c_timeout_ms);
+
+    while (bench_clock::now() < limit)
+    {
+        bool replied = e == nullptr || e->e_done;
+        if (replied && (count < 0 || s_connections.load() == count))
+            break;
+
+        (void) lo_server_recv_noblock(srv, 1);
+    }
+    bool result = count < 0 || s_connections.load() == count;
+    if (e != nullptr)
+        result = result && e->e_done && ! e->e_failed;
+
+    return result;
+}
+
+void
+prepare (expectation & e, const std::string & path)
+{
+    e.e_path = path;
+    e.e_done = e.e_failed = false;
+    e.e_error.clear();
+}
+
+void
+result_line (const bench_size & bs, long count, const char * op, double ms)
+{
+    std::printf
+    (
+        "%d,%d,%d,%ld,%s,%.3f,%s\n", bs.bs_clients, bs.bs_ports,
+        bs.bs_fanout, count, op, ms, ms >= 0.0 ? "ok" : "error"
+    );
+    std::fflush(stdout);
+}
+
+/*
+ *  Runs the four timings of one size, with a fresh jackpatch66.
+ */
+
+bool
+run_size (lo_server srv, expectation & e, const bench_size & bs)
+{
+    std::string name = "bench-" + std::to_string(bs.bs_clients) + "x" +
+        std::to_string(bs.bs_ports) + "x" + std::to_string(bs.bs_fanout);
+
+    std::string project = s_root + "/" + name;
+    long first = 0;
+    long count = write_patches(project + ".jackpatch", bs, first);
+    if (count == 0)
+    {
+        std::fprintf(stderr, "Cannot write %s.jackpatch\n", project.c_str());
+        return false;
+    }
+
+    s_clients.assign(std::size_t(bs.bs_clients), nullptr);
+    for (int i = 0; i < bs.bs_clients; ++i)
+    {
+        if (! open_client(i, bs.bs_ports))
+        {
+            std::fprintf(stderr, "Cannot open %s\n", client_name(i).c_str());
+            close_clients();
+            return false;
+        }
+    }
+
+    std::vector<std::string> args { s_jackpatch_path };
+    if (s_settle_ms >= 0)
+    {
+        args.push_back("--settle");
+        args.push_back(std::to_string(s_settle_ms));
+    }
+    if (s_jackpatch != nullptr)
+    {
+        lo_address_free(s_jackpatch);
+        s_jackpatch = nullptr;
+    }
+
+    bool result = false;
+    pid_t pid = start_child(args);
+    bench_clock::time_point limit =
+        bench_clock::now() + std::chrono::milliseconds(10000);
+
+    while (s_jackpatch == nullptr && bench_clock::now() < limit)
+        (void) lo_server_recv_noblock(srv, 50);
+
+    if (s_jackpatch != nullptr)
+    {
+        result = true;
+
+        prepare(e, "/nsm/client/open");
+        bench_clock::time_point begin = bench_clock::now();
+        lo_send_from
+        (
+            s_jackpatch, srv, LO_TT_IMMEDIATE, "/nsm/client/open", "sss",
+            project.c_str(), name.c_str(), "nJPBN"
+        );
+        bool ok = wait_for(srv, &e, count);
+        result_line(bs, count, "restore", ok ? elapsed_ms(begin) : -1.0);
+        result = result && ok;
+
+        jack_client_close(s_clients[0]);
+        s_clients[0] = nullptr;
+        ok = wait_for(srv, nullptr, count - first);
+        begin = bench_clock::now();
+        ok = ok && open_client(0, bs.bs_ports) && wait_for(srv, nullptr, count);
+        result_line(bs, count, "hotplug", ok ? elapsed_ms(begin) : -1.0);
+        result = result && ok;
+
+        const char * saves [] = { "save", "resave" };
+        for (const char * op : saves)
+        {
+            prepare(e, "/nsm/client/save");
+            begin = bench_clock::now();
+            lo_send_from
+            (
+                s_jackpatch, srv, LO_TT_IMMEDIATE, "/nsm/client/save", ""
+            );
+            ok = wait_for(srv, &e, -1);
+            result_line(bs, count, op, ok ? elapsed_ms(begin) : -1.0);
+            result = result && ok;
+        }
+    }
+    else
+        std::fprintf(stderr, "jackpatch66 did not announce\n");
+
+    stop_child(pid);
+    close_clients();
+    (void) wait_for(srv, nullptr, 0);
+    return result;
+}
+
+int
+remove_entry (const char * path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+void
+help ()
+{
+    std::printf
+    (
+"jackpatch_jack_bench - times jackpatch66 on a dummy JACK server\n\n"
+"Usage: jackpatch_jack_bench --jackpatch path [ options ]\n\n"
+"   --jackpatch path   The jackpatch66 executable to run.\n"
+"   --jackd path       The jackd executable. Default \"jackd\".\n"
+"   --sizes list       Sizes as clientsxportsxfanout, comma-separated.\n"
+"                      Default 10x5x2,20x10x5,30x20x5,50x20x10, which\n"
+"                      is 100, 1000, 3000, and 10000 connections.\n"
+"   --settle ms        Passed on to jackpatch66.\n"
+"   --verbose          Show the output of jackd and jackpatch66.\n"
+"   --help             Show this help.\n"
+    );
+}
+
+bool
+parse_sizes (const std::string & text)
+{
+    s_sizes.clear();
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t comma = text.find(',', pos);
+        if (comma == std::string::npos)
+            comma = text.size();
+
+        std::string item = text.substr(pos, comma - pos);
+        bench_size bs { 0, 0, 0 };
+        if
+        (
+            std::sscanf
+            (
+                item.c_str(), "%dx%dx%d",
+                &bs.bs_clients, &bs.bs_ports, &bs.bs_fanout
+            ) != 3 ||
+            bs.bs_ports <= 0 || bs.bs_fanout <= 0 ||
+            bs.bs_fanout >= bs.bs_clients
+        )
+        {
+            return false;
+        }
+        s_sizes.push_back(bs);
+        pos = comma + 1;
+    }
+    return ! s_sizes.empty();
+}
+
+bool
+parse_cli (int argc, char * argv [])
+{
+    static struct option long_opts [] =
+    {
+        { "jackpatch",      required_argument,  0, 'j' },
+        { "jackd",          required_argument,  0, 'J' },
+        { "sizes",          required_argument,  0, 's' },
+        { "settle",         required_argument,  0, 'S' },
+        { "verbose",        no_argument,        0, 'v' },
+        { "help",           no_argument,        0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != (-1))
+    {
+        switch (c)
+        {
+            case 'j':
+
+                s_jackpatch_path = optarg;
+                break;
+
+            case 'J':
+
+                s_jackd_path = optarg;
+                break;
+
+            case 's':
+
+                if (! parse_sizes(optarg))
+                    return false;
+                break;
+
+            case 'S':
+
+                s_settle_ms = std::atoi(optarg);
+                break;
+
+            case 'v':
+
+                s_verbose = true;
+                break;
+
+            case 'h':
+
+                help();
+                exit(EXIT_SUCCESS);
+                break;
+
+            default:
+
+                return false;
+        }
+    }
+    return ! s_jackpatch_path.empty();
+}
+
+}           // namespace anonymous
+
+/*
+ * main() routine
+ */
+
+int
+main (int argc, char * argv [])
+{
+    if (! parse_cli(argc, argv))
+    {
+        help();
+        return EXIT_FAILURE;
+    }
+
+    char root [] = "/tmp/jackpatch-jack-bench-XXXXXX";
+    if (mkdtemp(root) == nullptr)
+    {
+        std::perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    s_root = root;
+
+    std::string server = "jpbench" + std::to_string(getpid());
+    setenv("JACK_DEFAULT_SERVER", server.c_str(), 1);   /* for all clients  */
+    setenv("JACK_NO_AUDIO_RESERVATION", "1", 1);
+
+    int status = c_exit_skip;
+    jack_client_t * monitor = nullptr;
+    pid_t jackd = start_jackd(server);
+    for (int i = 0; jackd > 0 && i < 100 && monitor == nullptr; ++i)
+    {
+        jack_status_t jstatus;
+        monitor = jack_client_open
+        (
+            "jpbench-monitor", JackNoStartServer, &jstatus
+        );
+        if (monitor == nullptr)
+            usleep(100000);
+    }
+    if (monitor != nullptr)
+    {
+        (void) jack_set_port_connect_callback(monitor, connect_callback, NULL);
+        status = EXIT_FAILURE;
+        lo_server srv = lo_server_new(nullptr, nullptr);
+        if (jack_activate(monitor) == 0 && srv != nullptr)
+        {
+            expectation e { "", false, false, "" };
+            char * url = lo_server_get_url(srv);
+            setenv("NSM_URL", url, 1);
+            std::free(url);
+            (void) lo_server_add_method
+            (
+                srv, "/nsm/server/announce", NULL, announce_handler, srv
+            );
+            (void) lo_server_add_method(srv, "/reply", NULL, reply_handler, &e);
+            (void) lo_server_add_method(srv, "/error", NULL, reply_handler, &e);
+
+            bool ok = true;
+            std::printf
+            (
+                "# clients,ports,fanout,connections,operation,ms,result\n"
+            );
+            for (const auto & bs : s_sizes)
+                ok = run_size(srv, e, bs) && ok;
+
+            if (ok)
+                status = EXIT_SUCCESS;
+        }
+        if (s_jackpatch != nullptr)
+            lo_address_free(s_jackpatch);
+
+        if (srv != nullptr)
+            lo_server_free(srv);
+
+        jack_client_close(monitor);
+    }
+    else
+        std::fprintf(stderr, "Cannot start jackd; skipping\n");
+
+    stop_child(jackd);
+    (void) nftw(s_root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return status;
+}
+
+/*
+ * jackpatch_jack_bench.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */
@@ -0,0 +1,664 @@
+/*
+ *  This file is part of nsm66.
+ *
+ *  nsm66 is free software; you can redistribute it and/or modify it under the
+ *  terms of the GNU General Public License as published by the Free Software
+ *  Foundation; either version 2 of the License, or (at your option) any later
+ *  version.
+ *
+ *  nsm66 is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with nsm66; if not, write to the Free Software Foundation, Inc., 59 Temple
+ *  Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * \file          nsmd_bench.cpp
+ *
+ *      A benchmark of the session operations of the nsm66d daemon, with
+ *      synthetic NSM clients.
+ *
+ * \library       nsm66
+ * \author        Chris Ahlstrom and other authors; see documentation
+ * \date          2026-10-14
+ * \updates       2026-10-14
+ * \license       See above.
+ *
+ *  The program has two roles, picked by the name it is run as:
+ *
+ *      -   As "nsmd_bench" it is the harness.  It makes a temporary
+ *          session root, starts the daemon on it, and for each client
+ *          count times the open, save, switch (open of a second session
+ *          with the same clients), duplicate, and close operations.
+ *      -   As "nsmd-bench-client*" it is a synthetic client, launched by
+ *          the daemon through symbolic links in the session root:
+ *
+ *          -   "nsmd-bench-client": announces with ":switch:".
+ *          -   "nsmd-bench-client-noswitch": announces without it, so it
+ *              is killed and relaunched on a switch.
+ *          -   "nsmd-bench-client-dumb": never announces.
+ *
+ *          The delays come from the environment, which the daemon passes
+ *          on: NSMD_BENCH_ANNOUNCE_MS and NSMD_BENCH_SAVE_MS.
+ *
+ *  The results go to standard output as CSV lines, "clients,operation,
+ *  ms,result", after a "#" header line, for comparison between builds.
+ */
+
+#include <arpa/inet.h>                  /* htonl()                          */
+#include <chrono>                       /* std::chrono::steady_clock        */
+#include <csignal>                      /* std::signal(), SIGTERM           */
+#include <cstdio>                       /* std::printf(), std::fprintf()    */
+#include <cstdlib>                      /* EXIT_SUCCESS, std::getenv()      */
+#include <cstring>                      /* std::strerror()                  */
+#include <fstream>                      /* std::ofstream                    */
+#include <ftw.h>                        /* nftw()                           */
+#include <getopt.h>                     /* getopt_long()                    */
+#include <netinet/in.h>                 /* struct sockaddr_in               */
+#include <string>                       /* std::string                      */
+#include <sys/socket.h>                 /* socket(), bind()                 */
+#include <sys/stat.h>                   /* mkdir()                          */
+#include <sys/wait.h>                   /* waitpid()                        */
+#include <unistd.h>                     /* fork(), execv(), usleep()        */
+#include <vector>                       /* std::vector<>                    */
+
+#include "lo/lo.h"                      /* liblo C API                      */
+
+namespace   // anonymous
+{
+
+/*-------------------------------------------------------------------------
+ * The synthetic client
+ *-------------------------------------------------------------------------*/
+
+volatile sig_atomic_t s_client_quit { 0 };
+
+void
+client_signal (int sig)
+{
+    (void) sig;
+    s_client_quit = 1;
+}
+
+long
+env_ms (const char * name)
+{
+    const char * v = std::getenv(name);
+    return v != nullptr ? std::atol(v) : 0 ;
+}
+
+int
+client_open
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) types;
+    if (argc >= 1)
+        (void) mkdir(&argv[0]->s, 0755);
+
+    lo_address a = lo_message_get_source(msg);
+    lo_server srv = static_cast<lo_server>(user_data);
+    lo_send_from(a, srv, LO_TT_IMMEDIATE, "/reply", "ss",
+        "/nsm/client/open", "OK");
+    return 0;
+}
+
+int
+client_save
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) path; (void) types; (void) argv; (void) argc;
+    long ms = env_ms("NSMD_BENCH_SAVE_MS");
+    if (ms > 0)
+        usleep(useconds_t(ms * 1000));
+
+    lo_address a = lo_message_get_source(msg);
+    lo_server srv = static_cast<lo_server>(user_data);
+    lo_send_from(a, srv, LO_TT_IMMEDIATE, "/reply", "ss",
+        "/nsm/client/save", "OK");
+    return 0;
+}
+
+int
+client_main (const std::string & name)
+{
+    std::signal(SIGTERM, client_signal);
+    std::signal(SIGINT, client_signal);
+    bool dumb = name.find("-dumb") != std::string::npos;
+    bool canswitch = name.find("-noswitch") == std::string::npos;
+    const char * url = std::getenv("NSM_URL");
+    if (dumb || url == nullptr)
+    {
+        while (s_client_quit == 0)
+            (void) pause();
+
+        return EXIT_SUCCESS;
+    }
+
+    const char * port = std::getenv("NSM_CLIENT_PORT");
+    lo_server srv = lo_server_new(port, nullptr);
+    if (srv == nullptr)
+        srv = lo_server_new(nullptr, nullptr);
+
+    lo_address daemon = lo_address_new_from_url(url);
+    if (srv == nullptr || daemon == nullptr)
+        return EXIT_FAILURE;
+
+    (void) lo_server_add_method(srv, "/nsm/client/open", "sss",
+        client_open, srv);
+    (void) lo_server_add_method(srv, "/nsm/client/save", "",
+        client_save, srv);
+
+    long ms = env_ms("NSMD_BENCH_ANNOUNCE_MS");
+    if (ms > 0)
+        usleep(useconds_t(ms * 1000));
+
+    lo_send_from(daemon, srv, LO_TT_IMMEDIATE, "/nsm/server/announce",
+        "sssiii", "BenchClient", canswitch ? ":switch:" : ":",
+        name.c_str(), 1, 2, int(getpid()));
+
+    while (s_client_quit == 0)
+        (void) lo_server_recv_noblock(srv, 100);
+
+    lo_address_free(daemon);
+    lo_server_free(srv);
+    return EXIT_SUCCESS;
+}
+
+/*-------------------------------------------------------------------------
+ * The harness
+ *-------------------------------------------------------------------------*/
+
+using bench_clock = std::chrono::steady_clock;
+
+/**
+ *  The reply the harness waits for: "/reply path okmessage", or any
+ *  "/error path ...".
+ */
+
+using expectation = struct
+{
+    std::string e_path;
+    std::string e_ok;
+    bool e_done;
+    bool e_failed;
+    std::string e_error;
+};
+
+const char * const c_client_base = "nsmd-bench-client";
+
+std::string s_nsmd_path;
+std::string s_root;
+std::vector<int> s_counts { 1, 10, 50, 200 };
+std::vector<std::string> s_nsmd_args;
+long s_announce_ms { 0 };
+long s_save_ms { 0 };
+int s_dumb_every { 0 };
+bool s_no_switch { false };
+bool s_verbose { false };
+
+int
+harness_reply
+(
+    const char * path, const char * types,
+    lo_arg ** argv, int argc, lo_message msg, void * user_data
+)
+{
+    (void) types; (void) msg;
+    expectation * e = static_cast<expectation *>(user_data);
+    if (argc < 1 || std::string(&argv[0]->s) != e->e_path)
+        return 0;
+
+    if (std::string(path) == "/error")
+    {
+        e->e_done = e->e_failed = true;
+        if (argc >= 3)
+            e->e_error = &argv[2]->s;
+    }
+    else if (e->e_ok.empty() || (argc >= 2 && &argv[1]->s == e->e_ok))
+        e->e_done = true;
+
+    return 0;
+}
+
+/*
+ *  Finds a free UDP port for the daemon.  There is a small race with
+ *  other programs, which is acceptable for a benchmark.
+ */
+
+int
+free_udp_port ()
+{
+    int result = 0;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd >= 0)
+    {
+        struct sockaddr_in sa {};
+        socklen_t len = sizeof sa;
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sa.sin_port = 0;
+        if
+        (
+            bind(fd, reinterpret_cast<struct sockaddr *>(&sa), len) == 0 &&
+            getsockname(fd, reinterpret_cast<struct sockaddr *>(&sa), &len)
+                == 0
+        )
+        {
+            result = ntohs(sa.sin_port);
+        }
+        close(fd);
+    }
+    return result;
+}
+
+int
+remove_entry (const char * path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+std::string
+client_id (char prefix, int index)
+{
+    std::string result { "n" };
+    result += prefix;
+    for (int i = 0; i < 3; ++i)
+    {
+        result += char('A' + index % 26);
+        index /= 26;
+    }
+    return result;
+}
+
+/*
+ *  Writes a session of "count" synthetic clients.  Every s_dumb_every-th
+ *  client is dumb.
+ */
+
+bool
+write_session (const std::string & name, int count, char idprefix)
+{
+    std::string dir = s_root + "/" + name;
+    if (mkdir(dir.c_str(), 0755) != 0)
+        return false;
+
+    std::ofstream out(dir + "/session.nsm");
+    std::string base = s_root + "/" + c_client_base;
+    for (int i = 0; i < count; ++i)
+    {
+        bool dumb = s_dumb_every > 0 && (i + 1) % s_dumb_every == 0;
+        std::string exe = base;
+        if (dumb)
+            exe += "-dumb";
+        else if (s_no_switch)
+            exe += "-noswitch";
+
+        out << "BenchClient:" << exe << ":" << client_id(idprefix, i) << "\n";
+    }
+    return bool(out);
+}
+
+bool
+make_client_links ()
+{
+    char self[4096];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof self - 1);
+    if (n <= 0)
+        return false;
+
+    self[n] = 0;
+    std::string base = s_root + "/" + c_client_base;
+    return
+        symlink(self, base.c_str()) == 0 &&
+        symlink(self, (base + "-noswitch").c_str()) == 0 &&
+        symlink(self, (base + "-dumb").c_str()) == 0;
+}
+
+pid_t
+start_daemon (int port)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<std::string> args
+        {
+            s_nsmd_path, "--session-root", s_root,
+            "--osc-port", std::to_string(port)
+        };
+        if (! s_verbose)
+            args.push_back("--quiet");
+
+        for (const auto & a : s_nsmd_args)
+            args.push_back(a);
+
+        std::vector<char *> argv;
+        for (auto & a : args)
+            argv.push_back(&a[0]);
+
+        argv.push_back(nullptr);
+        if (! s_verbose)
+        {
+            if (freopen("/dev/null", "w", stdout) == nullptr)
+                std::perror("freopen");
+        }
+        execv(s_nsmd_path.c_str(), argv.data());
+        std::fprintf
+        (
+            stderr, "Cannot run %s: %s\n",
+            s_nsmd_path.c_str(), std::strerror(errno)
+        );
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+/**
+ *  Sends a request and waits for its reply.
+ *
+ * \return
+ *      Returns the time to the reply in milliseconds, or -1 on an error
+ *      or a timeout.
+ */
+
+double
+request
+(
+    lo_server srv, lo_address daemon, expectation & e,
+    const std::string & path, const std::string & ok, const char * arg,
+    long timeout_ms = 120000
+)
+{
+    e.e_path = path;
+    e.e_ok = ok;
+    e.e_done = e.e_failed = false;
+    e.e_error.clear();
+
+    bench_clock::time_point begin = bench_clock::now();
+    if (arg != nullptr)
+        lo_send_from(daemon, srv, LO_TT_IMMEDIATE, path.c_str(), "s", arg);
+    else
+        lo_send_from(daemon, srv, LO_TT_IMMEDIATE, path.c_str(), "");
+
+    bench_clock::time_point limit =
+        begin + std::chrono::milliseconds(timeout_ms);
+    while (! e.e_done && bench_clock::now() < limit)
+        (void) lo_server_recv_noblock(srv, 50);
+
+    double ms = std::chrono::duration<double, std::milli>
+    (
+        bench_clock::now() - begin
+    ).count();
+    return e.e_done && ! e.e_failed ? ms : -1.0 ;
+}
+
+bool
+wait_for_daemon (lo_server srv, lo_address daemon, expectation & e)
+{
+    for (int i = 0; i < 50; ++i)
+    {
+        if (request(srv, daemon, e, "/osc/ping", "", nullptr, 200) >= 0.0)
+            return true;
+    }
+    return false;
+}
+
+void
+result_line (int count, const char * op, double ms, const expectation & e)
+{
+    std::printf
+    (
+        "%d,%s,%.1f,%s\n", count, op, ms,
+        ms >= 0.0 ? "ok" : (e.e_failed ? "error" : "timeout")
+    );
+    std::fflush(stdout);
+    if (ms < 0.0 && ! e.e_error.empty())
+        std::fprintf(stderr, "%s: %s\n", op, e.e_error.c_str());
+}
+
+bool
+run_counts (lo_server srv, lo_address daemon)
+{
+    bool result = true;
+    expectation e { "", "", false, false, "" };
+    (void) lo_server_add_method(srv, "/reply", NULL, harness_reply, &e);
+    (void) lo_server_add_method(srv, "/error", NULL, harness_reply, &e);
+    if (! wait_for_daemon(srv, daemon, e))
+    {
+        std::fprintf(stderr, "The daemon did not answer /osc/ping\n");
+        return false;
+    }
+    std::printf("# clients,operation,ms,result\n");
+    for (int count : s_counts)
+    {
+        std::string a = "bench-" + std::to_string(count) + "-a";
+        std::string b = "bench-" + std::to_string(count) + "-b";
+        std::string c = "bench-" + std::to_string(count) + "-c";
+        if (! write_session(a, count, 'A') || ! write_session(b, count, 'B'))
+        {
+            std::fprintf(stderr, "Cannot write the sessions\n");
+            return false;
+        }
+
+        double ms = request(srv, daemon, e, "/nsm/server/open", "Loaded",
+            a.c_str());
+        result_line(count, "open", ms, e);
+        result = result && ms >= 0.0;
+
+        ms = request(srv, daemon, e, "/nsm/server/save", "Saved", nullptr);
+        result_line(count, "save", ms, e);
+        result = result && ms >= 0.0;
+
+        ms = request(srv, daemon, e, "/nsm/server/open", "Loaded", b.c_str());
+        result_line(count, "switch", ms, e);
+        result = result && ms >= 0.0;
+
+        ms = request(srv, daemon, e, "/nsm/server/duplicate", "Duplicated",
+            c.c_str());
+        result_line(count, "duplicate", ms, e);
+        result = result && ms >= 0.0;
+
+        ms = request(srv, daemon, e, "/nsm/server/close", "Closed", nullptr);
+        result_line(count, "close", ms, e);
+        result = result && ms >= 0.0;
+    }
+    return result;
+}
+
+void
+help ()
+{
+    std::printf
+    (
+"nsmd_bench - times nsm66d session operations with synthetic clients\n\n"
+"Usage: nsmd_bench --nsmd path [ options ] [ -- nsmd options ]\n\n"
+"   --nsmd path        The nsm66d executable to run.\n"
+"   --counts list      Client counts, comma-separated. Default 1,10,50,200.\n"
+"   --announce-ms ms   Delay before each client announces. Default 0.\n"
+"   --save-ms ms       Delay before each client replies to save. Default 0.\n"
+"   --dumb-every n     Every n-th client never announces. Default 0, none.\n"
+"   --no-switch        Clients lack :switch:, so a switch relaunches them.\n"
+"   --verbose          Show the output of the daemon.\n"
+"   --help             Show this help.\n"
+    );
+}
+
+bool
+parse_counts (const std::string & text)
+{
+    s_counts.clear();
+    std::size_t pos = 0;
+    while (pos < text.size())
+    {
+        std::size_t comma = text.find(',', pos);
+        if (comma == std::string::npos)
+            comma = text.size();
+
+        int n = std::atoi(text.substr(pos, comma - pos).c_str());
+        if (n <= 0)
+            return false;
+
+        s_counts.push_back(n);
+        pos = comma + 1;
+    }
+    return ! s_counts.empty();
+}
+
+bool
+parse_cli (int argc, char * argv [])
+{
+    static struct option long_opts [] =
+    {
+        { "nsmd",           required_argument,  0, 'n' },
+        { "counts",         required_argument,  0, 'c' },
+        { "announce-ms",    required_argument,  0, 'a' },
+        { "save-ms",        required_argument,  0, 's' },
+        { "dumb-every",     required_argument,  0, 'd' },
+        { "no-switch",      no_argument,        0, 'S' },
+        { "verbose",        no_argument,        0, 'v' },
+        { "help",           no_argument,        0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_opts, nullptr)) != (-1))
+    {
+        switch (c)
+        {
+            case 'n':
+
+                s_nsmd_path = optarg;
+                break;
+
+            case 'c':
+
+                if (! parse_counts(optarg))
+                    return false;
+                break;
+
+            case 'a':
+
+                s_announce_ms = std::atol(optarg);
+                break;
+
+            case 's':
+
+                s_save_ms = std::atol(optarg);
+                break;
+
+            case 'd':
+
+                s_dumb_every = std::atoi(optarg);
+                break;
+
+            case 'S':
+
+                s_no_switch = true;
+                break;
+
+            case 'v':
+
+                s_verbose = true;
+                break;
+
+            case 'h':
+
+                help();
+                exit(EXIT_SUCCESS);
+                break;
+
+            default:
+
+                return false;
+        }
+    }
+    for (int i = optind; i < argc; ++i)
+        s_nsmd_args.push_back(argv[i]);
+
+    return ! s_nsmd_path.empty();
+}
+
+int
+harness_main (int argc, char * argv [])
+{
+    if (! parse_cli(argc, argv))
+    {
+        help();
+        return EXIT_FAILURE;
+    }
+
+    char root [] = "/tmp/nsmd-bench-XXXXXX";
+    if (mkdtemp(root) == nullptr)
+    {
+        std::perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    s_root = root;
+    if (! make_client_links())
+    {
+        std::perror("symlink");
+        return EXIT_FAILURE;
+    }
+    setenv("NSMD_BENCH_ANNOUNCE_MS", std::to_string(s_announce_ms).c_str(), 1);
+    setenv("NSMD_BENCH_SAVE_MS", std::to_string(s_save_ms).c_str(), 1);
+
+    bool ok = false;
+    int port = free_udp_port();
+    pid_t pid = port > 0 ? start_daemon(port) : pid_t(-1) ;
+    if (pid > 0)
+    {
+        std::string url = "osc.udp://127.0.0.1:" + std::to_string(port) + "/";
+        lo_server srv = lo_server_new(nullptr, nullptr);
+        lo_address daemon = lo_address_new_from_url(url.c_str());
+        if (srv != nullptr && daemon != nullptr)
+            ok = run_counts(srv, daemon);
+
+        if (daemon != nullptr)
+            lo_address_free(daemon);
+
+        if (srv != nullptr)
+            lo_server_free(srv);
+
+        kill(pid, SIGTERM);
+        (void) waitpid(pid, nullptr, 0);
+    }
+    else
+        std::fprintf(stderr, "Cannot start the daemon\n");
+
+    (void) nftw(s_root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE ;
+}
+
+}           // namespace anonymous
+
+/*
+ * main() routine
+ */
+
+int
+main (int argc, char * argv [])
+{
+    std::string name { argv[0] };
+    std::size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+
+    if (name.compare(0, 17, c_client_base) == 0)
+        return client_main(name);
+
+    return harness_main(argc, argv);
+}
+
+/*
+ * nsmd_bench.cpp
+ *
+ * vim: sw=4 ts=4 wm=4 et ft=cpp
+ */